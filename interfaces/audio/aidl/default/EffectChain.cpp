@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <utility>
+#define LOG_TAG "AHAL_EffectChain"
+
+#include "effect-impl/EffectChain.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+EffectChain::EffectChain(const Descriptor& descriptor, std::vector<Member> members)
+    : mDescriptor(descriptor), mMembers(std::move(members)) {}
+
+EffectChain::~EffectChain() {
+    cleanUp();
+}
+
+ndk::ScopedAStatus EffectChain::open(const Parameter::Common& common,
+                                     const std::optional<Parameter::Specific>& specific,
+                                     OpenEffectReturn* ret) {
+    // members process in place in the work buffer of the chain
+    RETURN_IF(common.input.base != common.output.base, EX_ILLEGAL_ARGUMENT, "configNotInPlace");
+    RETURN_IF_ASTATUS_NOT_OK(EffectImpl::open(common, std::nullopt, ret), "openChainFailed");
+
+    for (const auto& member : mMembers) {
+        OpenEffectReturn memberRet;
+        if (!member.effect->open(common, std::nullopt, &memberRet).isOk() ||
+            member.interface->setEffectFusedFunc(member.effect, true) != EX_NONE) {
+            close();
+            return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_STATE,
+                                                                    "openMemberFailed");
+        }
+    }
+
+    if (specific.has_value()) {
+        std::lock_guard lg(mImplMutex);
+        RETURN_IF_ASTATUS_NOT_OK(setParameterSpecific(specific.value()), "setSpecParamErr");
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus EffectChain::close() {
+    RETURN_IF_ASTATUS_NOT_OK(EffectImpl::close(), "closeChainFailed");
+    closeMembers();
+    return ndk::ScopedAStatus::ok();
+}
+
+void EffectChain::closeMembers() {
+    for (const auto& member : mMembers) {
+        if (!member.effect->close().isOk() ||
+            member.interface->setEffectFusedFunc(member.effect, false) != EX_NONE) {
+            LOG(ERROR) << getEffectName() << __func__ << " failed to close member "
+                       << member.effect.get();
+        }
+    }
+}
+
+ndk::ScopedAStatus EffectChain::getDescriptor(Descriptor* desc) {
+    *desc = mDescriptor;
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus EffectChain::commandImpl(CommandId command) {
+    RETURN_IF_ASTATUS_NOT_OK(EffectImpl::commandImpl(command), "commandImplFailed");
+    for (const auto& member : mMembers) {
+        RETURN_IF_ASTATUS_NOT_OK(member.effect->command(command), "memberCommandFailed");
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus EffectChain::setParameterCommon(const Parameter& param) {
+    RETURN_IF_ASTATUS_NOT_OK(EffectImpl::setParameterCommon(param), "setCommonParamFailed");
+    for (const auto& member : mMembers) {
+        RETURN_IF_ASTATUS_NOT_OK(member.effect->setParameter(param), "setMemberParamFailed");
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus EffectChain::setParameterSpecific(const Parameter::Specific& specific) {
+    const auto param = Parameter::make<Parameter::specific>(specific);
+    for (const auto& member : mMembers) {
+        if (member.effect->setParameter(param).isOk()) {
+            return ndk::ScopedAStatus::ok();
+        }
+    }
+    LOG(ERROR) << getEffectName() << __func__ << " no member accepts " << specific.toString();
+    return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
+                                                            "SpecificParamNotSupported");
+}
+
+ndk::ScopedAStatus EffectChain::getParameterSpecific(const Parameter::Id& id,
+                                                     Parameter::Specific* specific) {
+    for (const auto& member : mMembers) {
+        if (Parameter param; member.effect->getParameter(id, &param).isOk()) {
+            *specific = param.get<Parameter::specific>();
+            return ndk::ScopedAStatus::ok();
+        }
+    }
+    return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
+                                                            "SpecificParamNotSupported");
+}
+
+IEffect::Status EffectChain::effectProcessImpl(float* in, float* out, int samples) {
+    if (in != out) {
+        std::copy(in, in + samples, out);
+    }
+    for (const auto& member : mMembers) {
+        IEffect::Status memberStatus;
+        if (member.interface->processFusedEffectFunc(member.effect, out, samples,
+                                                     &memberStatus) != EX_NONE ||
+            memberStatus.status != STATUS_OK || memberStatus.fmqProduced != samples) {
+            LOG(ERROR) << getEffectName() << __func__ << " member " << member.effect.get()
+                       << " failed with " << memberStatus.toString();
+            return status(STATUS_INVALID_OPERATION, samples, 0);
+        }
+    }
+    return status(STATUS_OK, samples, samples);
+}
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -137,6 +137,10 @@ bool EffectConfig::parseLibrary(const tinyxml2::XMLElement& xml) {
 }
 
 bool EffectConfig::parseEffect(const tinyxml2::XMLElement& xml) {
+    if (std::strcmp(xml.Name(), "effectChain") == 0) {
+        return parseEffectChain(xml);
+    }
+
     struct EffectLibraries effectLibraries;
     std::vector<Library> libraries;
     std::string name = xml.Attribute("name");
@@ -169,6 +173,27 @@ bool EffectConfig::parseEffect(const tinyxml2::XMLElement& xml) {
     return true;
 }
 
+bool EffectConfig::parseEffectChain(const tinyxml2::XMLElement& xml) {
+    const char* name = xml.Attribute("name");
+    RETURN_VALUE_IF(!name, false, "chainNoName");
+
+    LOG(VERBOSE) << __func__ << dump(xml);
+    // a chain has no library, only the uuid and type attributes of a proxy
+    struct Library library;
+    RETURN_VALUE_IF(!parseLibrary(xml, library, true), false, "parseChainUuidFailed");
+    struct Chain chain;
+    chain.uuid = library.uuid;
+    chain.type = library.type;
+    for (auto& apply : getChildren(xml, "apply")) {
+        const char* effect = apply.get().Attribute("effect");
+        RETURN_VALUE_IF(!effect, false, "noEffectAttribute");
+        chain.effects.emplace_back(effect);
+    }
+    RETURN_VALUE_IF(chain.effects.empty(), false, "noEffectInChain");
+    mChainsMap[name] = std::move(chain);
+    return true;
+}
+
 bool EffectConfig::parseLibrary(const tinyxml2::XMLElement& xml, struct Library& library,
                                 bool isProxy) {
     // Retrieve library name only if not effectProxy element
@@ -252,11 +277,19 @@ bool EffectConfig::parseProcessing(Processing::Type::Tag typeTag, const tinyxml2
 
     for (auto& apply : getChildren(xml, "apply")) {
         const char* name = apply.get().Attribute("effect");
+        RETURN_VALUE_IF(!name, false, "noEffectAttribute");
+        if (auto chain = mChainsMap.find(name); chain != mChainsMap.end()) {
+            // the chain is created by the Factory, not by a library
+            struct EffectLibraries effectLibraries;
+            effectLibraries.libraries.push_back(
+                    {.name = name, .uuid = chain->second.uuid, .type = chain->second.type});
+            mProcessingMap[aidlType.value()].emplace_back(std::move(effectLibraries));
+            continue;
+        }
         if (mEffectsMap.find(name) == mEffectsMap.end()) {
             LOG(ERROR) << __func__ << " effect " << name << " doesn't exist, skipping";
             continue;
         }
-        RETURN_VALUE_IF(!name, false, "noEffectAttribute");
         mProcessingMap[aidlType.value()].emplace_back(mEffectsMap[name]);
     }
     return true;
@@ -29,6 +29,7 @@
 #include <system/audio_effects/effect_uuid.h>
 #include <system/thread_defs.h>
 
+#include "effect-impl/EffectChain.h"
 #include "effect-impl/EffectTypes.h"
 #include "effectFactory-impl/EffectFactory.h"
 
@@ -36,9 +37,25 @@ using aidl::android::media::audio::common::AudioUuid;
 
 namespace aidl::android::hardware::audio::effect {
 
+namespace {
+
+binder_exception_t destroyChainMembers(const std::vector<EffectChain::Member>& members) {
+    binder_exception_t ret = EX_NONE;
+    for (const auto& member : members) {
+        if (auto exception = member.interface->destroyEffectFunc(member.effect);
+            exception != EX_NONE) {
+            ret = exception;
+        }
+    }
+    return ret;
+}
+
+}  // namespace
+
 Factory::Factory(const std::string& file) : mConfig(EffectConfig(file)) {
     LOG(DEBUG) << __func__ << " with config file: " << file;
     loadEffectLibs();
+    loadEffectChains();
 }
 
 Factory::~Factory() {
@@ -68,6 +85,27 @@ ndk::ScopedAStatus Factory::getDescriptorWithUuid_l(const AudioUuid& uuid, Descr
         return ndk::ScopedAStatus::ok();
     }
 
+    if (auto chainIt = mEffectChainMap.find(uuid); chainIt != mEffectChainMap.end()) {
+        const auto& chain = chainIt->second;
+        // flags and capability of the first member of the chain type, or of the first member
+        std::optional<Descriptor> base;
+        for (const auto& member : chain.members) {
+            Descriptor memberDesc;
+            RETURN_IF_ASTATUS_NOT_OK(getDescriptorWithUuid_l(member, &memberDesc),
+                                     "getMemberDescriptorFailed");
+            if (!base.has_value() || (base->common.id.type != chain.type &&
+                                      memberDesc.common.id.type == chain.type)) {
+                base = std::move(memberDesc);
+            }
+        }
+        *desc = std::move(base.value());
+        desc->common.id.type = chain.type;
+        desc->common.id.uuid = uuid;
+        desc->common.id.proxy = std::nullopt;
+        desc->common.name = chain.name;
+        return ndk::ScopedAStatus::ok();
+    }
+
     return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
 }
 
@@ -87,7 +125,7 @@ ndk::ScopedAStatus Factory::queryEffects(const std::optional<AudioUuid>& in_type
                  });
     // query through the matching list
     for (const auto& id : idList) {
-        if (mEffectLibMap.count(id.uuid)) {
+        if (mEffectLibMap.count(id.uuid) || mEffectChainMap.count(id.uuid)) {
             Descriptor desc;
             RETURN_IF_ASTATUS_NOT_OK(getDescriptorWithUuid_l(id.uuid, &desc),
                                      "getDescriptorFailed");
@@ -129,30 +167,54 @@ ndk::ScopedAStatus Factory::createEffect(const AudioUuid& in_impl_uuid,
                                          std::shared_ptr<IEffect>* _aidl_return) {
     LOG(DEBUG) << __func__ << ": UUID " << ::android::audio::utils::toString(in_impl_uuid);
     std::lock_guard lg(mMutex);
-    if (mEffectLibMap.count(in_impl_uuid)) {
+    std::shared_ptr<IEffect> effectSp;
+    if (mEffectChainMap.count(in_impl_uuid)) {
+        RETURN_IF_ASTATUS_NOT_OK(createEffectChain_l(in_impl_uuid, &effectSp),
+                                 "createEffectChainFailed");
+    } else if (mEffectLibMap.count(in_impl_uuid)) {
         auto& entry = mEffectLibMap[in_impl_uuid];
         getDlSyms_l(entry);
 
         auto& libInterface = std::get<kMapEntryInterfaceIndex>(entry);
         RETURN_IF(!libInterface || !libInterface->createEffectFunc, EX_NULL_POINTER,
                   "dlNullcreateEffectFunc");
-        std::shared_ptr<IEffect> effectSp;
         RETURN_IF_BINDER_EXCEPTION(libInterface->createEffectFunc(&in_impl_uuid, &effectSp));
         if (!effectSp) {
             LOG(WARNING) << __func__ << ": library created null instance without return error!";
             return ndk::ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
         }
-        *_aidl_return = effectSp;
-        ndk::SpAIBinder effectBinder = effectSp->asBinder();
-        AIBinder_setMinSchedulerPolicy(effectBinder.get(), SCHED_NORMAL, ANDROID_PRIORITY_AUDIO);
-        AIBinder_setInheritRt(effectBinder.get(), true);
-        mEffectMap[std::weak_ptr<IEffect>(effectSp)] =
-                std::make_pair(in_impl_uuid, std::move(effectBinder));
-        return ndk::ScopedAStatus::ok();
     } else {
         LOG(ERROR) << __func__ << ": library doesn't exist";
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
+    *_aidl_return = effectSp;
+    ndk::SpAIBinder effectBinder = effectSp->asBinder();
+    AIBinder_setMinSchedulerPolicy(effectBinder.get(), SCHED_NORMAL, ANDROID_PRIORITY_AUDIO);
+    AIBinder_setInheritRt(effectBinder.get(), true);
+    mEffectMap[std::weak_ptr<IEffect>(effectSp)] =
+            std::make_pair(in_impl_uuid, std::move(effectBinder));
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Factory::createEffectChain_l(const AudioUuid& impl,
+                                                std::shared_ptr<IEffect>* chain) {
+    Descriptor desc;
+    RETURN_IF_ASTATUS_NOT_OK(getDescriptorWithUuid_l(impl, &desc), "getDescriptorFailed");
+
+    std::vector<EffectChain::Member> members;
+    for (const auto& memberUuid : mEffectChainMap[impl].members) {
+        // the fused entries of the member libraries were checked by loadEffectChains()
+        auto& libInterface = std::get<kMapEntryInterfaceIndex>(mEffectLibMap[memberUuid]);
+        std::shared_ptr<IEffect> memberSp;
+        if (libInterface->createEffectFunc(&memberUuid, &memberSp) != EX_NONE || !memberSp) {
+            LOG(ERROR) << __func__ << ": failed to create member "
+                       << ::android::audio::utils::toString(memberUuid);
+            destroyChainMembers(members);
+            return ndk::ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
+        }
+        members.push_back({std::move(memberSp), libInterface.get()});
+    }
+    *chain = ndk::SharedRefBase::make<EffectChain>(desc, std::move(members));
     return ndk::ScopedAStatus::ok();
 }
 
@@ -161,8 +223,13 @@ ndk::ScopedAStatus Factory::destroyEffectImpl_l(const std::shared_ptr<IEffect>&
     // find the effect entry with key (std::weak_ptr<IEffect>)
     if (auto effectIt = mEffectMap.find(wpHandle); effectIt != mEffectMap.end()) {
         auto& uuid = effectIt->second.first;
-        // find implementation library with UUID
-        if (auto libIt = mEffectLibMap.find(uuid); libIt != mEffectLibMap.end()) {
+        if (mEffectChainMap.count(uuid)) {
+            State state;
+            RETURN_IF(!in_handle->getState(&state).isOk() || State::INIT != state,
+                      EX_ILLEGAL_STATE, "chainNotClosed");
+            RETURN_IF_BINDER_EXCEPTION(destroyChainMembers(
+                    std::static_pointer_cast<EffectChain>(in_handle)->getMembers()));
+        } else if (auto libIt = mEffectLibMap.find(uuid); libIt != mEffectLibMap.end()) {
             auto& interface = std::get<kMapEntryInterfaceIndex>(libIt->second);
             RETURN_IF(!interface || !interface->destroyEffectFunc, EX_NULL_POINTER,
                       "dlNulldestroyEffectFunc");
@@ -216,7 +283,7 @@ bool Factory::openEffectLibrary(const AudioUuid& impl,
 
     LOG(DEBUG) << __func__ << " dlopen lib: " << path
                << "\nimpl:" << ::android::audio::utils::toString(impl) << "\nhandle:" << libHandle;
-    auto interface = new effect_dl_interface_s{nullptr, nullptr, nullptr};
+    auto interface = new effect_dl_interface_s{nullptr, nullptr, nullptr, nullptr, nullptr};
     mEffectLibMap.insert(
             {impl,
              std::make_tuple(std::move(libHandle),
@@ -269,6 +336,64 @@ void Factory::loadEffectLibs() {
     }
 }
 
+void Factory::loadEffectChains() {
+    std::lock_guard lg(mMutex);
+    const auto& configEffectsMap = mConfig.getEffectsMap();
+    for (const auto& [name, configChain] : mConfig.getChainsMap()) {
+        if (mEffectLibMap.count(configChain.uuid)) {
+            LOG(ERROR) << __func__ << ": effect chain " << name << " uuid used by an effect";
+            continue;
+        }
+        ChainEntry chain = {.name = name, .type = configChain.type.value_or(AudioUuid()),
+                            .members = {}};
+        bool resolved = true;
+        for (const auto& effect : configChain.effects) {
+            // only effects of a library loaded in this process can be fused
+            auto effectIt = configEffectsMap.find(effect);
+            if (effectIt == configEffectsMap.end() ||
+                effectIt->second.proxyLibrary.has_value()) {
+                LOG(ERROR) << __func__ << ": " << effect << " is not a library effect";
+                resolved = false;
+                break;
+            }
+            const AudioUuid& impl = effectIt->second.libraries.front().uuid;
+            auto libIt = mEffectLibMap.find(impl);
+            if (libIt == mEffectLibMap.end()) {
+                LOG(ERROR) << __func__ << ": library of " << effect << " not loaded";
+                resolved = false;
+                break;
+            }
+            getDlSyms_l(libIt->second);
+            auto& libInterface = std::get<kMapEntryInterfaceIndex>(libIt->second);
+            if (!libInterface->createEffectFunc || !libInterface->setEffectFusedFunc ||
+                !libInterface->processFusedEffectFunc) {
+                LOG(ERROR) << __func__ << ": library of " << effect
+                           << " does not support fused processing";
+                resolved = false;
+                break;
+            }
+            // without a type in the config, the chain has the type of its first effect
+            if (!configChain.type.has_value() && chain.members.empty()) {
+                EffectConfig::findUuid(*effectIt, &chain.type);
+            }
+            chain.members.push_back(impl);
+        }
+        if (!resolved || chain.type == AudioUuid()) {
+            LOG(ERROR) << __func__ << ": skipping effect chain " << name;
+            continue;
+        }
+
+        Descriptor::Identity id;
+        id.type = chain.type;
+        id.uuid = configChain.uuid;
+        LOG(DEBUG) << __func__ << " effect chain " << name << ": typeUuid "
+                   << ::android::audio::utils::toString(id.type) << "\nimplUuid "
+                   << ::android::audio::utils::toString(id.uuid);
+        mIdentitySet.insert(std::move(id));
+        mEffectChainMap[configChain.uuid] = std::move(chain);
+    }
+}
+
 void Factory::getDlSyms_l(DlEntry& entry) {
     auto& dlHandle = std::get<kMapEntryHandleIndex>(entry);
     RETURN_VALUE_IF(!dlHandle, void(), "dlNullHandle");
@@ -285,6 +410,15 @@ void Factory::getDlSyms_l(DlEntry& entry) {
         dlInterface->destroyEffectFunc =
                 (EffectDestroyFunctor)dlsym(dlHandle.get(), "destroyEffect");
     }
+    // optional, only libraries built with EffectImpl can be members of an effect chain
+    if (!dlInterface->setEffectFusedFunc) {
+        dlInterface->setEffectFusedFunc =
+                (EffectSetFusedFunctor)dlsym(dlHandle.get(), "setEffectFused");
+    }
+    if (!dlInterface->processFusedEffectFunc) {
+        dlInterface->processFusedEffectFunc =
+                (EffectProcessFusedFunctor)dlsym(dlHandle.get(), "processFusedEffect");
+    }
 
     if (!dlInterface->createEffectFunc || !dlInterface->destroyEffectFunc ||
         !dlInterface->queryEffectFunc) {
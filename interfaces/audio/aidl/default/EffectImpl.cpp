@@ -22,10 +22,12 @@
 #include "effect-impl/EffectTypes.h"
 #include "include/effect-impl/EffectTypes.h"
 
+using aidl::android::hardware::audio::effect::EffectImpl;
 using aidl::android::hardware::audio::effect::IEffect;
 using aidl::android::hardware::audio::effect::kEventFlagDataMqNotEmpty;
 using aidl::android::hardware::audio::effect::kEventFlagNotEmpty;
 using aidl::android::hardware::audio::effect::kReopenSupportedVersion;
+using aidl::android::hardware::audio::effect::RetCode;
 using aidl::android::hardware::audio::effect::State;
 using aidl::android::media::audio::common::PcmType;
 using ::android::hardware::EventFlag;
@@ -41,6 +43,28 @@ extern "C" binder_exception_t destroyEffect(const std::shared_ptr<IEffect>& inst
     return EX_NONE;
 }
 
+extern "C" binder_exception_t setEffectFused(const std::shared_ptr<IEffect>& instanceSp,
+                                             bool fused) {
+    auto effect = static_cast<EffectImpl*>(instanceSp.get());
+    if (!effect || effect->setFused(fused) != RetCode::SUCCESS) {
+        LOG(ERROR) << __func__ << " instance " << instanceSp.get() << " can not set fused to "
+                   << fused;
+        return EX_ILLEGAL_STATE;
+    }
+    return EX_NONE;
+}
+
+extern "C" binder_exception_t processFusedEffect(const std::shared_ptr<IEffect>& instanceSp,
+                                                 float* buffer, int samples,
+                                                 IEffect::Status* status) {
+    auto effect = static_cast<EffectImpl*>(instanceSp.get());
+    if (!effect || !status) {
+        return EX_NULL_POINTER;
+    }
+    *status = effect->processFused(buffer, samples);
+    return EX_NONE;
+}
+
 namespace aidl::android::hardware::audio::effect {
 
 ndk::ScopedAStatus EffectImpl::open(const Parameter::Common& common,
@@ -243,7 +267,10 @@ ndk::ScopedAStatus EffectImpl::command(CommandId command) {
             mState = State::PROCESSING;
             RETURN_IF(notifyEventFlag(mDataMqNotEmptyEf) != RetCode::SUCCESS, EX_ILLEGAL_STATE,
                       "notifyEventFlagNotEmptyFailed");
-            startThread();
+            // the worker of the EffectChain processes a fused effect
+            if (!mFused) {
+                startThread();
+            }
             break;
         case CommandId::STOP:
         case CommandId::RESET:
@@ -353,6 +380,21 @@ void EffectImpl::process() {
     }
 }
 
+RetCode EffectImpl::setFused(bool fused) {
+    std::lock_guard lg(mImplMutex);
+    RETURN_VALUE_IF(mState == State::PROCESSING, RetCode::ERROR_THREAD, "fuseAtProcessing");
+    mFused = fused;
+    return RetCode::SUCCESS;
+}
+
+IEffect::Status EffectImpl::processFused(float* buffer, int samples) {
+    std::lock_guard lg(mImplMutex);
+    if (!mFused || mState != State::PROCESSING) {
+        return status(STATUS_OK, samples, samples);
+    }
+    return effectProcessImpl(buffer, buffer, samples);
+}
+
 // A placeholder processing implementation to copy samples from input to output
 IEffect::Status EffectImpl::effectProcessImpl(float* in, float* out, int samples) {
     for (int i = 0; i < samples; i++) {
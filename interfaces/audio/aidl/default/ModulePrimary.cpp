@@ -14,12 +14,14 @@
  * limitations under the License.
  */
 
+#include <stdio.h>
 #include <vector>
 
 #define LOG_TAG "AHAL_ModulePrimary"
 #include <Utils.h>
 #include <android-base/logging.h>
 
+#include "alsa/DeviceWriter.h"
 #include "core-impl/ModulePrimary.h"
 #include "core-impl/StreamPrimary.h"
 #include "core-impl/Telephony.h"
@@ -66,4 +68,9 @@ int32_t ModulePrimary::getNominalLatencyMs(const AudioPortConfig&) {
     return kLatencyMs;
 }
 
+binder_status_t ModulePrimary::dump(int fd, const char** /*args*/, uint32_t /*numArgs*/) {
+    dprintf(fd, "\nAlsaDeviceWriters:\n%s\n", alsa::DeviceWriter::dumpWriters().c_str());
+    return STATUS_OK;
+}
+
 }  // namespace aidl::android::hardware::audio::core
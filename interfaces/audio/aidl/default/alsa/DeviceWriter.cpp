@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <sstream>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+
+#define LOG_TAG "AHAL_AlsaDeviceWriter"
+#include <android-base/logging.h>
+#include <audio_utils/clock.h>
+#include <system/thread_defs.h>
+
+#include "DeviceWriter.h"
+
+namespace aidl::android::hardware::audio::core::alsa {
+
+namespace {
+
+// The drift is measured over at least this duration.
+constexpr int64_t kMinDriftMeasurementNs = 1000000000;
+constexpr int kMaxPositionReadAttempts = 3;
+constexpr size_t kWriteChunksPerRing = 4;
+
+int64_t toNs(DeviceWriter::Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+DeviceWriter::Clock::duration getDuration(size_t frames, int sampleRate) {
+    return std::chrono::duration_cast<DeviceWriter::Clock::duration>(
+            std::chrono::nanoseconds(frames * NANOS_PER_SECOND / sampleRate));
+}
+
+void updateMax(std::atomic<int64_t>& max, int64_t value) {
+    int64_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value)) {
+    }
+}
+
+struct WritersRegistry {
+    std::mutex lock;
+    std::vector<std::weak_ptr<DeviceWriter>> writers;
+};
+
+WritersRegistry& getRegistry() {
+    static WritersRegistry registry;
+    return registry;
+}
+
+}  // namespace
+
+// static
+std::shared_ptr<DeviceWriter> DeviceWriter::create(const DeviceProfile& profile,
+                                                   DeviceProxy&& proxy, size_t frameSizeBytes,
+                                                   size_t ringFrames, int sampleRate,
+                                                   int writeRetries) {
+    auto writer = std::make_shared<DeviceWriter>(profile, std::move(proxy), frameSizeBytes,
+                                                 ringFrames, sampleRate, writeRetries);
+    auto& registry = getRegistry();
+    std::lock_guard guard(registry.lock);
+    std::erase_if(registry.writers, [](const auto& w) { return w.expired(); });
+    registry.writers.push_back(writer);
+    return writer;
+}
+
+// static
+std::string DeviceWriter::dumpWriters() {
+    auto& registry = getRegistry();
+    std::unique_lock lock(registry.lock, std::try_to_lock);
+    if (!lock.owns_lock()) return " <Busy>";
+    std::string result;
+    for (const auto& weakWriter : registry.writers) {
+        if (auto writer = weakWriter.lock(); writer) {
+            result.append(" - ").append(writer->dump()).append("\n");
+        }
+    }
+    if (result.empty()) result.append(" <Empty>");
+    return result;
+}
+
+DeviceWriter::DeviceWriter(const DeviceProfile& profile, DeviceProxy&& proxy,
+                           size_t frameSizeBytes, size_t ringFrames, int sampleRate,
+                           int writeRetries)
+    : mProfile(profile),
+      mProxy(std::move(proxy)),
+      mFrameSizeBytes(frameSizeBytes),
+      mSampleRate(sampleRate),
+      mWriteRetries(writeRetries),
+      mDeviceLatencyMs(proxy_get_latency(mProxy.get())),
+      mDeviceBufferFrames(mProxy.isMmap() ? pcm_get_buffer_size(mProxy.get()->pcm) : 0),
+      mRing(mProxy.isMmap() ? 0 : std::bit_ceil(ringFrames) * frameSizeBytes),
+      mRingFrames(std::bit_ceil(ringFrames)) {
+    if (mProxy.isMmap()) return;
+    // The writer runs with the scheduling of the stream worker creating it.
+    int schedPolicy = sched_getscheduler(0);
+    struct sched_param param = {};
+    sched_getparam(0, &param);
+    mThread = std::thread(&DeviceWriter::threadLoop, this, schedPolicy & ~SCHED_RESET_ON_FORK,
+                          param.sched_priority);
+}
+
+DeviceWriter::~DeviceWriter() {
+    if (!mThread.joinable()) return;
+    mExit = true;
+    {
+        std::lock_guard guard(mWakeLock);
+    }
+    mWakeCondition.notify_all();
+    mThread.join();
+}
+
+template <typename Predicate>
+bool DeviceWriter::waitFor(std::atomic<bool>& waiting, Clock::time_point deadline,
+                           Predicate predicate) {
+    if (predicate()) return true;
+    std::unique_lock lock(mWakeLock);
+    // Pairs with the load in 'wake': either the predicate sees the update of the other side, or
+    // the other side sees 'waiting' and notifies after the wait has started.
+    waiting = true;
+    bool result = true;
+    if (deadline == Clock::time_point::max()) {
+        mWakeCondition.wait(lock, predicate);
+    } else {
+        result = mWakeCondition.wait_until(lock, deadline, predicate);
+    }
+    waiting = false;
+    return result;
+}
+
+void DeviceWriter::wake(const std::atomic<bool>& waiting) {
+    if (waiting.load()) {
+        {
+            std::lock_guard guard(mWakeLock);
+        }
+        mWakeCondition.notify_all();
+    }
+}
+
+bool DeviceWriter::write(const void* buffer, size_t frameCount, Clock::time_point deadline) {
+    const bool wasStalled = mStalled.load(std::memory_order_relaxed);
+    const auto waitStart = Clock::now();
+    // A stalled device is only checked for room.
+    const auto waitDeadline = wasStalled ? Clock::time_point::min() : deadline;
+    const bool canWrite = mProxy.isMmap() ? waitForDeviceRoom(frameCount, waitDeadline)
+                                          : waitForRingRoom(frameCount, waitDeadline);
+    if (!canWrite) {
+        if (!wasStalled) {
+            LOG(WARNING) << __func__ << ": " << mProfile << " stalled, dropping its audio";
+            mStalled = true;
+            mStallCount++;
+        }
+        mDroppedFrames += frameCount;
+        return false;
+    }
+    if (wasStalled) {
+        LOG(INFO) << __func__ << ": " << mProfile << " recovered";
+        mStalled = false;
+    } else {
+        updateMax(mMaxWorkerWaitNs, toNs(Clock::now() - waitStart));
+    }
+
+    const uint64_t writePos = mWritePos.load(std::memory_order_relaxed);
+    if (mProxy.isMmap()) {
+        mWritePos = writePos + frameCount;
+        mReadPos = writePos + frameCount;
+        writeToDevice(buffer, frameCount);
+        return true;
+    }
+    const size_t offset = writePos & (mRingFrames - 1);
+    const size_t firstFrames = std::min(frameCount, mRingFrames - offset);
+    memcpy(&mRing[offset * mFrameSizeBytes], buffer, firstFrames * mFrameSizeBytes);
+    memcpy(mRing.data(), static_cast<const uint8_t*>(buffer) + firstFrames * mFrameSizeBytes,
+           (frameCount - firstFrames) * mFrameSizeBytes);
+    mWritePos = writePos + frameCount;
+    wake(mWriterWaiting);
+    return true;
+}
+
+bool DeviceWriter::waitForRingRoom(size_t frameCount, Clock::time_point deadline) {
+    if (frameCount > mRingFrames) return false;
+    const uint64_t writePos = mWritePos.load(std::memory_order_relaxed);
+    return waitFor(mWorkerWaiting, deadline,
+                   [&] { return writePos + frameCount - mReadPos.load() <= mRingFrames; });
+}
+
+bool DeviceWriter::waitForDeviceRoom(size_t frameCount, Clock::time_point deadline) {
+    // Frames beyond the device buffer are written as the hardware consumes the previous ones.
+    const size_t neededFrames = std::min(frameCount, mDeviceBufferFrames);
+    while (true) {
+        const int availableFrames = getMmapAvailableFrames(mProxy);
+        if (availableFrames < 0) return false;
+        if (static_cast<size_t>(availableFrames) >= neededFrames) return true;
+        const auto now = Clock::now();
+        if (now >= deadline) return false;
+        std::this_thread::sleep_until(std::min(
+                deadline, now + getDuration(neededFrames - availableFrames, mSampleRate)));
+    }
+}
+
+void DeviceWriter::waitForEmptyRing(Clock::time_point deadline) {
+    if (mStalled.load(std::memory_order_relaxed)) return;
+    const uint64_t writePos = mWritePos.load(std::memory_order_relaxed);
+    waitFor(mWorkerWaiting, deadline, [&] { return mReadPos.load() == writePos; });
+}
+
+unsigned DeviceWriter::getLatencyMs() const {
+    const uint64_t queuedFrames = mWritePos.load() - mReadPos.load();
+    return mDeviceLatencyMs + static_cast<unsigned>(queuedFrames * MILLIS_PER_SECOND / mSampleRate);
+}
+
+bool DeviceWriter::getPresentationPosition(uint64_t* frames, int64_t* timeNs) const {
+    for (int attempt = 0; attempt < kMaxPositionReadAttempts; attempt++) {
+        const uint32_t seq = mPositionSeq.load(std::memory_order_acquire);
+        if (seq & 1) continue;
+        const uint64_t positionFrames = mPositionFrames.load(std::memory_order_relaxed);
+        const int64_t positionTimeNs = mPositionTimeNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mPositionSeq.load(std::memory_order_relaxed) != seq) continue;
+        if (positionTimeNs == 0) return false;
+        *frames = positionFrames;
+        *timeNs = positionTimeNs;
+        return true;
+    }
+    return false;
+}
+
+void DeviceWriter::threadLoop(int schedPolicy, int schedPriority) {
+    std::ostringstream name;
+    name << "alsa_wr_" << mProfile.card << "_" << mProfile.device;
+    pthread_setname_np(pthread_self(), name.str().substr(0, 15).c_str());
+    setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_URGENT_AUDIO);
+    if (schedPolicy == SCHED_FIFO || schedPolicy == SCHED_RR) {
+        struct sched_param param = {.sched_priority = schedPriority};
+        if (sched_setscheduler(0, schedPolicy | SCHED_RESET_ON_FORK, &param) != 0) {
+            PLOG(WARNING) << __func__ << ": failed to set the scheduler of the stream worker";
+        }
+    }
+
+    while (!mExit) {
+        const uint64_t readPos = mReadPos.load(std::memory_order_relaxed);
+        const uint64_t writePos = mWritePos.load();
+        if (writePos == readPos) {
+            waitFor(mWriterWaiting, Clock::time_point::max(),
+                    [&] { return mExit || mWritePos.load() != readPos; });
+            continue;
+        }
+        const size_t offset = readPos & (mRingFrames - 1);
+        // Writing a quarter of the ring at most returns room to the stream worker steadily.
+        const size_t frames = std::min<uint64_t>(
+                {writePos - readPos, mRingFrames - offset, mRingFrames / kWriteChunksPerRing});
+        writeToDevice(&mRing[offset * mFrameSizeBytes], frames);
+        mReadPos = readPos + frames;
+        wake(mWorkerWaiting);
+    }
+}
+
+void DeviceWriter::writeToDevice(const void* data, size_t frameCount) {
+    const auto writeStart = Clock::now();
+    if (int ret = writeWithRetries(mProxy, data, frameCount * mFrameSizeBytes, mWriteRetries);
+        ret != 0) {
+        LOG(WARNING) << __func__ << ": " << mProfile << " write failed: " << ret;
+        mWriteErrors++;
+        // The device has probably underrun, the drift is measured again.
+        mFirstPosition.reset();
+    }
+    updateMax(mMaxWriteNs, toNs(Clock::now() - writeStart));
+    updatePosition();
+}
+
+void DeviceWriter::updatePosition() {
+    uint64_t frames;
+    int64_t timeNs;
+    if (mProxy.isMmap()) {
+        if (!mProxy.getMmapHwPosition(&frames, &timeNs)) return;
+    } else {
+        struct timespec timestamp;
+        if (proxy_get_presentation_position(mProxy.get(), &frames, &timestamp) != 0) return;
+        timeNs = audio_utils_ns_from_timespec(&timestamp);
+    }
+
+    const uint32_t seq = mPositionSeq.load(std::memory_order_relaxed);
+    mPositionSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mPositionFrames.store(frames, std::memory_order_relaxed);
+    mPositionTimeNs.store(timeNs, std::memory_order_relaxed);
+    mPositionSeq.store(seq + 2, std::memory_order_release);
+
+    if (!mFirstPosition.has_value()) {
+        mFirstPosition = Position{frames, timeNs};
+    } else if (const int64_t elapsedNs = timeNs - mFirstPosition->timeNs;
+               elapsedNs >= kMinDriftMeasurementNs) {
+        // Rate of the device clock against the monotonic clock, relative to the nominal rate.
+        const double expectedFrames =
+                static_cast<double>(elapsedNs) * mSampleRate / NANOS_PER_SECOND;
+        const double presentedFrames = frames - mFirstPosition->frames;
+        mDriftPpm.store((presentedFrames / expectedFrames - 1) * 1e6, std::memory_order_relaxed);
+    }
+}
+
+std::string DeviceWriter::dump() const {
+    const uint64_t writePos = mWritePos.load();
+    const uint64_t readPos = mReadPos.load();
+    std::ostringstream os;
+    os << mProfile << (mProxy.isMmap() ? " (mmap)" : "")
+       << (mStalled.load() ? ": STALLED" : ": active")
+       << ", stalls: " << mStallCount.load() << ", dropped frames: " << mDroppedFrames.load()
+       << ", write errors: " << mWriteErrors.load()
+       << ", queued frames: " << writePos - readPos << "/" << mRingFrames
+       << ", frames written: " << readPos << ", latency: " << getLatencyMs() << " ms"
+       << ", max write: " << mMaxWriteNs.load() / NANOS_PER_MICROSECOND << " us"
+       << ", max wait: " << mMaxWorkerWaitNs.load() / NANOS_PER_MICROSECOND << " us"
+       << ", drift: " << mDriftPpm.load() << " ppm";
+    return os.str();
+}
+
+}  // namespace aidl::android::hardware::audio::core::alsa
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Utils.h"
+
+namespace aidl::android::hardware::audio::core::alsa {
+
+// Writes to one output device from a thread of its own, so that a device blocking in
+// 'pcm_write' does not hold the stream worker, nor the other devices of the stream.
+//
+// The stream worker queues the audio into a lock-free single producer, single consumer ring,
+// from which the writer thread writes to the device. A device which does not make room in time
+// is considered stalled: its audio is dropped, and the stream worker stops waiting for it until
+// it catches up. The mutex of the writer is only used for sleeping and waking up, never to access
+// the ring.
+//
+// Devices opened for mmap transfers have no thread and no ring: the stream worker copies the
+// audio into the mmapped buffer of the device directly, which can not block once there is room
+// in it. Without period interrupts, the worker sleeps for the duration of the missing room.
+class DeviceWriter {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // Creates a writer of 'proxy', of a ring of at least 'ringFrames', and starts its thread.
+    static std::shared_ptr<DeviceWriter> create(const DeviceProfile& profile, DeviceProxy&& proxy,
+                                                size_t frameSizeBytes, size_t ringFrames,
+                                                int sampleRate, int writeRetries);
+    // Returns the state of the writers of all the open streams, for 'dump'.
+    static std::string dumpWriters();
+
+    DeviceWriter(const DeviceProfile& profile, DeviceProxy&& proxy, size_t frameSizeBytes,
+                 size_t ringFrames, int sampleRate, int writeRetries);
+    ~DeviceWriter();
+
+    // Methods called by the stream worker.
+
+    // Queues 'frameCount' frames, waiting until 'deadline' for room unless the device has
+    // already stalled. Returns false if the frames were dropped.
+    bool write(const void* buffer, size_t frameCount, Clock::time_point deadline);
+    // Waits until 'deadline' for the ring to be written to the device.
+    void waitForEmptyRing(Clock::time_point deadline);
+    // Latency of the device plus the duration of the queued frames.
+    unsigned getLatencyMs() const;
+    // Frames presented by the device since it was opened, with their time. Frames dropped and
+    // frames still queued by this writer are excluded.
+    bool getPresentationPosition(uint64_t* frames, int64_t* timeNs) const;
+    // Frames queued by 'write' since the device was opened.
+    uint64_t getQueuedFramesTotal() const { return mWritePos.load(std::memory_order_relaxed); }
+    bool isStalled() const { return mStalled.load(std::memory_order_relaxed); }
+
+    std::string dump() const;
+
+  private:
+    struct Position {
+        uint64_t frames;
+        int64_t timeNs;
+    };
+
+    void threadLoop(int schedPolicy, int schedPriority);
+    bool waitForRingRoom(size_t frameCount, Clock::time_point deadline);
+    bool waitForDeviceRoom(size_t frameCount, Clock::time_point deadline);
+    void writeToDevice(const void* data, size_t frameCount);
+    void updatePosition();
+    // Wakes up the other side if it is sleeping in 'waitFor'.
+    void wake(const std::atomic<bool>& waiting);
+    template <typename Predicate>
+    bool waitFor(std::atomic<bool>& waiting, Clock::time_point deadline, Predicate predicate);
+
+    const DeviceProfile mProfile;
+    DeviceProxy mProxy;
+    const size_t mFrameSizeBytes;
+    const int mSampleRate;
+    const int mWriteRetries;
+    const unsigned mDeviceLatencyMs;
+    // Only set for mmap devices.
+    const size_t mDeviceBufferFrames;
+
+    // The ring, a power of 2 frames long. Positions are frame counts, 'mWritePos' is only
+    // advanced by the stream worker and 'mReadPos' by the writer thread. For mmap devices the
+    // ring is empty, and both positions are advanced together by the stream worker.
+    std::vector<uint8_t> mRing;
+    const size_t mRingFrames;
+    std::atomic<uint64_t> mWritePos = 0;
+    std::atomic<uint64_t> mReadPos = 0;
+
+    std::mutex mWakeLock;
+    std::condition_variable mWakeCondition;
+    std::atomic<bool> mWorkerWaiting = false;
+    std::atomic<bool> mWriterWaiting = false;
+    std::atomic<bool> mExit = false;
+
+    // Last presentation position of the device, published with a sequence number which is odd
+    // while it is updated.
+    std::atomic<uint32_t> mPositionSeq = 0;
+    std::atomic<uint64_t> mPositionFrames = 0;
+    std::atomic<int64_t> mPositionTimeNs = 0;
+    // First valid position, the reference of the drift. Only accessed by the thread writing to
+    // the device.
+    std::optional<Position> mFirstPosition;
+
+    // Telemetry.
+    std::atomic<bool> mStalled = false;
+    std::atomic<uint64_t> mStallCount = 0;
+    std::atomic<uint64_t> mDroppedFrames = 0;
+    std::atomic<uint64_t> mWriteErrors = 0;
+    std::atomic<int64_t> mMaxWriteNs = 0;
+    std::atomic<int64_t> mMaxWorkerWaitNs = 0;
+    std::atomic<float> mDriftPpm = 0;
+
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::audio::core::alsa
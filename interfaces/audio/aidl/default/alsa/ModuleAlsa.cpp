@@ -16,10 +16,12 @@
 
 #define LOG_TAG "AHAL_ModuleAlsa"
 
+#include <stdio.h>
 #include <vector>
 
 #include <android-base/logging.h>
 
+#include "DeviceWriter.h"
 #include "Utils.h"
 #include "core-impl/ModuleAlsa.h"
 
@@ -65,4 +67,9 @@ ndk::ScopedAStatus ModuleAlsa::populateConnectedDevicePort(AudioPort* audioPort,
     return ndk::ScopedAStatus::ok();
 }
 
+binder_status_t ModuleAlsa::dump(int fd, const char** /*args*/, uint32_t /*numArgs*/) {
+    dprintf(fd, "\nAlsaDeviceWriters:\n%s\n", alsa::DeviceWriter::dumpWriters().c_str());
+    return STATUS_OK;
+}
+
 }  // namespace aidl::android::hardware::audio::core
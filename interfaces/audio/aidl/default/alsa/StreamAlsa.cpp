@@ -14,8 +14,11 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <limits>
+#include <thread>
 
 #define LOG_TAG "AHAL_StreamAlsa"
 #include <android-base/logging.h>
@@ -28,6 +31,19 @@
 
 namespace aidl::android::hardware::audio::core {
 
+namespace {
+
+// A device which takes longer than this many times the duration of a transfer to make room for
+// it is considered stalled, and is no longer waited for.
+constexpr int kDeviceStallTimeoutTransfers = 2;
+
+alsa::DeviceWriter::Clock::duration getDuration(size_t frames, int sampleRate) {
+    return std::chrono::duration_cast<alsa::DeviceWriter::Clock::duration>(
+            std::chrono::nanoseconds(frames * NANOS_PER_SECOND / sampleRate));
+}
+
+}  // namespace
+
 StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int readWriteRetries)
     : StreamCommonImpl(context, metadata),
       mBufferSizeFrames(getContext().getBufferSizeInFrames()),
@@ -35,7 +51,8 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
       mSampleRate(getContext().getSampleRate()),
       mIsInput(isInput(metadata)),
       mConfig(alsa::getPcmConfig(getContext(), mIsInput)),
-      mReadWriteRetries(readWriteRetries) {}
+      mReadWriteRetries(readWriteRetries),
+      mUseMmap(alsa::isMmapTransferRequested(getContext())) {}
 
 ::android::status_t StreamAlsa::init() {
     return mConfig.has_value() ? ::android::OK : ::android::NO_INIT;
@@ -43,6 +60,12 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
 
 ::android::status_t StreamAlsa::drain(StreamDescriptor::DrainMode) {
     if (!mIsInput) {
+        const auto deadline =
+                alsa::DeviceWriter::Clock::now() +
+                getDuration(kDeviceStallTimeoutTransfers * mBufferSizeFrames, mSampleRate);
+        for (auto& writer : mDeviceWriters) {
+            writer->waitForEmptyRing(deadline);
+        }
         static constexpr float kMicrosPerSecond = MICROS_PER_SECOND;
         const size_t delayUs = static_cast<size_t>(
                 std::roundf(mBufferSizeFrames * kMicrosPerSecond / mSampleRate));
@@ -61,16 +84,18 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
 
 ::android::status_t StreamAlsa::standby() {
     mAlsaDeviceProxies.clear();
+    mDeviceWriters.clear();
     return ::android::OK;
 }
 
 ::android::status_t StreamAlsa::start() {
-    if (!mAlsaDeviceProxies.empty()) {
+    if (!mAlsaDeviceProxies.empty() || !mDeviceWriters.empty()) {
         // This is a resume after a pause.
         return ::android::OK;
     }
+    const auto deviceProfiles = getDeviceProfiles();
     decltype(mAlsaDeviceProxies) alsaDeviceProxies;
-    for (const auto& device : getDeviceProfiles()) {
+    for (const auto& device : deviceProfiles) {
         alsa::DeviceProxy proxy;
         if (device.isExternal) {
             // Always ask alsa configure as required since the configuration should be supported
@@ -78,37 +103,57 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
             // `setAudioPatch`.
             proxy = alsa::openProxyForExternalDevice(
                     device, const_cast<struct pcm_config*>(&mConfig.value()),
-                    true /*require_exact_match*/);
+                    true /*require_exact_match*/, mUseMmap);
         } else {
             proxy = alsa::openProxyForAttachedDevice(
-                    device, const_cast<struct pcm_config*>(&mConfig.value()), mBufferSizeFrames);
+                    device, const_cast<struct pcm_config*>(&mConfig.value()), mBufferSizeFrames,
+                    mUseMmap);
         }
         if (proxy.get() == nullptr) {
             return ::android::NO_INIT;
         }
         alsaDeviceProxies.push_back(std::move(proxy));
     }
-    mAlsaDeviceProxies = std::move(alsaDeviceProxies);
+    if (mIsInput) {
+        mAlsaDeviceProxies = std::move(alsaDeviceProxies);
+        return ::android::OK;
+    }
+    for (size_t i = 0; i < alsaDeviceProxies.size(); ++i) {
+        mDeviceWriters.push_back(alsa::DeviceWriter::create(
+                deviceProfiles[i], std::move(alsaDeviceProxies[i]), mFrameSizeBytes,
+                mBufferSizeFrames, mSampleRate, mReadWriteRetries));
+    }
     return ::android::OK;
 }
 
 ::android::status_t StreamAlsa::transfer(void* buffer, size_t frameCount, size_t* actualFrameCount,
                                          int32_t* latencyMs) {
-    if (mAlsaDeviceProxies.empty()) {
+    if (mAlsaDeviceProxies.empty() && mDeviceWriters.empty()) {
         LOG(FATAL) << __func__ << ": no opened devices";
         return ::android::NO_INIT;
     }
-    const size_t bytesToTransfer = frameCount * mFrameSizeBytes;
     unsigned maxLatency = 0;
     if (mIsInput) {
         // For input case, only support single device.
-        proxy_read_with_retries(mAlsaDeviceProxies[0].get(), buffer, bytesToTransfer,
-                                mReadWriteRetries);
+        alsa::readWithRetries(mAlsaDeviceProxies[0], buffer, frameCount * mFrameSizeBytes,
+                              mReadWriteRetries);
         maxLatency = proxy_get_latency(mAlsaDeviceProxies[0].get());
     } else {
-        for (auto& proxy : mAlsaDeviceProxies) {
-            proxy_write_with_retries(proxy.get(), buffer, bytesToTransfer, mReadWriteRetries);
-            maxLatency = std::max(maxLatency, proxy_get_latency(proxy.get()));
+        // The writers wait for room in parallel, the transfer is paced by the slowest device
+        // which has not stalled.
+        const auto now = alsa::DeviceWriter::Clock::now();
+        const auto deadline =
+                now + getDuration(kDeviceStallTimeoutTransfers * frameCount, mSampleRate);
+        bool allStalled = true;
+        for (auto& writer : mDeviceWriters) {
+            if (writer->write(buffer, frameCount, deadline)) {
+                maxLatency = std::max(maxLatency, writer->getLatencyMs());
+                allStalled = false;
+            }
+        }
+        if (allStalled) {
+            // Keep the pace of the stream while no device consumes it.
+            std::this_thread::sleep_until(now + getDuration(frameCount, mSampleRate));
         }
     }
     *actualFrameCount = frameCount;
@@ -118,14 +163,26 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
 }
 
 ::android::status_t StreamAlsa::refinePosition(StreamDescriptor::Position* position) {
-    if (mAlsaDeviceProxies.empty()) {
+    if (mAlsaDeviceProxies.empty() && mDeviceWriters.empty()) {
         LOG(WARNING) << __func__ << ": no opened devices";
         return ::android::NO_INIT;
     }
-    // Since the proxy can only count transferred frames since its creation,
-    // we override its counter value with ours and let it to correct for buffered frames.
-    alsa::resetTransferredFrames(mAlsaDeviceProxies[0], position->frames);
-    if (mIsInput) {
+    if (mIsInput && mAlsaDeviceProxies[0].isMmap()) {
+        uint64_t hwFrames;
+        int64_t timeNs;
+        if (!mAlsaDeviceProxies[0].getMmapHwPosition(&hwFrames, &timeNs)) {
+            LOG(WARNING) << __func__ << ": failed to retrieve the hardware pointer";
+            return ::android::INVALID_OPERATION;
+        }
+        // Add the frames captured by the hardware which have not been read yet.
+        const int64_t unreadFrames = static_cast<int64_t>(
+                hwFrames - mAlsaDeviceProxies[0].getMmapApplFrames());
+        position->frames += std::max<int64_t>(0, unreadFrames);
+        position->timeNs = timeNs;
+    } else if (mIsInput) {
+        // Since the proxy can only count transferred frames since its creation,
+        // we override its counter value with ours and let it to correct for buffered frames.
+        alsa::resetTransferredFrames(mAlsaDeviceProxies[0], position->frames);
         if (int ret = proxy_get_capture_position(mAlsaDeviceProxies[0].get(), &position->frames,
                                                  &position->timeNs);
             ret != 0) {
@@ -133,26 +190,30 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
             return ::android::INVALID_OPERATION;
         }
     } else {
-        uint64_t hwFrames;
-        struct timespec timestamp;
-        if (int ret = proxy_get_presentation_position(mAlsaDeviceProxies[0].get(), &hwFrames,
-                                                      &timestamp);
-            ret == 0) {
-            if (hwFrames > std::numeric_limits<int64_t>::max()) {
-                hwFrames -= std::numeric_limits<int64_t>::max();
-            }
-            position->frames = static_cast<int64_t>(hwFrames);
-            position->timeNs = audio_utils_ns_from_timespec(&timestamp);
-        } else {
-            LOG(WARNING) << __func__ << ": failed to retrieve presentation position: " << ret;
+        const auto& writer = mDeviceWriters[0];
+        uint64_t presentedFrames;
+        int64_t timeNs;
+        if (!writer->getPresentationPosition(&presentedFrames, &timeNs)) {
+            LOG(WARNING) << __func__ << ": failed to retrieve presentation position";
             return ::android::INVALID_OPERATION;
         }
+        // Our counter includes the frames which the device has not presented yet, either still
+        // in the ring of the writer, or in the buffer of the device. The writer total is read
+        // after the position so that it is never behind it.
+        uint64_t pendingFrames = writer->getQueuedFramesTotal() - presentedFrames;
+        if (pendingFrames > std::numeric_limits<int64_t>::max()) {
+            pendingFrames = std::numeric_limits<int64_t>::max();
+        }
+        position->frames = std::max<int64_t>(
+                0, position->frames - static_cast<int64_t>(pendingFrames));
+        position->timeNs = timeNs;
     }
     return ::android::OK;
 }
 
 void StreamAlsa::shutdown() {
     mAlsaDeviceProxies.clear();
+    mDeviceWriters.clear();
 }
 
 }  // namespace aidl::android::hardware::audio::core
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <cerrno>
 #include <map>
 #include <set>
 
@@ -22,16 +24,20 @@
 #include <aidl/android/media/audio/common/AudioFormatType.h>
 #include <aidl/android/media/audio/common/PcmType.h>
 #include <android-base/logging.h>
+#include <audio_utils/clock.h>
 
 #include "Utils.h"
 #include "core-impl/utils.h"
 
 using aidl::android::hardware::audio::common::getChannelCount;
+using aidl::android::hardware::audio::common::isBitPositionFlagSet;
 using aidl::android::media::audio::common::AudioChannelLayout;
 using aidl::android::media::audio::common::AudioDeviceAddress;
 using aidl::android::media::audio::common::AudioFormatDescription;
 using aidl::android::media::audio::common::AudioFormatType;
+using aidl::android::media::audio::common::AudioInputFlags;
 using aidl::android::media::audio::common::AudioIoFlags;
+using aidl::android::media::audio::common::AudioOutputFlags;
 using aidl::android::media::audio::common::AudioPortExt;
 using aidl::android::media::audio::common::PcmType;
 
@@ -54,6 +60,51 @@ void DeviceProxy::alsaProxyDeleter(alsa_device_proxy* proxy) {
     }
 }
 
+int DeviceProxy::openMmap() {
+    alsa_device_proxy* proxy = mProxy.get();
+    struct pcm* pcm =
+            pcm_open(proxy->profile->card, proxy->profile->device,
+                     proxy->profile->direction | PCM_MONOTONIC | PCM_MMAP | PCM_NOIRQ,
+                     &proxy->alsa_config);
+    if (pcm == nullptr) return -ENOMEM;
+    if (!pcm_is_ready(pcm)) {
+        LOG(WARNING) << __func__ << ": " << pcm_get_error(pcm);
+        pcm_close(pcm);
+        return -ENODEV;
+    }
+    proxy->pcm = pcm;
+    mIsMmap = true;
+    return 0;
+}
+
+bool DeviceProxy::getMmapHwPosition(uint64_t* frames, int64_t* timeNs) {
+    unsigned int hwPtr;
+    struct timespec timestamp;
+    if (!mIsMmap || pcm_mmap_get_hw_ptr(mProxy->pcm, &hwPtr, &timestamp) != 0) return false;
+    // The pointer wraps around at its boundary, and restarts from 0 when the device is prepared
+    // again after an xrun. The hardware can not otherwise advance by more than the buffer
+    // between two transfers.
+    unsigned int advance = hwPtr - mMmapLastHwPtr;
+    if (advance > pcm_get_buffer_size(mProxy->pcm) && hwPtr < mMmapLastHwPtr) {
+        advance = hwPtr;
+    }
+    mMmapLastHwPtr = hwPtr;
+    mMmapHwFrames += advance;
+    *frames = mMmapHwFrames;
+    *timeNs = audio_utils_ns_from_timespec(&timestamp);
+    return true;
+}
+
+void DeviceProxy::resyncMmapHwPosition(uint64_t applFrames) {
+    // Preparing the device restarted its pointer from 0. The frames which the application had
+    // written but the hardware had not played, or the other way round for capture, are lost.
+    unsigned int hwPtr;
+    struct timespec timestamp;
+    if (pcm_mmap_get_hw_ptr(mProxy->pcm, &hwPtr, &timestamp) != 0) hwPtr = 0;
+    mMmapLastHwPtr = hwPtr;
+    mMmapHwFrames = applFrames + hwPtr;
+}
+
 namespace {
 
 using AudioChannelCountToMaskMap = std::map<unsigned int, AudioChannelLayout>;
@@ -166,6 +217,37 @@ const PcmFormatToAudioFormatDescMap& getPcmFormatToAudioFormatDescMap() {
     return pcmFormatToFormatDescMap;
 }
 
+int openProxy(DeviceProxy& proxy, const DeviceProfile& deviceProfile, bool useMmap) {
+    if (useMmap) {
+        if (int err = proxy.openMmap(); err == 0) return 0;
+        LOG(WARNING) << __func__ << ": mmap transfers are not supported, device address="
+                     << deviceProfile << " error=" << err << ", using read / write";
+    }
+    return proxy_open(proxy.get());
+}
+
+int mmapTransferWithRetries(DeviceProxy& proxy, size_t bytes, int retries,
+                            const std::function<int(struct pcm*, unsigned int)>& transfer) {
+    struct pcm* pcm = proxy.get()->pcm;
+    int result = 0;
+    if (pcm_state(pcm) == PCM_STATE_XRUN) {
+        // Stopping the device makes the transfer prepare and start it again.
+        pcm_stop(pcm);
+        result = -EPIPE;
+    }
+    const unsigned int frameCount = pcm_bytes_to_frames(pcm, bytes);
+    const uint64_t applFrames = proxy.getMmapApplFrames();
+    for (int tries = retries;; --tries) {
+        const int frames = transfer(pcm, frameCount);
+        if (frames >= 0) {
+            proxy.advanceMmapApplFrames(frames);
+            if (result == -EPIPE) proxy.resyncMmapHwPosition(applFrames);
+            return result;
+        }
+        if (tries <= 1 || (frames != -EIO && frames != -EAGAIN)) return frames;
+    }
+}
+
 }  // namespace
 
 std::ostream& operator<<(std::ostream& os, const DeviceProfile& device) {
@@ -268,6 +350,14 @@ std::optional<struct pcm_config> getPcmConfig(const StreamContext& context, bool
     return config;
 }
 
+bool isMmapTransferRequested(const StreamContext& context) {
+    const auto& flags = context.getFlags();
+    return (flags.getTag() == AudioIoFlags::Tag::input &&
+            isBitPositionFlagSet(flags.get<AudioIoFlags::Tag::input>(), AudioInputFlags::FAST)) ||
+           (flags.getTag() == AudioIoFlags::Tag::output &&
+            isBitPositionFlagSet(flags.get<AudioIoFlags::Tag::output>(), AudioOutputFlags::FAST));
+}
+
 std::vector<int> getSampleRatesFromProfile(const alsa_device_profile* profile) {
     std::vector<int> sampleRates;
     for (int i = 0; i < std::min(MAX_PROFILE_SAMPLE_RATES, AUDIO_PORT_MAX_SAMPLING_RATES) &&
@@ -279,7 +369,8 @@ std::vector<int> getSampleRatesFromProfile(const alsa_device_profile* profile) {
 }
 
 DeviceProxy openProxyForAttachedDevice(const DeviceProfile& deviceProfile,
-                                       struct pcm_config* pcmConfig, size_t bufferFrameCount) {
+                                       struct pcm_config* pcmConfig, size_t bufferFrameCount,
+                                       bool useMmap) {
     if (deviceProfile.isExternal) {
         LOG(FATAL) << __func__ << ": called for an external device, address=" << deviceProfile;
     }
@@ -292,7 +383,7 @@ DeviceProxy openProxyForAttachedDevice(const DeviceProfile& deviceProfile,
                    << " error=" << err;
         return DeviceProxy();
     }
-    if (int err = proxy_open(proxy.get()); err != 0) {
+    if (int err = openProxy(proxy, deviceProfile, useMmap); err != 0) {
         LOG(ERROR) << __func__ << ": failed to open device, address=" << deviceProfile
                    << " error=" << err;
         return DeviceProxy();
@@ -301,7 +392,8 @@ DeviceProxy openProxyForAttachedDevice(const DeviceProfile& deviceProfile,
 }
 
 DeviceProxy openProxyForExternalDevice(const DeviceProfile& deviceProfile,
-                                       struct pcm_config* pcmConfig, bool requireExactMatch) {
+                                       struct pcm_config* pcmConfig, bool requireExactMatch,
+                                       bool useMmap) {
     if (!deviceProfile.isExternal) {
         LOG(FATAL) << __func__ << ": called for an attached device, address=" << deviceProfile;
     }
@@ -315,7 +407,7 @@ DeviceProxy openProxyForExternalDevice(const DeviceProfile& deviceProfile,
                    << " error=" << err;
         return DeviceProxy();
     }
-    if (int err = proxy_open(proxy.get()); err != 0) {
+    if (int err = openProxy(proxy, deviceProfile, useMmap); err != 0) {
         LOG(ERROR) << __func__ << ": failed to open device, address=" << deviceProfile
                    << " error=" << err;
         return DeviceProxy();
@@ -332,6 +424,24 @@ DeviceProxy readAlsaDeviceInfo(const DeviceProfile& deviceProfile) {
     return proxy;
 }
 
+int readWithRetries(DeviceProxy& proxy, void* data, size_t bytes, int retries) {
+    if (!proxy.isMmap()) return proxy_read_with_retries(proxy.get(), data, bytes, retries);
+    return mmapTransferWithRetries(proxy, bytes, retries, [data](struct pcm* pcm, unsigned int n) {
+        return pcm_readi(pcm, data, n);
+    });
+}
+
+int writeWithRetries(DeviceProxy& proxy, const void* data, size_t bytes, int retries) {
+    if (!proxy.isMmap()) return proxy_write_with_retries(proxy.get(), data, bytes, retries);
+    return mmapTransferWithRetries(proxy, bytes, retries, [data](struct pcm* pcm, unsigned int n) {
+        return pcm_writei(pcm, data, n);
+    });
+}
+
+int getMmapAvailableFrames(DeviceProxy& proxy) {
+    return pcm_mmap_avail(proxy.get()->pcm);
+}
+
 void resetTransferredFrames(DeviceProxy& proxy, uint64_t frames) {
     if (proxy.get() != nullptr) {
         proxy.get()->transferred = frames;
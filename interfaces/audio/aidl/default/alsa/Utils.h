@@ -51,12 +51,30 @@ class DeviceProxy {
     alsa_device_profile* getProfile() { return mProfile.get(); }
     alsa_device_proxy* get() { return mProxy.get(); }
 
+    // Opens the prepared proxy for transfers through the mmapped buffer of the device, without
+    // period interrupts. This is an alternative to 'proxy_open'.
+    int openMmap();
+    bool isMmap() const { return mIsMmap; }
+    // Retrieves the count of frames transferred by the hardware since the device was opened,
+    // from its pointer in the mmapped buffer, and the time of the pointer.
+    bool getMmapHwPosition(uint64_t* frames, int64_t* timeNs);
+    // Restarts the count of frames transferred by the hardware after the device has been prepared
+    // again following an xrun, from the count of frames transferred by the application before it.
+    void resyncMmapHwPosition(uint64_t applFrames);
+    // Count of frames transferred by the application since the device was opened.
+    uint64_t getMmapApplFrames() const { return mMmapApplFrames; }
+    void advanceMmapApplFrames(size_t frames) { mMmapApplFrames += frames; }
+
   private:
     static void alsaProxyDeleter(alsa_device_proxy* proxy);
     using AlsaProxy = std::unique_ptr<alsa_device_proxy, decltype(alsaProxyDeleter)*>;
 
     std::unique_ptr<alsa_device_profile> mProfile;
     AlsaProxy mProxy;
+    bool mIsMmap = false;
+    unsigned int mMmapLastHwPtr = 0;
+    uint64_t mMmapHwFrames = 0;
+    uint64_t mMmapApplFrames = 0;
 };
 
 ::aidl::android::media::audio::common::AudioChannelLayout getChannelLayoutMaskFromChannelCount(
@@ -72,11 +90,24 @@ std::optional<DeviceProfile> getDeviceProfile(
 std::optional<DeviceProfile> getDeviceProfile(
         const ::aidl::android::media::audio::common::AudioPort& audioPort);
 std::optional<struct pcm_config> getPcmConfig(const StreamContext& context, bool isInput);
+// Streams of mix ports with the 'FAST' flag transfer through the mmapped buffer of the device.
+bool isMmapTransferRequested(const StreamContext& context);
 std::vector<int> getSampleRatesFromProfile(const alsa_device_profile* profile);
+// When 'useMmap' is set, the device is opened for mmap transfers if it supports them, and for
+// read / write transfers otherwise, see 'DeviceProxy::isMmap'.
 DeviceProxy openProxyForAttachedDevice(const DeviceProfile& deviceProfile,
-                                       struct pcm_config* pcmConfig, size_t bufferFrameCount);
+                                       struct pcm_config* pcmConfig, size_t bufferFrameCount,
+                                       bool useMmap = false);
 DeviceProxy openProxyForExternalDevice(const DeviceProfile& deviceProfile,
-                                       struct pcm_config* pcmConfig, bool requireExactMatch);
+                                       struct pcm_config* pcmConfig, bool requireExactMatch,
+                                       bool useMmap = false);
+// Counterparts of 'proxy_read_with_retries' and 'proxy_write_with_retries' for any proxy.
+// Mmap proxies copy to or from the mmapped buffer directly, and return -EPIPE after recovering
+// from an xrun, the frames are transferred anyway.
+int readWithRetries(DeviceProxy& proxy, void* data, size_t bytes, int retries);
+int writeWithRetries(DeviceProxy& proxy, const void* data, size_t bytes, int retries);
+// Count of frames that an mmap proxy can transfer without waiting, or a negative error.
+int getMmapAvailableFrames(DeviceProxy& proxy);
 DeviceProxy readAlsaDeviceInfo(const DeviceProfile& deviceProfile);
 void resetTransferredFrames(DeviceProxy& proxy, uint64_t frames);
 
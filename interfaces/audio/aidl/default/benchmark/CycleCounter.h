@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <optional>
+
+#include <android-base/unique_fd.h>
+
+namespace aidl::android::hardware::audio::effect::benchmark {
+
+/**
+ * Counts the CPU cycles spent by the calling thread, using the kernel perf events.
+ *
+ * Cycle counts are independent of frequency scaling, which makes them comparable across devices
+ * and runs. They require perf events to be accessible, i.e. running as root or with a low enough
+ * perf_event_paranoid level, otherwise read() returns std::nullopt.
+ */
+class CycleCounter {
+  public:
+    CycleCounter() {
+        perf_event_attr attr = {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        mFd.reset(syscall(__NR_perf_event_open, &attr, 0 /* pid */, -1 /* cpu */,
+                          -1 /* group_fd */, 0 /* flags */));
+    }
+
+    void reset() {
+        if (mFd.ok()) ioctl(mFd.get(), PERF_EVENT_IOC_RESET, 0);
+    }
+
+    std::optional<uint64_t> read() const {
+        uint64_t cycles = 0;
+        if (!mFd.ok() || ::read(mFd.get(), &cycles, sizeof(cycles)) != sizeof(cycles)) {
+            return std::nullopt;
+        }
+        return cycles;
+    }
+
+  private:
+    ::android::base::unique_fd mFd;
+};
+
+}  // namespace aidl::android::hardware::audio::effect::benchmark
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <Utils.h>
+#include <benchmark/benchmark.h>
+
+#include "CycleCounter.h"
+#include "DownmixSwEngine.h"
+
+using aidl::android::hardware::audio::common::getChannelCount;
+using aidl::android::media::audio::common::AudioChannelLayout;
+
+namespace aidl::android::hardware::audio::effect::benchmark {
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+// 10ms, the usual mixer period.
+constexpr size_t kFrames = 480;
+// 7.1 with the channels of the fronts of center, which has no specialized kernel.
+constexpr int32_t kGenericLayout = AudioChannelLayout::LAYOUT_7POINT1 |
+                                   AudioChannelLayout::CHANNEL_FRONT_LEFT_OF_CENTER |
+                                   AudioChannelLayout::CHANNEL_FRONT_RIGHT_OF_CENTER;
+
+std::vector<float> makeNoise(size_t samples) {
+    std::minstd_rand gen(42);
+    // Low enough for the fold not to clip.
+    std::uniform_real_distribution<float> dist(-0.1f, 0.1f);
+    std::vector<float> noise(samples);
+    for (auto& sample : noise) sample = dist(gen);
+    return noise;
+}
+
+}  // namespace
+
+/**
+ * Downmix of 10ms buffers at 48kHz to stereo, per input layout and type. The layouts up
+ * to 9.1.6 have specialized kernels, kGenericLayout reads its gains at run time.
+ */
+static void BM_DownmixProcess(::benchmark::State& state) {
+    const auto layout =
+            AudioChannelLayout::make<AudioChannelLayout::layoutMask>(state.range(0));
+    const auto type = static_cast<Downmix::Type>(state.range(1));
+    const size_t channelCount = getChannelCount(layout);
+
+    DownmixSwEngine engine(layout);
+    engine.setType(type);
+    const std::vector<float> input = makeNoise(kFrames * channelCount);
+    std::vector<float> output(kFrames * 2);
+
+    CycleCounter cycleCounter;
+    for (auto _ : state) {
+        engine.process(input.data(), output.data(), kFrames);
+        ::benchmark::DoNotOptimize(output.data());
+        ::benchmark::ClobberMemory();
+    }
+
+    const double processedFrames = static_cast<double>(state.iterations()) * kFrames;
+    state.counters["realtime"] = ::benchmark::Counter(processedFrames / kSampleRate,
+                                                      ::benchmark::Counter::kIsRate);
+    if (auto cycles = cycleCounter.read(); cycles.has_value()) {
+        state.counters["cycles_per_frame"] = *cycles / processedFrames;
+    }
+}
+BENCHMARK(BM_DownmixProcess)
+        ->ArgNames({"layout", "type"})
+        ->ArgsProduct({{AudioChannelLayout::LAYOUT_5POINT1, AudioChannelLayout::LAYOUT_7POINT1,
+                        AudioChannelLayout::LAYOUT_7POINT1POINT4, kGenericLayout},
+                       {static_cast<int>(Downmix::Type::STRIP),
+                        static_cast<int>(Downmix::Type::FOLD)}});
+
+}  // namespace aidl::android::hardware::audio::effect::benchmark
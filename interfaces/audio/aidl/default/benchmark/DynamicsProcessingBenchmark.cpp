@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "CycleCounter.h"
+#include "DynamicsProcessingSwEngine.h"
+
+namespace aidl::android::hardware::audio::effect::benchmark {
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+// 10ms, the usual mixer period.
+constexpr size_t kFrames = 480;
+constexpr int kEqBandCount = 4;
+const std::vector<float> kMbcCutoffs = {100, 400, 1500, 6000, 20000};
+
+std::vector<float> makeNoise(size_t samples) {
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<float> noise(samples);
+    for (auto& sample : noise) sample = dist(gen);
+    return noise;
+}
+
+/**
+ * An engine with all the stages in use and enabled on every channel, compressing and limiting the
+ * full scale noise of makeNoise().
+ */
+DynamicsProcessingSwEngine makeEngine(size_t channelCount, size_t mbcBandCount) {
+    DynamicsProcessing::EngineArchitecture architecture = {
+            .preEqStage = {.inUse = true, .bandCount = kEqBandCount},
+            .postEqStage = {.inUse = true, .bandCount = kEqBandCount},
+            .mbcStage = {.inUse = true, .bandCount = static_cast<int>(mbcBandCount)},
+            .limiterInUse = true};
+    DynamicsProcessingSwEngine engine(kSampleRate, channelCount, architecture);
+
+    std::vector<DynamicsProcessing::ChannelConfig> channels;
+    std::vector<DynamicsProcessing::EqBandConfig> eqBands;
+    std::vector<DynamicsProcessing::MbcBandConfig> mbcBands;
+    std::vector<DynamicsProcessing::LimiterConfig> limiters;
+    for (int channel = 0; channel < static_cast<int>(channelCount); channel++) {
+        channels.push_back({.channel = channel, .enable = true});
+        for (int band = 0; band < kEqBandCount; band++) {
+            eqBands.push_back({.channel = channel,
+                               .band = band,
+                               .enable = true,
+                               .cutoffFrequencyHz = 250.f * (1 << (2 * band)),
+                               .gainDb = band % 2 == 0 ? 3.f : -3.f});
+        }
+        for (int band = 0; band < static_cast<int>(mbcBandCount); band++) {
+            mbcBands.push_back({.channel = channel,
+                                .band = band,
+                                .enable = true,
+                                .cutoffFrequencyHz = kMbcCutoffs[band],
+                                .attackTimeMs = 3,
+                                .releaseTimeMs = 80,
+                                .ratio = 4,
+                                .thresholdDb = -20,
+                                .noiseGateThresholdDb = -70,
+                                .expanderRatio = 2,
+                                .postGainDb = 6});
+        }
+        limiters.push_back({.channel = channel,
+                            .enable = true,
+                            .linkGroup = 0,
+                            .attackTimeMs = 1,
+                            .releaseTimeMs = 60,
+                            .ratio = 10,
+                            .thresholdDb = -3});
+    }
+    engine.setPreEq(channels, eqBands);
+    engine.setPostEq(channels, eqBands);
+    engine.setMbc(channels, mbcBands);
+    engine.setLimiters(limiters);
+    return engine;
+}
+
+}  // namespace
+
+/**
+ * Steady state processing of 10ms buffers at 48kHz through the full DynamicsProcessing chain,
+ * per channel count (up to 8 channels of automotive output) and multiband compressor band count.
+ * "realtime" is the number of seconds of audio processed per second of CPU.
+ */
+static void BM_DynamicsProcessingProcess(::benchmark::State& state) {
+    const size_t channelCount = state.range(0);
+    const size_t mbcBandCount = state.range(1);
+
+    DynamicsProcessingSwEngine engine = makeEngine(channelCount, mbcBandCount);
+    const std::vector<float> in = makeNoise(kFrames * channelCount);
+    std::vector<float> out(in.size());
+
+    CycleCounter cycleCounter;
+    for (auto _ : state) {
+        engine.process(in.data(), out.data(), kFrames);
+        ::benchmark::DoNotOptimize(out.data());
+        ::benchmark::ClobberMemory();
+    }
+
+    const double processedFrames = static_cast<double>(state.iterations()) * kFrames;
+    state.counters["realtime"] = ::benchmark::Counter(processedFrames / kSampleRate,
+                                                      ::benchmark::Counter::kIsRate);
+    if (auto cycles = cycleCounter.read(); cycles.has_value()) {
+        state.counters["cycles_per_frame"] = *cycles / processedFrames;
+        state.counters["cycles_per_sample"] = *cycles / (processedFrames * channelCount);
+    }
+}
+BENCHMARK(BM_DynamicsProcessingProcess)
+        ->ArgNames({"channels", "bands"})
+        ->ArgsProduct({{2, 4, 6, 8}, {1, 3, 5}});
+
+}  // namespace aidl::android::hardware::audio::effect::benchmark
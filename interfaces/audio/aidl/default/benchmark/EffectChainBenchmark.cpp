@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <time.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "effect-impl/EffectBiquad.h"
+#include "effect-impl/EffectChain.h"
+#include "effect-impl/EffectImpl.h"
+
+namespace aidl::android::hardware::audio::effect::benchmark {
+
+namespace {
+
+using ::aidl::android::media::audio::common::AudioChannelLayout;
+using ::aidl::android::media::audio::common::AudioFormatType;
+using ::aidl::android::media::audio::common::PcmType;
+using ::android::hardware::EventFlag;
+
+constexpr int kSampleRate = 48000;
+constexpr size_t kChannelCount = 2;
+// 10ms, the usual mixer period.
+constexpr size_t kFrames = 480;
+constexpr size_t kSamples = kFrames * kChannelCount;
+
+/**
+ * Stand-in for the software effects of an output chain, with a comparable processing load: a 5
+ * band equalizer.
+ */
+class BiquadEffect final : public EffectImpl {
+  public:
+    ~BiquadEffect() { cleanUp(); }
+
+    ndk::ScopedAStatus getDescriptor(Descriptor* desc) override {
+        desc->common.name = getEffectName();
+        return ndk::ScopedAStatus::ok();
+    }
+    ndk::ScopedAStatus setParameterSpecific(const Parameter::Specific&)
+            REQUIRES(mImplMutex) override {
+        return ndk::ScopedAStatus::ok();
+    }
+    ndk::ScopedAStatus getParameterSpecific(const Parameter::Id&, Parameter::Specific*)
+            REQUIRES(mImplMutex) override {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    std::string getEffectName() override { return "BiquadEffect"; }
+
+    std::shared_ptr<EffectContext> createContext(const Parameter::Common& common)
+            REQUIRES(mImplMutex) override {
+        mEngine = std::make_unique<BiquadCascade>(kChannelCount, 5);
+        mEngine->setCoefficients(designGraphicEqualizer(
+                kSampleRate, {60, 230, 910, 3600, 14000}, {300, -200, 100, -200, 300}));
+        return EffectImpl::createContext(common);
+    }
+    RetCode releaseContext() REQUIRES(mImplMutex) override {
+        mEngine.reset();
+        return RetCode::SUCCESS;
+    }
+    IEffect::Status effectProcessImpl(float* in, float* out, int samples)
+            REQUIRES(mImplMutex) override {
+        mEngine->process(in, out, samples / kChannelCount);
+        return {STATUS_OK, samples, samples};
+    }
+
+  private:
+    std::unique_ptr<BiquadCascade> mEngine GUARDED_BY(mImplMutex);
+};
+
+// The fused entries of an effect library, see Factory::getDlSyms_l().
+const effect_dl_interface_s kFusedInterface = {nullptr, nullptr, nullptr, &setEffectFused,
+                                                &processFusedEffect};
+
+// Client side of the FMQs of an effect or of a chain, following the protocol of the framework.
+class Client {
+  public:
+    explicit Client(const IEffect::OpenEffectReturn& ret)
+        : mStatusMQ(std::make_unique<EffectContext::StatusMQ>(ret.statusMQ)),
+          mInputMQ(std::make_unique<EffectContext::DataMQ>(ret.inputDataMQ)),
+          mOutputMQ(std::make_unique<EffectContext::DataMQ>(ret.outputDataMQ)) {
+        EventFlag::createEventFlag(mStatusMQ->getEventFlagWord(), &mEventFlag);
+    }
+    ~Client() { EventFlag::deleteEventFlag(&mEventFlag); }
+
+    // Sends a buffer and waits for the processed one, in place.
+    bool transfer(float* buffer, size_t samples) {
+        if (!mInputMQ->write(buffer, samples)) return false;
+        mEventFlag->wake(kEventFlagDataMqNotEmpty);
+        IEffect::Status status;
+        if (!mStatusMQ->readBlocking(&status, 1) || status.status != STATUS_OK) return false;
+        return mOutputMQ->read(buffer, status.fmqProduced);
+    }
+
+  private:
+    std::unique_ptr<EffectContext::StatusMQ> mStatusMQ;
+    std::unique_ptr<EffectContext::DataMQ> mInputMQ;
+    std::unique_ptr<EffectContext::DataMQ> mOutputMQ;
+    EventFlag* mEventFlag = nullptr;
+};
+
+Parameter::Common makeCommon() {
+    Parameter::Common common;
+    common.input.base.sampleRate = kSampleRate;
+    common.input.base.channelMask = AudioChannelLayout::make<AudioChannelLayout::layoutMask>(
+            AudioChannelLayout::LAYOUT_STEREO);
+    common.input.base.format = {.type = AudioFormatType::PCM, .pcm = PcmType::FLOAT_32_BIT};
+    common.input.frameCount = kFrames;
+    common.output = common.input;
+    return common;
+}
+
+double processCpuTimeUs() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+}  // namespace
+
+/**
+ * One 10ms stereo buffer through a chain of effects, either through the FMQs and the worker of
+ * each effect in turn as the framework does for the effects of a stream, or through the single
+ * FMQ set and worker of an EffectChain, as created by the Factory for an "effectChain" of the
+ * effect config. The time is the latency of the buffer; "cpu_us" is the CPU time of all the
+ * threads of the process per buffer, including the effect workers.
+ */
+static void BM_EffectChain(::benchmark::State& state) {
+    const bool fused = state.range(0);
+    const size_t effectCount = state.range(1);
+    const Parameter::Common common = makeCommon();
+
+    std::vector<std::shared_ptr<IEffect>> effects;
+    std::vector<std::unique_ptr<Client>> clients;
+    if (fused) {
+        std::vector<EffectChain::Member> members;
+        for (size_t i = 0; i < effectCount; i++) {
+            members.push_back({ndk::SharedRefBase::make<BiquadEffect>(), &kFusedInterface});
+        }
+        Descriptor desc;
+        desc.common.name = "BenchmarkChain";
+        effects.push_back(ndk::SharedRefBase::make<EffectChain>(desc, std::move(members)));
+    } else {
+        for (size_t i = 0; i < effectCount; i++) {
+            effects.push_back(ndk::SharedRefBase::make<BiquadEffect>());
+        }
+    }
+    for (const auto& effect : effects) {
+        IEffect::OpenEffectReturn ret;
+        if (!effect->open(common, std::nullopt, &ret).isOk()) {
+            state.SkipWithError("failed to open effect");
+            return;
+        }
+        clients.push_back(std::make_unique<Client>(ret));
+        effect->command(CommandId::START);
+    }
+
+    std::vector<float> buffer(kSamples, 0.1f);
+    const double cpuStartUs = processCpuTimeUs();
+    for (auto _ : state) {
+        for (const auto& client : clients) {
+            if (!client->transfer(buffer.data(), kSamples)) {
+                state.SkipWithError("transfer failed");
+                break;
+            }
+        }
+        ::benchmark::DoNotOptimize(buffer.data());
+    }
+    state.counters["cpu_us"] = (processCpuTimeUs() - cpuStartUs) / state.iterations();
+
+    for (const auto& effect : effects) {
+        effect->command(CommandId::STOP);
+        effect->close();
+    }
+}
+BENCHMARK(BM_EffectChain)
+        ->ArgNames({"fused", "effects"})
+        ->ArgsProduct({{0, 1}, {1, 2, 4}})
+        ->UseRealTime();
+
+}  // namespace aidl::android::hardware::audio::effect::benchmark
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "CycleCounter.h"
+#include "effect-impl/EffectBiquad.h"
+
+namespace aidl::android::hardware::audio::effect::benchmark {
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr size_t kChannelCount = 2;
+
+// The bands of EqualizerSw, and a 10 band octave equalizer.
+const std::vector<int> kCenterFreqs5 = {60, 230, 910, 3600, 14000};
+const std::vector<int> kCenterFreqs10 = {31, 62, 125, 250, 500, 1000, 2000, 4000, 8000, 16000};
+
+std::vector<int32_t> makeLevels(size_t bandCount, int32_t sign) {
+    // Non zero levels on all bands, flat bands would be skipped.
+    std::vector<int32_t> levels(bandCount);
+    for (size_t i = 0; i < bandCount; i++) {
+        levels[i] = sign * (i % 2 == 0 ? 600 : -400);
+    }
+    return levels;
+}
+
+std::vector<float> makeNoise(size_t samples) {
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+    std::vector<float> noise(samples);
+    for (auto& sample : noise) sample = dist(gen);
+    return noise;
+}
+
+void setCounters(::benchmark::State& state, const CycleCounter& cycleCounter, size_t frames) {
+    const double processedFrames = static_cast<double>(state.iterations()) * frames;
+    state.counters["frames"] =
+            ::benchmark::Counter(processedFrames, ::benchmark::Counter::kIsRate);
+    if (auto cycles = cycleCounter.read(); cycles.has_value()) {
+        state.counters["cycles_per_frame"] = *cycles / processedFrames;
+    }
+}
+
+}  // namespace
+
+/**
+ * Steady state processing of 48kHz stereo with a 5 or 10 band equalizer, for typical buffer sizes
+ * (1ms to 40ms).
+ */
+static void BM_EqualizerProcess(::benchmark::State& state) {
+    const size_t bandCount = state.range(0);
+    const size_t frames = state.range(1);
+    const auto& centerFreqs = bandCount == 5 ? kCenterFreqs5 : kCenterFreqs10;
+
+    BiquadCascade eq(kChannelCount, bandCount);
+    eq.setCoefficients(designGraphicEqualizer(kSampleRate, centerFreqs, makeLevels(bandCount, 1)));
+    const std::vector<float> in = makeNoise(frames * kChannelCount);
+    std::vector<float> out(in.size());
+
+    CycleCounter cycleCounter;
+    for (auto _ : state) {
+        eq.process(in.data(), out.data(), frames);
+        ::benchmark::DoNotOptimize(out.data());
+        ::benchmark::ClobberMemory();
+    }
+    setCounters(state, cycleCounter, frames);
+}
+BENCHMARK(BM_EqualizerProcess)
+        ->ArgNames({"bands", "frames"})
+        ->ArgsProduct({{5, 10}, {48, 192, 480, 960, 1920}});
+
+/** Same with a band level change in every buffer, so every frame runs the coefficient ramp. */
+static void BM_EqualizerProcessWithRamp(::benchmark::State& state) {
+    const size_t bandCount = state.range(0);
+    const size_t frames = state.range(1);
+    const auto& centerFreqs = bandCount == 5 ? kCenterFreqs5 : kCenterFreqs10;
+
+    BiquadCascade eq(kChannelCount, bandCount);
+    const std::vector<std::vector<BiquadCoefficients>> coefs = {
+            designGraphicEqualizer(kSampleRate, centerFreqs, makeLevels(bandCount, 1)),
+            designGraphicEqualizer(kSampleRate, centerFreqs, makeLevels(bandCount, -1))};
+    const std::vector<float> in = makeNoise(frames * kChannelCount);
+    std::vector<float> out(in.size());
+
+    CycleCounter cycleCounter;
+    size_t i = 0;
+    for (auto _ : state) {
+        eq.setCoefficients(coefs[i++ % coefs.size()], frames);
+        eq.process(in.data(), out.data(), frames);
+        ::benchmark::DoNotOptimize(out.data());
+        ::benchmark::ClobberMemory();
+    }
+    setCounters(state, cycleCounter, frames);
+}
+BENCHMARK(BM_EqualizerProcessWithRamp)
+        ->ArgNames({"bands", "frames"})
+        ->ArgsProduct({{5, 10}, {48, 480}});
+
+}  // namespace aidl::android::hardware::audio::effect::benchmark
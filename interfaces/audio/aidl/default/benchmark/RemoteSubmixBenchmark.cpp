@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <aidl/android/media/audio/common/AudioDeviceAddress.h>
+#include <benchmark/benchmark.h>
+
+#include "CycleCounter.h"
+#include "SubmixResampler.h"
+#include "SubmixRoute.h"
+
+using aidl::android::hardware::audio::effect::benchmark::CycleCounter;
+using aidl::android::media::audio::common::AudioDeviceAddress;
+
+namespace aidl::android::hardware::audio::core::benchmark {
+
+using r_submix::SubmixResampler;
+using r_submix::SubmixRoute;
+
+namespace {
+
+constexpr int kPipeSampleRate = 48000;
+constexpr size_t kChannelCount = 2;
+// 10ms, the usual mixer period.
+constexpr size_t kWriteFrames = 480;
+constexpr int kDurationMs = 3000;
+// Same as StreamRemoteSubmix.
+constexpr auto kReadAttemptSleep = std::chrono::milliseconds(5);
+
+std::vector<int16_t> makeSine(size_t frames, int sampleRate) {
+    std::vector<int16_t> sine(frames * kChannelCount);
+    for (size_t i = 0; i < frames; ++i) {
+        const int16_t sample = std::lround(8192 * std::sin(2 * M_PI * 1000 * i / sampleRate));
+        std::fill_n(&sine[i * kChannelCount], kChannelCount, sample);
+    }
+    return sine;
+}
+
+r_submix::AudioConfig makePipeConfig() {
+    r_submix::AudioConfig config;
+    config.sampleRate = kPipeSampleRate;
+    config.frameSize = kChannelCount * sizeof(int16_t);
+    return config;
+}
+
+}  // namespace
+
+/**
+ * Sample rate conversion of 10ms stereo 16-bit buffers, as done by a remote submix stream which
+ * does not run at the rate of the pipe.
+ */
+static void BM_SubmixResample(::benchmark::State& state) {
+    const int inputRate = state.range(0);
+    const int outputRate = state.range(1);
+    const size_t inputFrames = inputRate / 100;
+
+    const auto pipeConfig = makePipeConfig();
+    SubmixResampler resampler(pipeConfig.format, kChannelCount, inputRate, outputRate,
+                              inputFrames);
+    const std::vector<int16_t> input = makeSine(inputFrames, inputRate);
+    const size_t maxOutputFrames = resampler.getMaxOutputFrames(inputFrames);
+    std::vector<int16_t> output(maxOutputFrames * kChannelCount);
+
+    CycleCounter cycleCounter;
+    for (auto _ : state) {
+        resampler.pushInput(input.data(), inputFrames);
+        resampler.pullOutput(output.data(), maxOutputFrames);
+        ::benchmark::DoNotOptimize(output.data());
+        ::benchmark::ClobberMemory();
+    }
+
+    const double processedFrames = static_cast<double>(state.iterations()) * inputFrames;
+    state.counters["realtime"] =
+            ::benchmark::Counter(processedFrames / inputRate, ::benchmark::Counter::kIsRate);
+    if (auto cycles = cycleCounter.read(); cycles.has_value()) {
+        state.counters["cycles_per_frame"] = *cycles / processedFrames;
+    }
+}
+BENCHMARK(BM_SubmixResample)
+        ->ArgNames({"in", "out"})
+        ->Args({44100, 48000})
+        ->Args({48000, 44100})
+        ->Args({16000, 48000})
+        ->Args({48000, 16000});
+
+/**
+ * Latency and xruns of a submix route between a writer and a reader running in real time, for
+ * several read sizes, and for a writer which does not run at the rate of the pipe.
+ *
+ * The writer writes 10ms buffers and is only paced by the pipe, like the output stream. The
+ * reader reads on its period with the retries of the input stream, and reports each read to the
+ * route, which adjusts the latency target. The latency is the fill of the pipe before each read.
+ */
+static void BM_SubmixRouteLatency(::benchmark::State& state) {
+    const size_t readFrames = state.range(0);
+    const int writerRate = state.range(1);
+    const auto readPeriod = std::chrono::microseconds(readFrames * 1000000 / kPipeSampleRate);
+    const size_t readCount = kDurationMs * kPipeSampleRate / 1000 / readFrames;
+    const AudioDeviceAddress address =
+            AudioDeviceAddress::make<AudioDeviceAddress::Tag::id>("benchmark");
+
+    double latencySumFrames = 0;
+    ssize_t maxLatencyFrames = 0;
+    uint64_t xruns = 0;
+    size_t latencyTargetFrames = 0;
+    for (auto _ : state) {
+        auto route = SubmixRoute::findOrCreateRoute(address, makePipeConfig());
+        if (route == nullptr) {
+            state.SkipWithError("could not create the route");
+            return;
+        }
+        route->openStream(true /*isInput*/);
+        route->openStream(false /*isInput*/);
+        route->exitStandby(true /*isInput*/);
+        route->exitStandby(false /*isInput*/);
+        sp<MonoPipe> sink = route->getSink();
+        sp<MonoPipeReader> source = route->getSource();
+
+        std::atomic<bool> stopWriter = false;
+        std::atomic<bool> writerStopped = false;
+        std::thread writer([&] {
+            const size_t writeFrames = kWriteFrames * writerRate / kPipeSampleRate;
+            const std::vector<int16_t> input = makeSine(writeFrames, writerRate);
+            std::unique_ptr<SubmixResampler> resampler;
+            std::vector<int16_t> resampled;
+            if (writerRate != kPipeSampleRate) {
+                resampler = std::make_unique<SubmixResampler>(makePipeConfig().format,
+                                                              kChannelCount, writerRate,
+                                                              kPipeSampleRate, writeFrames);
+                resampled.resize(resampler->getMaxOutputFrames(writeFrames) * kChannelCount);
+            }
+            while (!stopWriter) {
+                if (resampler != nullptr) {
+                    resampler->pushInput(input.data(), writeFrames);
+                    const size_t frames = resampler->pullOutput(
+                            resampled.data(), resampled.size() / kChannelCount);
+                    sink->write(resampled.data(), frames);
+                } else {
+                    sink->write(input.data(), writeFrames);
+                }
+            }
+            writerStopped = true;
+        });
+
+        std::vector<int16_t> output(readFrames * kChannelCount);
+        auto nextRead = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < readCount; ++i) {
+            nextRead += readPeriod;
+            std::this_thread::sleep_until(nextRead);
+            const ssize_t latencyFrames = source->availableToRead();
+            latencySumFrames += std::max<ssize_t>(latencyFrames, 0);
+            maxLatencyFrames = std::max(maxLatencyFrames, latencyFrames);
+            const auto deadline = std::chrono::steady_clock::now() + readPeriod / 2;
+            size_t framesRead = 0;
+            while (framesRead < readFrames) {
+                const ssize_t result = source->read(&output[framesRead * kChannelCount],
+                                                    readFrames - framesRead);
+                if (result > 0) framesRead += result;
+                if (std::chrono::steady_clock::now() >= deadline) break;
+                if (result <= 0) std::this_thread::sleep_for(kReadAttemptSleep);
+            }
+            route->onPipeRead(readFrames, framesRead);
+        }
+
+        // Keep the writer from blocking on a full pipe while it stops.
+        stopWriter = true;
+        while (!writerStopped) {
+            source->read(output.data(), readFrames);
+            std::this_thread::sleep_for(readPeriod);
+        }
+        writer.join();
+        xruns += route->getReadXrunCount();
+        latencyTargetFrames = route->getLatencyTargetFrames();
+        route->closeStream(false /*isInput*/);
+        route->closeStream(true /*isInput*/);
+        route->releasePipe();
+        SubmixRoute::removeRoute(address);
+    }
+
+    const double reads = static_cast<double>(state.iterations()) * readCount;
+    state.counters["latency_ms"] = latencySumFrames / reads * 1000 / kPipeSampleRate;
+    state.counters["max_latency_ms"] = maxLatencyFrames * 1000.0 / kPipeSampleRate;
+    state.counters["target_ms"] = latencyTargetFrames * 1000.0 / kPipeSampleRate;
+    state.counters["xruns"] = xruns;
+}
+BENCHMARK(BM_SubmixRouteLatency)
+        ->ArgNames({"read_frames", "writer_rate"})
+        ->Args({240, 48000})
+        ->Args({480, 48000})
+        ->Args({960, 48000})
+        ->Args({480, 44100})
+        ->Iterations(1)
+        ->UseRealTime()
+        ->Unit(::benchmark::kMillisecond);
+
+}  // namespace aidl::android::hardware::audio::core::benchmark
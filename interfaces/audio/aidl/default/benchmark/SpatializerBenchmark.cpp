@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <Utils.h>
+#include <benchmark/benchmark.h>
+
+#include "CycleCounter.h"
+#include "SpatializerSwEngine.h"
+
+using aidl::android::hardware::audio::common::getChannelCount;
+using aidl::android::media::audio::common::AudioChannelLayout;
+
+namespace aidl::android::hardware::audio::effect::benchmark {
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+// 10ms, the usual mixer period.
+constexpr size_t kFrames = 480;
+
+std::vector<float> makeNoise(size_t samples) {
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<float> noise(samples);
+    for (auto& sample : noise) sample = dist(gen);
+    return noise;
+}
+
+}  // namespace
+
+/**
+ * Binaural rendering of 10ms buffers at 48kHz to stereo, per input layout. The cost grows with
+ * the number of channels for the forward FFTs and the spectral products, the inverse FFTs are
+ * per ear.
+ */
+static void BM_SpatializerProcess(::benchmark::State& state) {
+    const auto layout =
+            AudioChannelLayout::make<AudioChannelLayout::layoutMask>(state.range(0));
+    const size_t channelCount = getChannelCount(layout);
+
+    SpatializerSwEngine engine(kSampleRate, layout, 2);
+    const std::vector<float> input = makeNoise(kFrames * channelCount);
+    std::vector<float> output(kFrames * 2);
+
+    CycleCounter cycleCounter;
+    for (auto _ : state) {
+        engine.process(input.data(), output.data(), kFrames);
+        ::benchmark::DoNotOptimize(output.data());
+        ::benchmark::ClobberMemory();
+    }
+
+    const double processedFrames = static_cast<double>(state.iterations()) * kFrames;
+    state.counters["realtime"] = ::benchmark::Counter(processedFrames / kSampleRate,
+                                                      ::benchmark::Counter::kIsRate);
+    if (auto cycles = cycleCounter.read(); cycles.has_value()) {
+        state.counters["cycles_per_frame"] = *cycles / processedFrames;
+    }
+}
+BENCHMARK(BM_SpatializerProcess)
+        ->ArgName("layout")
+        ->Arg(AudioChannelLayout::LAYOUT_5POINT1)
+        ->Arg(AudioChannelLayout::LAYOUT_7POINT1)
+        ->Arg(AudioChannelLayout::LAYOUT_7POINT1POINT4);
+
+}  // namespace aidl::android::hardware::audio::effect::benchmark
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "CycleCounter.h"
+#include "VisualizerSwEngine.h"
+
+namespace aidl::android::hardware::audio::effect::benchmark {
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+// 10ms, the usual mixer period.
+constexpr size_t kFrames = 480;
+
+std::vector<float> makeNoise(size_t samples) {
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<float> noise(samples);
+    for (auto& sample : noise) sample = dist(gen);
+    return noise;
+}
+
+}  // namespace
+
+/**
+ * Processing of 10ms buffers at 48kHz in place, as on the effect worker, per channel count.
+ * With capture=1 another thread takes waveform captures and measurements in a loop, which must
+ * not slow down processing. "realtime" is the number of seconds of audio processed per second.
+ */
+static void BM_VisualizerProcess(::benchmark::State& state) {
+    const size_t channelCount = state.range(0);
+    const bool capture = state.range(1);
+
+    VisualizerSwEngine engine(kSampleRate, channelCount);
+    std::vector<float> buffer = makeNoise(kFrames * channelCount);
+    // Fills the capture ring.
+    engine.process(buffer.data(), buffer.data(), kFrames);
+
+    std::atomic<bool> done = false;
+    std::thread reader;
+    if (capture) {
+        reader = std::thread([&engine, &done] {
+            while (!done) {
+                ::benchmark::DoNotOptimize(engine.captureWaveform());
+                ::benchmark::DoNotOptimize(engine.getMeasurement());
+            }
+        });
+    }
+
+    CycleCounter cycleCounter;
+    for (auto _ : state) {
+        engine.process(buffer.data(), buffer.data(), kFrames);
+        ::benchmark::DoNotOptimize(buffer.data());
+        ::benchmark::ClobberMemory();
+    }
+
+    const double processedFrames = static_cast<double>(state.iterations()) * kFrames;
+    state.counters["realtime"] = ::benchmark::Counter(processedFrames / kSampleRate,
+                                                      ::benchmark::Counter::kIsRate);
+    if (auto cycles = cycleCounter.read(); cycles.has_value()) {
+        state.counters["cycles_per_frame"] = *cycles / processedFrames;
+    }
+    done = true;
+    if (reader.joinable()) reader.join();
+}
+BENCHMARK(BM_VisualizerProcess)->ArgNames({"channels", "capture"})->ArgsProduct({{2, 8}, {0, 1}});
+
+/** An FFT capture per capture size, as requested by the client at the display rate. */
+static void BM_VisualizerCaptureFft(::benchmark::State& state) {
+    const int captureSize = state.range(0);
+
+    VisualizerSwEngine engine(kSampleRate, 2);
+    engine.setCaptureSize(captureSize);
+    std::vector<float> buffer = makeNoise(kFrames * 2);
+    for (int i = 0; i < 4; i++) engine.process(buffer.data(), buffer.data(), kFrames);
+
+    for (auto _ : state) {
+        ::benchmark::DoNotOptimize(engine.captureFft());
+    }
+}
+BENCHMARK(BM_VisualizerCaptureFft)
+        ->ArgName("captureSize")
+        ->Arg(VisualizerSwEngine::kMinCaptureSize)
+        ->Arg(512)
+        ->Arg(VisualizerSwEngine::kMaxCaptureSize);
+
+}  // namespace aidl::android::hardware::audio::effect::benchmark
@@ -153,12 +153,34 @@ RetCode DownmixSw::releaseContext() {
 
 // Processing method running in EffectWorker thread.
 IEffect::Status DownmixSw::effectProcessImpl(float* in, float* out, int samples) {
-    // TODO: get data buffer and process.
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
-    for (int i = 0; i < samples; i++) {
-        *out++ = *in++;
+    RETURN_VALUE_IF(!mContext, (IEffect::Status{EX_NULL_POINTER, 0, 0}), "nullContext");
+    return mContext->process(in, out, samples);
+}
+
+RetCode DownmixSwContext::setCommon(const Parameter::Common& common) {
+    if (auto ret = EffectContext::setCommon(common); ret != RetCode::SUCCESS) {
+        return ret;
+    }
+    createEngine();
+    return RetCode::SUCCESS;
+}
+
+void DownmixSwContext::createEngine() {
+    if (mOutputChannelCount != 2) {
+        LOG(ERROR) << __func__ << " output must be stereo: " << mCommon.toString();
+        mEngine.reset();
+        return;
     }
-    return {STATUS_OK, samples, samples};
+    mEngine = std::make_unique<DownmixSwEngine>(mCommon.input.base.channelMask);
+    mEngine->setType(mType);
+}
+
+IEffect::Status DownmixSwContext::process(float* in, float* out, int samples) {
+    RETURN_VALUE_IF(!mEngine, (IEffect::Status{EX_ILLEGAL_ARGUMENT, 0, 0}), "unsupportedConfig");
+    const size_t frames = samples / mInputChannelCount;
+    mEngine->process(in, out, frames);
+    return {STATUS_OK, static_cast<int32_t>(frames * mInputChannelCount),
+            static_cast<int32_t>(frames * mOutputChannelCount)};
 }
 
 }  // namespace aidl::android::hardware::audio::effect
@@ -21,6 +21,7 @@
 #include <cstdlib>
 #include <memory>
 
+#include "DownmixSwEngine.h"
 #include "effect-impl/EffectImpl.h"
 
 namespace aidl::android::hardware::audio::effect {
@@ -30,17 +31,27 @@ class DownmixSwContext final : public EffectContext {
     DownmixSwContext(int statusDepth, const Parameter::Common& common)
         : EffectContext(statusDepth, common) {
         LOG(DEBUG) << __func__;
+        createEngine();
     }
 
+    RetCode setCommon(const Parameter::Common& common) override;
+
     RetCode setDmType(Downmix::Type type) {
-        // TODO : Add implementation to apply new type
         mType = type;
+        if (mEngine) mEngine->setType(mType);
         return RetCode::SUCCESS;
     }
     Downmix::Type getDmType() const { return mType; }
 
+    IEffect::Status process(float* in, float* out, int samples);
+
   private:
+    // Downmixes to stereo only. With any other output layout there is no engine and process fails
+    // with EX_ILLEGAL_ARGUMENT, where the samples used to be copied through unchanged.
+    void createEngine();
+
     Downmix::Type mType = Downmix::Type::STRIP;
+    std::unique_ptr<DownmixSwEngine> mEngine;
 };
 
 class DownmixSw final : public EffectImpl {
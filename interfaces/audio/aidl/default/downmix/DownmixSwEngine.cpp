@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <utility>
+
+#include <Utils.h>
+
+#include "DownmixSwEngine.h"
+#include "effect-impl/EffectSimd.h"
+
+using aidl::android::hardware::audio::common::getChannelCount;
+using aidl::android::media::audio::common::AudioChannelLayout;
+
+namespace aidl::android::hardware::audio::effect {
+
+namespace {
+
+using StereoGains = DownmixSwEngine::StereoGains;
+
+constexpr float kMinus3Db = 0.70710678f;
+constexpr float kMinus6Db = 0.5f;
+// Pan of the channels between the front left or right and the center.
+constexpr float kPanNear = 0.92387953f;
+constexpr float kPanFar = 0.38268343f;
+
+// Gains of a channel of a positional layout, following the conventions of the framework downmix.
+constexpr StereoGains foldGains(int32_t channel, int32_t layout) {
+    switch (channel) {
+        case AudioChannelLayout::CHANNEL_FRONT_LEFT:
+        case AudioChannelLayout::CHANNEL_FRONT_WIDE_LEFT:
+            return {1.f, 0.f};
+        case AudioChannelLayout::CHANNEL_FRONT_RIGHT:
+        case AudioChannelLayout::CHANNEL_FRONT_WIDE_RIGHT:
+            return {0.f, 1.f};
+        case AudioChannelLayout::CHANNEL_FRONT_LEFT_OF_CENTER:
+            return {kPanNear, kPanFar};
+        case AudioChannelLayout::CHANNEL_FRONT_RIGHT_OF_CENTER:
+            return {kPanFar, kPanNear};
+        case AudioChannelLayout::CHANNEL_BACK_LEFT:
+        case AudioChannelLayout::CHANNEL_SIDE_LEFT:
+        case AudioChannelLayout::CHANNEL_TOP_FRONT_LEFT:
+        case AudioChannelLayout::CHANNEL_TOP_SIDE_LEFT:
+        case AudioChannelLayout::CHANNEL_TOP_BACK_LEFT:
+        case AudioChannelLayout::CHANNEL_BOTTOM_FRONT_LEFT:
+            return {kMinus3Db, 0.f};
+        case AudioChannelLayout::CHANNEL_BACK_RIGHT:
+        case AudioChannelLayout::CHANNEL_SIDE_RIGHT:
+        case AudioChannelLayout::CHANNEL_TOP_FRONT_RIGHT:
+        case AudioChannelLayout::CHANNEL_TOP_SIDE_RIGHT:
+        case AudioChannelLayout::CHANNEL_TOP_BACK_RIGHT:
+        case AudioChannelLayout::CHANNEL_BOTTOM_FRONT_RIGHT:
+        case AudioChannelLayout::CHANNEL_LOW_FREQUENCY_2:
+            return {0.f, kMinus3Db};
+        case AudioChannelLayout::CHANNEL_LOW_FREQUENCY:
+            // With a second LFE, the first one is on the left.
+            if (layout & AudioChannelLayout::CHANNEL_LOW_FREQUENCY_2) return {kMinus3Db, 0.f};
+            return {kMinus3Db, kMinus3Db};
+        case AudioChannelLayout::CHANNEL_FRONT_CENTER:
+        case AudioChannelLayout::CHANNEL_BOTTOM_FRONT_CENTER:
+            return {kMinus3Db, kMinus3Db};
+        case AudioChannelLayout::CHANNEL_BACK_CENTER:
+        case AudioChannelLayout::CHANNEL_TOP_CENTER:
+        case AudioChannelLayout::CHANNEL_TOP_FRONT_CENTER:
+        case AudioChannelLayout::CHANNEL_TOP_BACK_CENTER:
+            return {kMinus6Db, kMinus6Db};
+        default:
+            // Haptic and unknown channels.
+            return {0.f, 0.f};
+    }
+}
+
+template <size_t N>
+constexpr std::array<StereoGains, N> makeFoldMatrix(int32_t layout) {
+    std::array<StereoGains, N> gains{};
+    size_t index = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        const auto channel = static_cast<int32_t>(1u << bit);
+        if (layout & channel) gains[index++] = foldGains(channel, layout);
+    }
+    return gains;
+}
+
+template <int32_t kLayout>
+constexpr size_t kLayoutChannelCount = std::popcount(static_cast<uint32_t>(kLayout));
+
+template <int32_t kLayout>
+constexpr std::array<StereoGains, kLayoutChannelCount<kLayout>> kFoldMatrix =
+        makeFoldMatrix<kLayoutChannelCount<kLayout>>(kLayout);
+
+inline void clampAndStore(float* out, simd::float4 left, simd::float4 right) {
+    const simd::float4 one = simd::set1(1.f);
+    const simd::float4 minusOne = simd::set1(-1.f);
+    left = simd::max(simd::min(left, one), minusOne);
+    right = simd::max(simd::min(right, one), minusOne);
+    simd::float4 lo;
+    simd::float4 hi;
+    simd::interleave(left, right, lo, hi);
+    simd::store(out, lo);
+    simd::store(out + simd::kLanes, hi);
+}
+
+// Remaining frames of any kernel.
+void foldScalar(const float* in, float* out, size_t frames, size_t channelCount,
+                const StereoGains* gains) {
+    for (size_t i = 0; i < frames; i++, in += channelCount, out += 2) {
+        float left = 0;
+        float right = 0;
+        for (size_t c = 0; c < channelCount; c++) {
+            left += in[c] * gains[c].left;
+            right += in[c] * gains[c].right;
+        }
+        out[0] = std::clamp(left, -1.f, 1.f);
+        out[1] = std::clamp(right, -1.f, 1.f);
+    }
+}
+
+template <int32_t kLayout, size_t kChannel>
+inline void foldChannel(simd::float4 samples, simd::float4& left, simd::float4& right) {
+    constexpr StereoGains kGains = kFoldMatrix<kLayout>[kChannel];
+    if constexpr (kGains.left != 0) left = simd::mulAdd(left, samples, simd::set1(kGains.left));
+    if constexpr (kGains.right != 0) right = simd::mulAdd(right, samples, simd::set1(kGains.right));
+}
+
+// Accumulates the channels kGroup * kLanes to kGroup * kLanes + 3 of kLanes frames.
+template <int32_t kLayout, size_t kGroup>
+inline void foldGroup(const float* in, simd::float4& left, simd::float4& right) {
+    constexpr size_t kChannels = kLayoutChannelCount<kLayout>;
+    constexpr size_t kFirst = kGroup * simd::kLanes;
+    constexpr size_t kCount = std::min(simd::kLanes, kChannels - kFirst);
+    // The lanes after the last channel of the first frames are the next frame, in the block and
+    // ignored after the transposition. The last frame is loaded from the end of the block.
+    simd::float4 c0 = simd::load(in + kFirst);
+    simd::float4 c1 = simd::load(in + kChannels + kFirst);
+    simd::float4 c2 = simd::load(in + 2 * kChannels + kFirst);
+    simd::float4 c3 = simd::loadEnd<kCount>(in + 3 * kChannels + kFirst + kCount);
+    // One channel of the kLanes frames per vector.
+    simd::transpose(c0, c1, c2, c3);
+    foldChannel<kLayout, kFirst>(c0, left, right);
+    if constexpr (kCount > 1) foldChannel<kLayout, kFirst + 1>(c1, left, right);
+    if constexpr (kCount > 2) foldChannel<kLayout, kFirst + 2>(c2, left, right);
+    if constexpr (kCount > 3) foldChannel<kLayout, kFirst + 3>(c3, left, right);
+}
+
+template <int32_t kLayout, size_t... kGroups>
+inline void foldFrames(const float* in, simd::float4& left, simd::float4& right,
+                       std::index_sequence<kGroups...>) {
+    (foldGroup<kLayout, kGroups>(in, left, right), ...);
+}
+
+template <int32_t kLayout>
+void foldLayout(const float* in, float* out, size_t frames) {
+    constexpr size_t kChannels = kLayoutChannelCount<kLayout>;
+    constexpr size_t kGroupCount = (kChannels + simd::kLanes - 1) / simd::kLanes;
+    size_t i = 0;
+    // All the input of the frames is loaded before their output is stored, for in place use.
+    for (; i + simd::kLanes <= frames; i += simd::kLanes) {
+        simd::float4 left = simd::set1(0.f);
+        simd::float4 right = simd::set1(0.f);
+        foldFrames<kLayout>(in + i * kChannels, left, right,
+                            std::make_index_sequence<kGroupCount>());
+        clampAndStore(out + 2 * i, left, right);
+    }
+    foldScalar(in + i * kChannels, out + 2 * i, frames - i, kChannels, kFoldMatrix<kLayout>.data());
+}
+
+void foldAny(const float* in, float* out, size_t frames, size_t channelCount,
+             const StereoGains* gains) {
+    size_t i = 0;
+    for (; i + simd::kLanes <= frames; i += simd::kLanes) {
+        const float* frame = in + i * channelCount;
+        simd::float4 left = simd::set1(0.f);
+        simd::float4 right = simd::set1(0.f);
+        for (size_t first = 0; first < channelCount; first += simd::kLanes) {
+            const size_t count = std::min(simd::kLanes, channelCount - first);
+            simd::float4 c[simd::kLanes];
+            for (size_t f = 0; f + 1 < simd::kLanes; f++) {
+                c[f] = simd::load(frame + f * channelCount + first);
+            }
+            c[simd::kLanes - 1] =
+                    simd::loadPartial(frame + (simd::kLanes - 1) * channelCount + first, count);
+            simd::transpose(c[0], c[1], c[2], c[3]);
+            for (size_t j = 0; j < count; j++) {
+                left = simd::mulAdd(left, c[j], simd::set1(gains[first + j].left));
+                right = simd::mulAdd(right, c[j], simd::set1(gains[first + j].right));
+            }
+        }
+        clampAndStore(out + 2 * i, left, right);
+    }
+    foldScalar(in + i * channelCount, out + 2 * i, frames - i, channelCount, gains);
+}
+
+struct LayoutKernel {
+    int32_t layout;
+    void (*fold)(const float* in, float* out, size_t frames);
+};
+
+#define LAYOUT_KERNEL(layout) \
+    { AudioChannelLayout::layout, &foldLayout<AudioChannelLayout::layout> }
+constexpr LayoutKernel kLayoutKernels[] = {
+        LAYOUT_KERNEL(LAYOUT_2POINT1),       LAYOUT_KERNEL(LAYOUT_QUAD),
+        LAYOUT_KERNEL(LAYOUT_QUAD_SIDE),     LAYOUT_KERNEL(LAYOUT_SURROUND),
+        LAYOUT_KERNEL(LAYOUT_PENTA),         LAYOUT_KERNEL(LAYOUT_5POINT1),
+        LAYOUT_KERNEL(LAYOUT_5POINT1_SIDE),  LAYOUT_KERNEL(LAYOUT_5POINT1POINT2),
+        LAYOUT_KERNEL(LAYOUT_5POINT1POINT4), LAYOUT_KERNEL(LAYOUT_6POINT1),
+        LAYOUT_KERNEL(LAYOUT_7POINT1),       LAYOUT_KERNEL(LAYOUT_7POINT1POINT2),
+        LAYOUT_KERNEL(LAYOUT_7POINT1POINT4), LAYOUT_KERNEL(LAYOUT_9POINT1POINT4),
+        LAYOUT_KERNEL(LAYOUT_9POINT1POINT6),
+};
+#undef LAYOUT_KERNEL
+
+void strip(const float* in, float* out, size_t frames, size_t channelCount) {
+    if (channelCount == 2) {
+        if (in != out) memmove(out, in, frames * 2 * sizeof(float));
+        return;
+    }
+    for (size_t i = 0; i < frames; i++, in += channelCount, out += 2) {
+        const float left = in[0];
+        const float right = channelCount > 1 ? in[1] : left;
+        out[0] = left;
+        out[1] = right;
+    }
+}
+
+}  // namespace
+
+DownmixSwEngine::DownmixSwEngine(const AudioChannelLayout& inputLayout)
+    : mChannelCount(getChannelCount(inputLayout)) {
+    if (inputLayout.getTag() != AudioChannelLayout::layoutMask) return;
+    const int32_t layout = inputLayout.get<AudioChannelLayout::layoutMask>();
+    for (const auto& kernel : kLayoutKernels) {
+        if (kernel.layout == layout) {
+            mFoldKernel = kernel.fold;
+            return;
+        }
+    }
+    for (int bit = 0; bit < 32; bit++) {
+        const auto channel = static_cast<int32_t>(1u << bit);
+        if (layout & channel) mGains.push_back(foldGains(channel, layout));
+    }
+}
+
+void DownmixSwEngine::process(const float* in, float* out, size_t frames) const {
+    if (mType == Downmix::Type::FOLD && mChannelCount > 2) {
+        if (mFoldKernel) {
+            mFoldKernel(in, out, frames);
+            return;
+        }
+        if (mGains.size() == mChannelCount) {
+            foldAny(in, out, frames, mChannelCount, mGains.data());
+            return;
+        }
+    }
+    strip(in, out, frames, mChannelCount);
+}
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aidl/android/hardware/audio/effect/BnEffect.h>
+
+namespace aidl::android::hardware::audio::effect {
+
+/**
+ * Downmix of a multichannel layout to stereo.
+ *
+ * STRIP keeps the first two channels. FOLD mixes every channel of a positional layout to the left
+ * and/or right output with a gain depending on its position, and clamps the result. The common
+ * layouts, up to 9.1.6, have kernels specialized at compile time in which the channels are
+ * transposed kLanes frames at a time and the zero gains are skipped; other layouts use the same
+ * kernel with the gains read at run time. Index masks can only be stripped.
+ */
+class DownmixSwEngine {
+  public:
+    struct StereoGains {
+        float left = 0;
+        float right = 0;
+    };
+
+    explicit DownmixSwEngine(const ::aidl::android::media::audio::common::AudioChannelLayout&
+                                     inputLayout);
+
+    void setType(Downmix::Type type) { mType = type; }
+    size_t getInputChannelCount() const { return mChannelCount; }
+
+    /** Downmixes frames of interleaved input to interleaved stereo. out may alias in. */
+    void process(const float* in, float* out, size_t frames) const;
+
+  private:
+    using FoldKernel = void (*)(const float* in, float* out, size_t frames);
+
+    const size_t mChannelCount;
+    Downmix::Type mType = Downmix::Type::STRIP;
+    // Kernel of the input layout if it has one, mGains otherwise.
+    FoldKernel mFoldKernel = nullptr;
+    std::vector<StereoGains> mGains;
+};
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -269,12 +269,8 @@ RetCode DynamicsProcessingSw::releaseContext() {
 
 // Processing method running in EffectWorker thread.
 IEffect::Status DynamicsProcessingSw::effectProcessImpl(float* in, float* out, int samples) {
-    // TODO: get data buffer and process.
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
-    for (int i = 0; i < samples; i++) {
-        *out++ = *in++;
-    }
-    return {STATUS_OK, samples, samples};
+    RETURN_VALUE_IF(!mContext, (IEffect::Status{EX_NULL_POINTER, 0, 0}), "nullContext");
+    return mContext->process(in, out, samples);
 }
 
 RetCode DynamicsProcessingSwContext::setCommon(const Parameter::Common& common) {
@@ -286,6 +282,7 @@ RetCode DynamicsProcessingSwContext::setCommon(const Parameter::Common& common)
             common.input.base.channelMask);
     resizeChannels();
     resizeBands();
+    createEngine();
     LOG(INFO) << __func__ << mCommon.toString();
     return RetCode::SUCCESS;
 }
@@ -301,6 +298,7 @@ RetCode DynamicsProcessingSwContext::setEngineArchitecture(
     }
     mEngineSettings = cfg;
     resizeBands();
+    createEngine();
     return RetCode::SUCCESS;
 }
 
@@ -331,17 +329,23 @@ RetCode DynamicsProcessingSwContext::setChannelCfgs(
 
 RetCode DynamicsProcessingSwContext::setPreEqChannelCfgs(
         const std::vector<DynamicsProcessing::ChannelConfig>& cfgs) {
-    return setChannelCfgs(cfgs, mPreEqChCfgs, mEngineSettings.preEqStage);
+    RetCode ret = setChannelCfgs(cfgs, mPreEqChCfgs, mEngineSettings.preEqStage);
+    if (mEngine) mEngine->setPreEq(mPreEqChCfgs, mPreEqChBands);
+    return ret;
 }
 
 RetCode DynamicsProcessingSwContext::setPostEqChannelCfgs(
         const std::vector<DynamicsProcessing::ChannelConfig>& cfgs) {
-    return setChannelCfgs(cfgs, mPostEqChCfgs, mEngineSettings.postEqStage);
+    RetCode ret = setChannelCfgs(cfgs, mPostEqChCfgs, mEngineSettings.postEqStage);
+    if (mEngine) mEngine->setPostEq(mPostEqChCfgs, mPostEqChBands);
+    return ret;
 }
 
 RetCode DynamicsProcessingSwContext::setMbcChannelCfgs(
         const std::vector<DynamicsProcessing::ChannelConfig>& cfgs) {
-    return setChannelCfgs(cfgs, mMbcChCfgs, mEngineSettings.mbcStage);
+    RetCode ret = setChannelCfgs(cfgs, mMbcChCfgs, mEngineSettings.mbcStage);
+    if (mEngine) mEngine->setMbc(mMbcChCfgs, mMbcChBands);
+    return ret;
 }
 
 RetCode DynamicsProcessingSwContext::setEqBandCfgs(
@@ -373,12 +377,16 @@ RetCode DynamicsProcessingSwContext::setEqBandCfgs(
 
 RetCode DynamicsProcessingSwContext::setPreEqBandCfgs(
         const std::vector<DynamicsProcessing::EqBandConfig>& cfgs) {
-    return setEqBandCfgs(cfgs, mPreEqChBands, mEngineSettings.preEqStage, mPreEqChCfgs);
+    RetCode ret = setEqBandCfgs(cfgs, mPreEqChBands, mEngineSettings.preEqStage, mPreEqChCfgs);
+    if (mEngine) mEngine->setPreEq(mPreEqChCfgs, mPreEqChBands);
+    return ret;
 }
 
 RetCode DynamicsProcessingSwContext::setPostEqBandCfgs(
         const std::vector<DynamicsProcessing::EqBandConfig>& cfgs) {
-    return setEqBandCfgs(cfgs, mPostEqChBands, mEngineSettings.postEqStage, mPostEqChCfgs);
+    RetCode ret = setEqBandCfgs(cfgs, mPostEqChBands, mEngineSettings.postEqStage, mPostEqChCfgs);
+    if (mEngine) mEngine->setPostEq(mPostEqChCfgs, mPostEqChBands);
+    return ret;
 }
 
 RetCode DynamicsProcessingSwContext::setMbcBandCfgs(
@@ -406,6 +414,7 @@ RetCode DynamicsProcessingSwContext::setMbcBandCfgs(
         }
         mMbcChBands[it.channel * bandCount + it.band] = it;
     }
+    if (mEngine) mEngine->setMbc(mMbcChCfgs, mMbcChBands);
     return ret;
 }
 
@@ -431,6 +440,7 @@ RetCode DynamicsProcessingSwContext::setLimiterCfgs(
         }
         mLimiterCfgs[it.channel] = it;
     }
+    if (mEngine) mEngine->setLimiters(mLimiterCfgs);
     return ret;
 }
 
@@ -474,6 +484,7 @@ RetCode DynamicsProcessingSwContext::setInputGainCfgs(
                         RetCode::ERROR_ILLEGAL_PARAMETER, "invalidChannel");
         mInputGainCfgs[cfg.channel] = cfg;
     }
+    if (mEngine) mEngine->setInputGains(mInputGainCfgs);
     return RetCode::SUCCESS;
 }
 
@@ -484,6 +495,32 @@ std::vector<DynamicsProcessing::InputGain> DynamicsProcessingSwContext::getInput
     return ret;
 }
 
+void DynamicsProcessingSwContext::createEngine() {
+    const int sampleRate = mCommon.input.base.sampleRate;
+    if (sampleRate <= 0 || mChannelCount == 0 || mInputChannelCount != mOutputChannelCount) {
+        LOG(WARNING) << __func__ << " unsupported config, bypass: " << mCommon.toString();
+        mEngine.reset();
+        return;
+    }
+    mEngine = std::make_unique<DynamicsProcessingSwEngine>(sampleRate, mChannelCount,
+                                                           mEngineSettings);
+    mEngine->setInputGains(mInputGainCfgs);
+    mEngine->setPreEq(mPreEqChCfgs, mPreEqChBands);
+    mEngine->setPostEq(mPostEqChCfgs, mPostEqChBands);
+    mEngine->setMbc(mMbcChCfgs, mMbcChBands);
+    mEngine->setLimiters(mLimiterCfgs);
+}
+
+IEffect::Status DynamicsProcessingSwContext::process(float* in, float* out, int samples) {
+    if (!mEngine) {
+        // bypass
+        if (in != out) std::copy(in, in + samples, out);
+        return {STATUS_OK, samples, samples};
+    }
+    mEngine->process(in, out, samples / mChannelCount);
+    return {STATUS_OK, samples, samples};
+}
+
 bool DynamicsProcessingSwContext::validateStageEnablement(
         const DynamicsProcessing::StageEnablement& enablement) {
     return !enablement.inUse || (enablement.inUse && enablement.bandCount > 0);
@@ -24,6 +24,7 @@
 #include <aidl/android/hardware/audio/effect/BnEffect.h>
 #include <fmq/AidlMessageQueue.h>
 
+#include "DynamicsProcessingSwEngine.h"
 #include "effect-impl/EffectImpl.h"
 
 namespace aidl::android::hardware::audio::effect {
@@ -37,8 +38,10 @@ class DynamicsProcessingSwContext final : public EffectContext {
           mPreEqChCfgs(mChannelCount, {.channel = kInvalidChannelId}),
           mPostEqChCfgs(mChannelCount, {.channel = kInvalidChannelId}),
           mMbcChCfgs(mChannelCount, {.channel = kInvalidChannelId}),
-          mLimiterCfgs(mChannelCount, {.channel = kInvalidChannelId}) {
+          mLimiterCfgs(mChannelCount, {.channel = kInvalidChannelId}),
+          mInputGainCfgs(mChannelCount, {.channel = kInvalidChannelId}) {
         LOG(DEBUG) << __func__;
+        createEngine();
     }
 
     // utils
@@ -74,6 +77,8 @@ class DynamicsProcessingSwContext final : public EffectContext {
     std::vector<DynamicsProcessing::LimiterConfig> getLimiterCfgs() { return mLimiterCfgs; }
     std::vector<DynamicsProcessing::InputGain> getInputGainCfgs();
 
+    IEffect::Status process(float* in, float* out, int samples);
+
   private:
     static constexpr int32_t kInvalidChannelId = -1;
     size_t mChannelCount = 0;
@@ -99,6 +104,11 @@ class DynamicsProcessingSwContext final : public EffectContext {
     bool validateLimiterConfig(const DynamicsProcessing::LimiterConfig& limiter, int maxChannel);
     void resizeChannels();
     void resizeBands();
+    // Recreates the engine for the current common parameters and engine architecture.
+    void createEngine();
+
+    // Null when the configuration can't be processed, then the effect is bypassed.
+    std::unique_ptr<DynamicsProcessingSwEngine> mEngine;
 };  // DynamicsProcessingSwContext
 
 class DynamicsProcessingSw final : public EffectImpl {
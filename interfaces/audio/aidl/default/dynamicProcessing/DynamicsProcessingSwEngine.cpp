@@ -0,0 +1,549 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <Utils.h>
+
+#include "DynamicsProcessingSwEngine.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+namespace {
+
+constexpr int kEqRampDurationMs = 10;
+// Floor of the detected levels, keeps the log of silence finite.
+constexpr float kMinLevel = 1e-9f;
+constexpr float kMinGainDb = -120.f;
+
+float dbToLinear(float db) {
+    return std::pow(10.f, db / 20.f);
+}
+
+float linearToDb(float level) {
+    return 20.f * std::log10(std::max(level, kMinLevel));
+}
+
+// One pole coefficient reaching 63% of a step after timeMs, when updated every kControlFrames.
+float smoothingCoefficient(float timeMs, int sampleRate) {
+    const float periods = timeMs * sampleRate / 1000.f / DynamicsProcessingSwEngine::kControlFrames;
+    return periods <= 1.f ? 1.f : 1.f - std::exp(-1.f / periods);
+}
+
+bool isChannelEnabled(const std::vector<DynamicsProcessing::ChannelConfig>& channels,
+                      size_t channel) {
+    return channel < channels.size() && channels[channel].channel >= 0 && channels[channel].enable;
+}
+
+/**
+ * Designs the filters of the bands of one channel. Each band ends at its cutoff frequency and
+ * starts at the cutoff of the previous band: the first band is a low shelf, the last band a high
+ * shelf and the others are peaking filters centered in the band.
+ */
+std::vector<BiquadCoefficients> designEqBands(int sampleRate,
+                                              const DynamicsProcessing::EqBandConfig* bands,
+                                              size_t bandCount) {
+    std::vector<BiquadCoefficients> coefs(bandCount);
+    for (size_t i = 0; i < bandCount; i++) {
+        const auto& band = bands[i];
+        const double high = band.cutoffFrequencyHz;
+        if (band.channel < 0 || !band.enable || band.gainDb == 0 || high <= 0) continue;
+        double low = i > 0 ? bands[i - 1].cutoffFrequencyHz : 0;
+        if (i == 0) {
+            coefs[i] = BiquadCoefficients::lowShelf(sampleRate, high, band.gainDb);
+        } else if (i == bandCount - 1) {
+            coefs[i] = BiquadCoefficients::highShelf(sampleRate, low > 0 ? low : high,
+                                                     band.gainDb);
+        } else {
+            if (low <= 0 || low >= high) low = high / 2;
+            const double octaves = std::log2(high / low);
+            const double q = std::sqrt(std::exp2(octaves)) / (std::exp2(octaves) - 1.);
+            coefs[i] = BiquadCoefficients::peaking(sampleRate, std::sqrt(low * high), q,
+                                                   band.gainDb);
+        }
+    }
+    return coefs;
+}
+
+// Static curve of the compressor and of the noise gate expander, in dB.
+float compressorGainDb(float levelDb, float thresholdDb, float ratio, float kneeWidthDb,
+                       float noiseGateThresholdDb, float expanderRatio) {
+    float gainDb = 0;
+    if (ratio > 1.f) {
+        const float slope = 1.f / ratio - 1.f;
+        const float over = levelDb - thresholdDb;
+        if (kneeWidthDb > 0 && 2.f * std::abs(over) <= kneeWidthDb) {
+            const float x = over + kneeWidthDb / 2.f;
+            gainDb = slope * x * x / (2.f * kneeWidthDb);
+        } else if (over > 0) {
+            gainDb = slope * over;
+        }
+    }
+    if (expanderRatio > 1.f && levelDb < noiseGateThresholdDb) {
+        gainDb += (levelDb - noiseGateThresholdDb) * (expanderRatio - 1.f);
+    }
+    return std::max(gainDb, kMinGainDb);
+}
+
+}  // namespace
+
+DynamicsProcessingSwEngine::DynamicsProcessingSwEngine(
+        int sampleRate, size_t channelCount,
+        const DynamicsProcessing::EngineArchitecture& architecture)
+    : mSampleRate(sampleRate),
+      mChannelCount(channelCount),
+      mGroupCount((channelCount + kLanes - 1) / kLanes),
+      mEqRampFrames(::aidl::android::hardware::audio::common::frameCountFromDurationMs(
+              kEqRampDurationMs, sampleRate)),
+      mBlocks(mGroupCount * kBlockFrames * kLanes),
+      mInputGains(mGroupCount * kLanes, 1.f),
+      mPreEq(createEq(channelCount, architecture.preEqStage)),
+      mPostEq(createEq(channelCount, architecture.postEqStage)),
+      mMbcBandCount(architecture.mbcStage.inUse ? architecture.mbcStage.bandCount : 0),
+      mLimiterInUse(architecture.limiterInUse),
+      mLinkGroups(channelCount, -1),
+      mLimiterRequired(channelCount, 1.f) {
+    if (mMbcBandCount > 0) {
+        const size_t splitCount = mMbcBandCount - 1;
+        mMbcGroups.resize(mGroupCount);
+        for (auto& group : mMbcGroups) {
+            group.lowPass.resize(2 * splitCount);
+            group.highPass.resize(2 * splitCount);
+            group.allPass.resize(mMbcBandCount * splitCount);
+            group.bands.resize(mMbcBandCount);
+        }
+        mMbcBands.resize(mMbcBandCount * kBlockFrames * kLanes);
+        mMbcDry.resize(kBlockFrames * kLanes);
+    }
+    if (mLimiterInUse) {
+        mLimiterGroups.resize(mGroupCount);
+        for (auto& group : mLimiterGroups) {
+            group.delay.resize(kDelayFrames * kLanes);
+            group.peaks.resize((kMaxLookaheadBlocks + 1) * kLanes);
+        }
+    }
+}
+
+std::unique_ptr<BiquadCascade> DynamicsProcessingSwEngine::createEq(
+        size_t channelCount, const DynamicsProcessing::StageEnablement& stage) {
+    if (!stage.inUse || stage.bandCount <= 0) return nullptr;
+    return std::make_unique<BiquadCascade>(channelCount, stage.bandCount);
+}
+
+void DynamicsProcessingSwEngine::setInputGains(
+        const std::vector<DynamicsProcessing::InputGain>& gains) {
+    std::fill(mInputGains.begin(), mInputGains.end(), 1.f);
+    for (const auto& gain : gains) {
+        if (gain.channel < 0 || (size_t)gain.channel >= mChannelCount) continue;
+        mInputGains[gain.channel] = dbToLinear(gain.gainDb);
+    }
+    mInputGainActive = std::any_of(mInputGains.begin(), mInputGains.end(),
+                                   [](float gain) { return gain != 1.f; });
+}
+
+void DynamicsProcessingSwEngine::setPreEq(
+        const std::vector<DynamicsProcessing::ChannelConfig>& channels,
+        const std::vector<DynamicsProcessing::EqBandConfig>& bands) {
+    setEq(mPreEq.get(), channels, bands);
+}
+
+void DynamicsProcessingSwEngine::setPostEq(
+        const std::vector<DynamicsProcessing::ChannelConfig>& channels,
+        const std::vector<DynamicsProcessing::EqBandConfig>& bands) {
+    setEq(mPostEq.get(), channels, bands);
+}
+
+void DynamicsProcessingSwEngine::setEq(
+        BiquadCascade* eq, const std::vector<DynamicsProcessing::ChannelConfig>& channels,
+        const std::vector<DynamicsProcessing::EqBandConfig>& bands) {
+    if (!eq) return;
+    const size_t bandCount = eq->getStageCount();
+    for (size_t channel = 0; channel < mChannelCount; channel++) {
+        std::vector<BiquadCoefficients> coefs;
+        if (isChannelEnabled(channels, channel) && bands.size() >= (channel + 1) * bandCount) {
+            coefs = designEqBands(mSampleRate, &bands[channel * bandCount], bandCount);
+        }
+        eq->setChannelCoefficients(channel, coefs, mEqRampFrames);
+    }
+}
+
+void DynamicsProcessingSwEngine::setMbc(
+        const std::vector<DynamicsProcessing::ChannelConfig>& channels,
+        const std::vector<DynamicsProcessing::MbcBandConfig>& bands) {
+    if (mMbcBandCount == 0) return;
+    const size_t splitCount = mMbcBandCount - 1;
+    const double maxFrequency = mSampleRate * 0.45;
+
+    mMbcActive = false;
+    for (size_t g = 0; g < mGroupCount; g++) {
+        MbcGroup& group = mMbcGroups[g];
+        const bool wasActive = group.active;
+        group.active = false;
+        for (size_t lane = 0; lane < kLanes; lane++) {
+            const size_t channel = g * kLanes + lane;
+            const bool enabled = channel < mChannelCount && isChannelEnabled(channels, channel) &&
+                                 bands.size() >= (channel + 1) * mMbcBandCount;
+            group.mix[lane] = enabled ? 1.f : 0.f;
+            group.active |= enabled;
+            if (!enabled) {
+                for (auto& band : group.bands) band.enabled[lane] = 0.f;
+                continue;
+            }
+
+            const DynamicsProcessing::MbcBandConfig* channelBands =
+                    &bands[channel * mMbcBandCount];
+            // Crossover frequencies must be ascending, fix up unset or misordered bands.
+            double previous = 20.;
+            for (size_t split = 0; split < splitCount; split++) {
+                const double frequency =
+                        std::clamp<double>(channelBands[split].cutoffFrequencyHz, previous,
+                                           std::max(previous, maxFrequency));
+                previous = frequency;
+                const auto lowPass = BiquadCoefficients::lowPass(mSampleRate, frequency, M_SQRT1_2);
+                const auto highPass =
+                        BiquadCoefficients::highPass(mSampleRate, frequency, M_SQRT1_2);
+                for (size_t section = 0; section < 2; section++) {
+                    group.lowPass[2 * split + section].setCoefficients(lane, lowPass);
+                    group.highPass[2 * split + section].setCoefficients(lane, highPass);
+                }
+                // The sum of the two halves of a Linkwitz-Riley crossover is this allpass.
+                const auto allPass = BiquadCoefficients::allPass(mSampleRate, frequency, M_SQRT1_2);
+                for (size_t band = 0; band < split; band++) {
+                    group.allPass[band * splitCount + split].setCoefficients(lane, allPass);
+                }
+            }
+
+            for (size_t b = 0; b < mMbcBandCount; b++) {
+                const auto& config = channelBands[b];
+                Compressor& band = group.bands[b];
+                band.enabled[lane] = config.channel >= 0 && config.enable ? 1.f : 0.f;
+                band.preGain[lane] = dbToLinear(config.preGainDb);
+                band.postGain[lane] = dbToLinear(config.postGainDb);
+                band.thresholdDb[lane] = config.thresholdDb;
+                band.ratio[lane] = config.ratio;
+                // Configs with a positive knee are rejected for now, so this is a hard knee.
+                band.kneeWidthDb[lane] = std::max(0.f, config.kneeWidthDb);
+                band.noiseGateThresholdDb[lane] = config.noiseGateThresholdDb;
+                band.expanderRatio[lane] = config.expanderRatio;
+                band.attack[lane] = smoothingCoefficient(config.attackTimeMs, mSampleRate);
+                band.release[lane] = smoothingCoefficient(config.releaseTimeMs, mSampleRate);
+            }
+        }
+
+        if (group.active && !wasActive) {
+            // The filters didn't run while the group was bypassed, drop their stale history.
+            for (auto& filter : group.lowPass) filter.clear();
+            for (auto& filter : group.highPass) filter.clear();
+            for (auto& filter : group.allPass) filter.clear();
+            for (auto& band : group.bands) {
+                std::fill(std::begin(band.envelope), std::end(band.envelope), 0.f);
+                std::fill(std::begin(band.gain), std::end(band.gain), 1.f);
+            }
+        }
+        mMbcActive |= group.active;
+    }
+}
+
+void DynamicsProcessingSwEngine::setLimiters(
+        const std::vector<DynamicsProcessing::LimiterConfig>& limiters) {
+    if (!mLimiterInUse) return;
+
+    float maxAttackMs = 0;
+    mLimiterActive = false;
+    std::fill(mLinkGroups.begin(), mLinkGroups.end(), -1);
+    for (size_t channel = 0; channel < mChannelCount; channel++) {
+        LimiterGroup& group = mLimiterGroups[channel / kLanes];
+        const size_t lane = channel % kLanes;
+        const bool enabled = channel < limiters.size() && limiters[channel].channel >= 0 &&
+                             limiters[channel].enable;
+        group.enabled[lane] = enabled ? 1.f : 0.f;
+        if (!enabled) {
+            group.postGain[lane] = 1.f;
+            continue;
+        }
+        const auto& config = limiters[channel];
+        group.thresholdDb[lane] = config.thresholdDb;
+        group.ratio[lane] = config.ratio;
+        group.release[lane] = smoothingCoefficient(config.releaseTimeMs, mSampleRate);
+        group.postGain[lane] = dbToLinear(config.postGainDb);
+        // Link groups are only meaningful within the limiters being used.
+        mLinkGroups[channel] = std::max(0, config.linkGroup);
+        maxAttackMs = std::max(maxAttackMs, config.attackTimeMs);
+        mLimiterActive = true;
+    }
+
+    // At least one control period of lookahead, so that each sub-block is covered by the window
+    // of the previous one and the gain never ramps down too late.
+    size_t lookaheadFrames = 0;
+    if (mLimiterActive) {
+        const size_t attackFrames = std::ceil(maxAttackMs * mSampleRate / 1000.f);
+        const size_t attackBlocks = (attackFrames + kControlFrames - 1) / kControlFrames;
+        lookaheadFrames = std::clamp(attackBlocks, size_t(1), kMaxLookaheadBlocks) * kControlFrames;
+    }
+    if (lookaheadFrames != mLookaheadFrames) {
+        // The delay changes anyway, restart from silence rather than from a mismatched history.
+        mLookaheadFrames = lookaheadFrames;
+        mDelayPos = 0;
+        mPeakPos = 0;
+        for (auto& group : mLimiterGroups) {
+            std::fill(group.delay.begin(), group.delay.end(), 0.f);
+            std::fill(group.peaks.begin(), group.peaks.end(), 0.f);
+            std::fill(std::begin(group.gain), std::end(group.gain), 1.f);
+        }
+    }
+}
+
+void DynamicsProcessingSwEngine::process(const float* in, float* out, size_t frameCount) {
+    simd::ScopedFlushDenormals flushDenormals;
+    for (size_t offset = 0; offset < frameCount; offset += kBlockFrames) {
+        const size_t frames = std::min(kBlockFrames, frameCount - offset);
+        const size_t sampleOffset = offset * mChannelCount;
+
+        for (size_t group = 0; group < mGroupCount; group++) {
+            const size_t channel = group * kLanes;
+            const size_t lanes = std::min(kLanes, mChannelCount - channel);
+            float* block = groupBlock(group);
+            for (size_t f = 0; f < frames; f++) {
+                simd::store(block + f * kLanes,
+                            simd::loadPartial(in + sampleOffset + f * mChannelCount + channel,
+                                              lanes));
+            }
+        }
+
+        const size_t subBlockCount = splitSubBlocks(frames);
+        for (size_t group = 0; group < mGroupCount; group++) {
+            if (mInputGainActive) applyInputGain(group, frames);
+            if (mPreEq) mPreEq->processGroup(group, groupBlock(group), frames);
+            if (mMbcActive && mMbcGroups[group].active) processMbc(group, subBlockCount);
+            if (mPostEq) mPostEq->processGroup(group, groupBlock(group), frames);
+        }
+        // The limiter runs on all the groups at once, as linked channels can be in any group.
+        if (mLimiterActive) processLimiters(subBlockCount);
+
+        for (size_t group = 0; group < mGroupCount; group++) {
+            const size_t channel = group * kLanes;
+            const size_t lanes = std::min(kLanes, mChannelCount - channel);
+            const float* block = groupBlock(group);
+            for (size_t f = 0; f < frames; f++) {
+                simd::storePartial(out + sampleOffset + f * mChannelCount + channel,
+                                   simd::load(block + f * kLanes), lanes);
+            }
+        }
+    }
+}
+
+// Splits a block at the control period boundaries, which are independent of the buffer sizes.
+size_t DynamicsProcessingSwEngine::splitSubBlocks(size_t frames) {
+    size_t count = 0;
+    for (size_t offset = 0; offset < frames;) {
+        const size_t subBlockFrames = std::min(kControlFrames - mControlFill, frames - offset);
+        mControlFill += subBlockFrames;
+        const bool completesPeriod = mControlFill == kControlFrames;
+        if (completesPeriod) mControlFill = 0;
+        mSubBlocks[count++] = {offset, subBlockFrames, completesPeriod};
+        offset += subBlockFrames;
+    }
+    return count;
+}
+
+void DynamicsProcessingSwEngine::applyInputGain(size_t group, size_t frames) {
+    float* block = groupBlock(group);
+    const simd::float4 gain = simd::load(&mInputGains[group * kLanes]);
+    for (size_t f = 0; f < frames; f++) {
+        simd::store(block + f * kLanes, simd::mul(simd::load(block + f * kLanes), gain));
+    }
+}
+
+void DynamicsProcessingSwEngine::processMbc(size_t g, size_t subBlockCount) {
+    MbcGroup& group = mMbcGroups[g];
+    float* block = groupBlock(g);
+    const SubBlock& lastSubBlock = mSubBlocks[subBlockCount - 1];
+    const size_t frames = lastSubBlock.offset + lastSubBlock.frames;
+    const size_t samples = frames * kLanes;
+    const size_t splitCount = mMbcBandCount - 1;
+    auto bandData = [this](size_t band) { return &mMbcBands[band * kBlockFrames * kLanes]; };
+
+    // Split serially: each crossover takes the low band off what is above the previous one.
+    memcpy(mMbcDry.data(), block, samples * sizeof(float));
+    float* rest = bandData(splitCount);
+    memcpy(rest, block, samples * sizeof(float));
+    for (size_t split = 0; split < splitCount; split++) {
+        float* band = bandData(split);
+        memcpy(band, rest, samples * sizeof(float));
+        for (size_t section = 0; section < 2; section++) {
+            group.lowPass[2 * split + section].process(band, frames);
+            group.highPass[2 * split + section].process(rest, frames);
+        }
+    }
+    // Every band must go through the allpass response of the later splits, so that the bands
+    // sum back to an allpass rather than to a comb.
+    for (size_t band = 0; band + 2 < mMbcBandCount; band++) {
+        for (size_t split = band + 1; split < splitCount; split++) {
+            group.allPass[band * splitCount + split].process(bandData(band), frames);
+        }
+    }
+
+    for (size_t b = 0; b < mMbcBandCount; b++) {
+        for (size_t s = 0; s < subBlockCount; s++) {
+            compressBand(group.bands[b], bandData(b) + mSubBlocks[s].offset * kLanes,
+                         mSubBlocks[s].frames);
+        }
+    }
+
+    // Sum the bands, bypassed lanes keep the dry signal.
+    const simd::float4 mix = simd::load(group.mix);
+    for (size_t f = 0; f < frames; f++) {
+        const size_t i = f * kLanes;
+        simd::float4 sum = simd::load(bandData(0) + i);
+        for (size_t b = 1; b < mMbcBandCount; b++) {
+            sum = simd::add(sum, simd::load(bandData(b) + i));
+        }
+        const simd::float4 dry = simd::load(&mMbcDry[i]);
+        simd::store(block + i, simd::mulAdd(dry, mix, simd::sub(sum, dry)));
+    }
+}
+
+void DynamicsProcessingSwEngine::compressBand(Compressor& band, float* data, size_t frames) {
+    simd::float4 peak = simd::set1(0.f);
+    for (size_t f = 0; f < frames; f++) {
+        peak = simd::max(peak, simd::abs(simd::load(data + f * kLanes)));
+    }
+    float peaks[kLanes];
+    simd::store(peaks, peak);
+
+    float target[kLanes];
+    for (size_t lane = 0; lane < kLanes; lane++) {
+        if (band.enabled[lane] == 0.f) {
+            target[lane] = 1.f;
+            continue;
+        }
+        const float level = peaks[lane] * band.preGain[lane];
+        float& envelope = band.envelope[lane];
+        const float coefficient = level > envelope ? band.attack[lane] : band.release[lane];
+        envelope += coefficient * (level - envelope);
+        const float gainDb = compressorGainDb(
+                linearToDb(envelope), band.thresholdDb[lane], band.ratio[lane],
+                band.kneeWidthDb[lane], band.noiseGateThresholdDb[lane], band.expanderRatio[lane]);
+        target[lane] = dbToLinear(gainDb) * band.preGain[lane] * band.postGain[lane];
+    }
+
+    simd::float4 gain = simd::load(band.gain);
+    const simd::float4 step =
+            simd::mul(simd::sub(simd::load(target), gain), simd::set1(1.f / frames));
+    for (size_t f = 0; f < frames; f++) {
+        gain = simd::add(gain, step);
+        simd::store(data + f * kLanes, simd::mul(simd::load(data + f * kLanes), gain));
+    }
+    memcpy(band.gain, target, sizeof(target));
+}
+
+void DynamicsProcessingSwEngine::processLimiters(size_t subBlockCount) {
+    const size_t windowBlocks = mLookaheadFrames / kControlFrames + 1;
+    for (size_t s = 0; s < subBlockCount; s++) {
+        const SubBlock& subBlock = mSubBlocks[s];
+        for (size_t g = 0; g < mGroupCount; g++) {
+            LimiterGroup& group = mLimiterGroups[g];
+            float* data = groupBlock(g) + subBlock.offset * kLanes;
+            float* currentPeak = &group.peaks[mPeakPos * kLanes];
+            simd::float4 peak = simd::load(currentPeak);
+            for (size_t f = 0; f < subBlock.frames; f++) {
+                const simd::float4 x = simd::load(data + f * kLanes);
+                peak = simd::max(peak, simd::abs(x));
+                const size_t writePos = (mDelayPos + f) & (kDelayFrames - 1);
+                const size_t readPos = (writePos + kDelayFrames - mLookaheadFrames) &
+                                       (kDelayFrames - 1);
+                simd::store(data + f * kLanes, simd::load(&group.delay[readPos * kLanes]));
+                simd::store(&group.delay[writePos * kLanes], x);
+            }
+            simd::store(currentPeak, peak);
+
+            // The window covers the lookahead and the current period, the delayed sub-block is
+            // within it.
+            simd::float4 window = peak;
+            for (size_t i = 1; i < windowBlocks; i++) {
+                const size_t pos = (mPeakPos + kMaxLookaheadBlocks + 1 - i) %
+                                   (kMaxLookaheadBlocks + 1);
+                window = simd::max(window, simd::load(&group.peaks[pos * kLanes]));
+            }
+            simd::store(group.windowPeak, window);
+        }
+        mDelayPos = (mDelayPos + subBlock.frames) & (kDelayFrames - 1);
+
+        updateLimiterTargets();
+
+        for (size_t g = 0; g < mGroupCount; g++) {
+            LimiterGroup& group = mLimiterGroups[g];
+            float* data = groupBlock(g) + subBlock.offset * kLanes;
+            const simd::float4 postGain = simd::load(group.postGain);
+            simd::float4 gain = simd::load(group.gain);
+            const simd::float4 step = simd::mul(simd::sub(simd::load(group.target), gain),
+                                                simd::set1(1.f / subBlock.frames));
+            for (size_t f = 0; f < subBlock.frames; f++) {
+                gain = simd::add(gain, step);
+                simd::store(data + f * kLanes,
+                            simd::mul(simd::mul(simd::load(data + f * kLanes), gain), postGain));
+            }
+            memcpy(group.gain, group.target, sizeof(group.gain));
+        }
+
+        if (subBlock.completesPeriod) {
+            mPeakPos = (mPeakPos + 1) % (kMaxLookaheadBlocks + 1);
+            for (auto& group : mLimiterGroups) {
+                std::fill_n(&group.peaks[mPeakPos * kLanes], kLanes, 0.f);
+            }
+        }
+    }
+}
+
+void DynamicsProcessingSwEngine::updateLimiterTargets() {
+    for (size_t channel = 0; channel < mChannelCount; channel++) {
+        const LimiterGroup& group = mLimiterGroups[channel / kLanes];
+        const size_t lane = channel % kLanes;
+        float required = 1.f;
+        if (mLinkGroups[channel] >= 0 && group.ratio[lane] > 1.f) {
+            const float over = linearToDb(group.windowPeak[lane]) - group.thresholdDb[lane];
+            if (over > 0) {
+                required = dbToLinear(
+                        std::max(over * (1.f / group.ratio[lane] - 1.f), kMinGainDb));
+            }
+        }
+        mLimiterRequired[channel] = required;
+    }
+
+    for (size_t channel = 0; channel < mChannelCount; channel++) {
+        LimiterGroup& group = mLimiterGroups[channel / kLanes];
+        const size_t lane = channel % kLanes;
+        const int linkGroup = mLinkGroups[channel];
+        if (linkGroup < 0) {
+            group.target[lane] = 1.f;
+            continue;
+        }
+        float required = mLimiterRequired[channel];
+        for (size_t other = 0; other < mChannelCount; other++) {
+            if (mLinkGroups[other] == linkGroup) {
+                required = std::min(required, mLimiterRequired[other]);
+            }
+        }
+        // Attack is immediate, the lookahead makes it ramp over the previous sub-block.
+        const float gain = group.gain[lane];
+        group.target[lane] =
+                required < gain ? required : gain + group.release[lane] * (required - gain);
+    }
+}
+
+}  // namespace aidl::android::hardware::audio::effect
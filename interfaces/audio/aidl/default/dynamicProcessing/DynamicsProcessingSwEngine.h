@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <aidl/android/hardware/audio/effect/BnEffect.h>
+
+#include "effect-impl/EffectBiquad.h"
+#include "effect-impl/EffectSimd.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+/**
+ * Time domain implementation of the DynamicsProcessing stages. Each channel runs
+ *   input gain -> pre EQ -> multiband compressor -> post EQ -> limiter
+ * with the stages of the EngineArchitecture it was created with.
+ *
+ * Audio is processed in blocks of kBlockFrames frames, deinterleaved into channel groups with one
+ * channel per SIMD lane (see BiquadCascade). The compressor and limiter gains are computed every
+ * kControlFrames frames from the peak level of the sub-block and interpolated linearly in
+ * between, so the per frame work is only vector multiply-adds. The limiter delays the audio by its
+ * lookahead, derived from the largest attack time of the enabled limiters.
+ *
+ * The set* methods take the configs as stored by DynamicsProcessingSwContext: channel configs
+ * indexed by channel, band configs indexed by channel * bandCount + band. Entries with a negative
+ * channel have not been set and are treated as disabled. They preserve the processing state and
+ * may allocate; process() doesn't. The caller must serialize all the calls.
+ */
+class DynamicsProcessingSwEngine {
+  public:
+    static constexpr size_t kBlockFrames = 64;
+    static constexpr size_t kControlFrames = 16;
+    static constexpr size_t kMaxLookaheadFrames = 256;
+
+    DynamicsProcessingSwEngine(int sampleRate, size_t channelCount,
+                               const DynamicsProcessing::EngineArchitecture& architecture);
+
+    void setInputGains(const std::vector<DynamicsProcessing::InputGain>& gains);
+    void setPreEq(const std::vector<DynamicsProcessing::ChannelConfig>& channels,
+                  const std::vector<DynamicsProcessing::EqBandConfig>& bands);
+    void setPostEq(const std::vector<DynamicsProcessing::ChannelConfig>& channels,
+                   const std::vector<DynamicsProcessing::EqBandConfig>& bands);
+    void setMbc(const std::vector<DynamicsProcessing::ChannelConfig>& channels,
+                const std::vector<DynamicsProcessing::MbcBandConfig>& bands);
+    void setLimiters(const std::vector<DynamicsProcessing::LimiterConfig>& limiters);
+
+    /** Processes frameCount interleaved frames. in and out may be the same buffer. */
+    void process(const float* in, float* out, size_t frameCount);
+
+    /** Delay added by the limiter lookahead. */
+    size_t getLatencyFrames() const { return mLookaheadFrames; }
+
+  private:
+    static constexpr size_t kLanes = simd::kLanes;
+    static constexpr size_t kMaxLookaheadBlocks = kMaxLookaheadFrames / kControlFrames;
+    // Power of two larger than the lookahead plus one block, so the ring indices can be masked.
+    static constexpr size_t kDelayFrames = 512;
+    static_assert(kDelayFrames >= kMaxLookaheadFrames + kBlockFrames);
+    static constexpr size_t kMaxSubBlocks = kBlockFrames / kControlFrames + 1;
+
+    // Static curve and envelope follower of one compressor band, for the lanes of a group.
+    struct Compressor {
+        float enabled[kLanes] = {};
+        float preGain[kLanes] = {};
+        float postGain[kLanes] = {};
+        float thresholdDb[kLanes] = {};
+        float ratio[kLanes] = {};
+        float kneeWidthDb[kLanes] = {};
+        float noiseGateThresholdDb[kLanes] = {};
+        float expanderRatio[kLanes] = {};
+        // One pole smoothing coefficients of the envelope, per sub-block.
+        float attack[kLanes] = {};
+        float release[kLanes] = {};
+        float envelope[kLanes] = {};
+        float gain[kLanes] = {1.f, 1.f, 1.f, 1.f};
+    };
+
+    struct MbcGroup {
+        bool active = false;
+        // 1 for the lanes which go through the compressor, 0 for bypassed lanes.
+        float mix[kLanes] = {};
+        // Linkwitz-Riley crossovers, two cascaded Butterworth sections per split.
+        std::vector<BiquadLanes> lowPass;
+        std::vector<BiquadLanes> highPass;
+        // Allpass sections aligning the phase of each band with the later splits.
+        std::vector<BiquadLanes> allPass;
+        std::vector<Compressor> bands;
+    };
+
+    struct LimiterGroup {
+        float enabled[kLanes] = {};
+        float thresholdDb[kLanes] = {};
+        float ratio[kLanes] = {};
+        float release[kLanes] = {};
+        float postGain[kLanes] = {1.f, 1.f, 1.f, 1.f};
+        float gain[kLanes] = {1.f, 1.f, 1.f, 1.f};
+        // Target gain of the current sub-block, after linking.
+        float target[kLanes] = {1.f, 1.f, 1.f, 1.f};
+        // Lookahead delay line, kDelayFrames lane frames.
+        std::vector<float> delay;
+        // Peak level of the last sub-blocks, kMaxLookaheadBlocks + 1 lane frames.
+        std::vector<float> peaks;
+        // Peak level over the lookahead window of the current sub-block.
+        float windowPeak[kLanes] = {};
+    };
+
+    struct SubBlock {
+        size_t offset;
+        size_t frames;
+        // Whether this sub-block ends on a control period boundary.
+        bool completesPeriod;
+    };
+
+    static std::unique_ptr<BiquadCascade> createEq(
+            size_t channelCount, const DynamicsProcessing::StageEnablement& stage);
+    void setEq(BiquadCascade* eq, const std::vector<DynamicsProcessing::ChannelConfig>& channels,
+               const std::vector<DynamicsProcessing::EqBandConfig>& bands);
+    float* groupBlock(size_t group) { return mBlocks.data() + group * kBlockFrames * kLanes; }
+    size_t splitSubBlocks(size_t frames);
+    void applyInputGain(size_t group, size_t frames);
+    void processMbc(size_t group, size_t subBlockCount);
+    void compressBand(Compressor& band, float* data, size_t frames);
+    void processLimiters(size_t subBlockCount);
+    void updateLimiterTargets();
+
+    const int mSampleRate;
+    const size_t mChannelCount;
+    const size_t mGroupCount;
+    const size_t mEqRampFrames;
+
+    // Lane blocks of all the channel groups.
+    std::vector<float> mBlocks;
+    std::array<SubBlock, kMaxSubBlocks> mSubBlocks;
+    // Frames processed in the current control period.
+    size_t mControlFill = 0;
+
+    std::vector<float> mInputGains;
+    bool mInputGainActive = false;
+
+    std::unique_ptr<BiquadCascade> mPreEq;
+    std::unique_ptr<BiquadCascade> mPostEq;
+
+    const size_t mMbcBandCount;
+    bool mMbcActive = false;
+    std::vector<MbcGroup> mMbcGroups;
+    // Band split of the group being processed, mMbcBandCount lane blocks, and its dry signal.
+    std::vector<float> mMbcBands;
+    std::vector<float> mMbcDry;
+
+    const bool mLimiterInUse;
+    bool mLimiterActive = false;
+    std::vector<LimiterGroup> mLimiterGroups;
+    // Per channel link group, negative for the channels without an enabled limiter.
+    std::vector<int> mLinkGroups;
+    // Per channel gain required by the current sub-block, before linking.
+    std::vector<float> mLimiterRequired;
+    size_t mLookaheadFrames = 0;
+    size_t mDelayPos = 0;
+    size_t mPeakPos = 0;
+};
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -77,9 +77,9 @@ const std::vector<Range::EqualizerRange> EqualizerSw::kRanges = {
         MAKE_RANGE(Equalizer, preset, 0, EqualizerSw::kPresets.size() - 1),
         MAKE_RANGE(Equalizer, bandLevels,
                    std::vector<Equalizer::BandLevel>{
-                           Equalizer::BandLevel({.index = 0, .levelMb = -15})},
+                           Equalizer::BandLevel({.index = 0, .levelMb = -1500})},
                    std::vector<Equalizer::BandLevel>{Equalizer::BandLevel(
-                           {.index = EqualizerSwContext::kMaxBandNumber - 1, .levelMb = 15})}),
+                           {.index = EqualizerSwContext::kMaxBandNumber - 1, .levelMb = 1500})}),
         /* capability definition */
         MAKE_RANGE(Equalizer, bandFrequencies, EqualizerSw::kBandFrequency,
                    EqualizerSw::kBandFrequency),
@@ -207,11 +207,76 @@ RetCode EqualizerSw::releaseContext() {
 
 // Processing method running in EffectWorker thread.
 IEffect::Status EqualizerSw::effectProcessImpl(float* in, float* out, int samples) {
-    // TODO: get data buffer and process.
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
-    for (int i = 0; i < samples; i++) {
-        *out++ = *in++;
+    RETURN_VALUE_IF(!mContext, (IEffect::Status{EX_NULL_POINTER, 0, 0}), "nullContext");
+    return mContext->process(in, out, samples);
+}
+
+RetCode EqualizerSwContext::setCommon(const Parameter::Common& common) {
+    if (auto ret = EffectContext::setCommon(common); ret != RetCode::SUCCESS) {
+        return ret;
+    }
+    updateEngine(false /* ramp */);
+    return RetCode::SUCCESS;
+}
+
+RetCode EqualizerSwContext::setEqPreset(const int& presetIdx) {
+    if (presetIdx < 0 || presetIdx >= kMaxPresetNumber) {
+        return RetCode::ERROR_ILLEGAL_PARAMETER;
+    }
+    mPreset = presetIdx;
+    std::copy(kPresetBandLevels[presetIdx].begin(), kPresetBandLevels[presetIdx].end(),
+              std::begin(mBandLevels));
+    updateEngine(true /* ramp */);
+    return RetCode::SUCCESS;
+}
+
+RetCode EqualizerSwContext::setEqBandLevels(const std::vector<Equalizer::BandLevel>& bandLevels) {
+    if (bandLevels.size() > kMaxBandNumber) {
+        LOG(ERROR) << __func__ << " return because size exceed " << kMaxBandNumber;
+        return RetCode::ERROR_ILLEGAL_PARAMETER;
+    }
+    RetCode ret = RetCode::SUCCESS;
+    for (auto& it : bandLevels) {
+        if (it.index >= kMaxBandNumber || it.index < 0) {
+            LOG(ERROR) << __func__ << " index illegal, skip: " << it.index << " - " << it.levelMb;
+            ret = RetCode::ERROR_ILLEGAL_PARAMETER;
+        } else {
+            mBandLevels[it.index] = it.levelMb;
+        }
+    }
+    updateEngine(true /* ramp */);
+    return ret;
+}
+
+void EqualizerSwContext::updateEngine(bool ramp) {
+    const int sampleRate = mCommon.input.base.sampleRate;
+    if (sampleRate <= 0 || mInputChannelCount != mOutputChannelCount) {
+        LOG(WARNING) << __func__ << " unsupported config, bypassing: " << mCommon.toString();
+        mEngine.reset();
+        return;
+    }
+    if (!mEngine || mEngine->getChannelCount() != mInputChannelCount ||
+        mSampleRate != sampleRate) {
+        mEngine = std::make_unique<BiquadCascade>(mInputChannelCount, kMaxBandNumber);
+        mSampleRate = sampleRate;
+        ramp = false;
+    }
+
+    const auto coefs = designGraphicEqualizer(sampleRate, getCenterFreqs(),
+                                              {std::begin(mBandLevels), std::end(mBandLevels)});
+    mEngine->setCoefficients(
+            coefs, ramp ? ::aidl::android::hardware::audio::common::frameCountFromDurationMs(
+                                  kRampDurationMs, sampleRate)
+                        : 0);
+}
+
+IEffect::Status EqualizerSwContext::process(float* in, float* out, int samples) {
+    if (!mEngine) {
+        // bypass
+        if (in != out) std::copy(in, in + samples, out);
+        return {STATUS_OK, samples, samples};
     }
+    mEngine->process(in, out, samples / mInputChannelCount);
     return {STATUS_OK, samples, samples};
 }
 
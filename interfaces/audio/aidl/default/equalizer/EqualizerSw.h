@@ -21,6 +21,7 @@
 #include <cstdlib>
 #include <memory>
 
+#include "effect-impl/EffectBiquad.h"
 #include "effect-impl/EffectImpl.h"
 
 namespace aidl::android::hardware::audio::effect {
@@ -30,34 +31,15 @@ class EqualizerSwContext final : public EffectContext {
     EqualizerSwContext(int statusDepth, const Parameter::Common& common)
         : EffectContext(statusDepth, common) {
         LOG(DEBUG) << __func__;
+        updateEngine(false /* ramp */);
     }
 
-    RetCode setEqPreset(const int& presetIdx) {
-        if (presetIdx < 0 || presetIdx >= kMaxPresetNumber) {
-            return RetCode::ERROR_ILLEGAL_PARAMETER;
-        }
-        mPreset = presetIdx;
-        return RetCode::SUCCESS;
-    }
+    RetCode setCommon(const Parameter::Common& common) override;
+
+    RetCode setEqPreset(const int& presetIdx);
     int getEqPreset() { return mPreset; }
 
-    RetCode setEqBandLevels(const std::vector<Equalizer::BandLevel>& bandLevels) {
-        if (bandLevels.size() > kMaxBandNumber) {
-            LOG(ERROR) << __func__ << " return because size exceed " << kMaxBandNumber;
-            return RetCode::ERROR_ILLEGAL_PARAMETER;
-        }
-        RetCode ret = RetCode::SUCCESS;
-        for (auto& it : bandLevels) {
-            if (it.index >= kMaxBandNumber || it.index < 0) {
-                LOG(ERROR) << __func__ << " index illegal, skip: " << it.index << " - "
-                           << it.levelMb;
-                ret = RetCode::ERROR_ILLEGAL_PARAMETER;
-            } else {
-                mBandLevels[it.index] = it.levelMb;
-            }
-        }
-        return ret;
-    }
+    RetCode setEqBandLevels(const std::vector<Equalizer::BandLevel>& bandLevels);
 
     std::vector<Equalizer::BandLevel> getEqBandLevels() {
         std::vector<Equalizer::BandLevel> bandLevels;
@@ -70,6 +52,9 @@ class EqualizerSwContext final : public EffectContext {
     std::vector<int> getCenterFreqs() {
         return {std::begin(kPresetsFrequencies), std::end(kPresetsFrequencies)};
     }
+
+    IEffect::Status process(float* in, float* out, int samples);
+
     static const int kMaxBandNumber = 5;
     static const int kMaxPresetNumber = 10;
     static const int kCustomPreset = -1;
@@ -77,11 +62,29 @@ class EqualizerSwContext final : public EffectContext {
   private:
     static constexpr std::array<uint16_t, kMaxBandNumber> kPresetsFrequencies = {60, 230, 910, 3600,
                                                                                  14000};
+    // band levels in millibels of each preset in EqualizerSw::kPresets
+    static constexpr std::array<std::array<int32_t, kMaxBandNumber>, kMaxPresetNumber>
+            kPresetBandLevels = {{{300, 0, 0, 0, 300},
+                                  {500, 300, -200, 400, 400},
+                                  {600, 0, 200, 400, 100},
+                                  {0, 0, 0, 0, 0},
+                                  {300, 0, 0, 200, -100},
+                                  {400, 100, 900, 300, 0},
+                                  {500, 300, 0, 100, 300},
+                                  {400, 200, -200, 200, 500},
+                                  {-100, 200, 500, 100, -200},
+                                  {500, 300, -100, 300, 500}}};
+    // band level changes are ramped over this duration to avoid clicks
+    static constexpr int kRampDurationMs = 10;
+
+    void updateEngine(bool ramp);
+
     // preset band level
     int mPreset = kCustomPreset;
-    int32_t mBandLevels[kMaxBandNumber] = {3, 0, 0, 0, 3};
+    int32_t mBandLevels[kMaxBandNumber] = {300, 0, 0, 0, 300};
 
-    // Add equalizer specific context for processing here
+    int mSampleRate = 0;
+    std::unique_ptr<BiquadCascade> mEngine;
 };
 
 class EqualizerSw final : public EffectImpl {
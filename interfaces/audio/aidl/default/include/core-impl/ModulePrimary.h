@@ -41,6 +41,7 @@ class ModulePrimary final : public Module {
             std::shared_ptr<StreamOut>* result) override;
     int32_t getNominalLatencyMs(
             const ::aidl::android::media::audio::common::AudioPortConfig& portConfig) override;
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
 
   private:
     ChildInterface<ITelephony> mTelephony;
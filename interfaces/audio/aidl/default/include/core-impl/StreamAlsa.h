@@ -16,16 +16,20 @@
 
 #pragma once
 
+#include <memory>
 #include <optional>
 #include <vector>
 
 #include "Stream.h"
+#include "alsa/DeviceWriter.h"
 #include "alsa/Utils.h"
 
 namespace aidl::android::hardware::audio::core {
 
 // This class is intended to be used as a base class for implementations
 // that use TinyAlsa.
+// Output streams write to each of their devices from a thread of its own,
+// see 'alsa::DeviceWriter'.
 // This class does not define a complete stream implementation,
 // and should never be used on its own. Derived classes are expected to
 // provide necessary overrides for all interface methods omitted here.
@@ -45,7 +49,7 @@ class StreamAlsa : public StreamCommonImpl {
     void shutdown() override;
 
   protected:
-    // Called from 'start' to initialize 'mAlsaDeviceProxies', the vector must be non-empty.
+    // Called from 'start' to open the devices, the vector must be non-empty.
     virtual std::vector<alsa::DeviceProfile> getDeviceProfiles() = 0;
 
     const size_t mBufferSizeFrames;
@@ -54,8 +58,13 @@ class StreamAlsa : public StreamCommonImpl {
     const bool mIsInput;
     const std::optional<struct pcm_config> mConfig;
     const int mReadWriteRetries;
+    // Whether the devices are opened for mmap transfers, see 'alsa::isMmapTransferRequested'.
+    const bool mUseMmap;
     // All fields below are only used on the worker thread.
+    // Devices of input streams. Only a single device is supported.
     std::vector<alsa::DeviceProxy> mAlsaDeviceProxies;
+    // Writers of the devices of output streams.
+    std::vector<std::shared_ptr<alsa::DeviceWriter>> mDeviceWriters;
 };
 
 }  // namespace aidl::android::hardware::audio::core
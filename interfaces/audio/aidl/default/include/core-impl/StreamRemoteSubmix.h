@@ -16,10 +16,12 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "core-impl/Stream.h"
 #include "core-impl/StreamSwitcher.h"
+#include "r_submix/SubmixResampler.h"
 #include "r_submix/SubmixRoute.h"
 
 namespace aidl::android::hardware::audio::core {
@@ -47,13 +49,22 @@ class StreamRemoteSubmix : public StreamCommonImpl {
   private:
     long getDelayInUsForFrameCount(size_t frameCount);
     size_t getStreamPipeSizeInFrames();
+    size_t getStreamLatencyInFrames();
     ::android::status_t outWrite(void* buffer, size_t frameCount, size_t* actualFrameCount);
+    ::android::status_t outWriteToPipe(void* buffer, size_t frameCount, size_t* actualFrameCount);
     ::android::status_t inRead(void* buffer, size_t frameCount, size_t* actualFrameCount);
+    size_t inReadFromPipe(const sp<MonoPipeReader>& source, void* buffer, size_t frameCount,
+                          int64_t deadlineTimeNs);
 
     const ::aidl::android::media::audio::common::AudioDeviceAddress mDeviceAddress;
     const bool mIsInput;
     r_submix::AudioConfig mStreamConfig;
     std::shared_ptr<r_submix::SubmixRoute> mCurrentRoute = nullptr;
+    // Only set when the sample rate of the stream differs from the one of the pipe. Converts
+    // between the stream and 'mResamplerBuffer', which holds frames of the pipe.
+    std::unique_ptr<r_submix::SubmixResampler> mResampler;
+    std::vector<uint8_t> mResamplerBuffer;
+    size_t mResamplerBufferFrames = 0;
 
     // Limit for the number of error log entries to avoid spamming the logs.
     static constexpr int kMaxErrorLogs = 5;
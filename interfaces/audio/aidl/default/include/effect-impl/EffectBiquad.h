@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "EffectSimd.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+/**
+ * Coefficients of a biquad normalized to a0 == 1:
+ *   y[n] = b0 * x[n] + b1 * x[n-1] + b2 * x[n-2] - a1 * y[n-1] - a2 * y[n-2]
+ *
+ * The designs follow the Audio EQ Cookbook by Robert Bristow-Johnson. They are computed in double
+ * precision since the coefficients of low frequency filters are sensitive to rounding.
+ */
+struct BiquadCoefficients {
+    float b0 = 1.f;
+    float b1 = 0.f;
+    float b2 = 0.f;
+    float a1 = 0.f;
+    float a2 = 0.f;
+
+    bool operator==(const BiquadCoefficients& other) const = default;
+    bool isIdentity() const { return *this == BiquadCoefficients{}; }
+
+    static BiquadCoefficients peaking(double sampleRate, double frequency, double q,
+                                      double gainDb) {
+        if (gainDb == 0) return {};
+        const double a = std::pow(10., gainDb / 40.);
+        const double w0 = normalizedFrequency(sampleRate, frequency);
+        const double alpha = std::sin(w0) / (2. * q);
+        const double cosW0 = std::cos(w0);
+        return normalize(1. + alpha * a, -2. * cosW0, 1. - alpha * a, 1. + alpha / a, -2. * cosW0,
+                         1. - alpha / a);
+    }
+
+    // Shelves with a slope of 1, i.e. the steepest slope without overshoot.
+    static BiquadCoefficients lowShelf(double sampleRate, double frequency, double gainDb) {
+        if (gainDb == 0) return {};
+        const double a = std::pow(10., gainDb / 40.);
+        const double w0 = normalizedFrequency(sampleRate, frequency);
+        const double alpha2SqrtA = std::sin(w0) * std::sqrt(a) * M_SQRT1_2 * 2.;
+        const double cosW0 = std::cos(w0);
+        return normalize(a * ((a + 1.) - (a - 1.) * cosW0 + alpha2SqrtA),
+                         2. * a * ((a - 1.) - (a + 1.) * cosW0),
+                         a * ((a + 1.) - (a - 1.) * cosW0 - alpha2SqrtA),
+                         (a + 1.) + (a - 1.) * cosW0 + alpha2SqrtA,
+                         -2. * ((a - 1.) + (a + 1.) * cosW0),
+                         (a + 1.) + (a - 1.) * cosW0 - alpha2SqrtA);
+    }
+
+    static BiquadCoefficients highShelf(double sampleRate, double frequency, double gainDb) {
+        if (gainDb == 0) return {};
+        const double a = std::pow(10., gainDb / 40.);
+        const double w0 = normalizedFrequency(sampleRate, frequency);
+        const double alpha2SqrtA = std::sin(w0) * std::sqrt(a) * M_SQRT1_2 * 2.;
+        const double cosW0 = std::cos(w0);
+        return normalize(a * ((a + 1.) + (a - 1.) * cosW0 + alpha2SqrtA),
+                         -2. * a * ((a - 1.) + (a + 1.) * cosW0),
+                         a * ((a + 1.) + (a - 1.) * cosW0 - alpha2SqrtA),
+                         (a + 1.) - (a - 1.) * cosW0 + alpha2SqrtA,
+                         2. * ((a - 1.) - (a + 1.) * cosW0),
+                         (a + 1.) - (a - 1.) * cosW0 - alpha2SqrtA);
+    }
+
+    // Two sections of lowPass() or highPass() with q = M_SQRT1_2 make a Linkwitz-Riley crossover.
+    static BiquadCoefficients lowPass(double sampleRate, double frequency, double q) {
+        const double w0 = normalizedFrequency(sampleRate, frequency);
+        const double alpha = std::sin(w0) / (2. * q);
+        const double cosW0 = std::cos(w0);
+        return normalize((1. - cosW0) / 2., 1. - cosW0, (1. - cosW0) / 2., 1. + alpha,
+                         -2. * cosW0, 1. - alpha);
+    }
+
+    static BiquadCoefficients highPass(double sampleRate, double frequency, double q) {
+        const double w0 = normalizedFrequency(sampleRate, frequency);
+        const double alpha = std::sin(w0) / (2. * q);
+        const double cosW0 = std::cos(w0);
+        return normalize((1. + cosW0) / 2., -(1. + cosW0), (1. + cosW0) / 2., 1. + alpha,
+                         -2. * cosW0, 1. - alpha);
+    }
+
+    static BiquadCoefficients allPass(double sampleRate, double frequency, double q) {
+        const double w0 = normalizedFrequency(sampleRate, frequency);
+        const double alpha = std::sin(w0) / (2. * q);
+        const double cosW0 = std::cos(w0);
+        return normalize(1. - alpha, -2. * cosW0, 1. + alpha, 1. + alpha, -2. * cosW0,
+                         1. - alpha);
+    }
+
+  private:
+    // Keeps the frequency below Nyquist, so a band designed for 48kHz stays valid at 16kHz.
+    static double normalizedFrequency(double sampleRate, double frequency) {
+        return 2. * M_PI * std::min(frequency, sampleRate * 0.45) / sampleRate;
+    }
+
+    static BiquadCoefficients normalize(double b0, double b1, double b2, double a0, double a1,
+                                        double a2) {
+        return {.b0 = static_cast<float>(b0 / a0),
+                .b1 = static_cast<float>(b1 / a0),
+                .b2 = static_cast<float>(b2 / a0),
+                .a1 = static_cast<float>(a1 / a0),
+                .a2 = static_cast<float>(a2 / a0)};
+    }
+};
+
+/**
+ * Designs the filters of a graphic equalizer: a low shelf for the first band, a high shelf for the
+ * last one and peaking filters in between, each spanning the distance to its neighbor bands.
+ *
+ * \param sampleRate sample rate in Hz
+ * \param centerFreqsHz ascending center frequencies of the bands
+ * \param levelsMb gain of each band in millibels
+ */
+inline std::vector<BiquadCoefficients> designGraphicEqualizer(
+        int sampleRate, const std::vector<int>& centerFreqsHz,
+        const std::vector<int32_t>& levelsMb) {
+    const size_t bandCount = std::min(centerFreqsHz.size(), levelsMb.size());
+    std::vector<BiquadCoefficients> coefs(bandCount);
+    for (size_t band = 0; band < bandCount; band++) {
+        const double gainDb = levelsMb[band] / 100.;
+        if (band == 0) {
+            coefs[band] = BiquadCoefficients::lowShelf(sampleRate, centerFreqsHz[band], gainDb);
+        } else if (band == bandCount - 1) {
+            coefs[band] = BiquadCoefficients::highShelf(sampleRate, centerFreqsHz[band], gainDb);
+        } else {
+            // bandwidth in octaves, so neighbor bands cross at about half of their gain
+            const double octaves =
+                    std::log2(double(centerFreqsHz[band + 1]) / centerFreqsHz[band - 1]) / 2.;
+            const double q = std::sqrt(std::exp2(octaves)) / (std::exp2(octaves) - 1.);
+            coefs[band] = BiquadCoefficients::peaking(sampleRate, centerFreqsHz[band], q, gainDb);
+        }
+    }
+    return coefs;
+}
+
+/**
+ * One biquad per vector lane, i.e. per channel of a channel group, each with its own coefficients.
+ *
+ * Processes "lane blocks": blocks of frames stored one vector (simd::kLanes floats) per frame.
+ * Uses the transposed direct form II, which behaves best with floats.
+ */
+struct BiquadLanes {
+    float b0[simd::kLanes];
+    float b1[simd::kLanes];
+    float b2[simd::kLanes];
+    float a1[simd::kLanes];
+    float a2[simd::kLanes];
+    float s1[simd::kLanes] = {};
+    float s2[simd::kLanes] = {};
+
+    BiquadLanes() { setCoefficients(BiquadCoefficients{}); }
+
+    void setCoefficients(size_t lane, const BiquadCoefficients& coefs) {
+        b0[lane] = coefs.b0;
+        b1[lane] = coefs.b1;
+        b2[lane] = coefs.b2;
+        a1[lane] = coefs.a1;
+        a2[lane] = coefs.a2;
+    }
+
+    void setCoefficients(const BiquadCoefficients& coefs) {
+        for (size_t lane = 0; lane < simd::kLanes; lane++) setCoefficients(lane, coefs);
+    }
+
+    BiquadCoefficients getCoefficients(size_t lane) const {
+        return {.b0 = b0[lane], .b1 = b1[lane], .b2 = b2[lane], .a1 = a1[lane], .a2 = a2[lane]};
+    }
+
+    bool isIdentity() const {
+        for (size_t lane = 0; lane < simd::kLanes; lane++) {
+            if (!getCoefficients(lane).isIdentity()) return false;
+        }
+        return true;
+    }
+
+    void clear() {
+        std::fill(std::begin(s1), std::end(s1), 0.f);
+        std::fill(std::begin(s2), std::end(s2), 0.f);
+    }
+
+    /** Filters a lane block of frames in place. */
+    void process(float* block, size_t frames) {
+        const simd::float4 vb0 = simd::load(b0);
+        const simd::float4 vb1 = simd::load(b1);
+        const simd::float4 vb2 = simd::load(b2);
+        const simd::float4 va1 = simd::load(a1);
+        const simd::float4 va2 = simd::load(a2);
+        simd::float4 vs1 = simd::load(s1);
+        simd::float4 vs2 = simd::load(s2);
+        for (size_t f = 0; f < frames; f++) {
+            tick(block + f * simd::kLanes, vs1, vs2, vb0, vb1, vb2, va1, va2);
+        }
+        simd::store(s1, vs1);
+        simd::store(s2, vs2);
+    }
+
+    static inline void tick(float* sample, simd::float4& s1, simd::float4& s2, simd::float4 b0,
+                            simd::float4 b1, simd::float4 b2, simd::float4 a1, simd::float4 a2) {
+        const simd::float4 x = simd::load(sample);
+        const simd::float4 y = simd::mulAdd(s1, b0, x);
+        s1 = simd::mulSub(simd::mulAdd(s2, b1, x), a1, y);
+        s2 = simd::mulSub(simd::mul(b2, x), a2, y);
+        simd::store(sample, y);
+    }
+};
+
+/**
+ * A cascade of biquads applied to every channel of interleaved float audio, with per channel
+ * coefficients.
+ *
+ * Channels are processed in groups of simd::kLanes, one channel per vector lane, and each stage
+ * runs over a block of frames before the next stage, so its state and coefficients stay in
+ * registers.
+ *
+ * Coefficient changes can be ramped linearly over a number of frames to avoid clicks. A linear
+ * ramp between two stable biquads is itself stable, since the stability region in (a1, a2) is
+ * convex. Stages with identity coefficients on all the lanes of a group are skipped, so flat
+ * bands cost nothing.
+ *
+ * Not thread safe, the caller must serialize configuration changes and processing.
+ */
+class BiquadCascade {
+  public:
+    BiquadCascade(size_t channelCount, size_t stageCount)
+        : mChannelCount(channelCount),
+          mGroupCount((channelCount + simd::kLanes - 1) / simd::kLanes),
+          mStageCount(stageCount),
+          mStages(mGroupCount * stageCount),
+          mBlock(kBlockFrames * simd::kLanes) {}
+
+    size_t getChannelCount() const { return mChannelCount; }
+    size_t getStageCount() const { return mStageCount; }
+    size_t getGroupCount() const { return mGroupCount; }
+
+    /**
+     * Sets the coefficients of the stages of all channels, ramping from the current ones over
+     * rampFrames frames. Missing trailing stages are set to identity.
+     */
+    void setCoefficients(const std::vector<BiquadCoefficients>& coefs, size_t rampFrames = 0) {
+        for (size_t channel = 0; channel < mChannelCount; channel++) {
+            setLaneTargets(channel, coefs, rampFrames);
+        }
+        for (size_t group = 0; group < mGroupCount; group++) startRamps(group, rampFrames);
+    }
+
+    /** Same as setCoefficients(), for a single channel. */
+    void setChannelCoefficients(size_t channel, const std::vector<BiquadCoefficients>& coefs,
+                                size_t rampFrames = 0) {
+        setLaneTargets(channel, coefs, rampFrames);
+        startRamps(channel / simd::kLanes, rampFrames);
+    }
+
+    /** Resets the filter history, e.g. on a discontinuity of the input stream. */
+    void clear() {
+        for (auto& stage : mStages) stage.filter.clear();
+    }
+
+    /** Processes frameCount interleaved frames. in and out may be the same buffer. */
+    void process(const float* in, float* out, size_t frameCount) {
+        simd::ScopedFlushDenormals flushDenormals;
+        for (size_t offset = 0; offset < frameCount; offset += kBlockFrames) {
+            const size_t frames = std::min(kBlockFrames, frameCount - offset);
+            const size_t sampleOffset = offset * mChannelCount;
+            for (size_t group = 0; group < mGroupCount; group++) {
+                const size_t channel = group * simd::kLanes;
+                const size_t lanes = std::min(simd::kLanes, mChannelCount - channel);
+                for (size_t f = 0; f < frames; f++) {
+                    simd::store(&mBlock[f * simd::kLanes],
+                                simd::loadPartial(in + sampleOffset + f * mChannelCount + channel,
+                                                  lanes));
+                }
+                processGroup(group, mBlock.data(), frames);
+                for (size_t f = 0; f < frames; f++) {
+                    simd::storePartial(out + sampleOffset + f * mChannelCount + channel,
+                                       simd::load(&mBlock[f * simd::kLanes]), lanes);
+                }
+            }
+        }
+    }
+
+    /**
+     * Processes a lane block of frames of one channel group in place, for callers which keep
+     * audio deinterleaved across several processing stages.
+     */
+    void processGroup(size_t group, float* block, size_t frames) {
+        for (size_t s = 0; s < mStageCount; s++) {
+            Stage& stage = mStages[group * mStageCount + s];
+            if (stage.rampRemaining == 0) {
+                if (!stage.skipped) stage.filter.process(block, frames);
+            } else {
+                processRamp(stage, block, frames);
+            }
+        }
+    }
+
+  private:
+    static constexpr size_t kBlockFrames = 64;
+
+    struct Stage {
+        BiquadLanes filter;
+        // Only the coefficients of these are used.
+        BiquadLanes target;
+        BiquadLanes step;
+        size_t rampRemaining = 0;
+        // Whether the filter is an identity, cached as it is checked for every block.
+        bool skipped = true;
+    };
+
+    void setLaneTargets(size_t channel, const std::vector<BiquadCoefficients>& coefs,
+                        size_t rampFrames) {
+        const size_t group = channel / simd::kLanes;
+        const size_t lane = channel % simd::kLanes;
+        for (size_t s = 0; s < mStageCount; s++) {
+            Stage& stage = mStages[group * mStageCount + s];
+            const BiquadCoefficients target = s < coefs.size() ? coefs[s] : BiquadCoefficients{};
+            if (stage.skipped && !target.isIdentity()) {
+                // The stage didn't run, don't let a stale state leak into the output.
+                stage.filter.clear();
+            }
+            stage.target.setCoefficients(lane, target);
+            if (rampFrames == 0) stage.filter.setCoefficients(lane, target);
+        }
+    }
+
+    void startRamps(size_t group, size_t rampFrames) {
+        for (size_t s = 0; s < mStageCount; s++) {
+            Stage& stage = mStages[group * mStageCount + s];
+            stage.rampRemaining = 0;
+            if (rampFrames > 0) {
+                const float scale = 1.f / rampFrames;
+                for (size_t lane = 0; lane < simd::kLanes; lane++) {
+                    const BiquadCoefficients from = stage.filter.getCoefficients(lane);
+                    const BiquadCoefficients to = stage.target.getCoefficients(lane);
+                    stage.step.setCoefficients(lane, {.b0 = (to.b0 - from.b0) * scale,
+                                                      .b1 = (to.b1 - from.b1) * scale,
+                                                      .b2 = (to.b2 - from.b2) * scale,
+                                                      .a1 = (to.a1 - from.a1) * scale,
+                                                      .a2 = (to.a2 - from.a2) * scale});
+                    if (!(from == to)) stage.rampRemaining = rampFrames;
+                }
+            }
+            if (stage.rampRemaining == 0) {
+                stage.filter = copyCoefficients(stage.target, stage.filter);
+                stage.skipped = stage.filter.isIdentity();
+            } else {
+                stage.skipped = false;
+            }
+        }
+    }
+
+    // Returns state with the coefficients of coefs.
+    static BiquadLanes copyCoefficients(const BiquadLanes& coefs, BiquadLanes state) {
+        for (size_t lane = 0; lane < simd::kLanes; lane++) {
+            state.setCoefficients(lane, coefs.getCoefficients(lane));
+        }
+        return state;
+    }
+
+    static void processRamp(Stage& stage, float* block, size_t frames) {
+        BiquadLanes& filter = stage.filter;
+        simd::float4 s1 = simd::load(filter.s1);
+        simd::float4 s2 = simd::load(filter.s2);
+        simd::float4 b0 = simd::load(filter.b0);
+        simd::float4 b1 = simd::load(filter.b1);
+        simd::float4 b2 = simd::load(filter.b2);
+        simd::float4 a1 = simd::load(filter.a1);
+        simd::float4 a2 = simd::load(filter.a2);
+        const simd::float4 db0 = simd::load(stage.step.b0);
+        const simd::float4 db1 = simd::load(stage.step.b1);
+        const simd::float4 db2 = simd::load(stage.step.b2);
+        const simd::float4 da1 = simd::load(stage.step.a1);
+        const simd::float4 da2 = simd::load(stage.step.a2);
+
+        const size_t rampFrames = std::min(frames, stage.rampRemaining);
+        size_t f = 0;
+        for (; f < rampFrames; f++) {
+            b0 = simd::add(b0, db0);
+            b1 = simd::add(b1, db1);
+            b2 = simd::add(b2, db2);
+            a1 = simd::add(a1, da1);
+            a2 = simd::add(a2, da2);
+            BiquadLanes::tick(block + f * simd::kLanes, s1, s2, b0, b1, b2, a1, a2);
+        }
+        stage.rampRemaining -= rampFrames;
+        if (stage.rampRemaining == 0) {
+            // Snap to the exact target, the accumulated steps carry rounding errors.
+            b0 = simd::load(stage.target.b0);
+            b1 = simd::load(stage.target.b1);
+            b2 = simd::load(stage.target.b2);
+            a1 = simd::load(stage.target.a1);
+            a2 = simd::load(stage.target.a2);
+            for (; f < frames; f++) {
+                BiquadLanes::tick(block + f * simd::kLanes, s1, s2, b0, b1, b2, a1, a2);
+            }
+        }
+
+        simd::store(filter.b0, b0);
+        simd::store(filter.b1, b1);
+        simd::store(filter.b2, b2);
+        simd::store(filter.a1, a1);
+        simd::store(filter.a2, a2);
+        simd::store(filter.s1, s1);
+        simd::store(filter.s2, s2);
+        if (stage.rampRemaining == 0) stage.skipped = filter.isIdentity();
+    }
+
+    const size_t mChannelCount;
+    const size_t mGroupCount;
+    const size_t mStageCount;
+    // Stages of each channel group, group major.
+    std::vector<Stage> mStages;
+    // One lane block of the channel group being processed by process().
+    std::vector<float> mBlock;
+};
+
+}  // namespace aidl::android::hardware::audio::effect
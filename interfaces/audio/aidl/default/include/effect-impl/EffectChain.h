@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "effect-impl/EffectImpl.h"
+#include "effect-impl/EffectTypes.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+/**
+ * Fused processing of co-located software effects, declared with an "effectChain" element in the
+ * effect config and created by the Factory like any other effect.
+ *
+ * Each EffectImpl has its own worker thread and data MQs, so N effects applied to a stream cost
+ * N thread wakeups and 2 * N MQ copies per buffer. An EffectChain is one effect to the framework,
+ * with one worker and one set of MQs: its worker reads the input once and processes the member
+ * effects in place and in order, through the processFusedEffect() entry of their libraries.
+ *
+ * The members are opened with the config of the chain, which must have the same input and output
+ * config, and follow the commands of the chain. Common parameters are set on all members, and
+ * specific parameters on the first member accepting them.
+ */
+class EffectChain final : public EffectImpl {
+  public:
+    struct Member {
+        std::shared_ptr<IEffect> effect;
+        // Library interface which created the effect, with the fused entries.
+        const effect_dl_interface_s* interface;
+    };
+
+    EffectChain(const Descriptor& descriptor, std::vector<Member> members);
+    ~EffectChain();
+
+    ndk::ScopedAStatus open(const Parameter::Common& common,
+                            const std::optional<Parameter::Specific>& specific,
+                            OpenEffectReturn* ret) override;
+    ndk::ScopedAStatus close() override;
+
+    ndk::ScopedAStatus getDescriptor(Descriptor* desc) override;
+    ndk::ScopedAStatus setParameterCommon(const Parameter& param) REQUIRES(mImplMutex) override;
+    ndk::ScopedAStatus setParameterSpecific(const Parameter::Specific& specific)
+            REQUIRES(mImplMutex) override;
+    ndk::ScopedAStatus getParameterSpecific(const Parameter::Id& id, Parameter::Specific* specific)
+            REQUIRES(mImplMutex) override;
+
+    std::string getEffectName() override { return mDescriptor.common.name; }
+    RetCode releaseContext() REQUIRES(mImplMutex) override { return RetCode::SUCCESS; }
+    IEffect::Status effectProcessImpl(float* in, float* out, int samples)
+            REQUIRES(mImplMutex) override;
+
+    const std::vector<Member>& getMembers() const { return mMembers; }
+
+  private:
+    const Descriptor mDescriptor;
+    const std::vector<Member> mMembers;
+
+    ndk::ScopedAStatus commandImpl(CommandId command) REQUIRES(mImplMutex) override;
+    void closeMembers();
+};
+
+}  // namespace aidl::android::hardware::audio::effect
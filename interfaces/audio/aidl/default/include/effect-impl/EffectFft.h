@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "EffectSimd.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+/**
+ * FFT of real signals of a power of 2 size, at least 8.
+ *
+ * A signal of size N is transformed as the complex signal of size N / 2 made of its even and odd
+ * samples, followed by a split step. Spectra are the N / 2 + 1 bins from DC to Nyquist, with the
+ * real and imaginary parts in separate arrays so that the butterflies, and the products of
+ * spectra by the callers, run kLanes bins at a time.
+ *
+ * All the tables are computed by the constructor, forward() and inverse() don't allocate and may
+ * be called concurrently.
+ */
+class RealFft {
+  public:
+    explicit RealFft(size_t size) : mSize(size), mHalf(size / 2) {
+        const int bits = std::countr_zero(mHalf);
+        for (size_t i = 0; i < mHalf; i++) {
+            size_t reversed = 0;
+            for (int b = 0; b < bits; b++) reversed |= ((i >> b) & 1) << (bits - 1 - b);
+            if (i < reversed) mSwaps.emplace_back(i, reversed);
+        }
+        // exp(-i * pi * k / h) at offset h - 1 + k for the stage of half size h.
+        for (size_t h = 1; h < mHalf; h <<= 1) {
+            for (size_t k = 0; k < h; k++) {
+                const double angle = M_PI * k / h;
+                mStageCos.push_back(std::cos(angle));
+                mStageSin.push_back(-std::sin(angle));
+            }
+        }
+        // exp(-2 * i * pi * k / size), for the split step.
+        for (size_t k = 0; k <= mHalf / 2; k++) {
+            const double angle = 2 * M_PI * k / mSize;
+            mSplitCos.push_back(std::cos(angle));
+            mSplitSin.push_back(-std::sin(angle));
+        }
+    }
+
+    size_t getSize() const { return mSize; }
+    size_t getBinCount() const { return mHalf + 1; }
+
+    /** Computes the getBinCount() bins of the spectrum of the getSize() samples of in. */
+    void forward(const float* in, float* re, float* im) const {
+        for (size_t m = 0; m < mHalf; m++) {
+            re[m] = in[2 * m];
+            im[m] = in[2 * m + 1];
+        }
+        complexFft(re, im);
+
+        // With Z the FFT of the complex signal, E and O the spectra of the even and odd samples:
+        //   E[k] = (Z[k] + conj(Z[N/2 - k])) / 2, O[k] = -i * (Z[k] - conj(Z[N/2 - k])) / 2
+        //   X[k] = E[k] + W^k * O[k], X[N/2 - k] = conj(E[k] - W^k * O[k])
+        const float z0Re = re[0];
+        const float z0Im = im[0];
+        re[0] = z0Re + z0Im;
+        im[0] = 0;
+        re[mHalf] = z0Re - z0Im;
+        im[mHalf] = 0;
+        for (size_t k = 1; k <= mHalf / 2; k++) {
+            const size_t j = mHalf - k;
+            const float eRe = 0.5f * (re[k] + re[j]);
+            const float eIm = 0.5f * (im[k] - im[j]);
+            const float oRe = 0.5f * (im[k] + im[j]);
+            const float oIm = -0.5f * (re[k] - re[j]);
+            const float woRe = mSplitCos[k] * oRe - mSplitSin[k] * oIm;
+            const float woIm = mSplitCos[k] * oIm + mSplitSin[k] * oRe;
+            re[j] = eRe - woRe;
+            im[j] = woIm - eIm;
+            re[k] = eRe + woRe;
+            im[k] = eIm + woIm;
+        }
+    }
+
+    /**
+     * Computes the getSize() samples of the signal of the spectrum re, im to out, scaled by
+     * getSize(): inverse(forward(x)) is getSize() * x. re and im are overwritten.
+     */
+    void inverse(float* re, float* im, float* out) const {
+        // Inverse of the split step, E[k] = X[k] + conj(X[N/2 - k]) and
+        // O[k] = (X[k] - conj(X[N/2 - k])) * conj(W^k), twice their values above.
+        const float x0Re = re[0];
+        const float xnRe = re[mHalf];
+        re[0] = x0Re + xnRe;
+        im[0] = x0Re - xnRe;
+        for (size_t k = 1; k <= mHalf / 2; k++) {
+            const size_t j = mHalf - k;
+            const float eRe = re[k] + re[j];
+            const float eIm = im[k] - im[j];
+            const float dRe = re[k] - re[j];
+            const float dIm = im[k] + im[j];
+            const float oRe = dRe * mSplitCos[k] + dIm * mSplitSin[k];
+            const float oIm = dIm * mSplitCos[k] - dRe * mSplitSin[k];
+            // Z[k] = E[k] + i * O[k], Z[N/2 - k] = conj(E[k]) + i * conj(O[k]).
+            re[k] = eRe - oIm;
+            im[k] = eIm + oRe;
+            re[j] = eRe + oIm;
+            im[j] = oRe - eIm;
+        }
+        // The inverse FFT is the forward FFT with the real and imaginary parts swapped.
+        complexFft(im, re);
+        for (size_t m = 0; m < mHalf; m++) {
+            out[2 * m] = re[m];
+            out[2 * m + 1] = im[m];
+        }
+    }
+
+  private:
+    // Radix-2 decimation in time FFT of size N / 2, in place.
+    void complexFft(float* re, float* im) const {
+        for (const auto& [i, j] : mSwaps) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+        for (size_t h = 1; h < mHalf; h <<= 1) {
+            const float* wRe = &mStageCos[h - 1];
+            const float* wIm = &mStageSin[h - 1];
+            for (size_t group = 0; group < mHalf; group += 2 * h) {
+                float* aRe = re + group;
+                float* aIm = im + group;
+                float* bRe = aRe + h;
+                float* bIm = aIm + h;
+                size_t k = 0;
+                // h is a power of 2, the larger stages are whole vectors.
+                for (; h >= simd::kLanes && k < h; k += simd::kLanes) {
+                    const simd::float4 xRe = simd::load(bRe + k);
+                    const simd::float4 xIm = simd::load(bIm + k);
+                    const simd::float4 cRe = simd::load(wRe + k);
+                    const simd::float4 cIm = simd::load(wIm + k);
+                    const simd::float4 tRe = simd::mulSub(simd::mul(xRe, cRe), xIm, cIm);
+                    const simd::float4 tIm = simd::mulAdd(simd::mul(xRe, cIm), xIm, cRe);
+                    const simd::float4 uRe = simd::load(aRe + k);
+                    const simd::float4 uIm = simd::load(aIm + k);
+                    simd::store(aRe + k, simd::add(uRe, tRe));
+                    simd::store(aIm + k, simd::add(uIm, tIm));
+                    simd::store(bRe + k, simd::sub(uRe, tRe));
+                    simd::store(bIm + k, simd::sub(uIm, tIm));
+                }
+                for (; k < h; k++) {
+                    const float tRe = bRe[k] * wRe[k] - bIm[k] * wIm[k];
+                    const float tIm = bRe[k] * wIm[k] + bIm[k] * wRe[k];
+                    bRe[k] = aRe[k] - tRe;
+                    bIm[k] = aIm[k] - tIm;
+                    aRe[k] += tRe;
+                    aIm[k] += tIm;
+                }
+            }
+        }
+    }
+
+    const size_t mSize;
+    const size_t mHalf;
+    std::vector<std::pair<uint32_t, uint32_t>> mSwaps;
+    std::vector<float> mStageCos;
+    std::vector<float> mStageSin;
+    std::vector<float> mSplitCos;
+    std::vector<float> mSplitSin;
+};
+
+}  // namespace aidl::android::hardware::audio::effect
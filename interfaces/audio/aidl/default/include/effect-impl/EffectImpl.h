@@ -30,6 +30,13 @@
 
 extern "C" binder_exception_t destroyEffect(
         const std::shared_ptr<aidl::android::hardware::audio::effect::IEffect>& instanceSp);
+extern "C" binder_exception_t setEffectFused(
+        const std::shared_ptr<aidl::android::hardware::audio::effect::IEffect>& instanceSp,
+        bool fused);
+extern "C" binder_exception_t processFusedEffect(
+        const std::shared_ptr<aidl::android::hardware::audio::effect::IEffect>& instanceSp,
+        float* buffer, int samples,
+        aidl::android::hardware::audio::effect::IEffect::Status* status);
 
 namespace aidl::android::hardware::audio::effect {
 
@@ -88,6 +95,18 @@ class EffectImpl : public BnEffect, public EffectThread {
      */
     void process() override;
 
+    /**
+     * A fused effect is processed by the worker of the EffectChain it is a member of, through
+     * processFused(), instead of by its own worker and data MQs. Only allowed when not processing.
+     */
+    RetCode setFused(bool fused);
+
+    /**
+     * Process samples in place in the buffer of the EffectChain worker. The buffer is left
+     * untouched if the effect is not fused or not processing.
+     */
+    IEffect::Status processFused(float* buffer, int samples);
+
   protected:
     // current Hal version
     int mVersion = 0;
@@ -95,6 +114,7 @@ class EffectImpl : public BnEffect, public EffectThread {
     int mDataMqNotEmptyEf = aidl::android::hardware::audio::effect::kEventFlagDataMqNotEmpty;
 
     State mState GUARDED_BY(mImplMutex) = State::INIT;
+    bool mFused GUARDED_BY(mImplMutex) = false;
 
     IEffect::Status status(binder_status_t status, size_t consumed, size_t produced);
     void cleanUp();
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Minimal portable 4-lane float vector used by the software effects.
+ *
+ * Maps to NEON on arm/arm64, to SSE on x86/x86_64 and to plain arrays elsewhere, so effect code is
+ * written once against these helpers instead of against intrinsics.
+ */
+namespace aidl::android::hardware::audio::effect::simd {
+
+constexpr size_t kLanes = 4;
+
+#if defined(__ARM_NEON)
+
+using float4 = float32x4_t;
+
+inline float4 load(const float* p) {
+    return vld1q_f32(p);
+}
+inline void store(float* p, float4 v) {
+    vst1q_f32(p, v);
+}
+inline float4 set1(float v) {
+    return vdupq_n_f32(v);
+}
+inline float4 add(float4 a, float4 b) {
+    return vaddq_f32(a, b);
+}
+inline float4 sub(float4 a, float4 b) {
+    return vsubq_f32(a, b);
+}
+inline float4 mul(float4 a, float4 b) {
+    return vmulq_f32(a, b);
+}
+inline float4 min(float4 a, float4 b) {
+    return vminq_f32(a, b);
+}
+inline float4 max(float4 a, float4 b) {
+    return vmaxq_f32(a, b);
+}
+inline float4 abs(float4 a) {
+    return vabsq_f32(a);
+}
+// Returns acc + a * b.
+inline float4 mulAdd(float4 acc, float4 a, float4 b) {
+#if defined(__aarch64__)
+    return vfmaq_f32(acc, a, b);
+#else
+    return vmlaq_f32(acc, a, b);
+#endif
+}
+// Returns acc - a * b.
+inline float4 mulSub(float4 acc, float4 a, float4 b) {
+#if defined(__aarch64__)
+    return vfmsq_f32(acc, a, b);
+#else
+    return vmlsq_f32(acc, a, b);
+#endif
+}
+// Transposes the 4x4 matrix of rows a, b, c and d.
+inline void transpose(float4& a, float4& b, float4& c, float4& d) {
+    const float32x4x2_t ab = vtrnq_f32(a, b);
+    const float32x4x2_t cd = vtrnq_f32(c, d);
+    a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+// Interleaves a and b, lo = {a0, b0, a1, b1} and hi = {a2, b2, a3, b3}.
+inline void interleave(float4 a, float4 b, float4& lo, float4& hi) {
+    const float32x4x2_t ab = vzipq_f32(a, b);
+    lo = ab.val[0];
+    hi = ab.val[1];
+}
+// Moves the lanes of v down by kShift, shifting zeros in.
+template <int kShift>
+inline float4 shiftDown(float4 v) {
+    return vextq_f32(v, vdupq_n_f32(0), kShift);
+}
+
+#elif defined(__SSE2__)
+
+using float4 = __m128;
+
+inline float4 load(const float* p) {
+    return _mm_loadu_ps(p);
+}
+inline void store(float* p, float4 v) {
+    _mm_storeu_ps(p, v);
+}
+inline float4 set1(float v) {
+    return _mm_set1_ps(v);
+}
+inline float4 add(float4 a, float4 b) {
+    return _mm_add_ps(a, b);
+}
+inline float4 sub(float4 a, float4 b) {
+    return _mm_sub_ps(a, b);
+}
+inline float4 mul(float4 a, float4 b) {
+    return _mm_mul_ps(a, b);
+}
+inline float4 min(float4 a, float4 b) {
+    return _mm_min_ps(a, b);
+}
+inline float4 max(float4 a, float4 b) {
+    return _mm_max_ps(a, b);
+}
+inline float4 abs(float4 a) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), a);
+}
+inline float4 mulAdd(float4 acc, float4 a, float4 b) {
+    return _mm_add_ps(acc, _mm_mul_ps(a, b));
+}
+inline float4 mulSub(float4 acc, float4 a, float4 b) {
+    return _mm_sub_ps(acc, _mm_mul_ps(a, b));
+}
+inline void transpose(float4& a, float4& b, float4& c, float4& d) {
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+}
+inline void interleave(float4 a, float4 b, float4& lo, float4& hi) {
+    lo = _mm_unpacklo_ps(a, b);
+    hi = _mm_unpackhi_ps(a, b);
+}
+template <int kShift>
+inline float4 shiftDown(float4 v) {
+    return _mm_castsi128_ps(_mm_srli_si128(_mm_castps_si128(v), kShift * sizeof(float)));
+}
+
+#else
+
+struct float4 {
+    float v[kLanes];
+};
+
+inline float4 load(const float* p) {
+    float4 r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+inline void store(float* p, float4 v) {
+    memcpy(p, v.v, sizeof(v.v));
+}
+inline float4 set1(float v) {
+    return {{v, v, v, v}};
+}
+#define SIMD_SCALAR_OP(name, expr)                                      \
+    inline float4 name(float4 a, float4 b) {                            \
+        float4 r;                                                       \
+        for (size_t i = 0; i < kLanes; i++) r.v[i] = a.v[i] expr b.v[i]; \
+        return r;                                                       \
+    }
+SIMD_SCALAR_OP(add, +)
+SIMD_SCALAR_OP(sub, -)
+SIMD_SCALAR_OP(mul, *)
+#undef SIMD_SCALAR_OP
+inline float4 min(float4 a, float4 b) {
+    float4 r;
+    for (size_t i = 0; i < kLanes; i++) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+    return r;
+}
+inline float4 max(float4 a, float4 b) {
+    float4 r;
+    for (size_t i = 0; i < kLanes; i++) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+    return r;
+}
+inline float4 abs(float4 a) {
+    float4 r;
+    for (size_t i = 0; i < kLanes; i++) r.v[i] = a.v[i] < 0 ? -a.v[i] : a.v[i];
+    return r;
+}
+inline float4 mulAdd(float4 acc, float4 a, float4 b) {
+    return add(acc, mul(a, b));
+}
+inline float4 mulSub(float4 acc, float4 a, float4 b) {
+    return sub(acc, mul(a, b));
+}
+inline void transpose(float4& a, float4& b, float4& c, float4& d) {
+    float4* rows[kLanes] = {&a, &b, &c, &d};
+    float m[kLanes][kLanes];
+    for (size_t i = 0; i < kLanes; i++) store(m[i], *rows[i]);
+    for (size_t i = 0; i < kLanes; i++) {
+        for (size_t j = 0; j < kLanes; j++) rows[i]->v[j] = m[j][i];
+    }
+}
+inline void interleave(float4 a, float4 b, float4& lo, float4& hi) {
+    lo = {{a.v[0], b.v[0], a.v[1], b.v[1]}};
+    hi = {{a.v[2], b.v[2], a.v[3], b.v[3]}};
+}
+template <int kShift>
+inline float4 shiftDown(float4 v) {
+    float4 r = {};
+    for (size_t i = 0; i + kShift < kLanes; i++) r.v[i] = v.v[i + kShift];
+    return r;
+}
+
+#endif
+
+/**
+ * Loads the first count (1 to kLanes) floats from p, zeroing the remaining lanes.
+ *
+ * Used to gather one frame of interleaved audio with fewer channels than lanes. The fixed size
+ * copies compile to single loads, so this is cheap enough for per-frame use.
+ */
+inline float4 loadPartial(const float* p, size_t count) {
+    float tmp[kLanes] = {};
+    switch (count) {
+        case 1:
+            memcpy(tmp, p, 1 * sizeof(float));
+            break;
+        case 2:
+            memcpy(tmp, p, 2 * sizeof(float));
+            break;
+        case 3:
+            memcpy(tmp, p, 3 * sizeof(float));
+            break;
+        default:
+            return load(p);
+    }
+    return load(tmp);
+}
+
+/**
+ * Loads the kCount (1 to kLanes) floats before end to the first lanes, zeroing the remaining
+ * lanes, with a full load of the kLanes floats before end, which must all be readable.
+ *
+ * Faster than loadPartial() at the end of a buffer, which goes through memory.
+ */
+template <int kCount>
+inline float4 loadEnd(const float* end) {
+    return shiftDown<kLanes - kCount>(load(end - kLanes));
+}
+
+/** Returns the sum of the lanes of v, for the end of a dot product. */
+inline float reduceAdd(float4 v) {
+    float tmp[kLanes];
+    store(tmp, v);
+    return (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+}
+
+/** Stores the first count (1 to kLanes) lanes of v to p. */
+inline void storePartial(float* p, float4 v, size_t count) {
+    float tmp[kLanes];
+    switch (count) {
+        case 1:
+            store(tmp, v);
+            memcpy(p, tmp, 1 * sizeof(float));
+            break;
+        case 2:
+            store(tmp, v);
+            memcpy(p, tmp, 2 * sizeof(float));
+            break;
+        case 3:
+            store(tmp, v);
+            memcpy(p, tmp, 3 * sizeof(float));
+            break;
+        default:
+            store(p, v);
+            break;
+    }
+}
+
+/**
+ * Flushes denormals to zero while in scope.
+ *
+ * Recursive filters decaying towards silence otherwise end up in denormal arithmetic, which is
+ * more than an order of magnitude slower on most cores. Instantiate at the top of a processing
+ * call; the previous floating point mode is restored on exit.
+ */
+class ScopedFlushDenormals {
+  public:
+#if defined(__aarch64__)
+    ScopedFlushDenormals() {
+        asm volatile("mrs %0, fpcr" : "=r"(mSaved));
+        asm volatile("msr fpcr, %0" ::"r"(mSaved | kFpcrFz));
+    }
+    ~ScopedFlushDenormals() { asm volatile("msr fpcr, %0" ::"r"(mSaved)); }
+
+  private:
+    static constexpr uint64_t kFpcrFz = 1 << 24;
+    uint64_t mSaved;
+#elif defined(__SSE2__)
+    ScopedFlushDenormals() : mSaved(_mm_getcsr()) { _mm_setcsr(mSaved | kMxcsrFtzDaz); }
+    ~ScopedFlushDenormals() { _mm_setcsr(mSaved); }
+
+  private:
+    static constexpr unsigned int kMxcsrFtzDaz = 0x8040;
+    unsigned int mSaved;
+#else
+    // No-op elsewhere; 32-bit NEON always flushes denormals anyway.
+    ScopedFlushDenormals() {}
+    ~ScopedFlushDenormals() {}
+#endif
+};
+
+}  // namespace aidl::android::hardware::audio::effect::simd
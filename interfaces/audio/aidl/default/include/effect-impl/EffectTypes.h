@@ -30,11 +30,19 @@ typedef binder_exception_t (*EffectDestroyFunctor)(
 typedef binder_exception_t (*EffectQueryFunctor)(
         const ::aidl::android::media::audio::common::AudioUuid*,
         ::aidl::android::hardware::audio::effect::Descriptor*);
+typedef binder_exception_t (*EffectSetFusedFunctor)(
+        const std::shared_ptr<::aidl::android::hardware::audio::effect::IEffect>&, bool);
+typedef binder_exception_t (*EffectProcessFusedFunctor)(
+        const std::shared_ptr<::aidl::android::hardware::audio::effect::IEffect>&, float*, int,
+        ::aidl::android::hardware::audio::effect::IEffect::Status*);
 
 struct effect_dl_interface_s {
     EffectCreateFunctor createEffectFunc;
     EffectDestroyFunctor destroyEffectFunc;
     EffectQueryFunctor queryEffectFunc;
+    // Optional, only needed for the library effects to be members of an EffectChain.
+    EffectSetFusedFunctor setEffectFusedFunc;
+    EffectProcessFusedFunctor processFusedEffectFunc;
 };
 
 namespace aidl::android::hardware::audio::effect {
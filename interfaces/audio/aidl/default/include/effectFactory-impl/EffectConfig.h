@@ -34,6 +34,7 @@ namespace aidl::android::hardware::audio::effect {
 /**
  *  Library contains a mapping from library name to path.
  *  Effect contains a mapping from effect name to Libraries and implementation UUID.
+ *  Effect chain contains a mapping from chain name to implementation UUID and effect names.
  *  Pre/post processor contains a mapping from processing name to effect names.
  */
 class EffectConfig {
@@ -50,6 +51,13 @@ class EffectConfig {
         std::optional<struct Library> proxyLibrary;
         std::vector<struct Library> libraries;
     };
+    // <effectChain>
+    struct Chain {
+        ::aidl::android::media::audio::common::AudioUuid uuid;  // implementation UUID
+        // optional type UUID, the type of the first effect if not set
+        std::optional<::aidl::android::media::audio::common::AudioUuid> type;
+        std::vector<std::string> effects;  // names of the chained effects, in processing order
+    };
 
     int getSkippedElements() const { return mSkippedElements; }
     const std::unordered_map<std::string, std::string> getLibraryMap() const { return mLibraryMap; }
@@ -57,6 +65,10 @@ class EffectConfig {
         return mEffectsMap;
     }
 
+    const std::unordered_map<std::string, struct Chain>& getChainsMap() const {
+        return mChainsMap;
+    }
+
     static bool findUuid(const std::pair<std::string, struct EffectLibraries>& effectElem,
                          ::aidl::android::media::audio::common::AudioUuid* uuid);
 
@@ -80,6 +92,8 @@ class EffectConfig {
     std::unordered_map<std::string, std::string> mLibraryMap;
     /* Parsed Effects result */
     std::unordered_map<std::string, struct EffectLibraries> mEffectsMap;
+    /* Parsed effect chains result */
+    std::unordered_map<std::string, struct Chain> mChainsMap;
     /**
      * For parsed pre/post processing result: {key: AudioStreamType/AudioSource, value:
      * EffectLibraries}
@@ -98,6 +112,9 @@ class EffectConfig {
      */
     bool parseEffect(const tinyxml2::XMLElement& xml);
 
+    /** Parse an effect chain and push the result in mChainsMap or return false on failure. */
+    bool parseEffectChain(const tinyxml2::XMLElement& xml);
+
     bool parseProcessing(Processing::Type::Tag typeTag, const tinyxml2::XMLElement& xml);
 
     // Function to parse effect.library name and effect.uuid from xml
@@ -20,6 +20,7 @@
 #include <map>
 #include <optional>
 #include <set>
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -100,6 +101,15 @@ class Factory : public BnFactory {
     std::map<aidl::android::media::audio::common::AudioUuid /* implUUID */, DlEntry> mEffectLibMap
             GUARDED_BY(mMutex);
 
+    // Effect chain declared in the config, created by the Factory from its member effects.
+    struct ChainEntry {
+        std::string name;
+        aidl::android::media::audio::common::AudioUuid type;
+        std::vector<aidl::android::media::audio::common::AudioUuid> members;  // implUUIDs
+    };
+    std::map<aidl::android::media::audio::common::AudioUuid /* implUUID */, ChainEntry>
+            mEffectChainMap GUARDED_BY(mMutex);
+
     typedef std::pair<aidl::android::media::audio::common::AudioUuid, ndk::SpAIBinder> EffectEntry;
     std::map<std::weak_ptr<IEffect>, EffectEntry, std::owner_less<>> mEffectMap GUARDED_BY(mMutex);
 
@@ -118,6 +128,10 @@ class Factory : public BnFactory {
             REQUIRES(mMutex);
 
     void loadEffectLibs();
+    void loadEffectChains();
+    ndk::ScopedAStatus createEffectChain_l(
+            const ::aidl::android::media::audio::common::AudioUuid& impl,
+            std::shared_ptr<IEffect>* chain) REQUIRES(mMutex);
     /* Get effect_dl_interface_s from library handle */
     void getDlSyms_l(DlEntry& entry) REQUIRES(mMutex);
 };
@@ -15,6 +15,7 @@
  */
 
 #define LOG_TAG "AHAL_StreamRemoteSubmix"
+#include <Utils.h>
 #include <android-base/logging.h>
 #include <audio_utils/clock.h>
 #include <error/Result.h>
@@ -22,8 +23,10 @@
 
 #include "core-impl/StreamRemoteSubmix.h"
 
+using aidl::android::hardware::audio::common::getChannelCount;
 using aidl::android::hardware::audio::common::SinkMetadata;
 using aidl::android::hardware::audio::common::SourceMetadata;
+using aidl::android::hardware::audio::core::r_submix::SubmixResampler;
 using aidl::android::hardware::audio::core::r_submix::SubmixRoute;
 using aidl::android::media::audio::common::AudioDeviceAddress;
 using aidl::android::media::audio::common::AudioOffloadInfo;
@@ -52,6 +55,20 @@ StreamRemoteSubmix::StreamRemoteSubmix(StreamContext* context, const Metadata& m
         LOG(ERROR) << __func__ << ": invalid stream config";
         return ::android::NO_INIT;
     }
+    if (const int pipeSampleRate = mCurrentRoute->getPipeConfig().sampleRate;
+        pipeSampleRate != mStreamConfig.sampleRate) {
+        const size_t maxStreamFrames = mContext.getBufferSizeInFrames();
+        mResamplerBufferFrames =
+                (maxStreamFrames * pipeSampleRate + mStreamConfig.sampleRate - 1) /
+                        mStreamConfig.sampleRate +
+                SubmixResampler::kTaps + 1;
+        mResamplerBuffer.resize(mResamplerBufferFrames * mStreamConfig.frameSize);
+        mResampler = std::make_unique<SubmixResampler>(
+                mStreamConfig.format, getChannelCount(mStreamConfig.channelLayout),
+                mIsInput ? pipeSampleRate : mStreamConfig.sampleRate,
+                mIsInput ? mStreamConfig.sampleRate : pipeSampleRate,
+                mIsInput ? mResamplerBufferFrames : maxStreamFrames);
+    }
     sp<MonoPipe> sink = mCurrentRoute->getSink();
     if (sink == nullptr) {
         LOG(ERROR) << __func__ << ": nullptr sink when opening stream";
@@ -131,7 +148,7 @@ void StreamRemoteSubmix::shutdown() {
 
 ::android::status_t StreamRemoteSubmix::transfer(void* buffer, size_t frameCount,
                                                  size_t* actualFrameCount, int32_t* latencyMs) {
-    *latencyMs = getDelayInUsForFrameCount(getStreamPipeSizeInFrames()) / 1000;
+    *latencyMs = getDelayInUsForFrameCount(getStreamLatencyInFrames()) / 1000;
     LOG(VERBOSE) << __func__ << ": Latency " << *latencyMs << "ms";
     mCurrentRoute->exitStandby(mIsInput);
     ::android::status_t status = mIsInput ? inRead(buffer, frameCount, actualFrameCount)
@@ -163,11 +180,15 @@ void StreamRemoteSubmix::shutdown() {
     if (source == nullptr) {
         return ::android::NO_INIT;
     }
-    const ssize_t framesInPipe = source->availableToRead();
+    ssize_t framesInPipe = source->availableToRead();
     if (framesInPipe <= 0) {
         // No need to update the position frames
         return ::android::OK;
     }
+    if (mResampler != nullptr) {
+        framesInPipe = framesInPipe * mStreamConfig.sampleRate /
+                       mCurrentRoute->getPipeConfig().sampleRate;
+    }
     if (mIsInput) {
         position->frames += framesInPipe;
     } else if (position->frames >= framesInPipe) {
@@ -184,11 +205,52 @@ long StreamRemoteSubmix::getDelayInUsForFrameCount(size_t frameCount) {
 size_t StreamRemoteSubmix::getStreamPipeSizeInFrames() {
     auto pipeConfig = mCurrentRoute->getPipeConfig();
     const size_t maxFrameSize = std::max(mStreamConfig.frameSize, pipeConfig.frameSize);
-    return (pipeConfig.frameCount * pipeConfig.frameSize) / maxFrameSize;
+    return (pipeConfig.frameCount * pipeConfig.frameSize) / maxFrameSize *
+           mStreamConfig.sampleRate / pipeConfig.sampleRate;
+}
+
+// The latency target of the pipe once the reader has set it, otherwise the size of the pipe,
+// in frames of the stream.
+size_t StreamRemoteSubmix::getStreamLatencyInFrames() {
+    const size_t latencyTargetFrames = mCurrentRoute->getLatencyTargetFrames();
+    if (latencyTargetFrames == 0) {
+        return getStreamPipeSizeInFrames();
+    }
+    return latencyTargetFrames * mStreamConfig.sampleRate /
+           mCurrentRoute->getPipeConfig().sampleRate;
 }
 
 ::android::status_t StreamRemoteSubmix::outWrite(void* buffer, size_t frameCount,
                                                  size_t* actualFrameCount) {
+    if (mResampler == nullptr) {
+        return outWriteToPipe(buffer, frameCount, actualFrameCount);
+    }
+    mResampler->pushInput(buffer, frameCount);
+    const size_t pipeFrameCount =
+            mResampler->pullOutput(mResamplerBuffer.data(), mResamplerBufferFrames);
+    // The resampler has consumed the whole input, so its output must all reach the pipe: a
+    // partial write is completed, as the unwritten frames could not be rendered again.
+    size_t writtenPipeFrames = 0;
+    ::android::status_t status = ::android::OK;
+    while (writtenPipeFrames < pipeFrameCount) {
+        size_t writtenFrames = 0;
+        status = outWriteToPipe(&mResamplerBuffer[writtenPipeFrames * mStreamConfig.frameSize],
+                                pipeFrameCount - writtenPipeFrames, &writtenFrames);
+        writtenPipeFrames += writtenFrames;
+        if (status != ::android::OK || writtenFrames == 0) break;
+    }
+    if (writtenPipeFrames < pipeFrameCount) {
+        LOG(WARNING) << __func__ << ": wrote " << writtenPipeFrames << " of " << pipeFrameCount
+                     << " resampled frames";
+    }
+    *actualFrameCount = writtenPipeFrames >= pipeFrameCount
+                                ? frameCount
+                                : writtenPipeFrames * frameCount / pipeFrameCount;
+    return status;
+}
+
+::android::status_t StreamRemoteSubmix::outWriteToPipe(void* buffer, size_t frameCount,
+                                                       size_t* actualFrameCount) {
     sp<MonoPipe> sink = mCurrentRoute->getSink();
     if (sink != nullptr) {
         if (sink->isShutdown()) {
@@ -281,13 +343,40 @@ size_t StreamRemoteSubmix::getStreamPipeSizeInFrames() {
 
     LOG(VERBOSE) << __func__ << ": " << mDeviceAddress.toString() << ", " << frameCount
                  << " frames";
+    const int64_t deadlineTimeNs =
+            ::android::uptimeNanos() +
+            getDelayInUsForFrameCount(frameCount) * NANOS_PER_MICROSECOND / 2;
+    size_t actuallyRead = 0;
+    if (mResampler != nullptr) {
+        const size_t pipeFrameCount =
+                std::min(mResampler->getInputFramesNeeded(frameCount), mResamplerBufferFrames);
+        const size_t pipeFramesRead = inReadFromPipe(source, mResamplerBuffer.data(),
+                                                     pipeFrameCount, deadlineTimeNs);
+        mCurrentRoute->onPipeRead(pipeFrameCount, pipeFramesRead);
+        mResampler->pushInput(mResamplerBuffer.data(), pipeFramesRead);
+        actuallyRead = mResampler->pullOutput(buffer, frameCount);
+    } else {
+        actuallyRead = inReadFromPipe(source, buffer, frameCount, deadlineTimeNs);
+        mCurrentRoute->onPipeRead(frameCount, actuallyRead);
+    }
+    if (actuallyRead < frameCount) {
+        if (++mReadFailureCount < kMaxReadFailureAttempts) {
+            LOG(WARNING) << __func__ << ": read " << actuallyRead << " vs. requested " << frameCount
+                         << " (not all errors will be logged)";
+        }
+    } else {
+        mReadFailureCount = 0;
+    }
+    mCurrentRoute->updateReadCounterFrames(*actualFrameCount);
+    return ::android::OK;
+}
+
+size_t StreamRemoteSubmix::inReadFromPipe(const sp<MonoPipeReader>& source, void* buffer,
+                                          size_t frameCount, int64_t deadlineTimeNs) {
     // read the data from the pipe
     char* buff = (char*)buffer;
     size_t actuallyRead = 0;
     long remainingFrames = frameCount;
-    const int64_t deadlineTimeNs =
-            ::android::uptimeNanos() +
-            getDelayInUsForFrameCount(frameCount) * NANOS_PER_MICROSECOND / 2;
     while (remainingFrames > 0) {
         ssize_t framesRead = source->read(buff, remainingFrames);
         LOG(VERBOSE) << __func__ << ": frames read " << framesRead;
@@ -305,16 +394,7 @@ size_t StreamRemoteSubmix::getStreamPipeSizeInFrames() {
             usleep(kReadAttemptSleepUs);
         }
     }
-    if (actuallyRead < frameCount) {
-        if (++mReadFailureCount < kMaxReadFailureAttempts) {
-            LOG(WARNING) << __func__ << ": read " << actuallyRead << " vs. requested " << frameCount
-                         << " (not all errors will be logged)";
-        }
-    } else {
-        mReadFailureCount = 0;
-    }
-    mCurrentRoute->updateReadCounterFrames(*actualFrameCount);
-    return ::android::OK;
+    return actuallyRead;
 }
 
 StreamInRemoteSubmix::StreamInRemoteSubmix(StreamContext&& context,
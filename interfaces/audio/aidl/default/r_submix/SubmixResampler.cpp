@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <audio_utils/primitives.h>
+
+#include "SubmixResampler.h"
+#include "effect-impl/EffectSimd.h"
+
+using aidl::android::media::audio::common::AudioFormatDescription;
+using aidl::android::media::audio::common::AudioFormatType;
+using aidl::android::media::audio::common::PcmType;
+
+namespace simd = aidl::android::hardware::audio::effect::simd;
+
+namespace aidl::android::hardware::audio::core::r_submix {
+
+namespace {
+
+constexpr size_t kVectors = SubmixResampler::kTaps / simd::kLanes;
+static_assert(SubmixResampler::kTaps % simd::kLanes == 0);
+// Shape of the Kaiser window, about 60 dB of stop band attenuation.
+constexpr double kKaiserBeta = 6.0;
+// Cutoff relative to the Nyquist frequency of the lower of the two rates, leaving room for the
+// transition band of the short filter.
+constexpr double kCutoffRatio = 0.92;
+
+// Modified Bessel function of the first kind, of order 0.
+double besselI0(double x) {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 32; ++k) {
+        const double factor = x / (2 * k);
+        term *= factor * factor;
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+}  // namespace
+
+// static
+bool SubmixResampler::isFormatSupported(const AudioFormatDescription& format) {
+    return format.type == AudioFormatType::PCM &&
+           (format.pcm == PcmType::INT_16_BIT || format.pcm == PcmType::FLOAT_32_BIT);
+}
+
+SubmixResampler::SubmixResampler(const AudioFormatDescription& format, size_t channelCount,
+                                 int inputRate, int outputRate, size_t maxInputFrames)
+    : mIsFloat(format.pcm == PcmType::FLOAT_32_BIT),
+      mChannelCount(channelCount),
+      mInputRate(inputRate),
+      mOutputRate(outputRate),
+      mStep((static_cast<uint64_t>(inputRate) << kFractionBits) / outputRate),
+      mCoefficients((kPhases + 1) * kTaps),
+      mInput(channelCount, std::vector<float>(kTaps + maxInputFrames)),
+      // The history starts with silence, so that the first output frame is centered on the
+      // first input frame.
+      mInputFrames(kTaps / 2 - 1) {
+    // Cutoff in cycles per input frame.
+    const double cutoff = 0.5 * kCutoffRatio * std::min(1.0, static_cast<double>(outputRate) /
+                                                                     inputRate);
+    const double halfLength = kTaps / 2.0;
+    const double windowNorm = 1 / besselI0(kKaiserBeta);
+    double taps[kTaps];
+    for (size_t phase = 0; phase <= kPhases; ++phase) {
+        float* row = &mCoefficients[phase * kTaps];
+        double sum = 0;
+        for (size_t k = 0; k < kTaps; ++k) {
+            // Time of the tap relative to the output frame, in input frames.
+            const double t = static_cast<double>(k) - (kTaps / 2 - 1) -
+                             static_cast<double>(phase) / kPhases;
+            const double x = 2 * M_PI * cutoff * t;
+            const double sinc = t == 0 ? 1 : std::sin(x) / x;
+            const double r = t / halfLength;
+            const double window =
+                    r * r < 1 ? besselI0(kKaiserBeta * std::sqrt(1 - r * r)) * windowNorm : 0;
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+        // Unity gain at DC for every phase.
+        for (size_t k = 0; k < kTaps; ++k) row[k] = static_cast<float>(taps[k] / sum);
+    }
+}
+
+size_t SubmixResampler::getInputFramesNeeded(size_t outputFrames) const {
+    if (outputFrames == 0) return 0;
+    const uint64_t lastPosition = mPosition + (outputFrames - 1) * mStep;
+    const size_t framesNeeded = (lastPosition >> kFractionBits) + kTaps;
+    return framesNeeded > mInputFrames ? framesNeeded - mInputFrames : 0;
+}
+
+size_t SubmixResampler::getMaxOutputFrames(size_t inputFrames) const {
+    return (static_cast<uint64_t>(mInputFrames + inputFrames) * mOutputRate + mInputRate - 1) /
+                   mInputRate +
+           1;
+}
+
+void SubmixResampler::pushInput(const void* buffer, size_t frameCount) {
+    if (mInputFrames + frameCount > mInput[0].size()) {
+        for (auto& channel : mInput) channel.resize(mInputFrames + frameCount);
+    }
+    if (mIsFloat) {
+        const float* in = static_cast<const float*>(buffer);
+        for (size_t ch = 0; ch < mChannelCount; ++ch) {
+            float* dst = &mInput[ch][mInputFrames];
+            for (size_t i = 0; i < frameCount; ++i) dst[i] = in[i * mChannelCount + ch];
+        }
+    } else {
+        static constexpr float kScale = 1.0f / (1 << 15);
+        const int16_t* in = static_cast<const int16_t*>(buffer);
+        for (size_t ch = 0; ch < mChannelCount; ++ch) {
+            float* dst = &mInput[ch][mInputFrames];
+            for (size_t i = 0; i < frameCount; ++i) dst[i] = in[i * mChannelCount + ch] * kScale;
+        }
+    }
+    mInputFrames += frameCount;
+}
+
+size_t SubmixResampler::pullOutput(void* buffer, size_t frameCount) {
+    static constexpr float kPhaseFractionScale = 1.0f / (uint64_t{1} << kFractionBits);
+    float* outFloat = static_cast<float*>(buffer);
+    int16_t* outInt16 = static_cast<int16_t*>(buffer);
+    size_t produced = 0;
+    for (; produced < frameCount; ++produced, mPosition += mStep) {
+        const size_t first = mPosition >> kFractionBits;
+        if (first + kTaps > mInputFrames) break;
+        // Interpolate the coefficients between the two nearest phases.
+        const uint64_t phasePosition = (mPosition & kFractionMask) * kPhases;
+        const float* coefficients = &mCoefficients[(phasePosition >> kFractionBits) * kTaps];
+        const simd::float4 fraction =
+                simd::set1((phasePosition & kFractionMask) * kPhaseFractionScale);
+        simd::float4 weights[kVectors];
+        for (size_t v = 0; v < kVectors; ++v) {
+            const simd::float4 c0 = simd::load(coefficients + v * simd::kLanes);
+            const simd::float4 c1 = simd::load(coefficients + kTaps + v * simd::kLanes);
+            weights[v] = simd::mulAdd(c0, simd::sub(c1, c0), fraction);
+        }
+        for (size_t ch = 0; ch < mChannelCount; ++ch) {
+            const float* in = &mInput[ch][first];
+            simd::float4 acc = simd::mul(simd::load(in), weights[0]);
+            for (size_t v = 1; v < kVectors; ++v) {
+                acc = simd::mulAdd(acc, simd::load(in + v * simd::kLanes), weights[v]);
+            }
+            const float sample = simd::reduceAdd(acc);
+            if (mIsFloat) {
+                outFloat[produced * mChannelCount + ch] = sample;
+            } else {
+                outInt16[produced * mChannelCount + ch] = clamp16_from_float(sample);
+            }
+        }
+    }
+    // Drop the input which no further output frame needs.
+    const size_t consumed = std::min<size_t>(mPosition >> kFractionBits, mInputFrames);
+    if (consumed > 0) {
+        for (auto& channel : mInput) {
+            memmove(channel.data(), channel.data() + consumed,
+                    (mInputFrames - consumed) * sizeof(float));
+        }
+        mInputFrames -= consumed;
+        mPosition -= static_cast<uint64_t>(consumed) << kFractionBits;
+    }
+    return produced;
+}
+
+}  // namespace aidl::android::hardware::audio::core::r_submix
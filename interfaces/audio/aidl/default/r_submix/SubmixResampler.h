@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aidl/android/media/audio/common/AudioFormatDescription.h>
+
+namespace aidl::android::hardware::audio::core::r_submix {
+
+// Converts the sample rate of the audio of a stream to the rate of the pipe of its route, or
+// back, when both ends of a route do not use the same rate.
+//
+// A polyphase windowed sinc filter of kTaps taps, with kPhases phases and linear interpolation
+// between them. The input is kept deinterleaved as float, so that each output sample is a
+// contiguous dot product of kTaps samples. The latency is kTaps / 2 input frames.
+//
+// The resampler is a stream: 'pushInput' appends input frames, 'pullOutput' renders all the
+// output frames which the input received so far allows, and keeps the remaining input.
+class SubmixResampler {
+  public:
+    static constexpr size_t kTaps = 16;
+    static constexpr size_t kPhases = 64;
+
+    static bool isFormatSupported(
+            const ::aidl::android::media::audio::common::AudioFormatDescription& format);
+
+    // 'maxInputFrames' is the largest expected input, buffers are allocated for it upfront.
+    SubmixResampler(const ::aidl::android::media::audio::common::AudioFormatDescription& format,
+                    size_t channelCount, int inputRate, int outputRate, size_t maxInputFrames);
+
+    // Count of input frames to push before 'outputFrames' frames can be pulled.
+    size_t getInputFramesNeeded(size_t outputFrames) const;
+    // Upper bound of the count of output frames produced by 'inputFrames' more input frames.
+    size_t getMaxOutputFrames(size_t inputFrames) const;
+    void pushInput(const void* buffer, size_t frameCount);
+    // Returns the count of frames written to 'buffer', at most 'frameCount'.
+    size_t pullOutput(void* buffer, size_t frameCount);
+
+  private:
+    // Fractional positions have 32 bits of fraction.
+    static constexpr int kFractionBits = 32;
+    static constexpr uint64_t kFractionMask = (uint64_t{1} << kFractionBits) - 1;
+
+    const bool mIsFloat;
+    const size_t mChannelCount;
+    const int mInputRate;
+    const int mOutputRate;
+    // Distance between two output frames, in input frames.
+    const uint64_t mStep;
+    // (kPhases + 1) rows of kTaps coefficients, the last row is the first one shifted by a tap.
+    std::vector<float> mCoefficients;
+    // Deinterleaved input, one buffer per channel, of which mInputFrames are valid.
+    std::vector<std::vector<float>> mInput;
+    size_t mInputFrames;
+    // Position of the first tap of the next output frame in the input.
+    uint64_t mPosition = 0;
+};
+
+}  // namespace aidl::android::hardware::audio::core::r_submix
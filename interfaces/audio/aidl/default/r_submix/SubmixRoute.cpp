@@ -14,14 +14,17 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <mutex>
 
 #define LOG_TAG "AHAL_SubmixRoute"
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 #include <media/AidlConversionCppNdk.h>
 
 #include <Utils.h>
 
+#include "SubmixResampler.h"
 #include "SubmixRoute.h"
 
 using aidl::android::hardware::audio::common::getChannelCount;
@@ -109,18 +112,24 @@ bool SubmixRoute::isStreamConfigCompatible(const AudioConfig& streamConfig) {
                    << " pipe config channels = " << mPipeConfig.channelLayout.toString();
         return false;
     }
-    if (streamConfig.sampleRate != mPipeConfig.sampleRate) {
-        LOG(ERROR) << __func__
-                   << ": sample rate mismatch, stream sample rate = " << streamConfig.sampleRate
-                   << " pipe config sample rate = " << mPipeConfig.sampleRate;
-        return false;
-    }
     if (streamConfig.format != mPipeConfig.format) {
         LOG(ERROR) << __func__
                    << ": format mismatch, stream format = " << streamConfig.format.toString()
                    << " pipe config format = " << mPipeConfig.format.toString();
         return false;
     }
+    if (streamConfig.sampleRate != mPipeConfig.sampleRate) {
+        if (!SubmixResampler::isFormatSupported(streamConfig.format)) {
+            LOG(ERROR) << __func__ << ": sample rate mismatch, stream sample rate = "
+                       << streamConfig.sampleRate
+                       << " pipe config sample rate = " << mPipeConfig.sampleRate
+                       << ", can not resample format " << streamConfig.format.toString();
+            return false;
+        }
+        LOG(DEBUG) << __func__ << ": stream sample rate = " << streamConfig.sampleRate
+                   << " will be resampled to pipe config sample rate = "
+                   << mPipeConfig.sampleRate;
+    }
     return true;
 }
 
@@ -140,6 +149,39 @@ bool SubmixRoute::shouldBlockWrite() {
     return (mStreamInOpen || (mStreamInStandby && (mReadCounterFrames != 0)));
 }
 
+void SubmixRoute::onPipeRead(size_t requestedFrames, size_t readFrames) {
+    std::lock_guard guard(mLock);
+    if (mSink == nullptr || requestedFrames == 0) return;
+    const size_t maxTargetFrames = mSink->maxFrames();
+    size_t targetFrames = mLatencyTargetFrames;
+    if (targetFrames == 0) {
+        mMinLatencyTargetFrames =
+                std::min(kMinLatencyTargetReads * requestedFrames, maxTargetFrames);
+        targetFrames = mMinLatencyTargetFrames;
+    }
+    if (readFrames < requestedFrames) {
+        // Short reads while there is no writer say nothing about the target.
+        if (!mStreamOutStandby) {
+            mReadXrunCount++;
+            targetFrames = std::min(targetFrames + requestedFrames, maxTargetFrames);
+            mFramesSinceLatencyChange = 0;
+        }
+    } else if ((mFramesSinceLatencyChange += readFrames) >=
+               static_cast<size_t>(kLatencyTargetDecreaseIntervalMs * mPipeConfig.sampleRate /
+                                   MILLIS_PER_SECOND)) {
+        targetFrames = std::max(targetFrames - targetFrames / kLatencyTargetDecreaseDivisor,
+                                mMinLatencyTargetFrames);
+        mFramesSinceLatencyChange = 0;
+    }
+    if (targetFrames != mLatencyTargetFrames) {
+        LOG(VERBOSE) << __func__ << ": latency target " << mLatencyTargetFrames << " -> "
+                     << targetFrames << " frames";
+        mLatencyTargetFrames = targetFrames;
+        // The writer is throttled by MonoPipe to keep this many frames in the pipe.
+        mSink->setAvgFrames(targetFrames);
+    }
+}
+
 long SubmixRoute::updateReadCounterFrames(size_t frameCount) {
     std::lock_guard guard(mLock);
     mReadCounterFrames += frameCount;
@@ -190,8 +232,10 @@ void SubmixRoute::closeStream(bool isInput) {
     const ::android::NBAIO_Format offers[1] = {format};
     size_t numCounterOffers = 0;
 
+    static const size_t pipeSizeAtDefaultRate = ::android::base::GetUintProperty<size_t>(
+            "ro.vendor.audio.r_submix.pipe_size_frames", r_submix::kDefaultPipeSizeInFrames);
     const size_t pipeSizeInFrames =
-            r_submix::kDefaultPipeSizeInFrames *
+            pipeSizeAtDefaultRate *
             ((float)streamConfig.sampleRate / r_submix::kDefaultSampleRateHz);
     LOG(VERBOSE) << __func__ << ": creating pipe, rate : " << streamConfig.sampleRate
                  << ", pipe size : " << pipeSizeInFrames;
@@ -229,6 +273,10 @@ void SubmixRoute::closeStream(bool isInput) {
         std::lock_guard guard(mLock);
         mPipeConfig = streamConfig;
         mPipeConfig.frameCount = sink->maxFrames();
+        if (mLatencyTargetFrames != 0) {
+            mLatencyTargetFrames = std::min(mLatencyTargetFrames, sink->maxFrames());
+            sink->setAvgFrames(mLatencyTargetFrames);
+        }
         mSink = std::move(sink);
         mSource = std::move(source);
     }
@@ -290,7 +338,15 @@ std::string SubmixRoute::dump() NO_THREAD_SAFETY_ANALYSIS {
                                  .append(mStreamOutOpen ? "open" : "closed")
                                  .append(mStreamOutStandby ? ", standby" : ", active")
                                  .append(", framesWritten: ")
-                                 .append(mSink ? std::to_string(mSink->framesWritten()) : "<null>");
+                                 .append(mSink ? std::to_string(mSink->framesWritten()) : "<null>")
+                                 .append("; Pipe ")
+                                 .append(std::to_string(mPipeConfig.sampleRate))
+                                 .append(" Hz, size: ")
+                                 .append(std::to_string(mPipeConfig.frameCount))
+                                 .append(", latency target: ")
+                                 .append(std::to_string(mLatencyTargetFrames))
+                                 .append(", read xruns: ")
+                                 .append(std::to_string(mReadXrunCount));
     if (isLocked) mLock.unlock();
     return result;
 }
@@ -44,9 +44,17 @@ static constexpr int kDefaultSampleRateHz = 48000;
 // read from the sink. The maximum latency of the device is the size of the MonoPipe's buffer
 // the minimum latency is the MonoPipe buffer size divided by this value.
 static constexpr int kDefaultPipePeriodCount = 4;
-// Size at the default sample rate
+// Size at the default sample rate, can be overridden with the property
+// 'ro.vendor.audio.r_submix.pipe_size_frames'.
 // NOTE: This value will be rounded up to the nearest power of 2 by MonoPipe.
 static constexpr int kDefaultPipeSizeInFrames = 1024 * kDefaultPipePeriodCount;
+// The latency target of the pipe, the count of frames which the writer keeps in it, is
+// adjusted to the reader: it starts at this many reads, grows by one read on each read xrun,
+// and shrinks by 1/kLatencyTargetDecreaseDivisor after kLatencyTargetDecreaseIntervalMs
+// without xruns, never below the initial value.
+static constexpr int kMinLatencyTargetReads = 2;
+static constexpr int kLatencyTargetDecreaseIntervalMs = 2000;
+static constexpr int kLatencyTargetDecreaseDivisor = 8;
 
 // Configuration of the audio stream.
 struct AudioConfig {
@@ -103,6 +111,14 @@ class SubmixRoute {
         std::lock_guard guard(mLock);
         return mPipeConfig;
     }
+    size_t getLatencyTargetFrames() {
+        std::lock_guard guard(mLock);
+        return mLatencyTargetFrames;
+    }
+    uint64_t getReadXrunCount() {
+        std::lock_guard guard(mLock);
+        return mReadXrunCount;
+    }
 
     bool isStreamConfigValid(bool isInput, const AudioConfig& streamConfig);
     void closeStream(bool isInput);
@@ -110,6 +126,9 @@ class SubmixRoute {
     void exitStandby(bool isInput);
     bool hasAtleastOneStreamOpen();
     int notifyReadError();
+    // Called by the reader after each read from the pipe, in frames of the pipe. Adjusts the
+    // latency target of the pipe.
+    void onPipeRead(size_t requestedFrames, size_t readFrames);
     void openStream(bool isInput);
     AudioConfig releasePipe();
     ::android::status_t resetPipe();
@@ -148,6 +167,11 @@ class SubmixRoute {
     bool mStreamOutStandby GUARDED_BY(mLock) = true;
     // how many frames have been requested to be read since standby
     long mReadCounterFrames GUARDED_BY(mLock) = 0;
+    // 0 until the first read.
+    size_t mLatencyTargetFrames GUARDED_BY(mLock) = 0;
+    size_t mMinLatencyTargetFrames GUARDED_BY(mLock) = 0;
+    size_t mFramesSinceLatencyChange GUARDED_BY(mLock) = 0;
+    uint64_t mReadXrunCount GUARDED_BY(mLock) = 0;
 
     // Pipe variables: they handle the ring buffer that "pipes" audio:
     //  - from the submix virtual audio output == what needs to be played
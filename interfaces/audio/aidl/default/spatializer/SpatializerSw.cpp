@@ -21,9 +21,9 @@
 #include <android-base/logging.h>
 #include <system/audio_effects/effect_uuid.h>
 
+#include <algorithm>
 #include <optional>
 
-using aidl::android::hardware::audio::common::getChannelCount;
 using aidl::android::hardware::audio::effect::Descriptor;
 using aidl::android::hardware::audio::effect::getEffectImplUuidSpatializerSw;
 using aidl::android::hardware::audio::effect::getEffectTypeUuidSpatializer;
@@ -64,12 +64,16 @@ namespace aidl::android::hardware::audio::effect {
 
 const std::string SpatializerSw::kEffectName = "SpatializerSw";
 
-const AudioChannelLayout kSupportedChannelMask =
+const std::vector<AudioChannelLayout> kSupportedChannelLayouts = {
         AudioChannelLayout::make<AudioChannelLayout::layoutMask>(
-                AudioChannelLayout::LAYOUT_5POINT1);
+                AudioChannelLayout::LAYOUT_5POINT1),
+        AudioChannelLayout::make<AudioChannelLayout::layoutMask>(
+                AudioChannelLayout::LAYOUT_7POINT1),
+        AudioChannelLayout::make<AudioChannelLayout::layoutMask>(
+                AudioChannelLayout::LAYOUT_7POINT1POINT4)};
 const std::vector<Range::SpatializerRange> SpatializerSw::kRanges = {
-        MAKE_RANGE(Spatializer, supportedChannelLayout, {kSupportedChannelMask},
-                   {kSupportedChannelMask}),
+        MAKE_RANGE(Spatializer, supportedChannelLayout, kSupportedChannelLayouts,
+                   kSupportedChannelLayouts),
         MAKE_RANGE(Spatializer, spatializationLevel, Spatialization::Level::NONE,
                    Spatialization::Level::BED_PLUS_OBJECTS),
         MAKE_RANGE(Spatializer, spatializationMode, Spatialization::Mode::BINAURAL,
@@ -138,7 +142,8 @@ ndk::ScopedAStatus SpatializerSw::getParameterSpecific(const Parameter::Id& id,
 }
 
 std::shared_ptr<EffectContext> SpatializerSw::createContext(const Parameter::Common& common) {
-    if (common.input.base.channelMask != kSupportedChannelMask) {
+    if (std::find(kSupportedChannelLayouts.begin(), kSupportedChannelLayouts.end(),
+                  common.input.base.channelMask) == kSupportedChannelLayouts.end()) {
         LOG(ERROR) << __func__
                    << " channelMask not supported: " << common.input.base.channelMask.toString();
         return nullptr;
@@ -172,6 +177,7 @@ IEffect::Status SpatializerSw::effectProcessImpl(float* in, float* out, int samp
 SpatializerSwContext::SpatializerSwContext(int statusDepth, const Parameter::Common& common)
     : EffectContext(statusDepth, common) {
     LOG(DEBUG) << __func__;
+    createEngine();
 }
 
 SpatializerSwContext::~SpatializerSwContext() {
@@ -184,9 +190,7 @@ std::optional<Spatializer> SpatializerSwContext::getParam(TAG tag) {
         return mParamsMap.at(tag);
     }
     if (tag == Spatializer::supportedChannelLayout) {
-        return Spatializer::make<Spatializer::supportedChannelLayout>(
-                {AudioChannelLayout::make<AudioChannelLayout::layoutMask>(
-                        AudioChannelLayout::LAYOUT_5POINT1)});
+        return Spatializer::make<Spatializer::supportedChannelLayout>(kSupportedChannelLayouts);
     }
     return std::nullopt;
 }
@@ -200,26 +204,31 @@ ndk::ScopedAStatus SpatializerSwContext::setParam(TAG tag, Spatializer spatializ
     return ndk::ScopedAStatus::ok();
 }
 
-IEffect::Status SpatializerSwContext::process(float* in, float* out, int samples) {
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
-    IEffect::Status status = {EX_ILLEGAL_ARGUMENT, 0, 0};
-
-    const auto inputChannelCount = getChannelCount(mCommon.input.base.channelMask);
-    const auto outputChannelCount = getChannelCount(mCommon.output.base.channelMask);
-    if (outputChannelCount < 2 || inputChannelCount < outputChannelCount) {
-        LOG(ERROR) << __func__ << " invalid channel count, in: " << inputChannelCount
-                   << " out: " << outputChannelCount;
-        return status;
+RetCode SpatializerSwContext::setCommon(const Parameter::Common& common) {
+    if (auto ret = EffectContext::setCommon(common); ret != RetCode::SUCCESS) {
+        return ret;
     }
+    createEngine();
+    return RetCode::SUCCESS;
+}
 
-    int iFrames = samples / inputChannelCount;
-    for (int i = 0; i < iFrames; i++) {
-        std::memcpy(out, in, outputChannelCount);
-        in += inputChannelCount;
-        out += outputChannelCount;
+void SpatializerSwContext::createEngine() {
+    if (mOutputChannelCount < 2 || mInputChannelCount < mOutputChannelCount) {
+        LOG(ERROR) << __func__ << " invalid channel count, in: " << mInputChannelCount
+                   << " out: " << mOutputChannelCount;
+        mEngine.reset();
+        return;
     }
-    return {STATUS_OK, static_cast<int32_t>(iFrames * inputChannelCount),
-            static_cast<int32_t>(iFrames * outputChannelCount)};
+    mEngine = std::make_unique<SpatializerSwEngine>(
+            mCommon.input.base.sampleRate, mCommon.input.base.channelMask, mOutputChannelCount);
+}
+
+IEffect::Status SpatializerSwContext::process(float* in, float* out, int samples) {
+    RETURN_VALUE_IF(!mEngine, (IEffect::Status{EX_ILLEGAL_ARGUMENT, 0, 0}), "unsupportedConfig");
+    const size_t frames = samples / mInputChannelCount;
+    mEngine->process(in, out, frames);
+    return {STATUS_OK, static_cast<int32_t>(frames * mInputChannelCount),
+            static_cast<int32_t>(frames * mOutputChannelCount)};
 }
 
 }  // namespace aidl::android::hardware::audio::effect
@@ -21,9 +21,12 @@
 
 #include <fmq/AidlMessageQueue.h>
 
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
+#include "SpatializerSwEngine.h"
+
 namespace aidl::android::hardware::audio::effect {
 
 class SpatializerSwContext final : public EffectContext {
@@ -31,6 +34,8 @@ class SpatializerSwContext final : public EffectContext {
     SpatializerSwContext(int statusDepth, const Parameter::Common& common);
     ~SpatializerSwContext();
 
+    RetCode setCommon(const Parameter::Common& common) override;
+
     template <typename TAG>
     std::optional<Spatializer> getParam(TAG tag);
     template <typename TAG>
@@ -39,7 +44,10 @@ class SpatializerSwContext final : public EffectContext {
     IEffect::Status process(float* in, float* out, int samples);
 
   private:
+    void createEngine();
+
     std::unordered_map<Spatializer::Tag, Spatializer> mParamsMap;
+    std::unique_ptr<SpatializerSwEngine> mEngine;
 };
 
 class SpatializerSw final : public EffectImpl {
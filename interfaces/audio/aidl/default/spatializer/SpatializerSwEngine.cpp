@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+
+#include <Utils.h>
+
+#include "SpatializerSwEngine.h"
+#include "effect-impl/EffectSimd.h"
+
+using aidl::android::hardware::audio::common::getChannelCount;
+using aidl::android::media::audio::common::AudioChannelLayout;
+
+namespace aidl::android::hardware::audio::effect {
+
+namespace {
+
+constexpr float kMinus3Db = 0.70710678f;
+
+// Azimuths are positive to the left, elevations positive upwards, in degrees.
+struct SpeakerPosition {
+    int32_t channel;
+    float azimuth;
+    float elevation;
+    float gain;
+};
+
+// Positions of ITU-R BS.2051, the channels other than the front left and right are mixed at -3dB
+// as in the downmix.
+constexpr SpeakerPosition kSpeakerPositions[] = {
+        {AudioChannelLayout::CHANNEL_FRONT_LEFT, 30, 0, 1.f},
+        {AudioChannelLayout::CHANNEL_FRONT_RIGHT, -30, 0, 1.f},
+        {AudioChannelLayout::CHANNEL_FRONT_CENTER, 0, 0, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_BACK_LEFT, 135, 0, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_BACK_RIGHT, -135, 0, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_FRONT_LEFT_OF_CENTER, 15, 0, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_FRONT_RIGHT_OF_CENTER, -15, 0, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_BACK_CENTER, 180, 0, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_SIDE_LEFT, 90, 0, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_SIDE_RIGHT, -90, 0, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_TOP_CENTER, 0, 90, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_TOP_FRONT_LEFT, 45, 30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_TOP_FRONT_CENTER, 0, 30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_TOP_FRONT_RIGHT, -45, 30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_TOP_BACK_LEFT, 135, 30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_TOP_BACK_CENTER, 180, 30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_TOP_BACK_RIGHT, -135, 30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_TOP_SIDE_LEFT, 90, 30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_TOP_SIDE_RIGHT, -90, 30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_BOTTOM_FRONT_LEFT, 45, -30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_BOTTOM_FRONT_CENTER, 0, -30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_BOTTOM_FRONT_RIGHT, -45, -30, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_FRONT_WIDE_LEFT, 60, 0, kMinus3Db},
+        {AudioChannelLayout::CHANNEL_FRONT_WIDE_RIGHT, -60, 0, kMinus3Db},
+};
+constexpr SpeakerPosition kMonoPosition = {AudioChannelLayout::CHANNEL_FRONT_CENTER, 0, 0, 1.f};
+
+// Spherical head model of Brown and Duda, "A structural model for binaural sound synthesis".
+constexpr double kHeadRadiusM = 0.0875;
+constexpr double kSpeedOfSoundMps = 343;
+constexpr double kMinShadowAlpha = 0.1;
+constexpr double kMinShadowAngle = M_PI * 150 / 180;
+// The delays are synthesized in the frequency domain, the ringing before the onset must fit.
+constexpr size_t kSynthesisFftSize = 512;
+constexpr double kOnsetFrames = 8;
+constexpr size_t kFadeOutFrames = 32;
+
+const SpeakerPosition* findSpeakerPosition(int32_t channel) {
+    for (const auto& position : kSpeakerPositions) {
+        if (position.channel == channel) return &position;
+    }
+    return nullptr;
+}
+
+/**
+ * Synthesizes the HRIR of the ear on the side of earSign, 1 for the left ear and -1 for the right
+ * one, to hrir of kHrirFrames.
+ */
+void synthesizeHrir(int sampleRate, const SpeakerPosition& position, double earSign,
+                    float* hrir) {
+    const double azimuth = position.azimuth * M_PI / 180;
+    const double elevation = position.elevation * M_PI / 180;
+    // Angle between the direction of the speaker and the axis of the ear.
+    const double incidence =
+            std::acos(std::clamp(earSign * std::cos(elevation) * std::sin(azimuth), -1., 1.));
+
+    // Woodworth delay from the ear nearest to the speaker.
+    const double delayS = kHeadRadiusM / kSpeedOfSoundMps *
+                          (incidence < M_PI / 2 ? 1 - std::cos(incidence)
+                                                : 1 + incidence - M_PI / 2);
+    const double delayFrames = kOnsetFrames + delayS * sampleRate;
+    // One pole, one zero head shadow, boosting the ipsilateral side and cutting the other above
+    // 2 c / a.
+    const double alpha = 1 + kMinShadowAlpha / 2 +
+                         (1 - kMinShadowAlpha / 2) * std::cos(incidence / kMinShadowAngle * M_PI);
+    const double cornerRadS = 2 * kSpeedOfSoundMps / kHeadRadiusM;
+
+    const RealFft fft(kSynthesisFftSize);
+    std::vector<float> re(fft.getBinCount());
+    std::vector<float> im(fft.getBinCount());
+    for (size_t k = 0; k < fft.getBinCount(); k++) {
+        const double omega = 2 * M_PI * k * sampleRate / kSynthesisFftSize;
+        const std::complex<double> shadow = std::complex<double>(1, alpha * omega / cornerRadS) /
+                                            std::complex<double>(1, omega / cornerRadS);
+        const std::complex<double> bin =
+                shadow * std::polar(1., -2 * M_PI * k * delayFrames / kSynthesisFftSize);
+        re[k] = bin.real();
+        im[k] = bin.imag();
+    }
+    std::vector<float> response(kSynthesisFftSize);
+    fft.inverse(re.data(), im.data(), response.data());
+
+    const float scale = position.gain / kSynthesisFftSize;
+    for (size_t i = 0; i < SpatializerSwEngine::kHrirFrames; i++) {
+        const size_t fromEnd = SpatializerSwEngine::kHrirFrames - i;
+        float fade = 1.f;
+        if (fromEnd < kFadeOutFrames) {
+            fade = 0.5f - 0.5f * std::cos(static_cast<float>(M_PI) * fromEnd / kFadeOutFrames);
+        }
+        hrir[i] = response[i] * scale * fade;
+    }
+}
+
+// acc += x * h, for count bins, a multiple of kLanes.
+void multiplyAccumulate(const float* xRe, const float* xIm, const float* hRe, const float* hIm,
+                        float* accRe, float* accIm, size_t count) {
+    for (size_t k = 0; k < count; k += simd::kLanes) {
+        const simd::float4 xr = simd::load(xRe + k);
+        const simd::float4 xi = simd::load(xIm + k);
+        const simd::float4 hr = simd::load(hRe + k);
+        const simd::float4 hi = simd::load(hIm + k);
+        simd::float4 ar = simd::load(accRe + k);
+        simd::float4 ai = simd::load(accIm + k);
+        ar = simd::mulSub(simd::mulAdd(ar, xr, hr), xi, hi);
+        ai = simd::mulAdd(simd::mulAdd(ai, xr, hi), xi, hr);
+        simd::store(accRe + k, ar);
+        simd::store(accIm + k, ai);
+    }
+}
+
+}  // namespace
+
+SpatializerSwEngine::SpatializerSwEngine(int sampleRate, const AudioChannelLayout& inputLayout,
+                                         size_t outputChannelCount)
+    : mInputChannelCount(getChannelCount(inputLayout)),
+      mOutputChannelCount(outputChannelCount),
+      mBlockInput(kBlockFrames * mInputChannelCount, 0.f) {
+    std::vector<const SpeakerPosition*> positions(mInputChannelCount, nullptr);
+    if (inputLayout.getTag() == AudioChannelLayout::layoutMask) {
+        const int32_t layout = inputLayout.get<AudioChannelLayout::layoutMask>();
+        if (layout == AudioChannelLayout::LAYOUT_MONO) {
+            positions[0] = &kMonoPosition;
+        } else {
+            size_t channel = 0;
+            for (int bit = 0; bit < 32; bit++) {
+                const auto mask = static_cast<int32_t>(1u << bit);
+                if (!(layout & mask)) continue;
+                if (mask == AudioChannelLayout::CHANNEL_LOW_FREQUENCY ||
+                    mask == AudioChannelLayout::CHANNEL_LOW_FREQUENCY_2) {
+                    mDirectChannels.push_back({channel, kMinus3Db});
+                } else {
+                    positions[channel] = findSpeakerPosition(mask);
+                }
+                channel++;
+            }
+        }
+    } else if (mInputChannelCount >= 2) {
+        // Index masks have no positions, the first two channels are rendered as a stereo pair.
+        positions[0] = findSpeakerPosition(AudioChannelLayout::CHANNEL_FRONT_LEFT);
+        positions[1] = findSpeakerPosition(AudioChannelLayout::CHANNEL_FRONT_RIGHT);
+    }
+
+    float hrir[kHrirFrames];
+    float partition[kFftSize] = {};
+    for (size_t channel = 0; channel < mInputChannelCount; channel++) {
+        if (!positions[channel]) continue;
+        Source& source = mSources.emplace_back();
+        source.channel = channel;
+        for (size_t ear = 0; ear < kEars; ear++) {
+            synthesizeHrir(sampleRate, *positions[channel], ear == 0 ? 1 : -1, hrir);
+            for (size_t p = 0; p < kPartitions; p++) {
+                // The inverse FFT of the rendering is scaled by kFftSize.
+                for (size_t i = 0; i < kBlockFrames; i++) {
+                    partition[i] = hrir[p * kBlockFrames + i] / kFftSize;
+                }
+                mFft.forward(partition, source.hrtf[ear][p].re, source.hrtf[ear][p].im);
+            }
+        }
+    }
+}
+
+void SpatializerSwEngine::process(const float* in, float* out, size_t frames) {
+    simd::ScopedFlushDenormals flushDenormals;
+    while (frames > 0) {
+        const size_t count = std::min(frames, kBlockFrames - mBlockPos);
+        // The input is consumed before the output is written over it.
+        memcpy(&mBlockInput[mBlockPos * mInputChannelCount], in,
+               count * mInputChannelCount * sizeof(float));
+        for (size_t i = 0; i < count; i++, out += mOutputChannelCount) {
+            out[0] = mBlockOutput[(mBlockPos + i) * kEars];
+            out[1] = mBlockOutput[(mBlockPos + i) * kEars + 1];
+            std::fill(out + kEars, out + mOutputChannelCount, 0.f);
+        }
+        in += count * mInputChannelCount;
+        frames -= count;
+        mBlockPos += count;
+        if (mBlockPos == kBlockFrames) {
+            render();
+            mBlockPos = 0;
+        }
+    }
+}
+
+void SpatializerSwEngine::render() {
+    for (auto& source : mSources) {
+        memcpy(source.window, source.window + kBlockFrames, kBlockFrames * sizeof(float));
+        for (size_t i = 0; i < kBlockFrames; i++) {
+            source.window[kBlockFrames + i] = mBlockInput[i * mInputChannelCount + source.channel];
+        }
+        Spectrum& spectrum = source.delayLine[mDelayLinePos];
+        mFft.forward(source.window, spectrum.re, spectrum.im);
+    }
+
+    for (size_t ear = 0; ear < kEars; ear++) {
+        std::fill(std::begin(mAccumulator.re), std::end(mAccumulator.re), 0.f);
+        std::fill(std::begin(mAccumulator.im), std::end(mAccumulator.im), 0.f);
+        for (const auto& source : mSources) {
+            for (size_t p = 0; p < kPartitions; p++) {
+                const size_t pos = (mDelayLinePos + kPartitions - p) % kPartitions;
+                const Spectrum& x = source.delayLine[pos];
+                const Spectrum& h = source.hrtf[ear][p];
+                multiplyAccumulate(x.re, x.im, h.re, h.im, mAccumulator.re, mAccumulator.im,
+                                   kBinStride);
+            }
+        }
+        // Overlap-save: the first half of the circular convolution wraps around.
+        mFft.inverse(mAccumulator.re, mAccumulator.im, mEarOutput);
+        for (size_t i = 0; i < kBlockFrames; i++) {
+            mBlockOutput[i * kEars + ear] = mEarOutput[kBlockFrames + i];
+        }
+    }
+
+    for (const auto& direct : mDirectChannels) {
+        for (size_t i = 0; i < kBlockFrames; i++) {
+            const float sample = direct.gain * mBlockInput[i * mInputChannelCount + direct.channel];
+            mBlockOutput[i * kEars] += sample;
+            mBlockOutput[i * kEars + 1] += sample;
+        }
+    }
+    mDelayLinePos = (mDelayLinePos + 1) % kPartitions;
+}
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aidl/android/hardware/audio/effect/BnEffect.h>
+
+#include "effect-impl/EffectFft.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+/**
+ * Binaural rendering of a multichannel layout to headphones.
+ *
+ * Every positional channel is convolved with the head related impulse responses (HRIRs) of its
+ * speaker position for both ears, with a uniformly partitioned overlap-save convolution: blocks
+ * of kBlockFrames are transformed once, kept in a frequency domain delay line of kPartitions
+ * spectra, and multiplied by the spectra of the matching HRIR partitions, kLanes bins at a time.
+ * One inverse FFT per ear renders a block, whatever the channel count. The LFE channels are mixed
+ * to both ears without filtering.
+ *
+ * The HRIRs are synthesized from a spherical head model: interaural delay and head shadow, no
+ * pinna or room cues.
+ *
+ * The output is delayed by kBlockFrames. process() does not allocate and must not be called
+ * concurrently with itself.
+ */
+class SpatializerSwEngine {
+  public:
+    static constexpr size_t kBlockFrames = 64;
+    static constexpr size_t kPartitions = 4;
+    static constexpr size_t kHrirFrames = kBlockFrames * kPartitions;
+
+    SpatializerSwEngine(int sampleRate,
+                        const ::aidl::android::media::audio::common::AudioChannelLayout&
+                                inputLayout,
+                        size_t outputChannelCount);
+
+    size_t getInputChannelCount() const { return mInputChannelCount; }
+
+    /**
+     * Renders frames of interleaved input to interleaved output, of which the channels after the
+     * first two are silent. out may alias in, if it has no more channels.
+     */
+    void process(const float* in, float* out, size_t frames);
+
+  private:
+    static constexpr size_t kFftSize = 2 * kBlockFrames;
+    static constexpr size_t kBinCount = kFftSize / 2 + 1;
+    // Spectra are padded with zero bins to whole vectors.
+    static constexpr size_t kBinStride = (kBinCount + 3) & ~size_t{3};
+    static constexpr size_t kEars = 2;
+
+    struct Spectrum {
+        float re[kBinStride] = {};
+        float im[kBinStride] = {};
+    };
+
+    struct Source {
+        size_t channel;
+        // The previous block and the current one, the input of the FFT.
+        float window[kFftSize] = {};
+        // Spectra of the last kPartitions windows, the latest at mDelayLinePos.
+        Spectrum delayLine[kPartitions];
+        // Spectra of the HRIR partitions, scaled by 1 / kFftSize for the inverse FFT.
+        Spectrum hrtf[kEars][kPartitions];
+    };
+
+    struct DirectChannel {
+        size_t channel;
+        float gain;
+    };
+
+    void render();
+
+    const size_t mInputChannelCount;
+    const size_t mOutputChannelCount;
+    const RealFft mFft{kFftSize};
+    std::vector<Source> mSources;
+    std::vector<DirectChannel> mDirectChannels;
+    size_t mDelayLinePos = 0;
+
+    // Input of the block being filled, interleaved, and output of the previous block, stereo.
+    std::vector<float> mBlockInput;
+    float mBlockOutput[kBlockFrames * kEars] = {};
+    size_t mBlockPos = 0;
+
+    Spectrum mAccumulator;
+    float mEarOutput[kFftSize];
+};
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "DownmixSwEngine.h"
+
+using aidl::android::hardware::audio::effect::Downmix;
+using aidl::android::hardware::audio::effect::DownmixSwEngine;
+using aidl::android::media::audio::common::AudioChannelLayout;
+
+namespace {
+
+constexpr float kMinus3Db = 0.70710678f;
+constexpr float kTolerance = 1e-6f;
+// From a single frame, all scalar, to several vectors of 4 frames and a tail.
+constexpr size_t kFrameCounts[] = {1, 2, 3, 4, 5, 7, 8, 13};
+
+AudioChannelLayout makeLayout(int32_t layout) {
+    return AudioChannelLayout::make<AudioChannelLayout::layoutMask>(layout);
+}
+
+// Expected left and right gains of a channel of the layout.
+std::pair<float, float> expectedGains(int32_t channel, int32_t layout) {
+    switch (channel) {
+        case AudioChannelLayout::CHANNEL_FRONT_LEFT:
+            return {1.f, 0.f};
+        case AudioChannelLayout::CHANNEL_FRONT_RIGHT:
+            return {0.f, 1.f};
+        case AudioChannelLayout::CHANNEL_FRONT_CENTER:
+            return {kMinus3Db, kMinus3Db};
+        case AudioChannelLayout::CHANNEL_LOW_FREQUENCY:
+            if (layout & AudioChannelLayout::CHANNEL_LOW_FREQUENCY_2) return {kMinus3Db, 0.f};
+            return {kMinus3Db, kMinus3Db};
+        case AudioChannelLayout::CHANNEL_LOW_FREQUENCY_2:
+            return {0.f, kMinus3Db};
+        case AudioChannelLayout::CHANNEL_BACK_LEFT:
+        case AudioChannelLayout::CHANNEL_SIDE_LEFT:
+        case AudioChannelLayout::CHANNEL_TOP_FRONT_LEFT:
+        case AudioChannelLayout::CHANNEL_TOP_BACK_LEFT:
+            return {kMinus3Db, 0.f};
+        case AudioChannelLayout::CHANNEL_BACK_RIGHT:
+        case AudioChannelLayout::CHANNEL_SIDE_RIGHT:
+        case AudioChannelLayout::CHANNEL_TOP_FRONT_RIGHT:
+        case AudioChannelLayout::CHANNEL_TOP_BACK_RIGHT:
+            return {0.f, kMinus3Db};
+        case AudioChannelLayout::CHANNEL_BACK_CENTER:
+            return {0.5f, 0.5f};
+        default:
+            ADD_FAILURE() << "no expected gains for channel " << channel;
+            return {0.f, 0.f};
+    }
+}
+
+std::vector<int32_t> getChannels(int32_t layout) {
+    std::vector<int32_t> channels;
+    for (int bit = 0; bit < 32; bit++) {
+        const auto channel = static_cast<int32_t>(1u << bit);
+        if (layout & channel) channels.push_back(channel);
+    }
+    return channels;
+}
+
+// Input in which only channel `index` is set, to a different value in every frame.
+std::vector<float> makeSingleChannelInput(size_t frames, size_t channelCount, size_t index) {
+    std::vector<float> in(frames * channelCount, 0.f);
+    for (size_t i = 0; i < frames; i++) {
+        in[i * channelCount + index] = 0.5f - 0.1f * i / frames;
+    }
+    return in;
+}
+
+}  // namespace
+
+// 5.1, 7.1.4 and 6.1 have specialized kernels, the layouts with LFE_2 or a center back without
+// back left and right do not.
+class DownmixSwEngineFoldTest : public ::testing::TestWithParam<int32_t> {};
+
+TEST_P(DownmixSwEngineFoldTest, RoutesEveryChannel) {
+    const int32_t layout = GetParam();
+    const std::vector<int32_t> channels = getChannels(layout);
+    DownmixSwEngine engine(makeLayout(layout));
+    engine.setType(Downmix::Type::FOLD);
+    ASSERT_EQ(channels.size(), engine.getInputChannelCount());
+
+    for (size_t frames : kFrameCounts) {
+        for (size_t index = 0; index < channels.size(); index++) {
+            SCOPED_TRACE(testing::Message() << "frames " << frames << " channel " << index);
+            const auto [leftGain, rightGain] = expectedGains(channels[index], layout);
+            const std::vector<float> in = makeSingleChannelInput(frames, channels.size(), index);
+            std::vector<float> out(frames * 2, -2.f);
+            engine.process(in.data(), out.data(), frames);
+            for (size_t i = 0; i < frames; i++) {
+                const float sample = in[i * channels.size() + index];
+                ASSERT_NEAR(sample * leftGain, out[2 * i], kTolerance) << "frame " << i;
+                ASSERT_NEAR(sample * rightGain, out[2 * i + 1], kTolerance) << "frame " << i;
+            }
+        }
+    }
+}
+
+TEST_P(DownmixSwEngineFoldTest, ProcessesInPlace) {
+    const int32_t layout = GetParam();
+    const size_t channelCount = std::popcount(static_cast<uint32_t>(layout));
+    DownmixSwEngine engine(makeLayout(layout));
+    engine.setType(Downmix::Type::FOLD);
+    for (size_t frames : kFrameCounts) {
+        SCOPED_TRACE(testing::Message() << "frames " << frames);
+        std::vector<float> in(frames * channelCount);
+        for (size_t i = 0; i < in.size(); i++) in[i] = 0.1f * ((i * 7) % 11) - 0.5f;
+        std::vector<float> out(frames * 2);
+        engine.process(in.data(), out.data(), frames);
+        engine.process(in.data(), in.data(), frames);
+        for (size_t i = 0; i < out.size(); i++) ASSERT_EQ(out[i], in[i]) << "sample " << i;
+    }
+}
+
+TEST_P(DownmixSwEngineFoldTest, Clamps) {
+    const int32_t layout = GetParam();
+    const size_t channelCount = std::popcount(static_cast<uint32_t>(layout));
+    DownmixSwEngine engine(makeLayout(layout));
+    engine.setType(Downmix::Type::FOLD);
+    for (size_t frames : kFrameCounts) {
+        SCOPED_TRACE(testing::Message() << "frames " << frames);
+        // Full scale on every channel, positive in even frames and negative in odd ones.
+        std::vector<float> in(frames * channelCount);
+        for (size_t i = 0; i < frames; i++) {
+            std::fill_n(&in[i * channelCount], channelCount, i % 2 == 0 ? 1.f : -1.f);
+        }
+        std::vector<float> out(frames * 2);
+        engine.process(in.data(), out.data(), frames);
+        for (size_t i = 0; i < frames; i++) {
+            const float expected = i % 2 == 0 ? 1.f : -1.f;
+            ASSERT_EQ(expected, out[2 * i]) << "frame " << i;
+            ASSERT_EQ(expected, out[2 * i + 1]) << "frame " << i;
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        DownmixSwEngineTest, DownmixSwEngineFoldTest,
+        ::testing::Values(
+                AudioChannelLayout::LAYOUT_5POINT1, AudioChannelLayout::LAYOUT_6POINT1,
+                AudioChannelLayout::LAYOUT_7POINT1POINT4,
+                AudioChannelLayout::LAYOUT_5POINT1 | AudioChannelLayout::CHANNEL_LOW_FREQUENCY_2,
+                AudioChannelLayout::LAYOUT_7POINT1 | AudioChannelLayout::CHANNEL_LOW_FREQUENCY_2,
+                AudioChannelLayout::LAYOUT_STEREO | AudioChannelLayout::CHANNEL_FRONT_CENTER |
+                        AudioChannelLayout::CHANNEL_BACK_CENTER |
+                        AudioChannelLayout::CHANNEL_LOW_FREQUENCY),
+        [](const ::testing::TestParamInfo<int32_t>& info) {
+            return "layout_" + std::to_string(info.param);
+        });
+
+TEST(DownmixSwEngineTest, StripKeepsFirstTwoChannels) {
+    for (int32_t layout : {AudioChannelLayout::LAYOUT_STEREO, AudioChannelLayout::LAYOUT_5POINT1,
+                           AudioChannelLayout::LAYOUT_7POINT1POINT4}) {
+        const size_t channelCount = std::popcount(static_cast<uint32_t>(layout));
+        DownmixSwEngine engine(makeLayout(layout));
+        engine.setType(Downmix::Type::STRIP);
+        for (size_t frames : kFrameCounts) {
+            SCOPED_TRACE(testing::Message() << "layout " << layout << " frames " << frames);
+            std::vector<float> in(frames * channelCount);
+            // Out of range samples are not clamped either.
+            for (size_t i = 0; i < in.size(); i++) in[i] = 0.5f * i - 1.f;
+            std::vector<float> out(frames * 2);
+            engine.process(in.data(), out.data(), frames);
+            for (size_t i = 0; i < frames; i++) {
+                ASSERT_EQ(in[i * channelCount], out[2 * i]) << "frame " << i;
+                ASSERT_EQ(in[i * channelCount + 1], out[2 * i + 1]) << "frame " << i;
+            }
+        }
+    }
+}
+
+TEST(DownmixSwEngineTest, FoldStripsIndexMasks) {
+    DownmixSwEngine engine(AudioChannelLayout::make<AudioChannelLayout::indexMask>(0xF));
+    engine.setType(Downmix::Type::FOLD);
+    ASSERT_EQ(4u, engine.getInputChannelCount());
+    const std::vector<float> in = {0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f};
+    std::vector<float> out(4);
+    engine.process(in.data(), out.data(), 2);
+    EXPECT_EQ((std::vector<float>{0.1f, 0.2f, 0.5f, 0.6f}), out);
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "DynamicsProcessingSwEngine.h"
+
+using aidl::android::hardware::audio::effect::DynamicsProcessing;
+using aidl::android::hardware::audio::effect::DynamicsProcessingSwEngine;
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+// Long enough for the envelopes and the filters to settle.
+constexpr size_t kSettleFrames = kSampleRate;
+constexpr size_t kMeasureFrames = kSampleRate / 10;
+
+float dbToLinear(float db) {
+    return std::pow(10.f, db / 20.f);
+}
+
+// Interleaved frames of a cosine on every channel.
+std::vector<float> makeCosine(size_t frames, size_t channelCount, float frequencyHz,
+                              float amplitude) {
+    std::vector<float> cosine(frames * channelCount);
+    for (size_t i = 0; i < frames; i++) {
+        const float value = amplitude * std::cos(2 * std::numbers::pi * frequencyHz * i /
+                                                 kSampleRate);
+        for (size_t c = 0; c < channelCount; c++) cosine[i * channelCount + c] = value;
+    }
+    return cosine;
+}
+
+// Processes in buffers of varying sizes, none a multiple of the block or control period.
+std::vector<float> processInChunks(DynamicsProcessingSwEngine& engine, const std::vector<float>& in,
+                                   size_t channelCount) {
+    const size_t frames = in.size() / channelCount;
+    std::vector<float> out(in.size());
+    size_t chunk = 37;
+    for (size_t frame = 0; frame < frames;) {
+        const size_t count = std::min(chunk, frames - frame);
+        engine.process(&in[frame * channelCount], &out[frame * channelCount], count);
+        frame += count;
+        chunk = chunk * 3 % 211 + 1;
+    }
+    return out;
+}
+
+// Peak of a channel over the last kMeasureFrames frames.
+float tailPeak(const std::vector<float>& samples, size_t channelCount, size_t channel) {
+    const size_t frames = samples.size() / channelCount;
+    float peak = 0;
+    for (size_t i = frames - kMeasureFrames; i < frames; i++) {
+        peak = std::max(peak, std::abs(samples[i * channelCount + channel]));
+    }
+    return peak;
+}
+
+// RMS of a channel over the last kMeasureFrames frames.
+float tailRms(const std::vector<float>& samples, size_t channelCount, size_t channel) {
+    const size_t frames = samples.size() / channelCount;
+    double sumSquares = 0;
+    for (size_t i = frames - kMeasureFrames; i < frames; i++) {
+        sumSquares += samples[i * channelCount + channel] * samples[i * channelCount + channel];
+    }
+    return std::sqrt(sumSquares / kMeasureFrames);
+}
+
+std::vector<DynamicsProcessing::ChannelConfig> enableChannels(size_t channelCount) {
+    std::vector<DynamicsProcessing::ChannelConfig> channels;
+    for (int channel = 0; channel < static_cast<int>(channelCount); channel++) {
+        channels.push_back({.channel = channel, .enable = true});
+    }
+    return channels;
+}
+
+DynamicsProcessing::LimiterConfig makeLimiter(int channel, int linkGroup, float thresholdDb,
+                                              float ratio) {
+    return {.channel = channel,
+            .enable = true,
+            .linkGroup = linkGroup,
+            .attackTimeMs = 1,
+            .releaseTimeMs = 50,
+            .ratio = ratio,
+            .thresholdDb = thresholdDb};
+}
+
+DynamicsProcessing::EngineArchitecture makeArchitecture(int mbcBandCount, bool limiterInUse) {
+    DynamicsProcessing::EngineArchitecture architecture;
+    architecture.mbcStage = {.inUse = mbcBandCount > 0, .bandCount = mbcBandCount};
+    architecture.limiterInUse = limiterInUse;
+    return architecture;
+}
+
+const DynamicsProcessing::EngineArchitecture kLimiterOnly = makeArchitecture(0, true);
+
+}  // namespace
+
+TEST(DynamicsProcessingSwEngineTest, PassesAudioThroughWithoutStages) {
+    DynamicsProcessingSwEngine engine(kSampleRate, 2, makeArchitecture(0, false));
+    const std::vector<float> in = makeCosine(1000, 2, 1000, 0.5f);
+    EXPECT_EQ(in, processInChunks(engine, in, 2));
+    EXPECT_EQ(0u, engine.getLatencyFrames());
+}
+
+TEST(DynamicsProcessingSwEngineTest, AppliesInputGain) {
+    constexpr size_t kChannelCount = 6;
+    DynamicsProcessingSwEngine engine(kSampleRate, kChannelCount, makeArchitecture(0, false));
+    engine.setInputGains({{.channel = 0, .gainDb = 6}, {.channel = 5, .gainDb = -12}});
+    const std::vector<float> in = makeCosine(1000, kChannelCount, 1000, 0.25f);
+    const std::vector<float> out = processInChunks(engine, in, kChannelCount);
+    for (size_t i = 0; i < in.size(); i++) {
+        const size_t channel = i % kChannelCount;
+        const float gainDb = channel == 0 ? 6.f : channel == 5 ? -12.f : 0.f;
+        ASSERT_FLOAT_EQ(in[i] * dbToLinear(gainDb), out[i]) << "sample " << i;
+    }
+
+    // Unset gains are back to unity.
+    engine.setInputGains({});
+    EXPECT_EQ(in, processInChunks(engine, in, kChannelCount));
+}
+
+class DynamicsProcessingSwEngineCompressorTest
+    : public ::testing::TestWithParam<std::tuple<float /* levelDb */, float /* kneeWidthDb */>> {};
+
+// With one band, the compressor sees the input as is. The cosine has a period of one control
+// period and peaks at its first frame, so the detected level is the amplitude.
+TEST_P(DynamicsProcessingSwEngineCompressorTest, FollowsStaticCurve) {
+    constexpr float kThresholdDb = -20;
+    constexpr float kRatio = 4;
+    const auto [levelDb, kneeWidthDb] = GetParam();
+    DynamicsProcessingSwEngine engine(kSampleRate, 1, makeArchitecture(1, false));
+    engine.setMbc(enableChannels(1), {{.channel = 0,
+                                       .band = 0,
+                                       .enable = true,
+                                       .cutoffFrequencyHz = 20000,
+                                       .attackTimeMs = 1,
+                                       .releaseTimeMs = 50,
+                                       .ratio = kRatio,
+                                       .thresholdDb = kThresholdDb,
+                                       .kneeWidthDb = kneeWidthDb,
+                                       .noiseGateThresholdDb = -90,
+                                       .expanderRatio = 1}});
+
+    float expectedGainDb = 0;
+    const float over = levelDb - kThresholdDb;
+    if (kneeWidthDb > 0 && 2 * std::abs(over) <= kneeWidthDb) {
+        const float x = over + kneeWidthDb / 2;
+        expectedGainDb = (1 / kRatio - 1) * x * x / (2 * kneeWidthDb);
+    } else if (over > 0) {
+        expectedGainDb = (1 / kRatio - 1) * over;
+    }
+
+    constexpr float kFrequencyHz =
+            static_cast<float>(kSampleRate) / DynamicsProcessingSwEngine::kControlFrames;
+    const float amplitude = dbToLinear(levelDb);
+    const std::vector<float> out = processInChunks(
+            engine, makeCosine(kSettleFrames, 1, kFrequencyHz, amplitude), 1);
+    const float gainDb = 20 * std::log10(tailPeak(out, 1, 0) / amplitude);
+    EXPECT_NEAR(expectedGainDb, gainDb, 0.01f);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        DynamicsProcessingSwEngineTest, DynamicsProcessingSwEngineCompressorTest,
+        ::testing::Combine(::testing::Values(-40.f, -27.f, -22.f, -20.f, -16.f, -6.f, 0.f),
+                           ::testing::Values(0.f, 10.f)));
+
+// With every band enabled but bypassed, the crossover is only an allpass. The frequencies have a
+// whole number of periods in kMeasureFrames, so that the RMS doesn't depend on the phase.
+TEST(DynamicsProcessingSwEngineTest, CrossoverSumsFlat) {
+    constexpr size_t kChannelCount = 2;
+    constexpr int kBandCount = 4;
+    const float cutoffs[kBandCount] = {150, 1500, 6000, 20000};
+    for (float frequencyHz : {40.f, 150.f, 700.f, 1500.f, 3000.f, 6000.f, 12000.f}) {
+        DynamicsProcessingSwEngine engine(kSampleRate, kChannelCount,
+                                          makeArchitecture(kBandCount, false));
+        std::vector<DynamicsProcessing::MbcBandConfig> bands;
+        for (int channel = 0; channel < static_cast<int>(kChannelCount); channel++) {
+            for (int band = 0; band < kBandCount; band++) {
+                bands.push_back({.channel = channel,
+                                 .band = band,
+                                 .enable = false,
+                                 .cutoffFrequencyHz = cutoffs[band]});
+            }
+        }
+        engine.setMbc(enableChannels(kChannelCount), bands);
+
+        const std::vector<float> out = processInChunks(
+                engine, makeCosine(kSettleFrames, kChannelCount, frequencyHz, 0.5f),
+                kChannelCount);
+        for (size_t channel = 0; channel < kChannelCount; channel++) {
+            EXPECT_NEAR(0.5f * M_SQRT1_2, tailRms(out, kChannelCount, channel), 1e-4f)
+                    << frequencyHz << " Hz, channel " << channel;
+        }
+    }
+}
+
+TEST(DynamicsProcessingSwEngineTest, LimiterReportsLookaheadLatency) {
+    DynamicsProcessingSwEngine engine(kSampleRate, 1, kLimiterOnly);
+    EXPECT_EQ(0u, engine.getLatencyFrames());
+    // 1ms is 48 frames, three control periods.
+    engine.setLimiters({makeLimiter(0, 0, 0, 10)});
+    const size_t latency = engine.getLatencyFrames();
+    EXPECT_EQ(48u, latency);
+
+    // Below the threshold, the output is the input delayed by the latency.
+    std::vector<float> in(1000, 0.f);
+    in[100] = 0.5f;
+    const std::vector<float> out = processInChunks(engine, in, 1);
+    for (size_t i = 0; i < out.size(); i++) {
+        ASSERT_FLOAT_EQ(i == 100 + latency ? 0.5f : 0.f, out[i]) << "frame " << i;
+    }
+
+    // The lookahead is bounded.
+    auto limiter = makeLimiter(0, 0, 0, 10);
+    limiter.attackTimeMs = 1000;
+    engine.setLimiters({limiter});
+    EXPECT_EQ(DynamicsProcessingSwEngine::kMaxLookaheadFrames, engine.getLatencyFrames());
+    engine.setLimiters({});
+    EXPECT_EQ(0u, engine.getLatencyFrames());
+}
+
+TEST(DynamicsProcessingSwEngineTest, LimiterOutputNeverExceedsThreshold) {
+    constexpr float kThresholdDb = -6;
+    const float threshold = dbToLinear(kThresholdDb);
+    DynamicsProcessingSwEngine engine(kSampleRate, 1, kLimiterOnly);
+    engine.setLimiters({makeLimiter(0, 0, kThresholdDb, 1e6f)});
+
+    // Bursts of increasing level with sudden onsets, separated by silence long enough for the
+    // limiter to release.
+    std::vector<float> in;
+    for (float amplitude : {0.3f, 0.6f, 1.f, 2.f, 4.f}) {
+        const std::vector<float> burst = makeCosine(2000, 1, 997, amplitude);
+        in.insert(in.end(), burst.begin(), burst.end());
+        in.insert(in.end(), kSampleRate / 2, 0.f);
+        // A single sample spike.
+        in.push_back(amplitude);
+        in.insert(in.end(), kSampleRate / 2, 0.f);
+    }
+    const std::vector<float> out = processInChunks(engine, in, 1);
+    for (size_t i = 0; i < out.size(); i++) {
+        ASSERT_LE(std::abs(out[i]), threshold * 1.0001f) << "frame " << i;
+    }
+    // Quiet audio is left alone.
+    EXPECT_FLOAT_EQ(0.3f, tailPeak(std::vector<float>(out.begin(), out.begin() + 2000 +
+                                                                          kMeasureFrames),
+                                   1, 0));
+}
+
+// Channels 0 and 5, in different SIMD groups, are linked. Only channel 0 is loud.
+TEST(DynamicsProcessingSwEngineTest, LinkedLimitersApplyTheSameGain) {
+    constexpr size_t kChannelCount = 6;
+    constexpr size_t kFrames = kSampleRate / 2;
+    constexpr size_t kStepFrame = kFrames / 4;
+    DynamicsProcessingSwEngine engine(kSampleRate, kChannelCount, kLimiterOnly);
+    engine.setLimiters({makeLimiter(0, 1, -12, 10), makeLimiter(1, 2, -12, 10),
+                        makeLimiter(2, 2, -12, 10), makeLimiter(3, 2, -12, 10),
+                        makeLimiter(4, 2, -12, 10), makeLimiter(5, 1, -12, 10)});
+    const size_t latency = engine.getLatencyFrames();
+
+    // Steps of DC, so that the gain of every frame is out / in.
+    std::vector<float> in(kFrames * kChannelCount, 0.1f);
+    for (size_t i = kStepFrame; i < kFrames; i++) in[i * kChannelCount] = 0.9f;
+    const std::vector<float> out = processInChunks(engine, in, kChannelCount);
+
+    bool limited = false;
+    for (size_t i = latency; i < kFrames; i++) {
+        const float* inFrame = &in[(i - latency) * kChannelCount];
+        const float* outFrame = &out[i * kChannelCount];
+        const float gain = outFrame[0] / inFrame[0];
+        ASSERT_NEAR(gain, outFrame[5] / inFrame[5], 1e-5f) << "frame " << i;
+        limited |= gain < 0.5f;
+        // The other link group is below its threshold.
+        for (size_t channel = 1; channel < 5; channel++) {
+            ASSERT_FLOAT_EQ(inFrame[channel], outFrame[channel]) << "frame " << i;
+        }
+    }
+    EXPECT_TRUE(limited);
+}
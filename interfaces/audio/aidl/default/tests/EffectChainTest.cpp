@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <gtest/gtest.h>
+#define LOG_TAG "EffectChainTest"
+
+#include "effect-impl/EffectChain.h"
+#include "effect-impl/EffectImpl.h"
+
+using aidl::android::hardware::audio::effect::CommandId;
+using aidl::android::hardware::audio::effect::Descriptor;
+using aidl::android::hardware::audio::effect::EffectChain;
+using aidl::android::hardware::audio::effect::EffectContext;
+using aidl::android::hardware::audio::effect::EffectImpl;
+using aidl::android::hardware::audio::effect::Equalizer;
+using aidl::android::hardware::audio::effect::IEffect;
+using aidl::android::hardware::audio::effect::kEventFlagDataMqNotEmpty;
+using aidl::android::hardware::audio::effect::Parameter;
+using aidl::android::hardware::audio::effect::RetCode;
+using aidl::android::hardware::audio::effect::State;
+using aidl::android::hardware::audio::effect::Volume;
+using aidl::android::media::audio::common::AudioChannelLayout;
+using aidl::android::media::audio::common::AudioFormatDescription;
+using aidl::android::media::audio::common::AudioFormatType;
+using aidl::android::media::audio::common::PcmType;
+using ::android::hardware::EventFlag;
+
+namespace {
+
+constexpr size_t kSamples = 64;
+
+// out = in * gain + offset. The gain can be set as a Volume level if acceptsVolume.
+class AffineEffect final : public EffectImpl {
+  public:
+    AffineEffect(float gain, float offset, bool acceptsVolume)
+        : mGain(gain), mOffset(offset), mAcceptsVolume(acceptsVolume) {}
+    ~AffineEffect() { cleanUp(); }
+
+    ndk::ScopedAStatus getDescriptor(Descriptor* desc) override {
+        desc->common.name = getEffectName();
+        return ndk::ScopedAStatus::ok();
+    }
+    ndk::ScopedAStatus setParameterSpecific(const Parameter::Specific& specific)
+            REQUIRES(mImplMutex) override {
+        RETURN_IF(!mAcceptsVolume || specific.getTag() != Parameter::Specific::volume ||
+                          specific.get<Parameter::Specific::volume>().getTag() != Volume::levelDb,
+                  EX_ILLEGAL_ARGUMENT, "unsupportedParameter");
+        mLevelDb = specific.get<Parameter::Specific::volume>().get<Volume::levelDb>();
+        mGain = std::pow(10.f, mLevelDb / 20.f);
+        return ndk::ScopedAStatus::ok();
+    }
+    ndk::ScopedAStatus getParameterSpecific(const Parameter::Id& id, Parameter::Specific* specific)
+            REQUIRES(mImplMutex) override {
+        RETURN_IF(!mAcceptsVolume || id.getTag() != Parameter::Id::volumeTag, EX_ILLEGAL_ARGUMENT,
+                  "unsupportedParameter");
+        specific->set<Parameter::Specific::volume>(Volume::make<Volume::levelDb>(mLevelDb));
+        return ndk::ScopedAStatus::ok();
+    }
+    std::string getEffectName() override { return "AffineEffect"; }
+    RetCode releaseContext() REQUIRES(mImplMutex) override { return RetCode::SUCCESS; }
+
+    IEffect::Status effectProcessImpl(float* in, float* out, int samples)
+            REQUIRES(mImplMutex) override {
+        for (int i = 0; i < samples; i++) {
+            out[i] = in[i] * mGain + mOffset;
+        }
+        return {STATUS_OK, samples, samples};
+    }
+
+  private:
+    float mGain GUARDED_BY(mImplMutex);
+    const float mOffset;
+    const bool mAcceptsVolume;
+    int mLevelDb GUARDED_BY(mImplMutex) = 0;
+};
+
+// The fused entries of an effect library, see Factory::getDlSyms_l().
+const effect_dl_interface_s kFusedInterface = {nullptr, nullptr, nullptr, &setEffectFused,
+                                                &processFusedEffect};
+
+Parameter::Common makeCommon() {
+    Parameter::Common common;
+    for (auto* config : {&common.input, &common.output}) {
+        config->base.sampleRate = 48000;
+        config->base.channelMask = AudioChannelLayout::make<AudioChannelLayout::layoutMask>(
+                AudioChannelLayout::LAYOUT_STEREO);
+        config->base.format =
+                AudioFormatDescription{.type = AudioFormatType::PCM, .pcm = PcmType::FLOAT_32_BIT};
+        config->frameCount = 0x100;
+    }
+    return common;
+}
+
+}  // namespace
+
+class EffectChainTest : public ::testing::Test {
+  public:
+    void SetUp() override {
+        // Scales by 2 then adds 1, which tells the processing order apart.
+        mScale = ndk::SharedRefBase::make<AffineEffect>(2.f, 0.f, true /* acceptsVolume */);
+        mOffset = ndk::SharedRefBase::make<AffineEffect>(1.f, 1.f, false /* acceptsVolume */);
+        Descriptor desc;
+        desc.common.name = "TestChain";
+        mChain = ndk::SharedRefBase::make<EffectChain>(
+                desc, std::vector<EffectChain::Member>{{mScale, &kFusedInterface},
+                                                       {mOffset, &kFusedInterface}});
+    }
+
+    void TearDown() override {
+        if (mEventFlag) {
+            EventFlag::deleteEventFlag(&mEventFlag);
+        }
+        mChain->command(CommandId::STOP);
+        mChain->close();
+    }
+
+    void open() {
+        IEffect::OpenEffectReturn ret;
+        ASSERT_TRUE(mChain->open(makeCommon(), std::nullopt, &ret).isOk());
+        mStatusMQ = std::make_unique<EffectContext::StatusMQ>(ret.statusMQ);
+        mInputMQ = std::make_unique<EffectContext::DataMQ>(ret.inputDataMQ);
+        mOutputMQ = std::make_unique<EffectContext::DataMQ>(ret.outputDataMQ);
+        ASSERT_EQ(::android::OK,
+                  EventFlag::createEventFlag(mStatusMQ->getEventFlagWord(), &mEventFlag));
+    }
+
+    // Sends kSamples of value through the queues of the chain, returns the processed samples.
+    std::vector<float> transfer(float value) {
+        std::vector<float> buffer(kSamples, value);
+        EXPECT_TRUE(mInputMQ->write(buffer.data(), buffer.size()));
+        mEventFlag->wake(kEventFlagDataMqNotEmpty);
+        IEffect::Status status;
+        EXPECT_TRUE(mStatusMQ->readBlocking(&status, 1));
+        EXPECT_EQ(STATUS_OK, status.status);
+        EXPECT_EQ(static_cast<int>(kSamples), status.fmqProduced);
+        EXPECT_TRUE(mOutputMQ->read(buffer.data(), status.fmqProduced));
+        return buffer;
+    }
+
+    State getState(const std::shared_ptr<IEffect>& effect) {
+        State state;
+        EXPECT_TRUE(effect->getState(&state).isOk());
+        return state;
+    }
+
+    std::shared_ptr<AffineEffect> mScale;
+    std::shared_ptr<AffineEffect> mOffset;
+    std::shared_ptr<EffectChain> mChain;
+    std::unique_ptr<EffectContext::StatusMQ> mStatusMQ;
+    std::unique_ptr<EffectContext::DataMQ> mInputMQ;
+    std::unique_ptr<EffectContext::DataMQ> mOutputMQ;
+    EventFlag* mEventFlag = nullptr;
+};
+
+TEST_F(EffectChainTest, ProcessesMembersInOrder) {
+    ASSERT_NO_FATAL_FAILURE(open());
+    ASSERT_TRUE(mChain->command(CommandId::START).isOk());
+    for (float sample : transfer(0.25f)) {
+        ASSERT_EQ(1.5f, sample);
+    }
+}
+
+TEST_F(EffectChainTest, MembersFollowChainCommands) {
+    EXPECT_EQ(State::INIT, getState(mScale));
+    ASSERT_NO_FATAL_FAILURE(open());
+    EXPECT_EQ(State::IDLE, getState(mScale));
+    EXPECT_EQ(State::IDLE, getState(mOffset));
+    ASSERT_TRUE(mChain->command(CommandId::START).isOk());
+    EXPECT_EQ(State::PROCESSING, getState(mScale));
+    EXPECT_EQ(State::PROCESSING, getState(mOffset));
+    ASSERT_TRUE(mChain->command(CommandId::STOP).isOk());
+    EXPECT_EQ(State::IDLE, getState(mScale));
+    EXPECT_EQ(State::IDLE, getState(mOffset));
+    ASSERT_TRUE(mChain->close().isOk());
+    EXPECT_EQ(State::INIT, getState(mScale));
+    EXPECT_EQ(State::INIT, getState(mOffset));
+}
+
+TEST_F(EffectChainTest, RoutesSpecificParametersToMembers) {
+    ASSERT_NO_FATAL_FAILURE(open());
+    ASSERT_TRUE(mChain->setParameter(Parameter::make<Parameter::specific>(
+                                             Parameter::Specific::make<Parameter::Specific::volume>(
+                                                     Volume::make<Volume::levelDb>(20))))
+                        .isOk());
+    Parameter param;
+    ASSERT_TRUE(mChain->getParameter(Parameter::Id::make<Parameter::Id::volumeTag>(
+                                             Volume::Id::make<Volume::Id::commonTag>(
+                                                     Volume::levelDb)),
+                                     &param)
+                        .isOk());
+    EXPECT_EQ(20, param.get<Parameter::specific>()
+                          .get<Parameter::Specific::volume>()
+                          .get<Volume::levelDb>());
+
+    ASSERT_TRUE(mChain->command(CommandId::START).isOk());
+    for (float sample : transfer(0.25f)) {
+        ASSERT_FLOAT_EQ(3.5f, sample);
+    }
+
+    // No member is an equalizer.
+    EXPECT_FALSE(mChain->setParameter(Parameter::make<Parameter::specific>(
+                                              Parameter::Specific::make<
+                                                      Parameter::Specific::equalizer>(
+                                                      Equalizer::make<Equalizer::preset>(0))))
+                         .isOk());
+}
+
+TEST_F(EffectChainTest, RejectsConfigNotInPlace) {
+    Parameter::Common common = makeCommon();
+    common.output.base.channelMask = AudioChannelLayout::make<AudioChannelLayout::layoutMask>(
+            AudioChannelLayout::LAYOUT_MONO);
+    IEffect::OpenEffectReturn ret;
+    EXPECT_FALSE(mChain->open(common, std::nullopt, &ret).isOk());
+    EXPECT_EQ(State::INIT, getState(mChain));
+    EXPECT_EQ(State::INIT, getState(mScale));
+}
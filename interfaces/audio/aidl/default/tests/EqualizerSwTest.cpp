@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#define LOG_TAG "EqualizerSwTest"
+
+#include "EqualizerSw.h"
+
+using aidl::android::hardware::audio::effect::Descriptor;
+using aidl::android::hardware::audio::effect::Equalizer;
+using aidl::android::hardware::audio::effect::EqualizerSw;
+using aidl::android::hardware::audio::effect::EqualizerSwContext;
+using aidl::android::hardware::audio::effect::IEffect;
+using aidl::android::hardware::audio::effect::Parameter;
+using aidl::android::hardware::audio::effect::Range;
+using aidl::android::media::audio::common::AudioChannelLayout;
+using aidl::android::media::audio::common::AudioFormatDescription;
+using aidl::android::media::audio::common::AudioFormatType;
+using aidl::android::media::audio::common::PcmType;
+
+namespace {
+
+Parameter::Common makeCommon() {
+    Parameter::Common common;
+    for (auto* config : {&common.input, &common.output}) {
+        config->base.sampleRate = 48000;
+        config->base.channelMask = AudioChannelLayout::make<AudioChannelLayout::layoutMask>(
+                AudioChannelLayout::LAYOUT_STEREO);
+        config->base.format =
+                AudioFormatDescription{.type = AudioFormatType::PCM, .pcm = PcmType::FLOAT_32_BIT};
+        config->frameCount = 0x100;
+    }
+    return common;
+}
+
+}  // namespace
+
+class EqualizerSwTest : public ::testing::Test {
+  public:
+    void SetUp() override {
+        mEffect = ndk::SharedRefBase::make<EqualizerSw>();
+        IEffect::OpenEffectReturn ret;
+        ASSERT_TRUE(mEffect->open(makeCommon(), std::nullopt, &ret).isOk());
+    }
+
+    void TearDown() override { mEffect->close(); }
+
+    ndk::ScopedAStatus setEqualizer(const Equalizer& eq) {
+        return mEffect->setParameter(Parameter::make<Parameter::specific>(
+                Parameter::Specific::make<Parameter::Specific::equalizer>(eq)));
+    }
+
+    std::vector<Equalizer::BandLevel> getBandLevels() {
+        Parameter param;
+        Parameter::Id id = Parameter::Id::make<Parameter::Id::equalizerTag>(
+                Equalizer::Id::make<Equalizer::Id::commonTag>(Equalizer::bandLevels));
+        EXPECT_TRUE(mEffect->getParameter(id, &param).isOk());
+        return param.get<Parameter::specific>()
+                .get<Parameter::Specific::equalizer>()
+                .get<Equalizer::bandLevels>();
+    }
+
+    // The band level range advertised in the capability of the effect.
+    std::pair<int, int> getBandLevelRange() {
+        Descriptor desc;
+        EXPECT_TRUE(mEffect->getDescriptor(&desc).isOk());
+        for (const auto& range : desc.capability.range.get<Range::equalizer>()) {
+            if (range.min.getTag() == Equalizer::bandLevels) {
+                return {range.min.get<Equalizer::bandLevels>()[0].levelMb,
+                        range.max.get<Equalizer::bandLevels>()[0].levelMb};
+            }
+        }
+        ADD_FAILURE() << "no band level range";
+        return {0, 0};
+    }
+
+    std::shared_ptr<EqualizerSw> mEffect;
+};
+
+TEST_F(EqualizerSwTest, DefaultBandLevelsAreInRange) {
+    const auto [minLevel, maxLevel] = getBandLevelRange();
+    const auto bandLevels = getBandLevels();
+    ASSERT_EQ(static_cast<size_t>(EqualizerSwContext::kMaxBandNumber), bandLevels.size());
+    for (const auto& bandLevel : bandLevels) {
+        EXPECT_GE(bandLevel.levelMb, minLevel) << bandLevel.toString();
+        EXPECT_LE(bandLevel.levelMb, maxLevel) << bandLevel.toString();
+    }
+    EXPECT_TRUE(setEqualizer(Equalizer::make<Equalizer::bandLevels>(bandLevels)).isOk());
+}
+
+TEST_F(EqualizerSwTest, PresetBandLevelsRoundTrip) {
+    const auto [minLevel, maxLevel] = getBandLevelRange();
+    for (int preset = 0; preset < EqualizerSwContext::kMaxPresetNumber; preset++) {
+        SCOPED_TRACE(testing::Message() << "preset " << preset);
+        ASSERT_TRUE(setEqualizer(Equalizer::make<Equalizer::preset>(preset)).isOk());
+        const auto bandLevels = getBandLevels();
+        ASSERT_EQ(static_cast<size_t>(EqualizerSwContext::kMaxBandNumber), bandLevels.size());
+        for (const auto& bandLevel : bandLevels) {
+            EXPECT_GE(bandLevel.levelMb, minLevel) << bandLevel.toString();
+            EXPECT_LE(bandLevel.levelMb, maxLevel) << bandLevel.toString();
+        }
+
+        // Flatten the bands, then set the levels of the preset back.
+        std::vector<Equalizer::BandLevel> flat = bandLevels;
+        for (auto& bandLevel : flat) {
+            bandLevel.levelMb = 0;
+        }
+        ASSERT_TRUE(setEqualizer(Equalizer::make<Equalizer::bandLevels>(flat)).isOk());
+        ASSERT_EQ(flat, getBandLevels());
+        ASSERT_TRUE(setEqualizer(Equalizer::make<Equalizer::bandLevels>(bandLevels)).isOk());
+        EXPECT_EQ(bandLevels, getBandLevels());
+    }
+}
+
+TEST_F(EqualizerSwTest, RejectsBandLevelsOutOfRange) {
+    const auto [minLevel, maxLevel] = getBandLevelRange();
+    const auto bandLevels = getBandLevels();
+    for (int levelMb : {maxLevel + 1, minLevel - 1}) {
+        const Equalizer::BandLevel bandLevel({.index = 0, .levelMb = levelMb});
+        EXPECT_FALSE(setEqualizer(Equalizer::make<Equalizer::bandLevels>({bandLevel})).isOk())
+                << bandLevel.toString();
+    }
+    EXPECT_EQ(bandLevels, getBandLevels());
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "SpatializerSwEngine.h"
+
+using aidl::android::hardware::audio::effect::SpatializerSwEngine;
+using aidl::android::media::audio::common::AudioChannelLayout;
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr size_t kBlockFrames = SpatializerSwEngine::kBlockFrames;
+// Sentinel of the output samples which must not be written.
+constexpr float kUnwritten = 42.f;
+
+AudioChannelLayout makeLayout(int32_t layout) {
+    return AudioChannelLayout::make<AudioChannelLayout::layoutMask>(layout);
+}
+
+size_t getChannelCount(int32_t layout) {
+    return std::popcount(static_cast<uint32_t>(layout));
+}
+
+// Deterministic noise in [-0.5, 0.5).
+std::vector<float> makeNoise(size_t samples) {
+    std::vector<float> noise(samples);
+    uint32_t state = 1;
+    for (auto& sample : noise) {
+        state = state * 1664525 + 1013904223;
+        sample = static_cast<float>(state >> 8) / (1 << 24) - 0.5f;
+    }
+    return noise;
+}
+
+// Processes in buffers of varying sizes, none a multiple of the block size.
+std::vector<float> processInChunks(SpatializerSwEngine& engine, const std::vector<float>& in,
+                                   size_t frames, size_t outputChannelCount) {
+    const size_t inputChannelCount = in.size() / frames;
+    std::vector<float> out(frames * outputChannelCount);
+    size_t chunk = 37;
+    for (size_t frame = 0; frame < frames; frame += chunk, chunk = chunk * 7 % 101 + 1) {
+        const size_t count = std::min(chunk, frames - frame);
+        engine.process(&in[frame * inputChannelCount], &out[frame * outputChannelCount], count);
+    }
+    return out;
+}
+
+}  // namespace
+
+TEST(SpatializerSwEngineTest, WritesOutputFramesOfOutputChannelCount) {
+    for (int32_t layout : {AudioChannelLayout::LAYOUT_5POINT1, AudioChannelLayout::LAYOUT_7POINT1,
+                           AudioChannelLayout::LAYOUT_7POINT1POINT4}) {
+        for (size_t outputChannelCount : {2, 4, 6}) {
+            SCOPED_TRACE(testing::Message() << "layout " << layout << " output channels "
+                                            << outputChannelCount);
+            SpatializerSwEngine engine(kSampleRate, makeLayout(layout), outputChannelCount);
+            ASSERT_EQ(getChannelCount(layout), engine.getInputChannelCount());
+            constexpr size_t kFrames = 5 * kBlockFrames + 13;
+            const std::vector<float> in = makeNoise(kFrames * engine.getInputChannelCount());
+            // One more frame than processed, to catch an overrun.
+            std::vector<float> out((kFrames + 1) * outputChannelCount, kUnwritten);
+            engine.process(in.data(), out.data(), kFrames);
+
+            bool rendered = false;
+            for (size_t i = 0; i < kFrames; i++) {
+                for (size_t c = 0; c < outputChannelCount; c++) {
+                    const float sample = out[i * outputChannelCount + c];
+                    ASSERT_NE(kUnwritten, sample) << "frame " << i << " channel " << c;
+                    if (c >= 2) {
+                        ASSERT_EQ(0.f, sample) << "frame " << i << " channel " << c;
+                    } else {
+                        rendered |= sample != 0.f;
+                    }
+                }
+            }
+            EXPECT_TRUE(rendered);
+            for (size_t c = 0; c < outputChannelCount; c++) {
+                EXPECT_EQ(kUnwritten, out[kFrames * outputChannelCount + c]) << "channel " << c;
+            }
+        }
+    }
+}
+
+TEST(SpatializerSwEngineTest, DelaysOutputByOneBlock) {
+    const int32_t layout = AudioChannelLayout::LAYOUT_5POINT1;
+    SpatializerSwEngine engine(kSampleRate, makeLayout(layout), 2);
+    const size_t channelCount = engine.getInputChannelCount();
+    constexpr size_t kFrames = 4 * kBlockFrames;
+    // An impulse on every channel in the first frame.
+    std::vector<float> in(kFrames * channelCount, 0.f);
+    std::fill_n(in.begin(), channelCount, 0.5f);
+    std::vector<float> out(kFrames * 2);
+    engine.process(in.data(), out.data(), kFrames);
+    for (size_t i = 0; i < 2 * kBlockFrames; i++) ASSERT_EQ(0.f, out[i]) << "sample " << i;
+    EXPECT_NE(0.f, out[2 * kBlockFrames]);
+    EXPECT_NE(0.f, out[2 * kBlockFrames + 1]);
+}
+
+TEST(SpatializerSwEngineTest, MixesLfeToBothEars) {
+    const int32_t layout = AudioChannelLayout::LAYOUT_5POINT1;
+    SpatializerSwEngine engine(kSampleRate, makeLayout(layout), 2);
+    const size_t channelCount = engine.getInputChannelCount();
+    // FL, FR, FC, LFE, BL, BR
+    constexpr size_t kLfe = 3;
+    constexpr size_t kFrames = 3 * kBlockFrames;
+    std::vector<float> in(kFrames * channelCount, 0.f);
+    in[kLfe] = 0.5f;
+    std::vector<float> out(kFrames * 2);
+    engine.process(in.data(), out.data(), kFrames);
+    for (size_t i = 0; i < kFrames; i++) {
+        const float expected = i == kBlockFrames ? 0.5f * 0.70710678f : 0.f;
+        ASSERT_NEAR(expected, out[2 * i], 1e-6) << "frame " << i;
+        ASSERT_NEAR(expected, out[2 * i + 1], 1e-6) << "frame " << i;
+    }
+}
+
+TEST(SpatializerSwEngineTest, RendersLeftSpeakerLouderInLeftEar) {
+    const int32_t layout = AudioChannelLayout::LAYOUT_7POINT1POINT4;
+    SpatializerSwEngine engine(kSampleRate, makeLayout(layout), 2);
+    const size_t channelCount = engine.getInputChannelCount();
+    constexpr size_t kFrames = SpatializerSwEngine::kHrirFrames + 2 * kBlockFrames;
+    std::vector<float> in(kFrames * channelCount, 0.f);
+    in[0] = 1.f;  // FL
+    std::vector<float> out(kFrames * 2);
+    engine.process(in.data(), out.data(), kFrames);
+    float left = 0.f;
+    float right = 0.f;
+    for (size_t i = 0; i < kFrames; i++) {
+        left += out[2 * i] * out[2 * i];
+        right += out[2 * i + 1] * out[2 * i + 1];
+    }
+    EXPECT_GT(left, right);
+    EXPECT_GT(right, 0.f);
+}
+
+TEST(SpatializerSwEngineTest, OutputDoesNotDependOnBufferSize) {
+    for (int32_t layout : {AudioChannelLayout::LAYOUT_5POINT1,
+                           AudioChannelLayout::LAYOUT_7POINT1POINT4}) {
+        SCOPED_TRACE(testing::Message() << "layout " << layout);
+        constexpr size_t kFrames = 2000;
+        const std::vector<float> in = makeNoise(kFrames * getChannelCount(layout));
+        SpatializerSwEngine whole(kSampleRate, makeLayout(layout), 2);
+        std::vector<float> expected(kFrames * 2);
+        whole.process(in.data(), expected.data(), kFrames);
+        SpatializerSwEngine chunked(kSampleRate, makeLayout(layout), 2);
+        EXPECT_EQ(expected, processInChunks(chunked, in, kFrames, 2));
+    }
+}
+
+TEST(SpatializerSwEngineTest, ProcessesInPlace) {
+    const int32_t layout = AudioChannelLayout::LAYOUT_7POINT1;
+    constexpr size_t kFrames = 1000;
+    const std::vector<float> in = makeNoise(kFrames * getChannelCount(layout));
+    SpatializerSwEngine engine(kSampleRate, makeLayout(layout), 2);
+    const std::vector<float> expected = processInChunks(engine, in, kFrames, 2);
+
+    SpatializerSwEngine inPlace(kSampleRate, makeLayout(layout), 2);
+    std::vector<float> buffer = in;
+    inPlace.process(buffer.data(), buffer.data(), kFrames);
+    buffer.resize(kFrames * 2);
+    EXPECT_EQ(expected, buffer);
+}
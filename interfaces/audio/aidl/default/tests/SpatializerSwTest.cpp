@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <gtest/gtest.h>
+#define LOG_TAG "SpatializerSwTest"
+
+#include "SpatializerSw.h"
+
+using aidl::android::hardware::audio::effect::IEffect;
+using aidl::android::hardware::audio::effect::Parameter;
+using aidl::android::hardware::audio::effect::SpatializerSw;
+using aidl::android::hardware::audio::effect::SpatializerSwContext;
+using aidl::android::media::audio::common::AudioChannelLayout;
+using aidl::android::media::audio::common::AudioFormatDescription;
+using aidl::android::media::audio::common::AudioFormatType;
+using aidl::android::media::audio::common::PcmType;
+
+namespace {
+
+constexpr int kFrameCount = 0x100;
+
+Parameter::Common makeCommon(int32_t inputLayout, int32_t outputLayout) {
+    Parameter::Common common;
+    for (auto* config : {&common.input, &common.output}) {
+        config->base.sampleRate = 48000;
+        config->base.format =
+                AudioFormatDescription{.type = AudioFormatType::PCM, .pcm = PcmType::FLOAT_32_BIT};
+        config->frameCount = kFrameCount;
+    }
+    common.input.base.channelMask =
+            AudioChannelLayout::make<AudioChannelLayout::layoutMask>(inputLayout);
+    common.output.base.channelMask =
+            AudioChannelLayout::make<AudioChannelLayout::layoutMask>(outputLayout);
+    return common;
+}
+
+ndk::ScopedAStatus open(int32_t inputLayout) {
+    auto effect = ndk::SharedRefBase::make<SpatializerSw>();
+    IEffect::OpenEffectReturn ret;
+    ndk::ScopedAStatus status = effect->open(
+            makeCommon(inputLayout, AudioChannelLayout::LAYOUT_STEREO), std::nullopt, &ret);
+    effect->close();
+    return status;
+}
+
+}  // namespace
+
+TEST(SpatializerSwTest, OpensSupportedLayouts) {
+    for (int32_t layout : {AudioChannelLayout::LAYOUT_5POINT1, AudioChannelLayout::LAYOUT_7POINT1,
+                           AudioChannelLayout::LAYOUT_7POINT1POINT4}) {
+        EXPECT_TRUE(open(layout).isOk()) << "layout " << layout;
+    }
+}
+
+TEST(SpatializerSwTest, RejectsUnsupportedLayouts) {
+    for (int32_t layout :
+         {AudioChannelLayout::LAYOUT_MONO, AudioChannelLayout::LAYOUT_STEREO,
+          AudioChannelLayout::LAYOUT_QUAD, AudioChannelLayout::LAYOUT_5POINT1POINT2,
+          AudioChannelLayout::LAYOUT_9POINT1POINT6}) {
+        EXPECT_FALSE(open(layout).isOk()) << "layout " << layout;
+    }
+}
+
+TEST(SpatializerSwTest, ProcessReturnsSampleCounts) {
+    for (int32_t outputLayout :
+         {AudioChannelLayout::LAYOUT_STEREO, AudioChannelLayout::LAYOUT_QUAD}) {
+        SCOPED_TRACE(testing::Message() << "output layout " << outputLayout);
+        SpatializerSwContext context(1 /* statusDepth */,
+                                     makeCommon(AudioChannelLayout::LAYOUT_5POINT1, outputLayout));
+        const size_t outputChannelCount = context.getOutputFrameSize() / sizeof(float);
+        std::vector<float> in(kFrameCount * 6, 0.25f);
+        std::vector<float> out(kFrameCount * outputChannelCount);
+        const IEffect::Status status = context.process(in.data(), out.data(), in.size());
+        EXPECT_EQ(STATUS_OK, status.status);
+        EXPECT_EQ(static_cast<int32_t>(in.size()), status.fmqConsumed);
+        EXPECT_EQ(static_cast<int32_t>(out.size()), status.fmqProduced);
+    }
+}
+
+TEST(SpatializerSwTest, ProcessFailsWithMonoOutput) {
+    SpatializerSwContext context(1 /* statusDepth */,
+                                 makeCommon(AudioChannelLayout::LAYOUT_5POINT1,
+                                            AudioChannelLayout::LAYOUT_MONO));
+    std::vector<float> in(kFrameCount * 6, 0.25f);
+    std::vector<float> out(kFrameCount);
+    const IEffect::Status status = context.process(in.data(), out.data(), in.size());
+    EXPECT_EQ(EX_ILLEGAL_ARGUMENT, status.status);
+    EXPECT_EQ(0, status.fmqConsumed);
+    EXPECT_EQ(0, status.fmqProduced);
+}
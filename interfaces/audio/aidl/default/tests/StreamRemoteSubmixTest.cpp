@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <Utils.h>
+#include <gtest/gtest.h>
+#define LOG_TAG "StreamRemoteSubmixTest"
+
+#include "core-impl/StreamRemoteSubmix.h"
+#include "core-impl/StreamSwitcher.h"
+
+using aidl::android::hardware::audio::common::getFrameSizeInBytes;
+using aidl::android::hardware::audio::common::SourceMetadata;
+using aidl::android::hardware::audio::core::InnerStreamWrapper;
+using aidl::android::hardware::audio::core::StreamContext;
+using aidl::android::hardware::audio::core::StreamRemoteSubmix;
+using aidl::android::hardware::audio::core::r_submix::AudioConfig;
+using aidl::android::hardware::audio::core::r_submix::SubmixRoute;
+using aidl::android::media::audio::common::AudioChannelLayout;
+using aidl::android::media::audio::common::AudioDeviceAddress;
+using aidl::android::media::audio::common::AudioFormatDescription;
+using aidl::android::media::audio::common::AudioFormatType;
+using aidl::android::media::audio::common::AudioIoFlags;
+using aidl::android::media::audio::common::PcmType;
+
+namespace {
+
+const AudioFormatDescription kFormat{.type = AudioFormatType::PCM, .pcm = PcmType::FLOAT_32_BIT};
+const AudioChannelLayout kChannelLayout =
+        AudioChannelLayout::make<AudioChannelLayout::layoutMask>(AudioChannelLayout::LAYOUT_STEREO);
+constexpr int kPipeSampleRate = 48000;
+
+AudioConfig makePipeConfig() {
+    AudioConfig config;
+    config.sampleRate = kPipeSampleRate;
+    config.format = kFormat;
+    config.channelLayout = kChannelLayout;
+    config.frameSize = getFrameSizeInBytes(kFormat, kChannelLayout);
+    return config;
+}
+
+StreamContext makeOutputContext(int sampleRate, size_t bufferSizeFrames) {
+    const size_t frameSize = getFrameSizeInBytes(kFormat, kChannelLayout);
+    return StreamContext(nullptr /*commandMQ*/, nullptr /*replyMQ*/, kFormat, kChannelLayout,
+                         sampleRate, AudioIoFlags::make<AudioIoFlags::output>(0),
+                         0 /*nominalLatencyMs*/, 0 /*mixPortHandle*/,
+                         std::make_unique<StreamContext::DataMQ>(frameSize * bufferSizeFrames),
+                         nullptr /*asyncCallback*/, nullptr /*outEventCallback*/,
+                         {} /*streamDataProcessor*/, {} /*debugParameters*/);
+}
+
+}  // namespace
+
+TEST(StreamRemoteSubmixTest, WritesAllResampledFrames) {
+    const auto address = AudioDeviceAddress::make<AudioDeviceAddress::id>("resampled_write");
+    // The pipe is created at its rate first, the output stream then resamples to it.
+    std::shared_ptr<SubmixRoute> route = SubmixRoute::findOrCreateRoute(address, makePipeConfig());
+    ASSERT_NE(nullptr, route);
+    const size_t pipeFrames = route->getPipeConfig().frameCount;
+
+    // Once resampled, a buffer as long as the pipe no longer fits in it. Without a reader, the
+    // pipe is written partially, then flushed to make room for the rest.
+    const size_t frameCount = pipeFrames;
+    StreamContext context = makeOutputContext(44100, frameCount);
+    InnerStreamWrapper<StreamRemoteSubmix> stream(&context, SourceMetadata{}, address);
+    ASSERT_EQ(::android::OK, stream.init());
+    std::vector<float> buffer(frameCount * 2, 0.25f);
+    size_t actualFrameCount = 0;
+    int32_t latencyMs = 0;
+    ASSERT_EQ(::android::OK,
+              stream.transfer(buffer.data(), frameCount, &actualFrameCount, &latencyMs));
+    EXPECT_EQ(frameCount, actualFrameCount);
+    EXPECT_EQ(static_cast<ssize_t>(pipeFrames), route->getSource()->availableToRead());
+
+    stream.shutdown();
+    EXPECT_TRUE(stream.close().isOk());
+    SubmixRoute::removeRoute(address);
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <numbers>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "VisualizerSwEngine.h"
+
+using aidl::android::hardware::audio::effect::Visualizer;
+using aidl::android::hardware::audio::effect::VisualizerSwEngine;
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr size_t kCaptureSize = VisualizerSwEngine::kMaxCaptureSize;
+
+// Interleaved frames with the same value on every channel.
+std::vector<float> makeConstant(size_t frames, size_t channelCount, float value) {
+    return std::vector<float>(frames * channelCount, value);
+}
+
+// Interleaved frames of a sine wave of the frequency of bin `bin` of a kCaptureSize FFT.
+std::vector<float> makeSine(size_t frames, size_t channelCount, size_t bin, float amplitude) {
+    std::vector<float> sine(frames * channelCount);
+    for (size_t i = 0; i < frames; i++) {
+        const float value = amplitude * std::sin(2 * std::numbers::pi * bin * i / kCaptureSize);
+        for (size_t c = 0; c < channelCount; c++) sine[i * channelCount + c] = value;
+    }
+    return sine;
+}
+
+void process(VisualizerSwEngine& engine, std::vector<float> buffer, size_t channelCount) {
+    engine.process(buffer.data(), buffer.data(), buffer.size() / channelCount);
+}
+
+}  // namespace
+
+TEST(VisualizerSwEngineTest, PassesAudioThrough) {
+    VisualizerSwEngine engine(kSampleRate, 2);
+    const std::vector<float> in = makeSine(480, 2, 10, 0.8f);
+    std::vector<float> out(in.size());
+    engine.process(in.data(), out.data(), 480);
+    EXPECT_EQ(in, out);
+}
+
+TEST(VisualizerSwEngineTest, CapturesSilenceBeforeProcessing) {
+    VisualizerSwEngine engine(kSampleRate, 2);
+    engine.setCaptureSize(kCaptureSize);
+    const std::vector<uint8_t> waveform = engine.captureWaveform();
+    ASSERT_EQ(kCaptureSize, waveform.size());
+    for (uint8_t sample : waveform) ASSERT_EQ(128, sample);
+    const Visualizer::Measurement measurement = engine.getMeasurement();
+    EXPECT_EQ(VisualizerSwEngine::kMinLevelMb, measurement.peak);
+    EXPECT_EQ(VisualizerSwEngine::kMinLevelMb, measurement.rms);
+}
+
+TEST(VisualizerSwEngineTest, CapturesMonoDownmixAsPlayed) {
+    VisualizerSwEngine engine(kSampleRate, 2);
+    engine.setCaptureSize(kCaptureSize);
+    engine.setScalingMode(Visualizer::ScalingMode::AS_PLAYED);
+    // Left and right average to 0.25.
+    std::vector<float> buffer(kCaptureSize * 2);
+    for (size_t i = 0; i < buffer.size(); i += 2) {
+        buffer[i] = 0.75f;
+        buffer[i + 1] = -0.25f;
+    }
+    process(engine, buffer, 2);
+    for (uint8_t sample : engine.captureWaveform()) ASSERT_EQ(160, sample);
+}
+
+TEST(VisualizerSwEngineTest, NormalizesCapture) {
+    VisualizerSwEngine engine(kSampleRate, 1);
+    engine.setCaptureSize(kCaptureSize);
+    engine.setScalingMode(Visualizer::ScalingMode::NORMALIZED);
+    process(engine, makeConstant(kCaptureSize, 1, -0.125f), 1);
+    for (uint8_t sample : engine.captureWaveform()) ASSERT_EQ(0, sample);
+}
+
+TEST(VisualizerSwEngineTest, CapturesTheLastFrames) {
+    VisualizerSwEngine engine(kSampleRate, 2);
+    engine.setCaptureSize(kCaptureSize);
+    engine.setScalingMode(Visualizer::ScalingMode::AS_PLAYED);
+    // More than the capture ring, in buffers of a size unrelated to the ring or the SIMD width.
+    process(engine, makeConstant(4 * kSampleRate, 2, 0.f), 2);
+    const std::vector<float> last = makeConstant(kCaptureSize, 2, 0.5f);
+    for (size_t frame = 0; frame < kCaptureSize; frame += 7) {
+        const size_t frames = std::min<size_t>(7, kCaptureSize - frame);
+        engine.process(&last[frame * 2], std::vector<float>(frames * 2).data(), frames);
+    }
+    for (uint8_t sample : engine.captureWaveform()) ASSERT_EQ(192, sample);
+}
+
+TEST(VisualizerSwEngineTest, DelaysCaptureByLatency) {
+    VisualizerSwEngine engine(kSampleRate, 1);
+    engine.setCaptureSize(kCaptureSize);
+    engine.setScalingMode(Visualizer::ScalingMode::AS_PLAYED);
+    engine.setLatencyMs(1000);
+    process(engine, makeConstant(kSampleRate, 1, 0.5f), 1);
+    // The last half second has not been played yet.
+    process(engine, makeConstant(kSampleRate / 2, 1, 0.f), 1);
+    for (uint8_t sample : engine.captureWaveform()) ASSERT_EQ(192, sample);
+    engine.setLatencyMs(0);
+    for (uint8_t sample : engine.captureWaveform()) ASSERT_EQ(128, sample);
+}
+
+TEST(VisualizerSwEngineTest, CapturesWhileProcessing) {
+    VisualizerSwEngine engine(kSampleRate, 1);
+    engine.setCaptureSize(kCaptureSize);
+    engine.setScalingMode(Visualizer::ScalingMode::AS_PLAYED);
+    // Sample n is captured as n % 256, so that a torn capture breaks the sequence.
+    uint64_t n = 0;
+    auto processRamp = [&engine, &n](size_t frames) {
+        std::vector<float> buffer(frames);
+        for (float& sample : buffer) sample = (static_cast<int>(n++ % 256) - 128) / 128.f;
+        engine.process(buffer.data(), buffer.data(), frames);
+    };
+    processRamp(kCaptureSize);
+
+    std::atomic<bool> stop = false;
+    std::thread worker([&] {
+        while (!stop) processRamp(240);
+    });
+    for (int i = 0; i < 1000; i++) {
+        const std::vector<uint8_t> waveform = engine.captureWaveform();
+        ASSERT_EQ(kCaptureSize, waveform.size());
+        // A capture overwritten while it was copied is silence.
+        if (std::all_of(waveform.begin(), waveform.end(), [](uint8_t s) { return s == 128; })) {
+            continue;
+        }
+        for (size_t j = 1; j < waveform.size(); j++) {
+            ASSERT_EQ(static_cast<uint8_t>(waveform[j - 1] + 1), waveform[j]) << j;
+        }
+    }
+    stop = true;
+    worker.join();
+}
+
+TEST(VisualizerSwEngineTest, FftOfSine) {
+    constexpr size_t kBin = 37;
+    VisualizerSwEngine engine(kSampleRate, 2);
+    engine.setCaptureSize(kCaptureSize);
+    engine.setScalingMode(Visualizer::ScalingMode::AS_PLAYED);
+    process(engine, makeSine(kCaptureSize, 2, kBin, 1.f), 2);
+    const std::vector<int8_t> fft = engine.captureFft();
+    ASSERT_EQ(kCaptureSize, fft.size());
+    for (size_t k = 1; k < kCaptureSize / 2; k++) {
+        const float magnitude = std::hypot(fft[2 * k], fft[2 * k + 1]);
+        if (k == kBin) {
+            EXPECT_NEAR(127, magnitude, 2) << "bin " << k;
+        } else {
+            EXPECT_LE(magnitude, 2) << "bin " << k;
+        }
+    }
+    EXPECT_LE(std::abs(fft[0]), 1);
+    EXPECT_LE(std::abs(fft[1]), 1);
+}
+
+TEST(VisualizerSwEngineTest, MeasuresPeakAndRms) {
+    VisualizerSwEngine engine(kSampleRate, 2);
+    // A full window of a sine of amplitude 0.5: -6dB peak, -9dB RMS. The sine period divides the
+    // measurement block so that the RMS is exact.
+    const size_t frames = VisualizerSwEngine::kMeasurementWindowBlocks *
+                          VisualizerSwEngine::kMeasurementBlockMs * kSampleRate / 1000;
+    std::vector<float> buffer(frames * 2);
+    for (size_t i = 0; i < frames; i++) {
+        buffer[2 * i] = buffer[2 * i + 1] = 0.5f * std::sin(2 * std::numbers::pi * i / 48);
+    }
+    // In buffers which do not end on block boundaries.
+    for (size_t frame = 0; frame < frames; frame += 333) {
+        const size_t count = std::min<size_t>(333, frames - frame);
+        engine.process(&buffer[2 * frame], std::vector<float>(2 * count).data(), count);
+    }
+    const Visualizer::Measurement measurement = engine.getMeasurement();
+    EXPECT_NEAR(-602, measurement.peak, 5);
+    EXPECT_NEAR(-903, measurement.rms, 5);
+}
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #define LOG_TAG "AHAL_VisualizerSw"
 
 #include <android-base/logging.h>
@@ -56,6 +58,26 @@ extern "C" binder_exception_t queryEffect(const AudioUuid* in_impl_uuid, Descrip
 
 namespace aidl::android::hardware::audio::effect {
 
+namespace {
+
+// Silence, with the unsigned 8 bit PCM of the capture, when the effect is bypassed.
+std::vector<uint8_t> captureSampleBuffer(const VisualizerSwEngine* engine, int captureSize) {
+    return engine ? engine->captureWaveform() : std::vector<uint8_t>(captureSize, 0x80);
+}
+
+Visualizer::Measurement measure(const VisualizerSwEngine* engine,
+                                Visualizer::MeasurementMode measurementMode) {
+    if (measurementMode != Visualizer::MeasurementMode::PEAK_RMS) {
+        return {};
+    }
+    if (!engine) {
+        return {.rms = VisualizerSwEngine::kMinLevelMb, .peak = VisualizerSwEngine::kMinLevelMb};
+    }
+    return engine->getMeasurement();
+}
+
+}  // namespace
+
 const std::string VisualizerSw::kEffectName = "VisualizerSw";
 
 /* capabilities */
@@ -84,6 +106,45 @@ ndk::ScopedAStatus VisualizerSw::getDescriptor(Descriptor* _aidl_return) {
     return ndk::ScopedAStatus::ok();
 }
 
+ndk::ScopedAStatus VisualizerSw::getParameter(const Parameter::Id& id, Parameter* param) {
+    if (id.getTag() == Parameter::Id::visualizerTag) {
+        const auto& vsId = id.get<Parameter::Id::visualizerTag>();
+        if (vsId.getTag() == Visualizer::Id::commonTag) {
+            const auto tag = vsId.get<Visualizer::Id::commonTag>();
+            if (tag == Visualizer::captureSampleBuffer || tag == Visualizer::measurement) {
+                return getSnapshot(tag, param);
+            }
+        }
+    }
+    return EffectImpl::getParameter(id, param);
+}
+
+// Captures and measurements are polled by the client at the display rate. mImplMutex is only held
+// to get the engine, the snapshot itself is taken without making the effect worker wait.
+ndk::ScopedAStatus VisualizerSw::getSnapshot(const Visualizer::Tag& tag, Parameter* param) {
+    std::shared_ptr<const VisualizerSwEngine> engine;
+    int captureSize;
+    Visualizer::MeasurementMode measurementMode;
+    {
+        std::lock_guard lg(mImplMutex);
+        RETURN_IF(!mContext, EX_NULL_POINTER, "nullContext");
+        engine = mContext->getEngine();
+        captureSize = mContext->getVsCaptureSize();
+        measurementMode = mContext->getVsMeasurementMode();
+    }
+
+    Visualizer vsParam;
+    if (tag == Visualizer::captureSampleBuffer) {
+        vsParam.set<Visualizer::captureSampleBuffer>(
+                captureSampleBuffer(engine.get(), captureSize));
+    } else {
+        vsParam.set<Visualizer::measurement>(measure(engine.get(), measurementMode));
+    }
+    param->set<Parameter::specific>(
+            Parameter::Specific::make<Parameter::Specific::visualizer>(vsParam));
+    return ndk::ScopedAStatus::ok();
+}
+
 ndk::ScopedAStatus VisualizerSw::setParameterSpecific(const Parameter::Specific& specific) {
     RETURN_IF(Parameter::Specific::visualizer != specific.getTag(), EX_ILLEGAL_ARGUMENT,
               "EffectNotSupported");
@@ -199,21 +260,27 @@ RetCode VisualizerSw::releaseContext() {
 
 // Processing method running in EffectWorker thread.
 IEffect::Status VisualizerSw::effectProcessImpl(float* in, float* out, int samples) {
-    // TODO: get data buffer and process.
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
-    for (int i = 0; i < samples; i++) {
-        *out++ = *in++;
+    RETURN_VALUE_IF(!mContext, (IEffect::Status{EX_NULL_POINTER, 0, 0}), "nullContext");
+    return mContext->process(in, out, samples);
+}
+
+RetCode VisualizerSwContext::setCommon(const Parameter::Common& common) {
+    if (auto ret = EffectContext::setCommon(common); ret != RetCode::SUCCESS) {
+        return ret;
     }
-    return {STATUS_OK, samples, samples};
+    createEngine();
+    return RetCode::SUCCESS;
 }
 
 RetCode VisualizerSwContext::setVsCaptureSize(int captureSize) {
     mCaptureSize = captureSize;
+    if (mEngine) mEngine->setCaptureSize(mCaptureSize);
     return RetCode::SUCCESS;
 }
 
 RetCode VisualizerSwContext::setVsScalingMode(Visualizer::ScalingMode scalingMode) {
     mScalingMode = scalingMode;
+    if (mEngine) mEngine->setScalingMode(mScalingMode);
     return RetCode::SUCCESS;
 }
 
@@ -224,7 +291,40 @@ RetCode VisualizerSwContext::setVsMeasurementMode(Visualizer::MeasurementMode me
 
 RetCode VisualizerSwContext::setVsLatency(int latency) {
     mLatency = latency;
+    if (mEngine) mEngine->setLatencyMs(mLatency);
     return RetCode::SUCCESS;
 }
 
+Visualizer::Measurement VisualizerSwContext::getVsMeasurement() const {
+    return measure(mEngine.get(), mMeasurementMode);
+}
+
+std::vector<uint8_t> VisualizerSwContext::getVsCaptureSampleBuffer() const {
+    return captureSampleBuffer(mEngine.get(), mCaptureSize);
+}
+
+void VisualizerSwContext::createEngine() {
+    const int sampleRate = mCommon.input.base.sampleRate;
+    if (sampleRate <= 0 || mInputChannelCount == 0 || mInputChannelCount != mOutputChannelCount) {
+        LOG(WARNING) << __func__ << " unsupported config, bypass: " << mCommon.toString();
+        mEngine.reset();
+        return;
+    }
+    // A new engine rather than a reset of the current one, which snapshots may still be reading.
+    mEngine = std::make_shared<VisualizerSwEngine>(sampleRate, mInputChannelCount);
+    mEngine->setCaptureSize(mCaptureSize);
+    mEngine->setScalingMode(mScalingMode);
+    mEngine->setLatencyMs(mLatency);
+}
+
+IEffect::Status VisualizerSwContext::process(float* in, float* out, int samples) {
+    if (!mEngine) {
+        // bypass
+        if (in != out) std::copy(in, in + samples, out);
+        return {STATUS_OK, samples, samples};
+    }
+    mEngine->process(in, out, samples / mInputChannelCount);
+    return {STATUS_OK, samples, samples};
+}
+
 }  // namespace aidl::android::hardware::audio::effect
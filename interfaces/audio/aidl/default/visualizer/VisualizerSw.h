@@ -16,28 +16,30 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <aidl/android/hardware/audio/effect/BnEffect.h>
 #include <system/audio_effects/effect_visualizer.h>
+
+#include "VisualizerSwEngine.h"
 #include "effect-impl/EffectImpl.h"
 
 namespace aidl::android::hardware::audio::effect {
 
 class VisualizerSwContext final : public EffectContext {
   public:
-    // need align the min/max capture size to VISUALIZER_CAPTURE_SIZE_MIN and
-    // VISUALIZER_CAPTURE_SIZE_MAX because of limitation in audio_utils fixedfft.
-    static constexpr int32_t kMinCaptureSize = VISUALIZER_CAPTURE_SIZE_MIN;
-    static constexpr int32_t kMaxCaptureSize = VISUALIZER_CAPTURE_SIZE_MAX;
-    static constexpr int32_t kMaxLatencyMs = 3000;
+    static constexpr int32_t kMinCaptureSize = VisualizerSwEngine::kMinCaptureSize;
+    static constexpr int32_t kMaxCaptureSize = VisualizerSwEngine::kMaxCaptureSize;
+    static constexpr int32_t kMaxLatencyMs = VisualizerSwEngine::kMaxLatencyMs;
     VisualizerSwContext(int statusDepth, const Parameter::Common& common)
         : EffectContext(statusDepth, common) {
         LOG(DEBUG) << __func__;
-        mCaptureSampleBuffer.resize(kMaxCaptureSize);
-        fill(mCaptureSampleBuffer.begin(), mCaptureSampleBuffer.end(), 0x80);
+        createEngine();
     }
 
+    RetCode setCommon(const Parameter::Common& common) override;
+
     RetCode setVsCaptureSize(int captureSize);
     int getVsCaptureSize() const { return mCaptureSize; }
 
@@ -50,16 +52,25 @@ class VisualizerSwContext final : public EffectContext {
     RetCode setVsLatency(int latency);
     int getVsLatency() const { return mLatency; }
 
-    Visualizer::Measurement getVsMeasurement() const { return mMeasurement; }
-    std::vector<uint8_t> getVsCaptureSampleBuffer() const { return mCaptureSampleBuffer; }
+    Visualizer::Measurement getVsMeasurement() const;
+    std::vector<uint8_t> getVsCaptureSampleBuffer() const;
+
+    /**
+     * The engine, for captures and measurements outside of the effect lock. The context may
+     * replace its engine on a config change, a reader keeps the previous one alive.
+     */
+    std::shared_ptr<const VisualizerSwEngine> getEngine() const { return mEngine; }
+
+    IEffect::Status process(float* in, float* out, int samples);
 
   private:
+    void createEngine();
+
     int mCaptureSize = kMaxCaptureSize;
     Visualizer::ScalingMode mScalingMode = Visualizer::ScalingMode::NORMALIZED;
     Visualizer::MeasurementMode mMeasurementMode = Visualizer::MeasurementMode::NONE;
     int mLatency = 0;
-    const Visualizer::Measurement mMeasurement = {0, 0};
-    std::vector<uint8_t> mCaptureSampleBuffer;
+    std::shared_ptr<VisualizerSwEngine> mEngine;
 };
 
 class VisualizerSw final : public EffectImpl {
@@ -74,6 +85,7 @@ class VisualizerSw final : public EffectImpl {
     }
 
     ndk::ScopedAStatus getDescriptor(Descriptor* _aidl_return) override;
+    ndk::ScopedAStatus getParameter(const Parameter::Id& id, Parameter* param) override;
     ndk::ScopedAStatus setParameterSpecific(const Parameter::Specific& specific)
             REQUIRES(mImplMutex) override;
     ndk::ScopedAStatus getParameterSpecific(const Parameter::Id& id, Parameter::Specific* specific)
@@ -92,5 +104,6 @@ class VisualizerSw final : public EffectImpl {
     std::shared_ptr<VisualizerSwContext> mContext GUARDED_BY(mImplMutex);
     ndk::ScopedAStatus getParameterVisualizer(const Visualizer::Tag& tag,
                                               Parameter::Specific* specific) REQUIRES(mImplMutex);
+    ndk::ScopedAStatus getSnapshot(const Visualizer::Tag& tag, Parameter* param);
 };
 }  // namespace aidl::android::hardware::audio::effect
@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <Utils.h>
+
+#include "VisualizerSwEngine.h"
+#include "effect-impl/EffectSimd.h"
+
+using aidl::android::hardware::audio::common::frameCountFromDurationMs;
+
+namespace aidl::android::hardware::audio::effect {
+
+namespace {
+
+// A snapshot overwritten while it is copied is retried, which only happens when the reader is
+// preempted for about as long as the capture ring lasts.
+constexpr int kSnapshotAttempts = 3;
+// Below -90dB, NORMALIZED scaling leaves the capture as is rather than amplifying the noise floor.
+constexpr float kMinNormalizedPeak = 1.f / 32768;
+
+size_t captureRingSize(int sampleRate) {
+    const size_t frames = VisualizerSwEngine::kMaxCaptureSize +
+                          frameCountFromDurationMs(VisualizerSwEngine::kMaxLatencyMs, sampleRate);
+    return std::bit_ceil(frames);
+}
+
+// Averages the channels of frames of interleaved audio into dst.
+void downmix(const float* in, std::atomic<float>* dst, size_t frames, size_t channelCount) {
+    switch (channelCount) {
+        case 1:
+            for (size_t i = 0; i < frames; i++) {
+                dst[i].store(in[i], std::memory_order_relaxed);
+            }
+            break;
+        case 2:
+            for (size_t i = 0; i < frames; i++) {
+                dst[i].store(0.5f * (in[2 * i] + in[2 * i + 1]), std::memory_order_relaxed);
+            }
+            break;
+        default: {
+            const float scale = 1.f / channelCount;
+            for (size_t i = 0; i < frames; i++, in += channelCount) {
+                float sum = 0;
+                for (size_t c = 0; c < channelCount; c++) sum += in[c];
+                dst[i].store(sum * scale, std::memory_order_relaxed);
+            }
+            break;
+        }
+    }
+}
+
+// Accumulates the peak and the sum of squares of count samples.
+void accumulateLevels(const float* in, size_t count, float* peak, float* sumSquares) {
+    simd::float4 peak4 = simd::set1(0.f);
+    simd::float4 sum4 = simd::set1(0.f);
+    size_t i = 0;
+    for (; i + simd::kLanes <= count; i += simd::kLanes) {
+        const simd::float4 x = simd::load(in + i);
+        peak4 = simd::max(peak4, simd::abs(x));
+        sum4 = simd::mulAdd(sum4, x, x);
+    }
+    float peaks[simd::kLanes];
+    float sums[simd::kLanes];
+    simd::store(peaks, peak4);
+    simd::store(sums, sum4);
+    float p = *peak;
+    float s = 0;
+    for (size_t lane = 0; lane < simd::kLanes; lane++) {
+        p = std::max(p, peaks[lane]);
+        s += sums[lane];
+    }
+    for (; i < count; i++) {
+        p = std::max(p, std::fabs(in[i]));
+        s += in[i] * in[i];
+    }
+    *peak = p;
+    *sumSquares += s;
+}
+
+int32_t levelToMb(float level) {
+    const float mb = 2000.f * std::log10(std::max(level, 1e-9f));
+    return std::max(VisualizerSwEngine::kMinLevelMb, static_cast<int32_t>(std::lround(mb)));
+}
+
+template <typename T>
+T quantize(float value, float min, float max) {
+    return static_cast<T>(std::lround(std::clamp(value, min, max)));
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+}  // namespace
+
+VisualizerSwEngine::VisualizerSwEngine(int sampleRate, size_t channelCount)
+    : mSampleRate(sampleRate),
+      mChannelCount(channelCount),
+      mCapture(captureRingSize(sampleRate)),
+      mCaptureMask(mCapture.size() - 1),
+      mMeasurementBlockSamples(std::max<size_t>(
+              1, frameCountFromDurationMs(kMeasurementBlockMs, sampleRate) * channelCount)) {
+    for (size_t size = kMinCaptureSize; size <= kMaxCaptureSize; size <<= 1) {
+        mFfts.emplace_back(size);
+    }
+}
+
+void VisualizerSwEngine::setCaptureSize(int captureSize) {
+    mCaptureSize = std::clamp(captureSize, kMinCaptureSize, kMaxCaptureSize);
+}
+
+void VisualizerSwEngine::setScalingMode(Visualizer::ScalingMode scalingMode) {
+    mScalingMode = scalingMode;
+}
+
+void VisualizerSwEngine::setLatencyMs(int latencyMs) {
+    mLatencyMs = std::clamp(latencyMs, 0, kMaxLatencyMs);
+}
+
+void VisualizerSwEngine::process(const float* in, float* out, size_t frames) {
+    const size_t samples = frames * mChannelCount;
+    if (in != out) {
+        memmove(out, in, samples * sizeof(float));
+    }
+    writeCapture(out, frames);
+    measure(out, samples);
+    mLastProcessNs.store(nowNs(), std::memory_order_relaxed);
+}
+
+void VisualizerSwEngine::writeCapture(const float* in, size_t frames) {
+    // Only the last ring size frames can be read back.
+    if (frames > mCapture.size()) {
+        in += (frames - mCapture.size()) * mChannelCount;
+        frames = mCapture.size();
+    }
+    const uint64_t start = mCaptureWritten.load(std::memory_order_relaxed);
+    mCaptureWriting.store(start + frames, std::memory_order_relaxed);
+    // Orders the announcement before the overwrite, pairs with the fence of snapshot().
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t done = 0; done < frames;) {
+        const size_t pos = (start + done) & mCaptureMask;
+        const size_t count = std::min(frames - done, mCapture.size() - pos);
+        downmix(in + done * mChannelCount, &mCapture[pos], count, mChannelCount);
+        done += count;
+    }
+    mCaptureWritten.store(start + frames, std::memory_order_release);
+}
+
+void VisualizerSwEngine::measure(const float* in, size_t samples) {
+    while (samples > 0) {
+        const size_t count = std::min(samples, mMeasurementBlockSamples - mBlockSamples);
+        accumulateLevels(in, count, &mBlockPeak, &mBlockSumSquares);
+        in += count;
+        samples -= count;
+        mBlockSamples += count;
+        if (mBlockSamples < mMeasurementBlockSamples) break;
+
+        // The window of a reader is 6 blocks away from the one overwritten here, a torn read
+        // would only mix two blocks of a level meter anyway.
+        const uint64_t block = mMeasuredBlocks.load(std::memory_order_relaxed);
+        MeasurementBlock& slot = mMeasurements[block % kMeasurementRingBlocks];
+        slot.peak.store(mBlockPeak, std::memory_order_relaxed);
+        slot.sumSquares.store(mBlockSumSquares, std::memory_order_relaxed);
+        mMeasuredBlocks.store(block + 1, std::memory_order_release);
+        mBlockPeak = 0;
+        mBlockSumSquares = 0;
+        mBlockSamples = 0;
+    }
+}
+
+int64_t VisualizerSwEngine::msSinceLastProcess() const {
+    const int64_t lastProcessNs = mLastProcessNs.load(std::memory_order_relaxed);
+    if (lastProcessNs == 0) return std::numeric_limits<int64_t>::max();
+    return (nowNs() - lastProcessNs) / 1000000;
+}
+
+void VisualizerSwEngine::snapshot(float* dst, size_t count) const {
+    const int64_t sinceProcessMs = msSinceLastProcess();
+    if (sinceProcessMs > kMaxStallTimeMs) {
+        std::fill(dst, dst + count, 0.f);
+        return;
+    }
+    // The last processed frame is played after the latency, some of which has already elapsed.
+    const int latencyMs = std::max<int64_t>(0, mLatencyMs.load() - sinceProcessMs);
+    const uint64_t delay = frameCountFromDurationMs(latencyMs, mSampleRate);
+    bool copied = false;
+    for (int attempt = 0; attempt < kSnapshotAttempts && !copied; attempt++) {
+        const uint64_t written = mCaptureWritten.load(std::memory_order_acquire);
+        const uint64_t end = written - std::min(written, delay);
+        const uint64_t start = end - std::min<uint64_t>(end, count);
+        // Silence before the first processed frame.
+        const size_t missing = count - (end - start);
+        std::fill(dst, dst + missing, 0.f);
+        for (uint64_t pos = start; pos < end; pos++) {
+            dst[missing + (pos - start)] =
+                    mCapture[pos & mCaptureMask].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        copied = mCaptureWriting.load(std::memory_order_relaxed) - start <= mCapture.size();
+    }
+    if (!copied) {
+        // Rather than a torn capture.
+        std::fill(dst, dst + count, 0.f);
+        return;
+    }
+
+    if (mScalingMode.load() == Visualizer::ScalingMode::NORMALIZED) {
+        float peak = 0;
+        for (size_t i = 0; i < count; i++) peak = std::max(peak, std::fabs(dst[i]));
+        if (peak > kMinNormalizedPeak) {
+            const float gain = 1.f / peak;
+            for (size_t i = 0; i < count; i++) dst[i] *= gain;
+        }
+    }
+}
+
+std::vector<uint8_t> VisualizerSwEngine::captureWaveform() const {
+    const size_t count = mCaptureSize.load();
+    std::vector<float> samples(count);
+    snapshot(samples.data(), count);
+    std::vector<uint8_t> waveform(count);
+    for (size_t i = 0; i < count; i++) {
+        waveform[i] = quantize<uint8_t>(samples[i] * 128.f + 128.f, 0.f, 255.f);
+    }
+    return waveform;
+}
+
+std::vector<int8_t> VisualizerSwEngine::captureFft() const {
+    const size_t count = mCaptureSize.load();
+    std::vector<float> samples(count);
+    snapshot(samples.data(), count);
+
+    // The most recent samples, if the capture size is not a power of 2.
+    const size_t size = std::bit_floor(count);
+    const RealFft& fft = mFfts[std::countr_zero(size / kMinCaptureSize)];
+    const size_t half = size / 2;
+    std::vector<float> re(fft.getBinCount());
+    std::vector<float> im(fft.getBinCount());
+    fft.forward(samples.data() + count - size, re.data(), im.data());
+
+    // A sine wave of amplitude 1 has a bin of magnitude size / 2.
+    const float scale = 127.f / half;
+    std::vector<int8_t> spectrum(size);
+    spectrum[0] = quantize<int8_t>(re[0] * scale, -128.f, 127.f);
+    spectrum[1] = quantize<int8_t>(re[half] * scale, -128.f, 127.f);
+    for (size_t k = 1; k < half; k++) {
+        spectrum[2 * k] = quantize<int8_t>(re[k] * scale, -128.f, 127.f);
+        spectrum[2 * k + 1] = quantize<int8_t>(im[k] * scale, -128.f, 127.f);
+    }
+    return spectrum;
+}
+
+Visualizer::Measurement VisualizerSwEngine::getMeasurement() const {
+    const Visualizer::Measurement silence = {.rms = kMinLevelMb, .peak = kMinLevelMb};
+    if (msSinceLastProcess() > kDiscardMeasurementsTimeMs) return silence;
+    const uint64_t blocks = mMeasuredBlocks.load(std::memory_order_acquire);
+    const uint64_t count = std::min<uint64_t>(blocks, kMeasurementWindowBlocks);
+    if (count == 0) return silence;
+
+    float peak = 0;
+    float sumSquares = 0;
+    for (uint64_t block = blocks - count; block < blocks; block++) {
+        const MeasurementBlock& slot = mMeasurements[block % kMeasurementRingBlocks];
+        peak = std::max(peak, slot.peak.load(std::memory_order_relaxed));
+        sumSquares += slot.sumSquares.load(std::memory_order_relaxed);
+    }
+    const float rms = std::sqrt(sumSquares / (count * mMeasurementBlockSamples));
+    return {.rms = levelToMb(rms), .peak = levelToMb(peak)};
+}
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aidl/android/hardware/audio/effect/BnEffect.h>
+#include <system/audio_effects/effect_visualizer.h>
+
+#include "effect-impl/EffectFft.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+/**
+ * Capture and measurement engine of the software Visualizer.
+ *
+ * The effect worker calls process(), which passes the audio through and records it in a ring of
+ * mono samples, together with the peak and the sum of squares of every 10ms block. Captures and
+ * measurements are snapshots of these rings, taken from any thread without a lock: the worker
+ * never waits for a reader, and a reader detects and retries a snapshot overwritten while it was
+ * copied. process() does not allocate.
+ *
+ * process() must not be called concurrently with itself. The settings may be changed from any
+ * thread, and take effect on the next snapshot.
+ */
+class VisualizerSwEngine {
+  public:
+    // need align the min/max capture size to VISUALIZER_CAPTURE_SIZE_MIN and
+    // VISUALIZER_CAPTURE_SIZE_MAX because of limitation in audio_utils fixedfft.
+    static constexpr int32_t kMinCaptureSize = VISUALIZER_CAPTURE_SIZE_MIN;
+    static constexpr int32_t kMaxCaptureSize = VISUALIZER_CAPTURE_SIZE_MAX;
+    static constexpr int32_t kMaxLatencyMs = 3000;
+    // Without processing for this long, the capture is silence and the measurement is discarded,
+    // as in the legacy Visualizer.
+    static constexpr int64_t kMaxStallTimeMs = 1000;
+    static constexpr int64_t kDiscardMeasurementsTimeMs = 2000;
+    // Measurements are over the last kMeasurementWindowBlocks blocks of kMeasurementBlockMs.
+    static constexpr int32_t kMeasurementBlockMs = 10;
+    static constexpr size_t kMeasurementWindowBlocks = 10;
+    // Level reported for silence, in millibels.
+    static constexpr int32_t kMinLevelMb = -9600;
+
+    VisualizerSwEngine(int sampleRate, size_t channelCount);
+
+    void setCaptureSize(int captureSize);
+    void setScalingMode(Visualizer::ScalingMode scalingMode);
+    void setLatencyMs(int latencyMs);
+
+    /** Copies frames of interleaved audio from in to out, which may alias, and records them. */
+    void process(const float* in, float* out, size_t frames);
+
+    /**
+     * Returns the last captureSize mono samples played, as unsigned 8 bit PCM. The capture point
+     * is delayed by the latency, minus the time elapsed since the last process() call.
+     */
+    std::vector<uint8_t> captureWaveform() const;
+
+    /**
+     * Returns the spectrum of the samples of captureWaveform(), in the format of the framework
+     * Visualizer::getFft(): size signed 8 bit values, the real parts of the DC and Nyquist bins
+     * followed by the real and imaginary parts of bins 1 to size / 2 - 1. size is captureSize
+     * rounded down to a power of 2. A full scale sine wave peaks at 127.
+     */
+    std::vector<int8_t> captureFft() const;
+
+    /** Returns the peak and RMS levels of the measurement window, in millibels. */
+    Visualizer::Measurement getMeasurement() const;
+
+  private:
+    struct MeasurementBlock {
+        std::atomic<float> peak = 0;
+        std::atomic<float> sumSquares = 0;
+    };
+    // Must be larger than the window, so that a reader has time to copy it.
+    static constexpr size_t kMeasurementRingBlocks = 16;
+    static_assert(kMeasurementRingBlocks > kMeasurementWindowBlocks);
+
+    // Copies the mono samples of the capture point to dst, scaled according to the scaling mode.
+    // If the worker keeps overwriting them while they are copied, dst is silence.
+    void snapshot(float* dst, size_t count) const;
+    void writeCapture(const float* in, size_t frames);
+    void measure(const float* in, size_t samples);
+    int64_t msSinceLastProcess() const;
+
+    const int mSampleRate;
+    const size_t mChannelCount;
+
+    std::atomic<int> mCaptureSize = kMaxCaptureSize;
+    std::atomic<Visualizer::ScalingMode> mScalingMode = Visualizer::ScalingMode::NORMALIZED;
+    std::atomic<int> mLatencyMs = 0;
+
+    // Capture ring of mono samples, a power of 2 long. The writer announces the end of the frames
+    // it is about to overwrite in mCaptureWriting, and publishes them in mCaptureWritten. Samples
+    // are stored and loaded relaxed, a reader racing with the writer discards what it copied.
+    std::vector<std::atomic<float>> mCapture;
+    const size_t mCaptureMask;
+    std::atomic<uint64_t> mCaptureWriting = 0;
+    std::atomic<uint64_t> mCaptureWritten = 0;
+    std::atomic<int64_t> mLastProcessNs = 0;
+
+    // Measurement ring, accumulated by the worker and published block by block.
+    const size_t mMeasurementBlockSamples;
+    float mBlockPeak = 0;
+    float mBlockSumSquares = 0;
+    size_t mBlockSamples = 0;
+    MeasurementBlock mMeasurements[kMeasurementRingBlocks];
+    std::atomic<uint64_t> mMeasuredBlocks = 0;
+
+    // FFTs of the power of 2 capture sizes, from kMinCaptureSize.
+    std::vector<RealFft> mFfts;
+};
+
+}  // namespace aidl::android::hardware::audio::effect
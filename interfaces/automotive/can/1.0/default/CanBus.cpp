@@ -30,6 +30,49 @@ namespace android::hardware::automotive::can::V1_0::implementation {
 /** Whether to log sent/received packets. */
 static constexpr bool kSuperVerbose = false;
 
+/**
+ * Converts a FilterFlag into bits of a kernel filter.
+ *
+ * \param filterFlag FilterFlag to convert
+ * \param flag CAN ID flag (such as CAN_RTR_FLAG) the FilterFlag applies to
+ * \param kernelFilter Kernel filter to update
+ */
+static void applyFilterFlag(FilterFlag filterFlag, canid_t flag, struct can_filter& kernelFilter) {
+    if (filterFlag == FilterFlag::DONT_CARE) return;
+    kernelFilter.can_mask |= flag;
+    if (filterFlag == FilterFlag::SET) kernelFilter.can_id |= flag;
+}
+
+/**
+ * Appends kernel receive filters accepting every message a listener filter may accept.
+ *
+ * Kernel filters are a union (a frame passes if it matches any of them), so exclude rules can't be
+ * expressed this way. They are skipped here, which makes the kernel filters a superset of what the
+ * listener accepts; match() still does the exact filtering in user space.
+ *
+ * \param filter Listener filter to convert
+ * \param kernelFilters Kernel filters to append to
+ * \return false if the listener accepts (almost) any message and can't be expressed as a
+ *         (non-trivial) kernel filter, true otherwise
+ */
+static bool appendKernelFilters(const hidl_vec<CanMessageFilter>& filter,
+                                std::vector<struct can_filter>& kernelFilters) {
+    bool anyNonExcludeRulePresent = false;
+    for (const auto& rule : filter) {
+        if (rule.exclude) continue;
+        anyNonExcludeRulePresent = true;
+
+        struct can_filter kernelFilter = {
+                .can_id = rule.id & CAN_EFF_MASK,
+                .can_mask = rule.mask & CAN_EFF_MASK,
+        };
+        applyFilterFlag(rule.rtr, CAN_RTR_FLAG, kernelFilter);
+        applyFilterFlag(rule.extendedFormat, CAN_EFF_FLAG, kernelFilter);
+        kernelFilters.push_back(kernelFilter);
+    }
+    return anyNonExcludeRulePresent;
+}
+
 Return<Result> CanBus::send(const CanMessage& message) {
     std::lock_guard<std::mutex> lck(mIsUpGuard);
     if (!mIsUp) return Result::INTERFACE_DOWN;
@@ -70,6 +113,7 @@ Return<void> CanBus::listen(const hidl_vec<CanMessageFilter>& filter,
     sp<CloseHandle> closeHandle = new CloseHandle([this, listenerCb]() {
         std::lock_guard<std::mutex> lck(mMsgListenersGuard);
         std::erase_if(mMsgListeners, [&](const auto& e) { return e.callback == listenerCb; });
+        updateSocketFilters();
     });
     mMsgListeners.emplace_back(CanMessageListener{listenerCb, filter, closeHandle});
     auto& listener = mMsgListeners.back();
@@ -78,6 +122,8 @@ Return<void> CanBus::listen(const hidl_vec<CanMessageFilter>& filter,
     std::for_each(listener.filter.begin(), listener.filter.end(),
                   [](auto& rule) { rule.id &= rule.mask; });
 
+    updateSocketFilters();
+
     _hidl_cb(Result::OK, closeHandle);
     return {};
 }
@@ -136,12 +182,19 @@ ICanController::Result CanBus::up() {
     using namespace std::placeholders;
     CanSocket::ReadCallback rdcb = std::bind(&CanBus::onRead, this, _1, _2);
     CanSocket::ErrorCallback errcb = std::bind(&CanBus::onError, this, _1);
-    mSocket = CanSocket::open(mIfname, rdcb, errcb);
-    if (!mSocket) {
+    auto socket = CanSocket::open(mIfname, rdcb, errcb);
+    if (!socket) {
         if (mDownAfterUse) netdevice::down(mIfname);
         return ICanController::Result::UNKNOWN_ERROR;
     }
 
+    {
+        std::lock_guard<std::mutex> lckListeners(mMsgListenersGuard);
+        mSocket = std::move(socket);
+        // No listeners yet, so don't wake up the reader thread for any data frames.
+        updateSocketFilters();
+    }
+
     mIsUp = true;
     return ICanController::Result::OK;
 }
@@ -167,6 +220,27 @@ void CanBus::clearMsgListeners() {
     CHECK(mMsgListeners.empty()) << "Listeners list wasn't emptied";
 }
 
+void CanBus::updateSocketFilters() {
+    if (!mSocket) return;
+    static const std::vector<struct can_filter> kPassAll = {{.can_id = 0, .can_mask = 0}};
+
+    std::vector<struct can_filter> kernelFilters;
+    bool passAll = false;
+    for (const auto& listener : mMsgListeners) {
+        if (!appendKernelFilters(listener.filter, kernelFilters)) {
+            passAll = true;
+            break;
+        }
+    }
+    if (kernelFilters.size() > CAN_RAW_FILTER_MAX) passAll = true;
+
+    if (!mSocket->setFilters(passAll ? kPassAll : kernelFilters)) {
+        // Fall back to receiving everything, match() will still filter messages in user space.
+        LOG(WARNING) << "Failed to set kernel filters on " << mIfname;
+        mSocket->setFilters(kPassAll);
+    }
+}
+
 void CanBus::clearErrListeners() {
     std::lock_guard<std::mutex> lck(mErrListenersGuard);
     mErrListeners.clear();
@@ -203,7 +277,14 @@ bool CanBus::down() {
 
     clearMsgListeners();
     clearErrListeners();
-    mSocket.reset();
+
+    std::unique_ptr<CanSocket> socket;
+    {
+        std::lock_guard<std::mutex> lckListeners(mMsgListenersGuard);
+        socket = std::move(mSocket);
+    }
+    // Destroy outside of mMsgListenersGuard, since it waits for the reader thread to finish.
+    socket.reset();
 
     bool success = true;
 
@@ -83,6 +83,7 @@ struct CanBus : public ICanBus {
         bool failedOnce = false;
     };
     void clearMsgListeners();
+    void updateSocketFilters() REQUIRES(mMsgListenersGuard);
     void clearErrListeners();
 
     void notifyErrorListeners(ErrorEvent err, bool isFatal);
@@ -96,6 +97,11 @@ struct CanBus : public ICanBus {
     std::mutex mErrListenersGuard;
     std::vector<sp<ICanErrorListener>> mErrListeners GUARDED_BY(mErrListenersGuard);
 
+    /**
+     * The socket is created and destroyed with mIsUpGuard held. Replacing it additionally requires
+     * mMsgListenersGuard, so listener close handles can update kernel filters without taking
+     * mIsUpGuard (which is already held when down() closes them).
+     */
     std::unique_ptr<CanSocket> mSocket;
     bool mDownAfterUse;
 
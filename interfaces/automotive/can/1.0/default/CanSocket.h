@@ -23,7 +23,9 @@
 #include <atomic>
 #include <chrono>
 #include <functional>
+#include <span>
 #include <thread>
+#include <vector>
 
 namespace android::hardware::automotive::can::V1_0::implementation {
 
@@ -52,6 +54,26 @@ struct CanSocket {
      */
     bool send(const struct canfd_frame& frame);
 
+    /**
+     * Send multiple CAN frames, batching them into as few system calls as possible.
+     *
+     * \param frames Frames to send, in order
+     * \return Number of frames sent; sending stops at the first failure
+     */
+    size_t send(std::span<const struct canfd_frame> frames);
+
+    /**
+     * Install kernel receive filters (CAN_RAW_FILTER).
+     *
+     * A frame is delivered if it matches any of the filters; the others are dropped by the kernel
+     * without waking up the reader thread. An empty filter list drops all data frames. Error
+     * frames are not affected by these filters.
+     *
+     * \param filters Filters to install, at most CAN_RAW_FILTER_MAX of them
+     * \return true in case of success, false otherwise
+     */
+    bool setFilters(const std::vector<struct can_filter>& filters);
+
   private:
     CanSocket(base::unique_fd socket, ReadCallback rdcb, ErrorCallback errcb);
     void readerThread();
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CanBusVirtual.h>
+#include <CanSocket.h>
+
+#include <benchmark/benchmark.h>
+#include <hidl-utils/hidl-utils.h>
+#include <linux/can.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+/**
+ * Frames-per-second and CPU cost of the CAN HAL data path on a vcan interface.
+ *
+ * Creating the vcan interface requires root, so run it after `adb root`. Both the sender and the
+ * receiver run in this process, so cpu_ns_per_frame is only meaningful to compare filter modes.
+ */
+namespace android::hardware::automotive::can::V1_0::implementation {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr char kIfname[] = "vcanbench0";
+
+/** Sent frame ids cycle over [0, kIdCount), so an id filter on the low nibble picks 1/16. */
+constexpr canid_t kIdCount = 16;
+constexpr size_t kFramesPerIteration = 256;
+
+enum FilterMode {
+    /** Listener with no filter: every frame is delivered. */
+    kNoFilter,
+    /** Listener accepting 1/16 of ids: the kernel drops the rest before the reader wakes up. */
+    kIncludeFilter,
+    /** Listener excluding 15/16 of ids: same delivery, but can only be filtered in user space. */
+    kExcludeFilter,
+};
+
+struct CountingListener : public ICanMessageListener {
+    Return<void> onReceive(const CanMessage&) override {
+        mReceived++;
+        return {};
+    }
+
+    std::atomic<uint64_t> mReceived = 0;
+};
+
+hidl_vec<CanMessageFilter> makeFilter(FilterMode mode) {
+    std::vector<CanMessageFilter> filter;
+    if (mode == kIncludeFilter) {
+        filter.push_back({.id = 0, .mask = kIdCount - 1});
+    } else if (mode == kExcludeFilter) {
+        for (canid_t id = 1; id < kIdCount; id++) {
+            filter.push_back({.id = id, .mask = kIdCount - 1, .exclude = true});
+        }
+    }
+    return filter;
+}
+
+std::vector<struct canfd_frame> makeFrames() {
+    std::vector<struct canfd_frame> frames(kFramesPerIteration);
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].can_id = i % kIdCount;
+        frames[i].len = 8;
+    }
+    return frames;
+}
+
+std::chrono::nanoseconds processCpuTime() {
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+std::unique_ptr<CanSocket> openSender() {
+    auto sender = CanSocket::open(
+            kIfname, [](const struct canfd_frame&, std::chrono::nanoseconds) {}, [](int) {});
+    // Don't let the sender's own reader thread compete for CPU with the measured receiver.
+    if (sender != nullptr) sender->setFilters({});
+    return sender;
+}
+
+/** Waits until the listener stops receiving, i.e. the reader drained the socket queue. */
+uint64_t waitForDrain(const CountingListener& listener) {
+    uint64_t received = listener.mReceived;
+    for (auto deadline = std::chrono::steady_clock::now() + 1s;
+         std::chrono::steady_clock::now() < deadline;) {
+        std::this_thread::sleep_for(10ms);
+        const uint64_t current = listener.mReceived;
+        if (current == received) break;
+        received = current;
+    }
+    return received;
+}
+
+}  // namespace
+
+static void BM_CanBusReceive(benchmark::State& state) {
+    const auto mode = static_cast<FilterMode>(state.range(0));
+
+    sp<CanBusVirtual> bus = new CanBusVirtual(kIfname);
+    if (bus->up() != ICanController::Result::OK) {
+        state.SkipWithError("Can't bring up vcan interface (requires root and vcan support)");
+        return;
+    }
+
+    sp<CountingListener> listener = new CountingListener();
+    Result result;
+    sp<ICloseHandle> closeHandle;
+    bus->listen(makeFilter(mode), listener, hidl_utils::fill(&result, &closeHandle));
+    auto sender = openSender();
+    if (result != Result::OK || sender == nullptr) {
+        state.SkipWithError("Can't set up the listener or the sender");
+        if (closeHandle != nullptr) closeHandle->close();
+        bus->down();
+        return;
+    }
+
+    const auto frames = makeFrames();
+    uint64_t sent = 0;
+    const auto cpuStart = processCpuTime();
+    for (auto _ : state) {
+        sent += sender->send(frames);
+    }
+    const uint64_t received = waitForDrain(*listener);
+    const auto cpuTime = processCpuTime() - cpuStart;
+
+    state.counters["sent_fps"] = benchmark::Counter(sent, benchmark::Counter::kIsRate);
+    state.counters["delivered_fps"] = benchmark::Counter(received, benchmark::Counter::kIsRate);
+    state.counters["cpu_ns_per_frame"] = sent == 0 ? 0 : cpuTime.count() / double(sent);
+
+    sender.reset();
+    closeHandle->close();
+    bus->down();
+}
+BENCHMARK(BM_CanBusReceive)
+        ->ArgName("filter")
+        ->Arg(kNoFilter)
+        ->Arg(kIncludeFilter)
+        ->Arg(kExcludeFilter)
+        ->UseRealTime();
+
+static void BM_CanSocketSend(benchmark::State& state) {
+    const bool batched = state.range(0) != 0;
+
+    sp<CanBusVirtual> bus = new CanBusVirtual(kIfname);
+    if (bus->up() != ICanController::Result::OK) {
+        state.SkipWithError("Can't bring up vcan interface (requires root and vcan support)");
+        return;
+    }
+    auto sender = openSender();
+    if (sender == nullptr) {
+        state.SkipWithError("Can't open the sender");
+        bus->down();
+        return;
+    }
+
+    const auto frames = makeFrames();
+    uint64_t sent = 0;
+    for (auto _ : state) {
+        if (batched) {
+            sent += sender->send(frames);
+        } else {
+            for (const auto& frame : frames) {
+                if (sender->send(frame)) sent++;
+            }
+        }
+    }
+    state.counters["sent_fps"] = benchmark::Counter(sent, benchmark::Counter::kIsRate);
+
+    sender.reset();
+    bus->down();
+}
+BENCHMARK(BM_CanSocketSend)->ArgName("batched")->Arg(0)->Arg(1)->UseRealTime();
+
+}  // namespace android::hardware::automotive::can::V1_0::implementation
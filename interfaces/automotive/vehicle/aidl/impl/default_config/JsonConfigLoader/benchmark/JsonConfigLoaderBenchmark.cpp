@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JsonConfigLoader.h>
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include <string>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+constexpr char kDefaultPropertiesConfigFile[] = "DefaultProperties.json";
+
+std::string getConfigPath() {
+    return android::base::GetExecutableDirectory() + "/" + kDefaultPropertiesConfigFile;
+}
+
+// The VHAL startup cost of loading the default config by parsing the JSON file.
+void BM_LoadDefaultPropertiesFromJson(benchmark::State& state) {
+    std::string configPath = getConfigPath();
+    JsonConfigLoader loader;
+    for (auto _ : state) {
+        auto result = loader.loadPropConfig(configPath);
+        if (!result.ok()) {
+            state.SkipWithError(result.error().message().c_str());
+            return;
+        }
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+// The VHAL startup cost of loading the default config from an up-to-date cache. This includes
+// reading and hashing the JSON file to check that the cache is not stale.
+void BM_LoadDefaultPropertiesFromCache(benchmark::State& state) {
+    std::string configPath = getConfigPath();
+    TemporaryDir tempDir;
+    std::string cachePath = std::string(tempDir.path) + "/DefaultProperties.json.cache";
+    JsonConfigLoader loader;
+    if (auto result = loader.writePropConfigCache(configPath, cachePath); !result.ok()) {
+        state.SkipWithError(result.error().message().c_str());
+        return;
+    }
+    for (auto _ : state) {
+        auto result = loader.loadPropConfig(configPath, cachePath);
+        if (!result.ok()) {
+            state.SkipWithError(result.error().message().c_str());
+            return;
+        }
+        benchmark::DoNotOptimize(result);
+    }
+    unlink(cachePath.c_str());
+}
+
+}  // namespace
+
+BENCHMARK(BM_LoadDefaultPropertiesFromJson);
+BENCHMARK(BM_LoadDefaultPropertiesFromCache);
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -149,6 +149,9 @@ class JsonConfigParser {
                     ConfigDeclaration* outPtr, std::vector<std::string>* errors);
 };
 
+// Returns the fingerprint stored in the property config caches written by this loader.
+uint64_t getLoaderFingerprint();
+
 }  // namespace jsonconfigloader_impl
 
 // A class to load vehicle property configs and initial values in JSON format.
@@ -164,6 +167,18 @@ class JsonConfigLoader final {
     android::base::Result<std::unordered_map<int32_t, ConfigDeclaration>> loadPropConfig(
             const std::string& configPath);
 
+    // Loads a JSON config file through the binary cache at {@code cachePath}.
+    //
+    // The cache is used if it was compiled from the same JSON content by the same loader,
+    // otherwise the JSON file is parsed and the cache is rewritten. Failing to write the cache is
+    // not an error.
+    android::base::Result<std::unordered_map<int32_t, ConfigDeclaration>> loadPropConfig(
+            const std::string& configPath, const std::string& cachePath);
+
+    // Compiles a JSON config file to a binary cache at {@code cachePath}, e.g. at build time.
+    android::base::Result<void> writePropConfigCache(const std::string& configPath,
+                                                     const std::string& cachePath);
+
   private:
     std::unique_ptr<jsonconfigloader_impl::JsonConfigParser> mParser;
 };
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_aidl_impl_default_config_JsonConfigLoader_include_PropConfigCache_H_
+#define android_hardware_automotive_vehicle_aidl_impl_default_config_JsonConfigLoader_include_PropConfigCache_H_
+
+#include <ConfigDeclaration.h>
+
+#include <android-base/result.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+// A binary cache of the ConfigDeclarations parsed from one JSON config file.
+//
+// The cache is a flat blob: a fixed header followed by the config declarations serialized in
+// native byte order. It is read through a read-only mapping, so loading it costs one pass over
+// the data without any JSON parsing or constant name lookups.
+//
+// A cache is only used if it was written from the exact same JSON content (compared by hash and
+// size) by a loader with the same format version and fingerprint, otherwise it is stale and the
+// caller must parse the JSON instead.
+namespace propconfigcache {
+
+// Bump this when the cache layout or the JSON parsing semantics change.
+constexpr uint32_t kFormatVersion = 1;
+
+// Hashes the content of a JSON config file.
+uint64_t hashSource(std::string_view content);
+
+// Serializes the configs into a cache blob.
+//
+// @param loaderFingerprint Identifies the loader build, e.g. a hash over the default access and
+//        change mode tables compiled into the loader.
+std::vector<uint8_t> serialize(const std::unordered_map<int32_t, ConfigDeclaration>& configs,
+                               uint64_t loaderFingerprint, uint64_t sourceHash,
+                               uint64_t sourceSize);
+
+// Deserializes a cache blob. Returns error if the blob is malformed or stale.
+android::base::Result<std::unordered_map<int32_t, ConfigDeclaration>> deserialize(
+        const uint8_t* data, size_t size, uint64_t loaderFingerprint, uint64_t sourceHash,
+        uint64_t sourceSize);
+
+// Maps the cache file and deserializes it. Returns error if the file does not exist, is
+// malformed or is stale.
+android::base::Result<std::unordered_map<int32_t, ConfigDeclaration>> readCacheFile(
+        const std::string& cachePath, uint64_t loaderFingerprint, uint64_t sourceHash,
+        uint64_t sourceSize);
+
+// Atomically replaces the cache file with the blob, so a reader never sees a partial file.
+android::base::Result<void> writeCacheFile(const std::string& cachePath,
+                                           const std::vector<uint8_t>& blob);
+
+}  // namespace propconfigcache
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_aidl_impl_default_config_JsonConfigLoader_include_PropConfigCache_H_
@@ -14,18 +14,28 @@
  * limitations under the License.
  */
 
+#define LOG_TAG "JsonConfigLoader"
+
 #include <JsonConfigLoader.h>
 
 #include <AccessForVehicleProperty.h>
 #include <ChangeModeForVehicleProperty.h>
+#include <PropConfigCache.h>
 #include <PropertyUtils.h>
 
 #ifdef ENABLE_VEHICLE_HAL_TEST_PROPERTIES
 #include <android/hardware/automotive/vehicle/TestVendorProperty.h>
 #endif  // ENABLE_VEHICLE_HAL_TEST_PROPERTIES
 
+#include <android-base/file.h>
 #include <android-base/strings.h>
+#include <utils/Log.h>
+
+#include <algorithm>
 #include <fstream>
+#include <sstream>
+#include <string_view>
+#include <tuple>
 
 namespace android {
 namespace hardware {
@@ -672,6 +682,33 @@ Result<std::unordered_map<int32_t, ConfigDeclaration>> JsonConfigParser::parseJs
     return configsByPropId;
 }
 
+// Identifies what this loader compiles a JSON config to: the default access and change modes
+// compiled into the loader, and whether the test properties are enabled. A cache written by a
+// loader with a different fingerprint is stale.
+uint64_t getLoaderFingerprint() {
+    static const uint64_t fingerprint = [] {
+        std::vector<std::tuple<int32_t, int32_t, int32_t>> entries;
+        for (const auto& [propId, access] : AccessForVehicleProperty) {
+            entries.emplace_back(0, toInt(propId), toInt(access));
+        }
+        for (const auto& [propId, changeMode] : ChangeModeForVehicleProperty) {
+            entries.emplace_back(1, toInt(propId), toInt(changeMode));
+        }
+#ifdef ENABLE_VEHICLE_HAL_TEST_PROPERTIES
+        entries.emplace_back(2, 0, 1);
+#endif  // ENABLE_VEHICLE_HAL_TEST_PROPERTIES
+        std::sort(entries.begin(), entries.end());
+        std::vector<int32_t> flattened;
+        for (const auto& [table, propId, value] : entries) {
+            flattened.insert(flattened.end(), {table, propId, value});
+        }
+        return propconfigcache::hashSource(
+                std::string_view(reinterpret_cast<const char*>(flattened.data()),
+                                 flattened.size() * sizeof(int32_t)));
+    }();
+    return fingerprint;
+}
+
 }  // namespace jsonconfigloader_impl
 
 JsonConfigLoader::JsonConfigLoader() {
@@ -693,6 +730,54 @@ JsonConfigLoader::loadPropConfig(const std::string& configPath) {
     return loadPropConfig(ifs);
 }
 
+android::base::Result<std::unordered_map<int32_t, ConfigDeclaration>>
+JsonConfigLoader::loadPropConfig(const std::string& configPath, const std::string& cachePath) {
+    std::string content;
+    if (!android::base::ReadFileToString(configPath, &content)) {
+        return android::base::Error() << "couldn't open " << configPath << " for parsing.";
+    }
+    uint64_t fingerprint = jsonconfigloader_impl::getLoaderFingerprint();
+    uint64_t sourceHash = propconfigcache::hashSource(content);
+    auto cacheResult =
+            propconfigcache::readCacheFile(cachePath, fingerprint, sourceHash, content.size());
+    if (cacheResult.ok()) {
+        return cacheResult;
+    }
+    ALOGI("config cache %s not used, parsing %s, reason: %s", cachePath.c_str(),
+          configPath.c_str(), cacheResult.error().message().c_str());
+
+    std::istringstream iss(content);
+    auto result = loadPropConfig(iss);
+    if (!result.ok()) {
+        return result;
+    }
+    auto writeResult = propconfigcache::writeCacheFile(
+            cachePath,
+            propconfigcache::serialize(*result, fingerprint, sourceHash, content.size()));
+    if (!writeResult.ok()) {
+        ALOGW("failed to write config cache, error: %s", writeResult.error().message().c_str());
+    }
+    return result;
+}
+
+android::base::Result<void> JsonConfigLoader::writePropConfigCache(const std::string& configPath,
+                                                                   const std::string& cachePath) {
+    std::string content;
+    if (!android::base::ReadFileToString(configPath, &content)) {
+        return android::base::Error() << "couldn't open " << configPath << " for parsing.";
+    }
+    std::istringstream iss(content);
+    auto result = loadPropConfig(iss);
+    if (!result.ok()) {
+        return result.error();
+    }
+    return propconfigcache::writeCacheFile(
+            cachePath, propconfigcache::serialize(*result,
+                                                  jsonconfigloader_impl::getLoaderFingerprint(),
+                                                  propconfigcache::hashSource(content),
+                                                  content.size()));
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PropConfigCache.h>
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <optional>
+#include <type_traits>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace propconfigcache {
+
+namespace {
+
+using ::aidl::android::hardware::automotive::vehicle::RawPropValues;
+using ::aidl::android::hardware::automotive::vehicle::VehicleAreaConfig;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropConfig;
+using ::android::base::Error;
+using ::android::base::Result;
+using ::android::base::unique_fd;
+
+constexpr char kMagic[8] = {'V', 'H', 'A', 'L', 'C', 'F', 'G', '\0'};
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t headerSize;
+    uint64_t loaderFingerprint;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint64_t payloadSize;
+    uint32_t configCount;
+    uint32_t reserved;
+};
+
+static_assert(std::is_trivially_copyable_v<CacheHeader>);
+
+class BlobWriter final {
+  public:
+    explicit BlobWriter(std::vector<uint8_t>* out) : mOut(out) {}
+
+    template <class T>
+    void write(T value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        mOut->insert(mOut->end(), bytes, bytes + sizeof(T));
+    }
+
+    template <class T>
+    void writeArray(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write(static_cast<uint32_t>(values.size()));
+        const auto* bytes = reinterpret_cast<const uint8_t*>(values.data());
+        mOut->insert(mOut->end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    void writeString(const std::string& value) {
+        write(static_cast<uint32_t>(value.size()));
+        mOut->insert(mOut->end(), value.begin(), value.end());
+    }
+
+  private:
+    std::vector<uint8_t>* mOut;
+};
+
+// Reads from a blob with bounds checking. After any read fails, all the following reads fail.
+class BlobReader final {
+  public:
+    BlobReader(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    template <class T>
+    bool read(T* out) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (!ensureAvailable(sizeof(T))) {
+            return false;
+        }
+        std::memcpy(out, mData + mOffset, sizeof(T));
+        mOffset += sizeof(T);
+        return true;
+    }
+
+    template <class T>
+    bool readArray(std::vector<T>* out) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint32_t count = 0;
+        if (!read(&count) || !ensureAvailable(static_cast<size_t>(count) * sizeof(T))) {
+            return false;
+        }
+        out->resize(count);
+        std::memcpy(out->data(), mData + mOffset, count * sizeof(T));
+        mOffset += count * sizeof(T);
+        return true;
+    }
+
+    bool readString(std::string* out) {
+        uint32_t size = 0;
+        if (!read(&size) || !ensureAvailable(size)) {
+            return false;
+        }
+        out->assign(reinterpret_cast<const char*>(mData + mOffset), size);
+        mOffset += size;
+        return true;
+    }
+
+    bool atEnd() const { return mOffset == mSize; }
+
+  private:
+    bool ensureAvailable(size_t size) {
+        if (mFailed || size > mSize - mOffset) {
+            mFailed = true;
+            return false;
+        }
+        return true;
+    }
+
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mOffset = 0;
+    bool mFailed = false;
+};
+
+void writeRawPropValues(BlobWriter* writer, const RawPropValues& values) {
+    writer->writeArray(values.int32Values);
+    writer->writeArray(values.floatValues);
+    writer->writeArray(values.int64Values);
+    writer->writeArray(values.byteValues);
+    writer->writeString(values.stringValue);
+}
+
+bool readRawPropValues(BlobReader* reader, RawPropValues* values) {
+    return reader->readArray(&values->int32Values) && reader->readArray(&values->floatValues) &&
+           reader->readArray(&values->int64Values) && reader->readArray(&values->byteValues) &&
+           reader->readString(&values->stringValue);
+}
+
+void writeAreaConfig(BlobWriter* writer, const VehicleAreaConfig& areaConfig) {
+    writer->write(areaConfig.areaId);
+    writer->write(areaConfig.access);
+    writer->write(areaConfig.minInt32Value);
+    writer->write(areaConfig.maxInt32Value);
+    writer->write(areaConfig.minInt64Value);
+    writer->write(areaConfig.maxInt64Value);
+    writer->write(areaConfig.minFloatValue);
+    writer->write(areaConfig.maxFloatValue);
+    writer->write(static_cast<uint8_t>(areaConfig.supportVariableUpdateRate));
+    writer->write(static_cast<uint8_t>(areaConfig.supportedEnumValues.has_value()));
+    if (areaConfig.supportedEnumValues.has_value()) {
+        writer->writeArray(*areaConfig.supportedEnumValues);
+    }
+}
+
+bool readAreaConfig(BlobReader* reader, VehicleAreaConfig* areaConfig) {
+    uint8_t supportVariableUpdateRate = 0;
+    uint8_t hasSupportedEnumValues = 0;
+    if (!reader->read(&areaConfig->areaId) || !reader->read(&areaConfig->access) ||
+        !reader->read(&areaConfig->minInt32Value) || !reader->read(&areaConfig->maxInt32Value) ||
+        !reader->read(&areaConfig->minInt64Value) || !reader->read(&areaConfig->maxInt64Value) ||
+        !reader->read(&areaConfig->minFloatValue) || !reader->read(&areaConfig->maxFloatValue) ||
+        !reader->read(&supportVariableUpdateRate) || !reader->read(&hasSupportedEnumValues)) {
+        return false;
+    }
+    areaConfig->supportVariableUpdateRate = supportVariableUpdateRate != 0;
+    if (hasSupportedEnumValues != 0) {
+        areaConfig->supportedEnumValues.emplace();
+        return reader->readArray(&*areaConfig->supportedEnumValues);
+    }
+    return true;
+}
+
+void writeConfigDeclaration(BlobWriter* writer, const ConfigDeclaration& configDecl) {
+    const VehiclePropConfig& config = configDecl.config;
+    writer->write(config.prop);
+    writer->write(config.access);
+    writer->write(config.changeMode);
+    writer->writeArray(config.configArray);
+    writer->writeString(config.configString);
+    writer->write(config.minSampleRate);
+    writer->write(config.maxSampleRate);
+    writer->write(static_cast<uint32_t>(config.areaConfigs.size()));
+    for (const auto& areaConfig : config.areaConfigs) {
+        writeAreaConfig(writer, areaConfig);
+    }
+    writeRawPropValues(writer, configDecl.initialValue);
+    writer->write(static_cast<uint32_t>(configDecl.initialAreaValues.size()));
+    for (const auto& [areaId, values] : configDecl.initialAreaValues) {
+        writer->write(areaId);
+        writeRawPropValues(writer, values);
+    }
+}
+
+bool readConfigDeclaration(BlobReader* reader, ConfigDeclaration* configDecl) {
+    VehiclePropConfig& config = configDecl->config;
+    uint32_t areaConfigCount = 0;
+    if (!reader->read(&config.prop) || !reader->read(&config.access) ||
+        !reader->read(&config.changeMode) || !reader->readArray(&config.configArray) ||
+        !reader->readString(&config.configString) || !reader->read(&config.minSampleRate) ||
+        !reader->read(&config.maxSampleRate) || !reader->read(&areaConfigCount)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < areaConfigCount; i++) {
+        if (!readAreaConfig(reader, &config.areaConfigs.emplace_back())) {
+            return false;
+        }
+    }
+    uint32_t initialAreaValueCount = 0;
+    if (!readRawPropValues(reader, &configDecl->initialValue) ||
+        !reader->read(&initialAreaValueCount)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < initialAreaValueCount; i++) {
+        int32_t areaId = 0;
+        if (!reader->read(&areaId) ||
+            !readRawPropValues(reader, &configDecl->initialAreaValues[areaId])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+uint64_t hashSource(std::string_view content) {
+    // FNV-1a.
+    uint64_t hash = 0xcbf29ce484222325;
+    for (char c : content) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+std::vector<uint8_t> serialize(const std::unordered_map<int32_t, ConfigDeclaration>& configs,
+                               uint64_t loaderFingerprint, uint64_t sourceHash,
+                               uint64_t sourceSize) {
+    std::vector<uint8_t> blob(sizeof(CacheHeader));
+    BlobWriter writer(&blob);
+    for (const auto& [_, configDecl] : configs) {
+        writeConfigDeclaration(&writer, configDecl);
+    }
+
+    CacheHeader header = {
+            .magic = {},
+            .formatVersion = kFormatVersion,
+            .headerSize = sizeof(CacheHeader),
+            .loaderFingerprint = loaderFingerprint,
+            .sourceHash = sourceHash,
+            .sourceSize = sourceSize,
+            .payloadSize = blob.size() - sizeof(CacheHeader),
+            .configCount = static_cast<uint32_t>(configs.size()),
+            .reserved = 0,
+    };
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    std::memcpy(blob.data(), &header, sizeof(CacheHeader));
+    return blob;
+}
+
+Result<std::unordered_map<int32_t, ConfigDeclaration>> deserialize(const uint8_t* data,
+                                                                   size_t size,
+                                                                   uint64_t loaderFingerprint,
+                                                                   uint64_t sourceHash,
+                                                                   uint64_t sourceSize) {
+    CacheHeader header;
+    if (size < sizeof(CacheHeader)) {
+        return Error() << "cache is too small: " << size << " bytes";
+    }
+    std::memcpy(&header, data, sizeof(CacheHeader));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        return Error() << "not a property config cache";
+    }
+    if (header.formatVersion != kFormatVersion || header.headerSize != sizeof(CacheHeader)) {
+        return Error() << "unsupported cache format version: " << header.formatVersion;
+    }
+    if (header.loaderFingerprint != loaderFingerprint) {
+        return Error() << "cache is written by a different config loader";
+    }
+    if (header.sourceHash != sourceHash || header.sourceSize != sourceSize) {
+        return Error() << "cache is stale, the JSON config has changed";
+    }
+    if (header.payloadSize != size - sizeof(CacheHeader)) {
+        return Error() << "cache is truncated";
+    }
+
+    std::unordered_map<int32_t, ConfigDeclaration> configsByPropId;
+    configsByPropId.reserve(header.configCount);
+    BlobReader reader(data + sizeof(CacheHeader), size - sizeof(CacheHeader));
+    for (uint32_t i = 0; i < header.configCount; i++) {
+        ConfigDeclaration configDecl;
+        if (!readConfigDeclaration(&reader, &configDecl)) {
+            return Error() << "cache is corrupted";
+        }
+        int32_t propId = configDecl.config.prop;
+        configsByPropId[propId] = std::move(configDecl);
+    }
+    if (!reader.atEnd()) {
+        return Error() << "cache is corrupted, unexpected trailing data";
+    }
+    return configsByPropId;
+}
+
+Result<std::unordered_map<int32_t, ConfigDeclaration>> readCacheFile(const std::string& cachePath,
+                                                                     uint64_t loaderFingerprint,
+                                                                     uint64_t sourceHash,
+                                                                     uint64_t sourceSize) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(cachePath.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (!fd.ok()) {
+        return Error() << "failed to open cache file: " << cachePath << ", errno: " << errno;
+    }
+    struct stat fileStat;
+    if (fstat(fd.get(), &fileStat) != 0) {
+        return Error() << "failed to stat cache file: " << cachePath << ", errno: " << errno;
+    }
+    size_t size = static_cast<size_t>(fileStat.st_size);
+    if (size == 0) {
+        return Error() << "cache file is empty: " << cachePath;
+    }
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        return Error() << "failed to map cache file: " << cachePath << ", errno: " << errno;
+    }
+    auto result = deserialize(static_cast<const uint8_t*>(addr), size, loaderFingerprint,
+                              sourceHash, sourceSize);
+    munmap(addr, size);
+    return result;
+}
+
+Result<void> writeCacheFile(const std::string& cachePath, const std::vector<uint8_t>& blob) {
+    std::string tmpPath = cachePath + ".tmp";
+    {
+        unique_fd fd(TEMP_FAILURE_RETRY(
+                open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)));
+        if (!fd.ok()) {
+            return Error() << "failed to create cache file: " << tmpPath << ", errno: " << errno;
+        }
+        if (!android::base::WriteFully(fd.get(), blob.data(), blob.size()) ||
+            fsync(fd.get()) != 0) {
+            int savedErrno = errno;
+            unlink(tmpPath.c_str());
+            return Error() << "failed to write cache file: " << tmpPath
+                           << ", errno: " << savedErrno;
+        }
+    }
+    if (rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+        int savedErrno = errno;
+        unlink(tmpPath.c_str());
+        return Error() << "failed to rename cache file to: " << cachePath
+                       << ", errno: " << savedErrno;
+    }
+    return {};
+}
+
+}  // namespace propconfigcache
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
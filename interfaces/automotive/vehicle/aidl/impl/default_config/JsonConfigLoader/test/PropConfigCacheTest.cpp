@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JsonConfigLoader.h>
+#include <PropConfigCache.h>
+#include <VehicleUtils.h>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+
+#include <string>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+using ::aidl::android::hardware::automotive::vehicle::VehicleProperty;
+
+constexpr char kConfig[] = R"(
+{
+    "properties": [
+        {
+            "property": "VehicleProperty::INFO_FUEL_CAPACITY",
+            "defaultValue": {
+                "floatValues": [1.5]
+            },
+            "configArray": [1, 2],
+            "configString": "config"
+        },
+        {
+            "property": "VehicleProperty::HVAC_FAN_SPEED",
+            "areas": [
+                {
+                    "areaId": 1,
+                    "minInt32Value": 0,
+                    "maxInt32Value": 10,
+                    "supportedEnumValues": [1, 2, 3],
+                    "defaultValue": {
+                        "int32Values": [5]
+                    }
+                },
+                {
+                    "areaId": 2,
+                    "supportVariableUpdateRate": false
+                }
+            ]
+        }
+    ]
+}
+)";
+
+constexpr char kUpdatedConfig[] = R"(
+{
+    "properties": [
+        {
+            "property": "VehicleProperty::INFO_FUEL_CAPACITY",
+            "defaultValue": {
+                "floatValues": [2.5]
+            }
+        }
+    ]
+}
+)";
+
+bool fileExists(const std::string& path) {
+    struct stat fileStat;
+    return stat(path.c_str(), &fileStat) == 0;
+}
+
+}  // namespace
+
+class PropConfigCacheTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mConfigPath = std::string(mTempDir.path) + "/config.json";
+        mCachePath = std::string(mTempDir.path) + "/config.json.cache";
+        ASSERT_TRUE(android::base::WriteStringToFile(kConfig, mConfigPath));
+    }
+
+    JsonConfigLoader mLoader;
+    TemporaryDir mTempDir;
+    std::string mConfigPath;
+    std::string mCachePath;
+};
+
+TEST_F(PropConfigCacheTest, testLoadWithCacheWritesCache) {
+    auto result = mLoader.loadPropConfig(mConfigPath, mCachePath);
+
+    ASSERT_TRUE(result.ok()) << result.error().message();
+    auto expected = mLoader.loadPropConfig(mConfigPath);
+    ASSERT_TRUE(expected.ok()) << expected.error().message();
+    EXPECT_EQ(result.value(), expected.value());
+    EXPECT_TRUE(fileExists(mCachePath));
+}
+
+TEST_F(PropConfigCacheTest, testLoadWithCacheReadsCache) {
+    ASSERT_TRUE(mLoader.writePropConfigCache(mConfigPath, mCachePath).ok());
+    auto expected = mLoader.loadPropConfig(mConfigPath);
+    ASSERT_TRUE(expected.ok()) << expected.error().message();
+
+    std::string content;
+    ASSERT_TRUE(android::base::ReadFileToString(mConfigPath, &content));
+    auto result = propconfigcache::readCacheFile(
+            mCachePath, jsonconfigloader_impl::getLoaderFingerprint(),
+            propconfigcache::hashSource(content), content.size());
+
+    ASSERT_TRUE(result.ok()) << result.error().message();
+    EXPECT_EQ(result.value(), expected.value());
+    const auto& areaConfigs =
+            result.value().at(toInt(VehicleProperty::HVAC_FAN_SPEED)).config.areaConfigs;
+    ASSERT_EQ(areaConfigs.size(), 2u);
+    EXPECT_EQ(areaConfigs[0].supportedEnumValues, std::vector<int64_t>({1, 2, 3}));
+    EXPECT_EQ(areaConfigs[1].supportedEnumValues, std::nullopt);
+    EXPECT_FALSE(areaConfigs[1].supportVariableUpdateRate);
+}
+
+TEST_F(PropConfigCacheTest, testLoadWithStaleCache) {
+    ASSERT_TRUE(mLoader.loadPropConfig(mConfigPath, mCachePath).ok());
+    ASSERT_TRUE(android::base::WriteStringToFile(kUpdatedConfig, mConfigPath));
+
+    auto result = mLoader.loadPropConfig(mConfigPath, mCachePath);
+
+    ASSERT_TRUE(result.ok()) << result.error().message();
+    ASSERT_EQ(result.value().size(), 1u);
+    const auto& initialValue =
+            result.value().at(toInt(VehicleProperty::INFO_FUEL_CAPACITY)).initialValue;
+    EXPECT_EQ(initialValue.floatValues, std::vector<float>({2.5}));
+
+    // The cache must have been rewritten from the updated config.
+    auto cachedResult = propconfigcache::readCacheFile(
+            mCachePath, jsonconfigloader_impl::getLoaderFingerprint(),
+            propconfigcache::hashSource(kUpdatedConfig), std::string(kUpdatedConfig).size());
+    ASSERT_TRUE(cachedResult.ok()) << cachedResult.error().message();
+    EXPECT_EQ(cachedResult.value(), result.value());
+}
+
+TEST_F(PropConfigCacheTest, testLoadWithCorruptedCache) {
+    ASSERT_TRUE(android::base::WriteStringToFile("not a cache", mCachePath));
+
+    auto result = mLoader.loadPropConfig(mConfigPath, mCachePath);
+
+    ASSERT_TRUE(result.ok()) << result.error().message();
+    EXPECT_EQ(result.value().size(), 2u);
+}
+
+TEST_F(PropConfigCacheTest, testLoadWithUnwritableCache) {
+    auto result = mLoader.loadPropConfig(mConfigPath,
+                                         std::string(mTempDir.path) + "/not_exist/config.cache");
+
+    ASSERT_TRUE(result.ok()) << "failing to write the cache must not fail the loading";
+    EXPECT_EQ(result.value().size(), 2u);
+}
+
+TEST_F(PropConfigCacheTest, testLoadWithCacheInvalidConfig) {
+    ASSERT_TRUE(android::base::WriteStringToFile("[]", mConfigPath));
+
+    ASSERT_FALSE(mLoader.loadPropConfig(mConfigPath, mCachePath).ok());
+    EXPECT_FALSE(fileExists(mCachePath));
+}
+
+TEST_F(PropConfigCacheTest, testDeserializeTruncatedCache) {
+    auto configs = mLoader.loadPropConfig(mConfigPath);
+    ASSERT_TRUE(configs.ok()) << configs.error().message();
+    std::vector<uint8_t> blob =
+            propconfigcache::serialize(configs.value(), /*loaderFingerprint=*/1,
+                                       /*sourceHash=*/2, /*sourceSize=*/3);
+
+    for (size_t size = 0; size < blob.size(); size++) {
+        EXPECT_FALSE(propconfigcache::deserialize(blob.data(), size, 1, 2, 3).ok())
+                << "truncated cache of size " << size << " must be rejected";
+    }
+    EXPECT_TRUE(propconfigcache::deserialize(blob.data(), blob.size(), 1, 2, 3).ok());
+    EXPECT_FALSE(propconfigcache::deserialize(blob.data(), blob.size(), 4, 2, 3).ok())
+            << "cache from a different loader must be rejected";
+}
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
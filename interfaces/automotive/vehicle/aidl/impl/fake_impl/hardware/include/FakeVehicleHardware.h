@@ -106,6 +106,8 @@ class FakeVehicleHardware : public IVehicleHardware {
 
     const std::string mDefaultConfigDir;
     const std::string mOverrideConfigDir;
+    // Empty if the config cache is disabled.
+    const std::string mConfigCacheDir;
 
     ValueResultType getValue(
             const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value) const;
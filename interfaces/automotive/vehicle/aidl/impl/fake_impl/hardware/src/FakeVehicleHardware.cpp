@@ -39,6 +39,7 @@
 #include <dirent.h>
 #include <inttypes.h>
 #include <sys/types.h>
+#include <algorithm>
 #include <regex>
 #include <unordered_set>
 #include <vector>
@@ -109,6 +110,9 @@ constexpr char OVERRIDE_CONFIG_DIR[] = "/vendor/etc/automotive/vhaloverride/";
 // If OVERRIDE_PROPERTY is set, we will use the configuration files from OVERRIDE_CONFIG_DIR to
 // overwrite the default configs.
 constexpr char OVERRIDE_PROPERTY[] = "persist.vendor.vhal_init_value_override";
+// If CONFIG_CACHE_DIR_PROPERTY is set to a writable directory, the parsed configuration files are
+// cached there in a binary format, so later boots do not need to parse the JSON files again.
+constexpr char CONFIG_CACHE_DIR_PROPERTY[] = "ro.vendor.vhal_config_cache_dir";
 constexpr char POWER_STATE_REQ_CONFIG_PROPERTY[] = "ro.vendor.fake_vhal.ap_power_state_req.config";
 // The value to be returned if VENDOR_PROPERTY_FOR_ERROR_CODE_TESTING is set as the property
 constexpr int VENDOR_ERROR_CODE = 0x00ab0005;
@@ -305,6 +309,7 @@ FakeVehicleHardware::FakeVehicleHardware(std::string defaultConfigDir,
       mServerSidePropStore(new VehiclePropertyStore(mValuePool)),
       mDefaultConfigDir(defaultConfigDir),
       mOverrideConfigDir(overrideConfigDir),
+      mConfigCacheDir(android::base::GetProperty(CONFIG_CACHE_DIR_PROPERTY, "")),
       mFakeObd2Frame(new obd2frame::FakeObd2Frame(mServerSidePropStore)),
       mFakeUserHal(new FakeUserHal(mValuePool)),
       mRecurrentTimer(new RecurrentTimer()),
@@ -2280,7 +2285,16 @@ bool FakeVehicleHardware::loadPropConfigsFromDir(
         }
         std::string filePath = dirPath + "/" + std::string(f->d_name);
         ALOGI("loading properties from %s", filePath.c_str());
-        auto result = mLoader.loadPropConfig(filePath);
+        Result<std::unordered_map<int32_t, ConfigDeclaration>> result;
+        if (mConfigCacheDir.empty()) {
+            result = mLoader.loadPropConfig(filePath);
+        } else {
+            // The default and override directories may contain files with the same name, so the
+            // cache is named after the full path.
+            std::string cacheName = filePath;
+            std::replace(cacheName.begin(), cacheName.end(), '/', '_');
+            result = mLoader.loadPropConfig(filePath, mConfigCacheDir + "/" + cacheName + ".cache");
+        }
         if (!result.ok()) {
             ALOGE("failed to load config file: %s, error: %s", filePath.c_str(),
                   result.error().message().c_str());
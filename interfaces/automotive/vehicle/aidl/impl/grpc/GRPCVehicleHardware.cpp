@@ -28,23 +28,87 @@
 
 namespace android::hardware::automotive::vehicle::virtualization {
 
+// Must match GrpcVehicleProxyServer::kValueRequestStreamMetadataKey.
+static constexpr char kValueRequestStreamMetadataKey[] = "vhal-value-request-stream";
+static constexpr auto kValueRequestStreamRetryInterval = std::chrono::seconds(1);
+
 static std::shared_ptr<::grpc::ChannelCredentials> getChannelCredentials() {
     // TODO(chenhaosjtuacm): get secured credentials here
     return ::grpc::InsecureChannelCredentials();
 }
 
+static proto::VehiclePropValueRequests toProtoRequests(
+        const std::vector<aidlvhal::GetValueRequest>& requests) {
+    proto::VehiclePropValueRequests protoRequests;
+    for (const auto& request : requests) {
+        auto& protoRequest = *protoRequests.add_requests();
+        protoRequest.set_request_id(request.requestId);
+        proto_msg_converter::aidlToProto(request.prop, protoRequest.mutable_value());
+    }
+    return protoRequests;
+}
+
+static proto::VehiclePropValueRequests toProtoRequests(
+        const std::vector<aidlvhal::SetValueRequest>& requests) {
+    proto::VehiclePropValueRequests protoRequests;
+    for (const auto& request : requests) {
+        auto& protoRequest = *protoRequests.add_requests();
+        protoRequest.set_request_id(request.requestId);
+        proto_msg_converter::aidlToProto(request.value, protoRequest.mutable_value());
+    }
+    return protoRequests;
+}
+
+static aidlvhal::GetValueResult toAidlResult(const proto::GetValueResult& protoResult) {
+    aidlvhal::GetValueResult result;
+    result.requestId = protoResult.request_id();
+    result.status = static_cast<aidlvhal::StatusCode>(protoResult.status());
+    if (protoResult.has_value()) {
+        aidlvhal::VehiclePropValue value;
+        proto_msg_converter::protoToAidl(protoResult.value(), &value);
+        result.prop = std::move(value);
+    }
+    return result;
+}
+
+static aidlvhal::SetValueResult toAidlResult(const proto::SetValueResult& protoResult) {
+    return {
+            .requestId = protoResult.request_id(),
+            .status = static_cast<aidlvhal::StatusCode>(protoResult.status()),
+    };
+}
+
 GRPCVehicleHardware::GRPCVehicleHardware(std::string service_addr)
+    : GRPCVehicleHardware(std::move(service_addr), ValueRequestStreamOptions{}) {}
+
+GRPCVehicleHardware::GRPCVehicleHardware(std::string service_addr,
+                                         ValueRequestStreamOptions options)
     : mServiceAddr(std::move(service_addr)),
       mGrpcChannel(::grpc::CreateChannel(mServiceAddr, getChannelCredentials())),
       mGrpcStub(proto::VehicleServer::NewStub(mGrpcChannel)),
-      mValuePollingThread([this] { ValuePollingLoop(); }) {}
+      mValuePollingThread([this] { ValuePollingLoop(); }),
+      mValueRequestStreamOptions(options) {
+    if (mValueRequestStreamOptions.enabled) {
+        mValueRequestStreamThread = std::thread([this] { ValueRequestStreamLoop(); });
+    }
+}
 
 // Only used for unit testing.
 GRPCVehicleHardware::GRPCVehicleHardware(std::unique_ptr<proto::VehicleServer::StubInterface> stub)
+    : GRPCVehicleHardware(std::move(stub), ValueRequestStreamOptions{}) {}
+
+// Only used for unit testing.
+GRPCVehicleHardware::GRPCVehicleHardware(std::unique_ptr<proto::VehicleServer::StubInterface> stub,
+                                         ValueRequestStreamOptions options)
     : mServiceAddr(""),
       mGrpcChannel(nullptr),
       mGrpcStub(std::move(stub)),
-      mValuePollingThread([] {}) {}
+      mValuePollingThread([] {}),
+      mValueRequestStreamOptions(options) {
+    if (mValueRequestStreamOptions.enabled) {
+        mValueRequestStreamThread = std::thread([this] { ValueRequestStreamLoop(); });
+    }
+}
 
 GRPCVehicleHardware::~GRPCVehicleHardware() {
     {
@@ -52,7 +116,17 @@ GRPCVehicleHardware::~GRPCVehicleHardware() {
         mShuttingDownFlag.store(true);
     }
     mShutdownCV.notify_all();
+    {
+        std::lock_guard lck(mValueRequestStreamMutex);
+        if (mValueRequestStreamContext != nullptr) {
+            mValueRequestStreamContext->TryCancel();
+        }
+    }
+    mValueRequestStreamCV.notify_all();
     mValuePollingThread.join();
+    if (mValueRequestStreamThread.joinable()) {
+        mValueRequestStreamThread.join();
+    }
 }
 
 std::vector<aidlvhal::VehiclePropConfig> GRPCVehicleHardware::getAllPropertyConfigs() const {
@@ -76,14 +150,23 @@ std::vector<aidlvhal::VehiclePropConfig> GRPCVehicleHardware::getAllPropertyConf
 aidlvhal::StatusCode GRPCVehicleHardware::setValues(
         std::shared_ptr<const SetValuesCallback> callback,
         const std::vector<aidlvhal::SetValueRequest>& requests) {
+    proto::VehiclePropValueRequests protoRequests = toProtoRequests(requests);
+    if (mValueRequestStreamOptions.enabled) {
+        proto::ValueRequestBatch batch;
+        batch.mutable_set_value_requests()->Swap(&protoRequests);
+        PendingValueRequest pending{.setValuesCallback = callback};
+        for (const auto& request : requests) {
+            pending.remainingRequestIds.insert(request.requestId);
+        }
+        if (EnqueueValueRequests(std::move(batch), std::move(pending))) {
+            return aidlvhal::StatusCode::OK;
+        }
+        // The stream is not available, the batch is left untouched.
+        batch.mutable_set_value_requests()->Swap(&protoRequests);
+    }
+
     ::grpc::ClientContext context;
-    proto::VehiclePropValueRequests protoRequests;
     proto::SetValueResults protoResults;
-    for (const auto& request : requests) {
-        auto& protoRequest = *protoRequests.add_requests();
-        protoRequest.set_request_id(request.requestId);
-        proto_msg_converter::aidlToProto(request.value, protoRequest.mutable_value());
-    }
     // TODO(chenhaosjtuacm): Make it Async.
     auto grpc_status = mGrpcStub->SetValues(&context, protoRequests, &protoResults);
     if (!grpc_status.ok()) {
@@ -96,9 +179,7 @@ aidlvhal::StatusCode GRPCVehicleHardware::setValues(
     }
     std::vector<aidlvhal::SetValueResult> results;
     for (const auto& protoResult : protoResults.results()) {
-        auto& result = results.emplace_back();
-        result.requestId = protoResult.request_id();
-        result.status = static_cast<aidlvhal::StatusCode>(protoResult.status());
+        results.push_back(toAidlResult(protoResult));
         // TODO(chenhaosjtuacm): call on-set-error callback.
     }
     (*callback)(std::move(results));
@@ -109,14 +190,23 @@ aidlvhal::StatusCode GRPCVehicleHardware::setValues(
 aidlvhal::StatusCode GRPCVehicleHardware::getValues(
         std::shared_ptr<const GetValuesCallback> callback,
         const std::vector<aidlvhal::GetValueRequest>& requests) const {
+    proto::VehiclePropValueRequests protoRequests = toProtoRequests(requests);
+    if (mValueRequestStreamOptions.enabled) {
+        proto::ValueRequestBatch batch;
+        batch.mutable_get_value_requests()->Swap(&protoRequests);
+        PendingValueRequest pending{.getValuesCallback = callback};
+        for (const auto& request : requests) {
+            pending.remainingRequestIds.insert(request.requestId);
+        }
+        if (EnqueueValueRequests(std::move(batch), std::move(pending))) {
+            return aidlvhal::StatusCode::OK;
+        }
+        // The stream is not available, the batch is left untouched.
+        batch.mutable_get_value_requests()->Swap(&protoRequests);
+    }
+
     ::grpc::ClientContext context;
-    proto::VehiclePropValueRequests protoRequests;
     proto::GetValueResults protoResults;
-    for (const auto& request : requests) {
-        auto& protoRequest = *protoRequests.add_requests();
-        protoRequest.set_request_id(request.requestId);
-        proto_msg_converter::aidlToProto(request.prop, protoRequest.mutable_value());
-    }
     // TODO(chenhaosjtuacm): Make it Async.
     auto grpc_status = mGrpcStub->GetValues(&context, protoRequests, &protoResults);
     if (!grpc_status.ok()) {
@@ -125,14 +215,7 @@ aidlvhal::StatusCode GRPCVehicleHardware::getValues(
     }
     std::vector<aidlvhal::GetValueResult> results;
     for (const auto& protoResult : protoResults.results()) {
-        auto& result = results.emplace_back();
-        result.requestId = protoResult.request_id();
-        result.status = static_cast<aidlvhal::StatusCode>(protoResult.status());
-        if (protoResult.has_value()) {
-            aidlvhal::VehiclePropValue value;
-            proto_msg_converter::protoToAidl(protoResult.value(), &value);
-            result.prop = std::move(value);
-        }
+        results.push_back(toAidlResult(protoResult));
     }
     (*callback)(std::move(results));
 
@@ -246,6 +329,13 @@ bool GRPCVehicleHardware::waitForConnected(std::chrono::milliseconds waitTime) {
             gpr_now(GPR_CLOCK_MONOTONIC), gpr_time_from_millis(waitTime.count(), GPR_TIMESPAN)));
 }
 
+bool GRPCVehicleHardware::waitForValueRequestStream(std::chrono::milliseconds waitTime) {
+    std::unique_lock lck(mValueRequestStreamMutex);
+    return mValueRequestStreamCV.wait_for(lck, waitTime, [this] {
+        return mValueRequestStreamReady || mShuttingDownFlag.load();
+    }) && mValueRequestStreamReady;
+}
+
 void GRPCVehicleHardware::ValuePollingLoop() {
     while (!mShuttingDownFlag.load()) {
         ::grpc::ClientContext context;
@@ -290,4 +380,206 @@ void GRPCVehicleHardware::ValuePollingLoop() {
     }
 }
 
+bool GRPCVehicleHardware::EnqueueValueRequests(proto::ValueRequestBatch&& batch,
+                                               PendingValueRequest&& pending) const {
+    {
+        std::lock_guard lck(mValueRequestStreamMutex);
+        if (!mValueRequestStreamReady) {
+            return false;
+        }
+        // Request IDs are only unique per VHAL client, so results are matched by batch ID.
+        int64_t batchId = mNextValueRequestBatchId++;
+        batch.set_batch_id(batchId);
+        mPendingValueRequests[batchId] = std::move(pending);
+        mQueuedValueRequestBatches.push_back(std::move(batch));
+    }
+    mValueRequestStreamCV.notify_all();
+    return true;
+}
+
+void GRPCVehicleHardware::ValueRequestStreamLoop() {
+    while (!mShuttingDownFlag.load()) {
+        ::grpc::ClientContext context;
+        {
+            std::lock_guard lck(mValueRequestStreamMutex);
+            if (mShuttingDownFlag.load()) {
+                return;
+            }
+            mValueRequestStreamContext = &context;
+        }
+        std::unique_ptr<ValueRequestStream> stream = mGrpcStub->StartValueRequestStream(&context);
+        // A legacy server rejects the stream without sending the metadata.
+        stream->WaitForInitialMetadata();
+        bool accepted =
+                context.GetServerInitialMetadata().count(kValueRequestStreamMetadataKey) != 0;
+        if (accepted) {
+            LOG(INFO) << __func__ << ": GRPC Value Request Streaming Started";
+            {
+                std::lock_guard lck(mValueRequestStreamMutex);
+                mValueRequestStreamReady = true;
+            }
+            mValueRequestStreamCV.notify_all();
+            std::thread reader([this, &stream] { ValueResultReadLoop(stream.get()); });
+            ValueRequestWriteLoop(stream.get());
+            {
+                std::lock_guard lck(mValueRequestStreamMutex);
+                mValueRequestStreamReady = false;
+            }
+            context.TryCancel();
+            reader.join();
+        }
+        {
+            std::lock_guard lck(mValueRequestStreamMutex);
+            mValueRequestStreamContext = nullptr;
+        }
+        auto grpc_status = stream->Finish();
+        FailPendingValueRequests();
+        if (!accepted && grpc_status.error_code() == ::grpc::StatusCode::UNIMPLEMENTED) {
+            // This is a legacy server, always use the unary GetValues/SetValues.
+            LOG(INFO) << __func__
+                      << ": GRPC Value Request Streaming is not supported by the server";
+            return;
+        }
+        LOG(ERROR) << __func__
+                   << ": GRPC Value Request Streaming Failed: " << grpc_status.error_message();
+
+        // Requests fall back to the unary RPCs until the stream is reconnected.
+        std::unique_lock lck(mShutdownMutex);
+        mShutdownCV.wait_for(lck, kValueRequestStreamRetryInterval,
+                             [this] { return mShuttingDownFlag.load(); });
+    }
+}
+
+void GRPCVehicleHardware::ValueRequestWriteLoop(ValueRequestStream* stream) {
+    const auto& options = mValueRequestStreamOptions;
+    while (true) {
+        proto::ValueRequestBatches requestBatches;
+        {
+            std::unique_lock lck(mValueRequestStreamMutex);
+            auto stopped = [this] { return !mValueRequestStreamReady || mShuttingDownFlag.load(); };
+            mValueRequestStreamCV.wait(lck, [this, &stopped] {
+                return stopped() || !mQueuedValueRequestBatches.empty();
+            });
+            if (stopped()) {
+                return;
+            }
+            if (options.batchingWindow.count() > 0 &&
+                mQueuedValueRequestBatches.size() < options.maxBatchCount) {
+                mValueRequestStreamCV.wait_for(lck, options.batchingWindow, [&] {
+                    return stopped() ||
+                           mQueuedValueRequestBatches.size() >= options.maxBatchCount;
+                });
+            }
+            while (!mQueuedValueRequestBatches.empty() &&
+                   static_cast<size_t>(requestBatches.batches_size()) < options.maxBatchCount) {
+                *requestBatches.add_batches() = std::move(mQueuedValueRequestBatches.front());
+                mQueuedValueRequestBatches.pop_front();
+            }
+        }
+        if (!stream->Write(requestBatches)) {
+            LOG(ERROR) << __func__ << ": failed to write value requests, connection lost";
+            return;
+        }
+    }
+}
+
+void GRPCVehicleHardware::ValueResultReadLoop(ValueRequestStream* stream) {
+    proto::ValueResultBatches resultBatches;
+    while (stream->Read(&resultBatches)) {
+        for (const auto& resultBatch : resultBatches.batches()) {
+            OnValueResultBatch(resultBatch);
+        }
+    }
+    {
+        std::lock_guard lck(mValueRequestStreamMutex);
+        mValueRequestStreamReady = false;
+    }
+    mValueRequestStreamCV.notify_all();
+}
+
+void GRPCVehicleHardware::OnValueResultBatch(const proto::ValueResultBatch& resultBatch) {
+    auto batchStatus = static_cast<aidlvhal::StatusCode>(resultBatch.status());
+    std::shared_ptr<const GetValuesCallback> getValuesCallback;
+    std::shared_ptr<const SetValuesCallback> setValuesCallback;
+    std::vector<aidlvhal::GetValueResult> getValueResults;
+    std::vector<aidlvhal::SetValueResult> setValueResults;
+    // The results not matching a remaining request ID are dropped.
+    std::vector<const proto::GetValueResult*> protoGetValueResults;
+    std::vector<const proto::SetValueResult*> protoSetValueResults;
+    {
+        std::lock_guard lck(mValueRequestStreamMutex);
+        auto it = mPendingValueRequests.find(resultBatch.batch_id());
+        if (it == mPendingValueRequests.end()) {
+            LOG(WARNING) << __func__ << ": no pending requests for batch ID "
+                         << resultBatch.batch_id() << ", drop the results";
+            return;
+        }
+        PendingValueRequest& pending = it->second;
+        getValuesCallback = pending.getValuesCallback;
+        setValuesCallback = pending.setValuesCallback;
+        if (batchStatus != aidlvhal::StatusCode::OK) {
+            for (int64_t requestId : pending.remainingRequestIds) {
+                if (getValuesCallback) {
+                    getValueResults.push_back({.requestId = requestId, .status = batchStatus});
+                } else {
+                    setValueResults.push_back({.requestId = requestId, .status = batchStatus});
+                }
+            }
+            pending.remainingRequestIds.clear();
+        }
+        for (const auto& protoResult : resultBatch.get_value_results().results()) {
+            if (pending.remainingRequestIds.erase(protoResult.request_id()) != 0) {
+                protoGetValueResults.push_back(&protoResult);
+            }
+        }
+        for (const auto& protoResult : resultBatch.set_value_results().results()) {
+            if (pending.remainingRequestIds.erase(protoResult.request_id()) != 0) {
+                protoSetValueResults.push_back(&protoResult);
+            }
+        }
+        if (pending.remainingRequestIds.empty()) {
+            mPendingValueRequests.erase(it);
+        }
+    }
+    for (const auto* protoResult : protoGetValueResults) {
+        getValueResults.push_back(toAidlResult(*protoResult));
+    }
+    for (const auto* protoResult : protoSetValueResults) {
+        setValueResults.push_back(toAidlResult(*protoResult));
+    }
+    if (getValuesCallback && !getValueResults.empty()) {
+        (*getValuesCallback)(std::move(getValueResults));
+    }
+    if (setValuesCallback && !setValueResults.empty()) {
+        (*setValuesCallback)(std::move(setValueResults));
+    }
+}
+
+void GRPCVehicleHardware::FailPendingValueRequests() {
+    std::unordered_map<int64_t, PendingValueRequest> pendingRequests;
+    {
+        std::lock_guard lck(mValueRequestStreamMutex);
+        pendingRequests = std::move(mPendingValueRequests);
+        mPendingValueRequests.clear();
+        mQueuedValueRequestBatches.clear();
+    }
+    for (auto& [_, pending] : pendingRequests) {
+        if (pending.getValuesCallback) {
+            std::vector<aidlvhal::GetValueResult> results;
+            for (int64_t requestId : pending.remainingRequestIds) {
+                results.push_back(
+                        {.requestId = requestId, .status = aidlvhal::StatusCode::TRY_AGAIN});
+            }
+            (*pending.getValuesCallback)(std::move(results));
+        } else if (pending.setValuesCallback) {
+            std::vector<aidlvhal::SetValueResult> results;
+            for (int64_t requestId : pending.remainingRequestIds) {
+                results.push_back(
+                        {.requestId = requestId, .status = aidlvhal::StatusCode::TRY_AGAIN});
+            }
+            (*pending.setValuesCallback)(std::move(results));
+        }
+    }
+}
+
 }  // namespace android::hardware::automotive::vehicle::virtualization
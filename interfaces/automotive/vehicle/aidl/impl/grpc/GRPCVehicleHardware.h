@@ -29,10 +29,14 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace android::hardware::automotive::vehicle::virtualization {
@@ -41,11 +45,29 @@ namespace aidlvhal = ::aidl::android::hardware::automotive::vehicle;
 
 class GRPCVehicleHardware : public IVehicleHardware {
   public:
+    // Options for sending getValues/setValues through one long-lasting bidirectional stream
+    // instead of one unary RPC per call.
+    struct ValueRequestStreamOptions {
+        bool enabled = false;
+        // How long the requests are held to be coalesced with later requests into one stream
+        // message. With zero, requests queued while the previous message is being written are
+        // still coalesced.
+        std::chrono::microseconds batchingWindow{0};
+        // The maximum number of getValues/setValues calls coalesced into one stream message.
+        size_t maxBatchCount = 64;
+    };
+
     explicit GRPCVehicleHardware(std::string service_addr);
 
+    GRPCVehicleHardware(std::string service_addr, ValueRequestStreamOptions options);
+
     // Only used for unit testing.
     explicit GRPCVehicleHardware(std::unique_ptr<proto::VehicleServer::StubInterface> stub);
 
+    // Only used for unit testing.
+    GRPCVehicleHardware(std::unique_ptr<proto::VehicleServer::StubInterface> stub,
+                        ValueRequestStreamOptions options);
+
     ~GRPCVehicleHardware();
 
     // Get all the property configs.
@@ -89,13 +111,45 @@ class GRPCVehicleHardware : public IVehicleHardware {
 
     bool waitForConnected(std::chrono::milliseconds waitTime);
 
+    // Waits until the server accepts the value request stream. Returns whether getValues/setValues
+    // are sent through the stream rather than the unary RPCs.
+    bool waitForValueRequestStream(std::chrono::milliseconds waitTime);
+
   protected:
     std::shared_mutex mCallbackMutex;
     std::unique_ptr<const PropertyChangeCallback> mOnPropChange;
 
   private:
+    using ValueRequestStream =
+            ::grpc::ClientReaderWriterInterface<proto::ValueRequestBatches,
+                                                proto::ValueResultBatches>;
+
+    // A getValues/setValues call sent through the value request stream and not fully answered.
+    struct PendingValueRequest {
+        // Exactly one of the callbacks is set.
+        std::shared_ptr<const GetValuesCallback> getValuesCallback;
+        std::shared_ptr<const SetValuesCallback> setValuesCallback;
+        std::unordered_set<int64_t> remainingRequestIds;
+    };
+
     void ValuePollingLoop();
 
+    void ValueRequestStreamLoop();
+
+    void ValueRequestWriteLoop(ValueRequestStream* stream);
+
+    void ValueResultReadLoop(ValueRequestStream* stream);
+
+    void OnValueResultBatch(const proto::ValueResultBatch& resultBatch);
+
+    // Fails all the pending requests with TRY_AGAIN after the stream is broken.
+    void FailPendingValueRequests();
+
+    // Queues the requests to the value request stream. Returns false if the stream is not
+    // available, the caller should then fall back to the unary RPC.
+    bool EnqueueValueRequests(proto::ValueRequestBatch&& batch,
+                              PendingValueRequest&& pending) const;
+
     std::string mServiceAddr;
     std::shared_ptr<::grpc::Channel> mGrpcChannel;
     std::unique_ptr<proto::VehicleServer::StubInterface> mGrpcStub;
@@ -106,6 +160,18 @@ class GRPCVehicleHardware : public IVehicleHardware {
     std::mutex mShutdownMutex;
     std::condition_variable mShutdownCV;
     std::atomic<bool> mShuttingDownFlag{false};
+
+    const ValueRequestStreamOptions mValueRequestStreamOptions;
+    // getValues is const but has to queue the requests, so the stream states are mutable.
+    mutable std::mutex mValueRequestStreamMutex;
+    mutable std::condition_variable mValueRequestStreamCV;
+    // Whether the server accepted the stream and the stream is not broken.
+    mutable bool mValueRequestStreamReady = false;
+    ::grpc::ClientContext* mValueRequestStreamContext = nullptr;
+    mutable int64_t mNextValueRequestBatchId = 0;
+    mutable std::deque<proto::ValueRequestBatch> mQueuedValueRequestBatches;
+    mutable std::unordered_map<int64_t, PendingValueRequest> mPendingValueRequests;
+    std::thread mValueRequestStreamThread;
 };
 
 }  // namespace android::hardware::automotive::vehicle::virtualization
@@ -38,6 +38,51 @@ static std::shared_ptr<::grpc::ServerCredentials> getServerCredentials() {
     return ::grpc::InsecureServerCredentials();
 }
 
+static std::vector<aidlvhal::GetValueRequest> toAidlGetValueRequests(
+        const proto::VehiclePropValueRequests& requests) {
+    std::vector<aidlvhal::GetValueRequest> aidlRequests;
+    aidlRequests.reserve(requests.requests_size());
+    for (const auto& protoRequest : requests.requests()) {
+        auto& aidlRequest = aidlRequests.emplace_back();
+        aidlRequest.requestId = protoRequest.request_id();
+        proto_msg_converter::protoToAidl(protoRequest.value(), &aidlRequest.prop);
+    }
+    return aidlRequests;
+}
+
+static std::vector<aidlvhal::SetValueRequest> toAidlSetValueRequests(
+        const proto::VehiclePropValueRequests& requests) {
+    std::vector<aidlvhal::SetValueRequest> aidlRequests;
+    aidlRequests.reserve(requests.requests_size());
+    for (const auto& protoRequest : requests.requests()) {
+        auto& aidlRequest = aidlRequests.emplace_back();
+        aidlRequest.requestId = protoRequest.request_id();
+        proto_msg_converter::protoToAidl(protoRequest.value(), &aidlRequest.value);
+    }
+    return aidlRequests;
+}
+
+static void addProtoResults(const std::vector<aidlvhal::GetValueResult>& aidlResults,
+                            proto::GetValueResults* protoResults) {
+    for (const auto& aidlResult : aidlResults) {
+        auto& protoResult = *protoResults->add_results();
+        protoResult.set_request_id(aidlResult.requestId);
+        protoResult.set_status(static_cast<proto::StatusCode>(aidlResult.status));
+        if (aidlResult.prop) {
+            proto_msg_converter::aidlToProto(*aidlResult.prop, protoResult.mutable_value());
+        }
+    }
+}
+
+static void addProtoResults(const std::vector<aidlvhal::SetValueResult>& aidlResults,
+                            proto::SetValueResults* protoResults) {
+    for (const auto& aidlResult : aidlResults) {
+        auto& protoResult = *protoResults->add_results();
+        protoResult.set_request_id(aidlResult.requestId);
+        protoResult.set_status(static_cast<proto::StatusCode>(aidlResult.status));
+    }
+}
+
 GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
                                                std::unique_ptr<IVehicleHardware>&& hardware)
     : mServiceAddr(std::move(serverAddr)), mHardware(std::move(hardware)) {
@@ -64,12 +109,7 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
 ::grpc::Status GrpcVehicleProxyServer::SetValues(::grpc::ServerContext* context,
                                                  const proto::VehiclePropValueRequests* requests,
                                                  proto::SetValueResults* results) {
-    std::vector<aidlvhal::SetValueRequest> aidlRequests;
-    for (const auto& protoRequest : requests->requests()) {
-        auto& aidlRequest = aidlRequests.emplace_back();
-        aidlRequest.requestId = protoRequest.request_id();
-        proto_msg_converter::protoToAidl(protoRequest.value(), &aidlRequest.value);
-    }
+    std::vector<aidlvhal::SetValueRequest> aidlRequests = toAidlSetValueRequests(*requests);
     auto waitMtx = std::make_shared<std::mutex>();
     auto waitCV = std::make_shared<std::condition_variable>();
     auto complete = std::make_shared<bool>(false);
@@ -78,12 +118,7 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
             std::make_shared<const IVehicleHardware::SetValuesCallback>(
                     [waitMtx, waitCV, complete,
                      tmpResults](std::vector<aidlvhal::SetValueResult> setValueResults) {
-                        for (const auto& aidlResult : setValueResults) {
-                            auto& protoResult = *tmpResults->add_results();
-                            protoResult.set_request_id(aidlResult.requestId);
-                            protoResult.set_status(
-                                    static_cast<proto::StatusCode>(aidlResult.status));
-                        }
+                        addProtoResults(setValueResults, tmpResults.get());
                         {
                             std::lock_guard lck(*waitMtx);
                             *complete = true;
@@ -109,12 +144,7 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
 ::grpc::Status GrpcVehicleProxyServer::GetValues(::grpc::ServerContext* context,
                                                  const proto::VehiclePropValueRequests* requests,
                                                  proto::GetValueResults* results) {
-    std::vector<aidlvhal::GetValueRequest> aidlRequests;
-    for (const auto& protoRequest : requests->requests()) {
-        auto& aidlRequest = aidlRequests.emplace_back();
-        aidlRequest.requestId = protoRequest.request_id();
-        proto_msg_converter::protoToAidl(protoRequest.value(), &aidlRequest.prop);
-    }
+    std::vector<aidlvhal::GetValueRequest> aidlRequests = toAidlGetValueRequests(*requests);
     auto waitMtx = std::make_shared<std::mutex>();
     auto waitCV = std::make_shared<std::condition_variable>();
     auto complete = std::make_shared<bool>(false);
@@ -123,16 +153,7 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
             std::make_shared<const IVehicleHardware::GetValuesCallback>(
                     [waitMtx, waitCV, complete,
                      tmpResults](std::vector<aidlvhal::GetValueResult> getValueResults) {
-                        for (const auto& aidlResult : getValueResults) {
-                            auto& protoResult = *tmpResults->add_results();
-                            protoResult.set_request_id(aidlResult.requestId);
-                            protoResult.set_status(
-                                    static_cast<proto::StatusCode>(aidlResult.status));
-                            if (aidlResult.prop) {
-                                auto* valuePtr = protoResult.mutable_value();
-                                proto_msg_converter::aidlToProto(*aidlResult.prop, valuePtr);
-                            }
-                        }
+                        addProtoResults(getValueResults, tmpResults.get());
                         {
                             std::lock_guard lck(*waitMtx);
                             *complete = true;
@@ -216,6 +237,86 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
     return ::grpc::Status(::grpc::StatusCode::ABORTED, "Connection lost.");
 }
 
+::grpc::Status GrpcVehicleProxyServer::StartValueRequestStream(
+        ::grpc::ServerContext* context, ValueRequestStream* stream) {
+    {
+        std::lock_guard lck(mValueRequestStreamMutex);
+        mValueRequestStreamContexts.insert(context);
+    }
+    // Let the client know the stream is accepted before any request is sent.
+    context->AddInitialMetadata(kValueRequestStreamMetadataKey, "1");
+    stream->SendInitialMetadata();
+
+    auto writer = std::make_shared<ValueResultWriter>(stream);
+    proto::ValueRequestBatches requestBatches;
+    while (stream->Read(&requestBatches)) {
+        for (const auto& batch : requestBatches.batches()) {
+            HandleValueRequestBatch(batch, writer);
+        }
+    }
+    // Results arriving from now on are dropped since the stream is no longer valid once this
+    // function returns.
+    writer->Close();
+    {
+        std::lock_guard lck(mValueRequestStreamMutex);
+        mValueRequestStreamContexts.erase(context);
+    }
+    return ::grpc::Status::OK;
+}
+
+void GrpcVehicleProxyServer::HandleValueRequestBatch(
+        const proto::ValueRequestBatch& batch, const std::shared_ptr<ValueResultWriter>& writer) {
+    int64_t batchId = batch.batch_id();
+    aidlvhal::StatusCode status = aidlvhal::StatusCode::INVALID_ARG;
+    if (batch.has_get_value_requests()) {
+        status = mHardware->getValues(
+                std::make_shared<const IVehicleHardware::GetValuesCallback>(
+                        [writer, batchId](std::vector<aidlvhal::GetValueResult> results) {
+                            proto::ValueResultBatch resultBatch;
+                            resultBatch.set_batch_id(batchId);
+                            addProtoResults(results, resultBatch.mutable_get_value_results());
+                            writer->Write(std::move(resultBatch));
+                        }),
+                toAidlGetValueRequests(batch.get_value_requests()));
+    } else if (batch.has_set_value_requests()) {
+        status = mHardware->setValues(
+                std::make_shared<const IVehicleHardware::SetValuesCallback>(
+                        [writer, batchId](std::vector<aidlvhal::SetValueResult> results) {
+                            proto::ValueResultBatch resultBatch;
+                            resultBatch.set_batch_id(batchId);
+                            addProtoResults(results, resultBatch.mutable_set_value_results());
+                            writer->Write(std::move(resultBatch));
+                        }),
+                toAidlSetValueRequests(batch.set_value_requests()));
+    }
+    if (status != aidlvhal::StatusCode::OK) {
+        LOG(ERROR) << __func__ << ": failed to handle value request batch, VHAL status: "
+                   << toString(status);
+        proto::ValueResultBatch resultBatch;
+        resultBatch.set_batch_id(batchId);
+        resultBatch.set_status(static_cast<proto::StatusCode>(status));
+        writer->Write(std::move(resultBatch));
+    }
+}
+
+void GrpcVehicleProxyServer::ValueResultWriter::Write(proto::ValueResultBatch&& resultBatch) {
+    proto::ValueResultBatches resultBatches;
+    *resultBatches.add_batches() = std::move(resultBatch);
+    std::lock_guard lck(mMtx);
+    if (mStream == nullptr) {
+        LOG(WARNING) << __func__ << ": value request stream ended, drop results";
+        return;
+    }
+    if (!mStream->Write(resultBatches)) {
+        LOG(ERROR) << __func__ << ": failed to write results, connection lost";
+    }
+}
+
+void GrpcVehicleProxyServer::ValueResultWriter::Close() {
+    std::lock_guard lck(mMtx);
+    mStream = nullptr;
+}
+
 void GrpcVehicleProxyServer::OnVehiclePropChange(
         const std::vector<aidlvhal::VehiclePropValue>& values) {
     std::unordered_set<uint64_t> brokenConn;
@@ -266,6 +367,12 @@ GrpcVehicleProxyServer& GrpcVehicleProxyServer::Shutdown() {
     for (auto& conn : mValueStreamingConnections) {
         conn->Shutdown();
     }
+    {
+        std::lock_guard lck(mValueRequestStreamMutex);
+        for (auto* context : mValueRequestStreamContexts) {
+            context->TryCancel();
+        }
+    }
     if (mServer) {
         mServer->Shutdown();
     }
@@ -28,8 +28,10 @@
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <string>
+#include <unordered_set>
 #include <utility>
 
 namespace android::hardware::automotive::vehicle::virtualization {
@@ -74,15 +76,45 @@ class GrpcVehicleProxyServer : public proto::VehicleServer::Service {
             ::grpc::ServerContext* context, const ::google::protobuf::Empty* request,
             ::grpc::ServerWriter<proto::VehiclePropValues>* stream) override;
 
+    ::grpc::Status StartValueRequestStream(
+            ::grpc::ServerContext* context,
+            ::grpc::ServerReaderWriter<proto::ValueResultBatches, proto::ValueRequestBatches>*
+                    stream) override;
+
     GrpcVehicleProxyServer& Start();
 
     GrpcVehicleProxyServer& Shutdown();
 
     void Wait();
 
+    // The initial metadata key the server sends once a value request stream is accepted, so that
+    // the client could tell the stream apart from a legacy server rejecting it.
+    static constexpr char kValueRequestStreamMetadataKey[] = "vhal-value-request-stream";
+
   private:
+    using ValueRequestStream =
+            ::grpc::ServerReaderWriter<proto::ValueResultBatches, proto::ValueRequestBatches>;
+
+    // Serializes the writes to one value request stream. The hardware might deliver results after
+    // the stream has ended, these results are dropped.
+    class ValueResultWriter {
+      public:
+        explicit ValueResultWriter(ValueRequestStream* stream) : mStream(stream) {}
+
+        void Write(proto::ValueResultBatch&& resultBatch);
+
+        void Close();
+
+      private:
+        std::mutex mMtx;
+        ValueRequestStream* mStream;
+    };
+
     void OnVehiclePropChange(const std::vector<aidlvhal::VehiclePropValue>& values);
 
+    void HandleValueRequestBatch(const proto::ValueRequestBatch& batch,
+                                 const std::shared_ptr<ValueResultWriter>& writer);
+
     // We keep long-lasting connection for streaming the prop values.
     struct ConnectionDescriptor {
         explicit ConnectionDescriptor(::grpc::ServerWriter<proto::VehiclePropValues>* stream)
@@ -123,6 +155,11 @@ class GrpcVehicleProxyServer : public proto::VehicleServer::Service {
     std::shared_mutex mConnectionMutex;
     std::vector<std::shared_ptr<ConnectionDescriptor>> mValueStreamingConnections;
 
+    // The contexts of the active value request streams, cancelled on shutdown since the handlers
+    // are blocked reading from the clients.
+    std::mutex mValueRequestStreamMutex;
+    std::unordered_set<::grpc::ServerContext*> mValueRequestStreamContexts;
+
     static constexpr auto kHardwareOpTimeout = std::chrono::seconds(1);
 };
 
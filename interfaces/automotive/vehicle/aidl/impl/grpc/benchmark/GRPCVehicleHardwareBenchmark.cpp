@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GRPCVehicleHardware.h"
+#include "GRPCVehicleProxyServer.h"
+#include "IVehicleHardware.h"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android::hardware::automotive::vehicle::virtualization {
+
+namespace {
+
+namespace aidlvhal = ::aidl::android::hardware::automotive::vehicle;
+
+const std::string kServerAddr = "127.0.0.1:54322";
+constexpr auto kWaitForConnectionMaxTime = std::chrono::seconds(5);
+constexpr auto kWaitForStreamStartMaxTime = std::chrono::seconds(5);
+constexpr int kCallsPerCaller = 200;
+
+// Answers every request immediately, so the benchmark measures the transport only.
+class EchoVehicleHardware : public IVehicleHardware {
+  public:
+    std::vector<aidlvhal::VehiclePropConfig> getAllPropertyConfigs() const override { return {}; }
+
+    aidlvhal::StatusCode setValues(
+            std::shared_ptr<const SetValuesCallback> callback,
+            const std::vector<aidlvhal::SetValueRequest>& requests) override {
+        std::vector<aidlvhal::SetValueResult> results;
+        for (const auto& request : requests) {
+            results.push_back({.requestId = request.requestId, .status = aidlvhal::StatusCode::OK});
+        }
+        (*callback)(std::move(results));
+        return aidlvhal::StatusCode::OK;
+    }
+
+    aidlvhal::StatusCode getValues(
+            std::shared_ptr<const GetValuesCallback> callback,
+            const std::vector<aidlvhal::GetValueRequest>& requests) const override {
+        std::vector<aidlvhal::GetValueResult> results;
+        for (const auto& request : requests) {
+            results.push_back({.requestId = request.requestId,
+                               .status = aidlvhal::StatusCode::OK,
+                               .prop = request.prop});
+        }
+        (*callback)(std::move(results));
+        return aidlvhal::StatusCode::OK;
+    }
+
+    DumpResult dump(const std::vector<std::string>& options) override { return {}; }
+
+    aidlvhal::StatusCode checkHealth() override { return aidlvhal::StatusCode::OK; }
+
+    void registerOnPropertyChangeEvent(
+            std::unique_ptr<const PropertyChangeCallback> callback) override {}
+
+    void registerOnPropertySetErrorEvent(
+            std::unique_ptr<const PropertySetErrorCallback> callback) override {}
+};
+
+// Issues {@code state.range(0)} concurrent callers, each sending kCallsPerCaller getValues
+// calls with one request, and waits for all the results.
+void runGetValues(benchmark::State& state,
+                  GRPCVehicleHardware::ValueRequestStreamOptions options) {
+    auto server = std::make_unique<GrpcVehicleProxyServer>(
+            kServerAddr, std::make_unique<EchoVehicleHardware>());
+    server->Start();
+    auto hardware = std::make_unique<GRPCVehicleHardware>(kServerAddr, options);
+    if (!hardware->waitForConnected(kWaitForConnectionMaxTime)) {
+        state.SkipWithError("failed to connect to the server");
+        return;
+    }
+    if (options.enabled && !hardware->waitForValueRequestStream(kWaitForStreamStartMaxTime)) {
+        state.SkipWithError("the server did not accept the value request stream");
+        return;
+    }
+
+    int callerCount = static_cast<int>(state.range(0));
+    int expectedCount = callerCount * kCallsPerCaller;
+    std::mutex mtx;
+    std::condition_variable cv;
+    int resultCount = 0;
+    auto callback = std::make_shared<const IVehicleHardware::GetValuesCallback>(
+            [&](std::vector<aidlvhal::GetValueResult> results) {
+                std::lock_guard lck(mtx);
+                resultCount += static_cast<int>(results.size());
+                cv.notify_all();
+            });
+
+    for (auto _ : state) {
+        {
+            std::lock_guard lck(mtx);
+            resultCount = 0;
+        }
+        std::vector<std::thread> callers;
+        for (int i = 0; i < callerCount; i++) {
+            callers.emplace_back([&hardware, &callback, i] {
+                for (int j = 0; j < kCallsPerCaller; j++) {
+                    hardware->getValues(callback, {{.requestId = i * kCallsPerCaller + j,
+                                                    .prop = {.prop = j}}});
+                }
+            });
+        }
+        for (auto& caller : callers) {
+            caller.join();
+        }
+        std::unique_lock lck(mtx);
+        cv.wait(lck, [&] { return resultCount >= expectedCount; });
+    }
+    state.SetItemsProcessed(state.iterations() * expectedCount);
+
+    hardware.reset();
+    server->Shutdown().Wait();
+}
+
+void BM_GetValuesUnary(benchmark::State& state) {
+    runGetValues(state, {});
+}
+
+void BM_GetValuesStream(benchmark::State& state) {
+    runGetValues(state, {.enabled = true});
+}
+
+void BM_GetValuesStreamBatchingWindow(benchmark::State& state) {
+    runGetValues(state, {.enabled = true, .batchingWindow = std::chrono::microseconds(200)});
+}
+
+}  // namespace
+
+BENCHMARK(BM_GetValuesUnary)->Arg(1)->Arg(8)->UseRealTime();
+BENCHMARK(BM_GetValuesStream)->Arg(1)->Arg(8)->UseRealTime();
+BENCHMARK(BM_GetValuesStreamBatchingWindow)->Arg(1)->Arg(8)->UseRealTime();
+
+}  // namespace android::hardware::automotive::vehicle::virtualization
@@ -22,8 +22,12 @@
 #include <grpc++/grpc++.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <utility>
@@ -34,6 +38,7 @@ namespace aidlvhal = ::aidl::android::hardware::automotive::vehicle;
 
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::Return;
 using ::testing::SaveArg;
 
@@ -55,15 +60,28 @@ class VehicleHardwareForTest : public IVehicleHardware {
     // Functions that we do not care.
     std::vector<aidlvhal::VehiclePropConfig> getAllPropertyConfigs() const override { return {}; }
 
+    // Sets always succeed and gets return the requested value.
     aidlvhal::StatusCode setValues(
             std::shared_ptr<const SetValuesCallback> callback,
             const std::vector<aidlvhal::SetValueRequest>& requests) override {
+        std::vector<aidlvhal::SetValueResult> results;
+        for (const auto& request : requests) {
+            results.push_back({.requestId = request.requestId, .status = aidlvhal::StatusCode::OK});
+        }
+        (*callback)(std::move(results));
         return aidlvhal::StatusCode::OK;
     }
 
     aidlvhal::StatusCode getValues(
             std::shared_ptr<const GetValuesCallback> callback,
             const std::vector<aidlvhal::GetValueRequest>& requests) const override {
+        std::vector<aidlvhal::GetValueResult> results;
+        for (const auto& request : requests) {
+            results.push_back({.requestId = request.requestId,
+                               .status = aidlvhal::StatusCode::OK,
+                               .prop = request.prop});
+        }
+        (*callback)(std::move(results));
         return aidlvhal::StatusCode::OK;
     }
 
@@ -107,6 +125,29 @@ class MockVehicleHardware : public IVehicleHardware {
                 (int32_t propId, int32_t areaId, float sampleRate), (override));
 };
 
+// Counts the calls to the unary GetValues/SetValues RPCs.
+class CountingVehicleProxyServer : public GrpcVehicleProxyServer {
+  public:
+    using GrpcVehicleProxyServer::GrpcVehicleProxyServer;
+
+    ::grpc::Status SetValues(::grpc::ServerContext* context,
+                             const proto::VehiclePropValueRequests* requests,
+                             proto::SetValueResults* results) override {
+        mUnarySetValuesCount++;
+        return GrpcVehicleProxyServer::SetValues(context, requests, results);
+    }
+
+    ::grpc::Status GetValues(::grpc::ServerContext* context,
+                             const proto::VehiclePropValueRequests* requests,
+                             proto::GetValueResults* results) override {
+        mUnaryGetValuesCount++;
+        return GrpcVehicleProxyServer::GetValues(context, requests, results);
+    }
+
+    std::atomic<int> mUnarySetValuesCount{0};
+    std::atomic<int> mUnaryGetValuesCount{0};
+};
+
 TEST(GRPCVehicleProxyServerUnitTest, ClientConnectDisconnect) {
     auto testHardware = std::make_unique<VehicleHardwareForTest>();
     // HACK: manipulate the underlying hardware via raw pointer for testing.
@@ -172,6 +213,81 @@ TEST(GRPCVehicleProxyServerUnitTest, ClientConnectDisconnect) {
     vehicleServer->Shutdown().Wait();
 }
 
+TEST(GRPCVehicleProxyServerUnitTest, ValueRequestStream) {
+    auto vehicleServer = std::make_unique<CountingVehicleProxyServer>(
+            kFakeServerAddr, std::make_unique<VehicleHardwareForTest>());
+    vehicleServer->Start();
+
+    constexpr auto kWaitForConnectionMaxTime = std::chrono::seconds(5);
+    constexpr auto kWaitForStreamStartMaxTime = std::chrono::seconds(5);
+    constexpr auto kWaitForResultsMaxTime = std::chrono::seconds(5);
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<aidlvhal::GetValueResult> getValueResults;
+    std::vector<aidlvhal::SetValueResult> setValueResults;
+    auto getValuesCallback = std::make_shared<const IVehicleHardware::GetValuesCallback>(
+            [&](std::vector<aidlvhal::GetValueResult> results) {
+                std::lock_guard lck(mtx);
+                for (auto& result : results) {
+                    getValueResults.push_back(std::move(result));
+                }
+                cv.notify_all();
+            });
+    auto setValuesCallback = std::make_shared<const IVehicleHardware::SetValuesCallback>(
+            [&](std::vector<aidlvhal::SetValueResult> results) {
+                std::lock_guard lck(mtx);
+                for (auto& result : results) {
+                    setValueResults.push_back(std::move(result));
+                }
+                cv.notify_all();
+            });
+
+    auto vehicleHardware = std::make_unique<GRPCVehicleHardware>(
+            kFakeServerAddr, GRPCVehicleHardware::ValueRequestStreamOptions{
+                                     .enabled = true,
+                                     .batchingWindow = std::chrono::milliseconds(1),
+                             });
+    EXPECT_TRUE(vehicleHardware->waitForConnected(kWaitForConnectionMaxTime));
+    EXPECT_TRUE(vehicleHardware->waitForValueRequestStream(kWaitForStreamStartMaxTime));
+
+    // The same request ID in different calls must not be mixed up.
+    EXPECT_EQ(vehicleHardware->getValues(getValuesCallback,
+                                         {{.requestId = 1, .prop = {.prop = 100}},
+                                          {.requestId = 2, .prop = {.prop = 200}}}),
+              aidlvhal::StatusCode::OK);
+    EXPECT_EQ(vehicleHardware->getValues(getValuesCallback,
+                                         {{.requestId = 1, .prop = {.prop = 300}}}),
+              aidlvhal::StatusCode::OK);
+    EXPECT_EQ(vehicleHardware->setValues(setValuesCallback,
+                                         {{.requestId = 3, .value = {.prop = 400}}}),
+              aidlvhal::StatusCode::OK);
+
+    {
+        std::unique_lock lck(mtx);
+        EXPECT_TRUE(cv.wait_for(lck, kWaitForResultsMaxTime, [&] {
+            return getValueResults.size() == 3 && setValueResults.size() == 1;
+        }));
+        std::vector<int32_t> propIds;
+        for (const auto& result : getValueResults) {
+            EXPECT_EQ(result.status, aidlvhal::StatusCode::OK);
+            ASSERT_TRUE(result.prop.has_value());
+            propIds.push_back(result.prop->prop);
+        }
+        std::sort(propIds.begin(), propIds.end());
+        EXPECT_THAT(propIds, ElementsAre(100, 200, 300));
+        ASSERT_EQ(setValueResults.size(), 1u);
+        EXPECT_EQ(setValueResults[0].requestId, 3);
+        EXPECT_EQ(setValueResults[0].status, aidlvhal::StatusCode::OK);
+    }
+    // Everything went through the stream, without falling back to the unary RPCs.
+    EXPECT_EQ(vehicleServer->mUnaryGetValuesCount, 0);
+    EXPECT_EQ(vehicleServer->mUnarySetValuesCount, 0);
+
+    vehicleHardware.reset();
+    vehicleServer->Shutdown().Wait();
+}
+
 TEST(GRPCVehicleProxyServerUnitTest, Subscribe) {
     auto mockHardware = std::make_unique<MockVehicleHardware>();
     // We make sure this is alive inside the function scope.
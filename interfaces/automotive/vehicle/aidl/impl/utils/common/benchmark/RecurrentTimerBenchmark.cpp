@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <RecurrentTimer.h>
+#include <benchmark/benchmark.h>
+#include <utils/SystemClock.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+constexpr size_t kCallbackCount = 1000;
+constexpr int64_t kRunTimeInMs = 2000;
+
+// Sample rates of continuous properties, in hz. The harmonic set shares deadlines, the mixed set
+// also contains rates whose intervals are not multiples of each other.
+const std::vector<int64_t> kHarmonicRates = {1, 2, 5, 10, 20, 25, 50, 100};
+const std::vector<int64_t> kMixedRates = {1, 3, 7, 10, 15, 30, 60, 100};
+
+struct JitterStats {
+    std::atomic<int64_t> callCount = 0;
+    std::atomic<int64_t> totalJitterInNanos = 0;
+    std::atomic<int64_t> maxJitterInNanos = 0;
+
+    void record(int64_t jitterInNanos) {
+        callCount++;
+        totalJitterInNanos += jitterInNanos;
+        int64_t currentMax = maxJitterInNanos;
+        while (jitterInNanos > currentMax &&
+               !maxJitterInNanos.compare_exchange_weak(currentMax, jitterInNanos)) {
+        }
+    }
+};
+
+void runTimer(benchmark::State& state, const std::vector<int64_t>& rates) {
+    for (auto _ : state) {
+        JitterStats stats;
+        RecurrentTimer timer;
+        std::vector<std::shared_ptr<RecurrentTimer::Callback>> callbacks;
+        for (size_t i = 0; i < kCallbackCount; i++) {
+            int64_t intervalInNanos = 1'000'000'000 / rates[i % rates.size()];
+            auto callback = std::make_shared<RecurrentTimer::Callback>([&stats, intervalInNanos] {
+                // Deadlines are aligned to multiples of the interval, so the distance to the
+                // previous multiple is how late this callback is.
+                stats.record(uptimeNanos() % intervalInNanos);
+            });
+            timer.registerTimerCallback(intervalInNanos, callback);
+            callbacks.push_back(callback);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(kRunTimeInMs));
+
+        for (const auto& callback : callbacks) {
+            timer.unregisterTimerCallback(callback);
+        }
+
+        double seconds = kRunTimeInMs / 1000.0;
+        int64_t callCount = std::max<int64_t>(stats.callCount, 1);
+        state.counters["wakeups_per_sec"] = timer.getWakeupCount() / seconds;
+        state.counters["callbacks_per_sec"] = stats.callCount / seconds;
+        state.counters["mean_jitter_us"] = stats.totalJitterInNanos / callCount / 1000.0;
+        state.counters["max_jitter_us"] = stats.maxJitterInNanos / 1000.0;
+    }
+}
+
+}  // namespace
+
+static void BM_RecurrentTimerHarmonicRates(benchmark::State& state) {
+    runTimer(state, kHarmonicRates);
+}
+BENCHMARK(BM_RecurrentTimerHarmonicRates)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+static void BM_RecurrentTimerMixedRates(benchmark::State& state) {
+    runTimer(state, kMixedRates);
+}
+BENCHMARK(BM_RecurrentTimerMixedRates)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
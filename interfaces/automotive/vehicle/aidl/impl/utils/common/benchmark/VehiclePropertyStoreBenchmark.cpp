@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <VehicleHalTypes.h>
+#include <VehiclePropertyStore.h>
+#include <VehicleUtils.h>
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+using ::aidl::android::hardware::automotive::vehicle::VehicleArea;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropConfig;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyAccess;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyChangeMode;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyGroup;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyType;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+
+constexpr int32_t kMaxThreads = 16;
+
+int32_t testPropId(int32_t index) {
+    return (0x1000 + index) | toInt(VehiclePropertyGroup::VENDOR) | toInt(VehicleArea::GLOBAL) |
+           toInt(VehiclePropertyType::FLOAT);
+}
+
+// The store is shared by all the benchmark threads.
+struct SharedStore {
+    std::shared_ptr<VehiclePropValuePool> valuePool = std::make_shared<VehiclePropValuePool>();
+    VehiclePropertyStore store{valuePool};
+
+    SharedStore() {
+        for (int32_t i = 0; i < kMaxThreads; i++) {
+            store.registerProperty(VehiclePropConfig{
+                    .prop = testPropId(i),
+                    .access = VehiclePropertyAccess::READ_WRITE,
+                    .changeMode = VehiclePropertyChangeMode::CONTINUOUS,
+            });
+            store.writeValue(valuePool->obtain(VehiclePropValue{
+                    .prop = testPropId(i),
+                    .value = {.floatValues = {0.0}},
+            }));
+        }
+        store.setOnValuesChangeCallback(
+                [](std::vector<VehiclePropValue> values) { benchmark::DoNotOptimize(values); });
+    }
+};
+
+SharedStore* getSharedStore() {
+    static SharedStore* sharedStore = new SharedStore();
+    return sharedStore;
+}
+
+void writeValue(SharedStore* s, int32_t propId, float value) {
+    auto result = s->store.writeValue(s->valuePool->obtain(VehiclePropValue{
+                                              .prop = propId,
+                                              .value = {.floatValues = {value}},
+                                      }),
+                                      /*updateStatus=*/false,
+                                      VehiclePropertyStore::EventMode::ON_VALUE_CHANGE,
+                                      /*useCurrentTimestamp=*/true);
+    benchmark::DoNotOptimize(result);
+}
+
+}  // namespace
+
+// All threads write to the same property. Every write is serialized on one lock, this is the
+// cost every write paid before the store was sharded per property.
+static void BM_WriteSameProperty(benchmark::State& state) {
+    SharedStore* s = getSharedStore();
+    float value = 0;
+    for (auto _ : state) {
+        writeValue(s, testPropId(0), value++);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WriteSameProperty)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+// Every thread writes to its own property, writes must scale with the number of threads.
+static void BM_WriteDistinctProperties(benchmark::State& state) {
+    SharedStore* s = getSharedStore();
+    int32_t propId = testPropId(state.thread_index());
+    float value = 0;
+    for (auto _ : state) {
+        writeValue(s, propId, value++);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WriteDistinctProperties)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+// Thread 0 reads all values (like a getValues burst) while the other threads keep writing their
+// own property.
+static void BM_ReadAllValuesWhileWriting(benchmark::State& state) {
+    SharedStore* s = getSharedStore();
+    int32_t propId = testPropId(state.thread_index());
+    float value = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            benchmark::DoNotOptimize(s->store.readAllValues());
+        } else {
+            writeValue(s, propId, value++);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReadAllValuesWhileWriting)->ThreadRange(2, kMaxThreads)->UseRealTime();
+
+// Every thread reads its own property while the same number of writes happen on it.
+static void BM_ReadWriteDistinctProperties(benchmark::State& state) {
+    SharedStore* s = getSharedStore();
+    int32_t propId = testPropId(state.thread_index());
+    float value = 0;
+    for (auto _ : state) {
+        writeValue(s, propId, value++);
+        benchmark::DoNotOptimize(s->store.readValue(propId));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_ReadWriteDistinctProperties)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_aidl_impl_utils_common_include_MpscRingQueue_H_
+#define android_hardware_automotive_vehicle_aidl_impl_utils_common_include_MpscRingQueue_H_
+
+#include <android-base/stringprintf.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+// A thread-safe histogram with power-of-two buckets: bucket 0 counts zeros, bucket i counts values
+// in [2^(i-1), 2^i). The last bucket also counts all the larger values.
+class Log2Histogram final {
+  public:
+    static constexpr size_t BUCKET_COUNT = 16;
+
+    void record(size_t value) {
+        size_t bucket = 0;
+        while (value != 0 && bucket < BUCKET_COUNT - 1) {
+            value >>= 1;
+            bucket++;
+        }
+        mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t getCount(size_t bucket) const {
+        return mBuckets[bucket].load(std::memory_order_relaxed);
+    }
+
+    // Returns the non-empty buckets in the format of "[lower-upper]: count, ...".
+    std::string toString() const {
+        std::string result;
+        for (size_t i = 0; i < BUCKET_COUNT; i++) {
+            uint64_t count = getCount(i);
+            if (count == 0) {
+                continue;
+            }
+            size_t lower = i == 0 ? 0 : (size_t{1} << (i - 1));
+            if (!result.empty()) {
+                result += ", ";
+            }
+            if (i == BUCKET_COUNT - 1) {
+                result += android::base::StringPrintf("[%zu+]: %" PRIu64, lower, count);
+            } else if (i <= 1) {
+                result += android::base::StringPrintf("[%zu]: %" PRIu64, lower, count);
+            } else {
+                result += android::base::StringPrintf("[%zu-%zu]: %" PRIu64, lower,
+                                                      (size_t{1} << i) - 1, count);
+            }
+        }
+        return result.empty() ? "empty" : result;
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> mBuckets = {};
+};
+
+// A bounded lock-free multi-producer single-consumer queue.
+//
+// Any thread could push items without taking a lock. Only one thread may pop items and wait for
+// items. Producers only take a lock to wake up the consumer if it is waiting and enough items are
+// available, so a consumer waiting for a full batch is not woken up for every single item.
+template <typename T>
+class MpscRingQueue {
+  public:
+    // The capacity is rounded up to a power of two.
+    explicit MpscRingQueue(size_t capacity) {
+        size_t roundedCapacity = 1;
+        while (roundedCapacity < capacity) {
+            roundedCapacity <<= 1;
+        }
+        mMask = roundedCapacity - 1;
+        mCells = std::make_unique<Cell[]>(roundedCapacity);
+        for (size_t i = 0; i < roundedCapacity; i++) {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingQueue(const MpscRingQueue&) = delete;
+    MpscRingQueue& operator=(const MpscRingQueue&) = delete;
+
+    size_t capacity() const { return mMask + 1; }
+
+    // Returns the number of items in the queue. Could include items that are being pushed.
+    size_t size() const {
+        return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+    }
+
+    // Tries to push the item, returns false if the queue is full or deactivated.
+    bool tryPush(T&& item) {
+        if (!mIsActive.load(std::memory_order_relaxed) || !tryPushInternal(std::move(item))) {
+            return false;
+        }
+        notifyConsumerIfNeeded();
+        return true;
+    }
+
+    // Pushes the item, yields while the queue is full. Returns false if the queue is deactivated.
+    bool push(T&& item) {
+        if (!pushInternal(std::move(item))) {
+            return false;
+        }
+        notifyConsumerIfNeeded();
+        return true;
+    }
+
+    // Pushes the items, yields while the queue is full. Returns false if the queue is deactivated.
+    bool push(std::vector<T>&& items) {
+        for (T& item : items) {
+            if (!pushInternal(std::move(item))) {
+                return false;
+            }
+        }
+        notifyConsumerIfNeeded();
+        return true;
+    }
+
+    // Moves at most maxCount items to the end of items. Returns the number of moved items.
+    // Must only be called from the consumer thread.
+    size_t popAll(std::vector<T>* items, size_t maxCount) {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        size_t count = 0;
+        while (count < maxCount) {
+            Cell& cell = mCells[head & mMask];
+            if (cell.sequence.load(std::memory_order_acquire) != head + 1) {
+                // Empty, or the producer has not finished writing this cell yet.
+                break;
+            }
+            items->push_back(std::move(cell.data));
+            cell.data = T();
+            cell.sequence.store(head + mMask + 1, std::memory_order_release);
+            head++;
+            count++;
+        }
+        mHead.store(head, std::memory_order_release);
+        return count;
+    }
+
+    // Blocks until the queue is not empty or is deactivated. Returns whether the queue is active.
+    // Must only be called from the consumer thread.
+    bool waitForItems() {
+        std::unique_lock<std::mutex> uniqueLock(mLock);
+        prepareWait(1);
+        mCond.wait(uniqueLock, [this] { return size() != 0 || !mIsActive; });
+        mConsumerWaiting.store(false, std::memory_order_relaxed);
+        return mIsActive;
+    }
+
+    // Blocks until at least minCount items are in the queue, the deadline passes, or the queue is
+    // deactivated. Returns whether at least minCount items are in the queue.
+    // Must only be called from the consumer thread.
+    bool waitForItemsUntil(size_t minCount, std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> uniqueLock(mLock);
+        prepareWait(minCount);
+        bool enough = mCond.wait_until(uniqueLock, deadline, [this, minCount] {
+            return size() >= minCount || !mIsActive;
+        });
+        mConsumerWaiting.store(false, std::memory_order_relaxed);
+        return enough && size() >= minCount;
+    }
+
+    // Deactivates the queue, thus no one can push items to it, also notifies the waiting
+    // consumer. The items already in the queue could still be popped after the queue is
+    // deactivated.
+    void deactivate() {
+        {
+            std::scoped_lock<std::mutex> lockGuard(mLock);
+            mIsActive = false;
+        }
+        mCond.notify_all();
+    }
+
+    // Returns how many times a producer had to wait because the queue was full.
+    uint64_t getFullCount() const { return mFullCount.load(std::memory_order_relaxed); }
+
+  private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> mCells;
+    size_t mMask;
+    // Producers and the consumer write to different cache lines.
+    alignas(64) std::atomic<size_t> mTail = 0;
+    alignas(64) std::atomic<size_t> mHead = 0;
+    alignas(64) std::atomic<bool> mIsActive = true;
+    std::atomic<bool> mConsumerWaiting = false;
+    std::atomic<size_t> mWakeUpThreshold = 1;
+    std::atomic<uint64_t> mFullCount = 0;
+    // Only used to block the consumer.
+    std::mutex mLock;
+    std::condition_variable mCond;
+
+    bool tryPushInternal(T&& item) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &mCells[tail & mMask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(tail);
+            if (diff == 0) {
+                if (mTail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // The cell still holds an item from the previous round, the queue is full.
+                return false;
+            } else {
+                tail = mTail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->sequence.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pushInternal(T&& item) {
+        bool full = false;
+        while (mIsActive.load(std::memory_order_relaxed)) {
+            if (tryPushInternal(std::move(item))) {
+                return true;
+            }
+            if (!full) {
+                full = true;
+                mFullCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            // Make sure the consumer is draining the queue.
+            notifyConsumerIfNeeded();
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    void prepareWait(size_t minCount) {
+        mWakeUpThreshold.store(minCount, std::memory_order_relaxed);
+        mConsumerWaiting.store(true, std::memory_order_relaxed);
+        // Pairs with the fence in notifyConsumerIfNeeded, either the consumer sees the new items
+        // or the producer sees the consumer waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void notifyConsumerIfNeeded() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!mConsumerWaiting.load(std::memory_order_relaxed) ||
+            size() < mWakeUpThreshold.load(std::memory_order_relaxed)) {
+            return;
+        }
+        {
+            // Taking the lock makes sure the consumer is either blocked or has not evaluated the
+            // wait condition yet.
+            std::scoped_lock<std::mutex> lockGuard(mLock);
+        }
+        mCond.notify_one();
+    }
+};
+
+// Consumes items from a MpscRingQueue in batches on a separate thread.
+//
+// A batch is delivered as soon as maxBatchSize items are available, or once batchWindow has
+// passed since the first item of the batch arrived, whichever happens first.
+template <typename T>
+class AdaptiveBatchingConsumer {
+  private:
+    enum class State {
+        INIT = 0,
+        RUNNING = 1,
+        STOP_REQUESTED = 2,
+        STOPPED = 3,
+    };
+
+  public:
+    AdaptiveBatchingConsumer() : mState(State::INIT) {}
+
+    AdaptiveBatchingConsumer(const AdaptiveBatchingConsumer&) = delete;
+    AdaptiveBatchingConsumer& operator=(const AdaptiveBatchingConsumer&) = delete;
+
+    using OnBatchReceivedFunc = std::function<void(std::vector<T> vec)>;
+
+    void run(MpscRingQueue<T>* queue, std::chrono::nanoseconds batchWindow, size_t maxBatchSize,
+             const OnBatchReceivedFunc& func) {
+        mQueue = queue;
+        mBatchWindow = batchWindow;
+        mMaxBatchSize = maxBatchSize;
+
+        mWorkerThread = std::thread(&AdaptiveBatchingConsumer<T>::runInternal, this, func);
+    }
+
+    // The queue must be deactivated before requesting stop to unblock the worker thread.
+    void requestStop() { mState = State::STOP_REQUESTED; }
+
+    void waitStopped() {
+        if (mWorkerThread.joinable()) {
+            mWorkerThread.join();
+        }
+    }
+
+    // The number of items in the queue when a new batch starts.
+    const Log2Histogram& getQueueDepthHistogram() const { return mQueueDepthHistogram; }
+
+    // The number of items in each delivered batch.
+    const Log2Histogram& getBatchSizeHistogram() const { return mBatchSizeHistogram; }
+
+  private:
+    void runInternal(const OnBatchReceivedFunc& onBatchReceived) {
+        if (mState.exchange(State::RUNNING) == State::INIT) {
+            while (State::RUNNING == mState) {
+                mQueue->waitForItems();
+                if (State::STOP_REQUESTED == mState) break;
+
+                auto deadline = std::chrono::steady_clock::now() + mBatchWindow;
+                std::vector<T> items;
+                items.reserve(mMaxBatchSize);
+                mQueueDepthHistogram.record(mQueue->size());
+                mQueue->popAll(&items, mMaxBatchSize);
+                while (items.size() < mMaxBatchSize && State::RUNNING == mState) {
+                    // Only wakes up early if the batch could be filled.
+                    bool filled = mQueue->waitForItemsUntil(mMaxBatchSize - items.size(), deadline);
+                    mQueue->popAll(&items, mMaxBatchSize - items.size());
+                    if (!filled) {
+                        // The deadline passed or the queue is deactivated.
+                        break;
+                    }
+                }
+                if (State::STOP_REQUESTED == mState) break;
+
+                if (items.size() > 0) {
+                    mBatchSizeHistogram.record(items.size());
+                    onBatchReceived(std::move(items));
+                }
+            }
+        }
+
+        mState = State::STOPPED;
+    }
+
+  private:
+    std::thread mWorkerThread;
+
+    std::atomic<State> mState;
+    std::chrono::nanoseconds mBatchWindow;
+    size_t mMaxBatchSize;
+    MpscRingQueue<T>* mQueue;
+    Log2Histogram mQueueDepthHistogram;
+    Log2Histogram mBatchSizeHistogram;
+};
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_aidl_impl_utils_common_include_MpscRingQueue_H_
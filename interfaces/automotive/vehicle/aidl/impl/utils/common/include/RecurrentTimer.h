@@ -21,6 +21,7 @@
 
 #include <utils/Looper.h>
 #include <atomic>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <queue>
@@ -37,6 +38,12 @@ namespace vehicle {
 class RecurrentMessageHandler;
 
 // A thread-safe recurrent timer.
+//
+// Callbacks are kept in a hierarchical timing wheel with a resolution of one tick (1ms). All the
+// callbacks that are due in the same tick are fired in one wakeup of the timer thread, and there
+// is at most one pending looper message at any time. Callback deadlines are aligned to multiples
+// of their interval since boot, so callbacks with harmonic intervals (e.g. 10hz and 20hz) share
+// the same wakeups.
 class RecurrentTimer final {
   public:
     // The class for the function that would be called recurrently.
@@ -53,6 +60,9 @@ class RecurrentTimer final {
     // Unregisters a previously registered recurrent callback.
     void unregisterTimerCallback(std::shared_ptr<Callback> callback);
 
+    // Returns how many times the timer thread has woken up to fire callbacks. Only for statistics.
+    uint64_t getWakeupCount() const;
+
   private:
     friend class RecurrentMessageHandler;
 
@@ -63,6 +73,15 @@ class RecurrentTimer final {
         std::shared_ptr<Callback> callback;
         int64_t intervalInNanos;
         int64_t nextTimeInNanos;
+        // Increased every time the callback is scheduled, so that outdated wheel entries for a
+        // re-registered callback can be identified and dropped.
+        uint64_t generation;
+    };
+
+    struct WheelEntry {
+        int callbackId;
+        uint64_t generation;
+        int64_t expiryTick;
     };
 
     android::sp<Looper> mLooper;
@@ -70,13 +89,34 @@ class RecurrentTimer final {
 
     std::atomic<bool> mStopRequested = false;
     std::atomic<int> mCallbackId = 0;
+    std::atomic<uint64_t> mWakeupCount = 0;
     std::mutex mLock;
     std::thread mThread;
     std::unordered_map<std::shared_ptr<Callback>, int> mIdByCallback GUARDED_BY(mLock);
     std::unordered_map<int, std::unique_ptr<CallbackInfo>> mCallbackInfoById GUARDED_BY(mLock);
+    // The timing wheel, indexed by [level][slot].
+    std::vector<std::vector<std::vector<WheelEntry>>> mWheel GUARDED_BY(mLock);
+    // The number of entries (including outdated ones) for each level of the wheel.
+    std::vector<size_t> mEntryCountByLevel GUARDED_BY(mLock);
+    // All the entries that expire at or before this tick have been processed.
+    int64_t mCurrentTick GUARDED_BY(mLock) = 0;
+    // The tick the pending looper message is scheduled for, INT64_MAX if there is none.
+    int64_t mScheduledTick GUARDED_BY(mLock) = INT64_MAX;
 
     void handleMessage(const android::Message& message) EXCLUDES(mLock);
     int getCallbackIdLocked(std::shared_ptr<Callback> callback) REQUIRES(mLock);
+    // Puts the callback into the wheel according to its nextTimeInNanos.
+    void scheduleLocked(int callbackId, CallbackInfo* callbackInfo) REQUIRES(mLock);
+    void insertEntryLocked(const WheelEntry& entry) REQUIRES(mLock);
+    // Moves all the entries from the given slot of an upper level to lower levels.
+    void cascadeLocked(size_t level, int64_t tick) REQUIRES(mLock);
+    // Advances the wheel to targetTick, appending all the expired entries to expiredEntries.
+    void advanceLocked(int64_t targetTick, std::vector<WheelEntry>* expiredEntries)
+            REQUIRES(mLock);
+    // Returns the next tick at which the wheel has to be advanced, INT64_MAX if the wheel is empty.
+    int64_t findNextTickLocked() const REQUIRES(mLock);
+    // Makes sure the pending looper message matches the next tick of the wheel.
+    void updateLooperMessageLocked() REQUIRES(mLock);
 };
 
 class RecurrentMessageHandler final : public android::MessageHandler {
@@ -21,6 +21,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 
 #include <VehicleHalTypes.h>
@@ -40,7 +41,10 @@ namespace vehicle {
 // VehiclePropertyValues stored in a sorted map thus it makes easier to get range of values, e.g.
 // to get value for all areas for particular property.
 //
-// This class is thread-safe, however it uses blocking synchronization across all methods.
+// This class is thread-safe. Values are sharded by property ID: every registered property owns
+// its own lock, so reads and writes for different properties never contend with each other. The
+// property registry and the change callbacks are guarded by a reader-writer lock which is only
+// held exclusively while registering properties or setting callbacks.
 class VehiclePropertyStore final {
   public:
     using ValueResultType = VhalResult<VehiclePropValuePool::RecyclableType>;
@@ -191,27 +195,47 @@ class VehiclePropertyStore final {
     };
 
     struct Record {
+        // propConfig and tokenFunction are immutable once the record is registered.
         aidl::android::hardware::automotive::vehicle::VehiclePropConfig propConfig;
         TokenFunction tokenFunction;
-        std::unordered_map<RecordId, VehiclePropValuePool::RecyclableType, RecordIdHash> values;
+        // Per-property lock, only guards the values for this property.
+        mutable std::mutex lock;
+        std::unordered_map<RecordId, VehiclePropValuePool::RecyclableType, RecordIdHash> values
+                GUARDED_BY(lock);
+    };
+
+    // std::shared_lock is not annotated for the thread safety analysis, this is.
+    class SCOPED_CAPABILITY SharedLock final {
+      public:
+        explicit SharedLock(std::shared_mutex& mutex) ACQUIRE_SHARED(mutex) : mMutex(mutex) {
+            mMutex.lock_shared();
+        }
+        ~SharedLock() RELEASE() { mMutex.unlock_shared(); }
+
+      private:
+        std::shared_mutex& mMutex;
     };
 
     // {@code VehiclePropValuePool} is thread-safe.
     std::shared_ptr<VehiclePropValuePool> mValuePool;
-    mutable std::mutex mLock;
-    std::unordered_map<int32_t, Record> mRecordsByPropId GUARDED_BY(mLock);
+    // Held in shared mode to look up records or read callbacks, held exclusively to modify them.
+    mutable std::shared_mutex mLock;
+    // Records are never removed once registered (only replaced by registerProperty), so a record
+    // pointer stays valid as long as mLock is held in shared mode.
+    std::unordered_map<int32_t, std::unique_ptr<Record>> mRecordsByPropId GUARDED_BY(mLock);
     OnValueChangeCallback mOnValueChangeCallback GUARDED_BY(mLock);
     OnValuesChangeCallback mOnValuesChangeCallback GUARDED_BY(mLock);
 
-    const Record* getRecordLocked(int32_t propId) const;
+    const Record* getRecordLocked(int32_t propId) const REQUIRES_SHARED(mLock);
 
-    Record* getRecordLocked(int32_t propId);
+    Record* getRecordLocked(int32_t propId) REQUIRES_SHARED(mLock);
 
-    RecordId getRecordIdLocked(
+    RecordId getRecordId(
             const aidl::android::hardware::automotive::vehicle::VehiclePropValue& propValue,
             const Record& record) const;
 
-    ValueResultType readValueLocked(const RecordId& recId, const Record& record) const;
+    ValueResultType readValueLocked(const RecordId& recId, const Record& record) const
+            REQUIRES(record.lock);
 };
 
 }  // namespace vehicle
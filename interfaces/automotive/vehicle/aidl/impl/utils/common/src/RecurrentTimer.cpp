@@ -21,7 +21,8 @@
 #include <utils/SystemClock.h>
 
 #include <inttypes.h>
-#include <math.h>
+
+#include <algorithm>
 
 namespace android {
 namespace hardware {
@@ -34,9 +35,45 @@ using ::android::base::ScopedLockAssertion;
 
 constexpr int INVALID_ID = -1;
 
+// The resolution of the timing wheel. Callbacks due within the same tick are fired together.
+constexpr int64_t TICK_IN_NANOS = 1'000'000;
+// Level 0 has 2^8 slots spanning one tick each. Every upper level has 2^6 slots, each spanning a
+// full rotation of the level below. With 3 levels, deadlines up to 2^20 ticks (~17min) ahead are
+// placed exactly, further deadlines are parked in the last level and re-cascaded.
+constexpr size_t LEVEL_0_BITS = 8;
+constexpr size_t UPPER_LEVEL_BITS = 6;
+constexpr size_t LEVEL_COUNT = 3;
+
+size_t getLevelShift(size_t level) {
+    return level == 0 ? 0 : LEVEL_0_BITS + (level - 1) * UPPER_LEVEL_BITS;
+}
+
+size_t getLevelSlotCount(size_t level) {
+    return level == 0 ? (1 << LEVEL_0_BITS) : (1 << UPPER_LEVEL_BITS);
+}
+
+size_t getSlotIndex(size_t level, int64_t tick) {
+    return (tick >> getLevelShift(level)) & (getLevelSlotCount(level) - 1);
+}
+
+// Aligns the time to the next multiple of interval since boot, so that callbacks with harmonic
+// intervals have the same deadlines.
+int64_t alignToInterval(int64_t timeInNanos, int64_t intervalInNanos) {
+    return (timeInNanos + intervalInNanos - 1) / intervalInNanos * intervalInNanos;
+}
+
 }  // namespace
 
 RecurrentTimer::RecurrentTimer() {
+    {
+        std::scoped_lock<std::mutex> lockGuard(mLock);
+
+        for (size_t level = 0; level < LEVEL_COUNT; level++) {
+            mWheel.emplace_back(getLevelSlotCount(level));
+        }
+        mEntryCountByLevel.resize(LEVEL_COUNT, 0);
+    }
+
     mHandler = sp<RecurrentMessageHandler>::make(this);
     mLooper = sp<Looper>::make(/*allowNonCallbacks=*/false);
     mThread = std::thread([this] {
@@ -57,6 +94,10 @@ RecurrentTimer::~RecurrentTimer() {
     }
 }
 
+uint64_t RecurrentTimer::getWakeupCount() const {
+    return mWakeupCount;
+}
+
 int RecurrentTimer::getCallbackIdLocked(std::shared_ptr<RecurrentTimer::Callback> callback) {
     const auto& it = mIdByCallback.find(callback);
     if (it != mIdByCallback.end()) {
@@ -65,33 +106,156 @@ int RecurrentTimer::getCallbackIdLocked(std::shared_ptr<RecurrentTimer::Callback
     return INVALID_ID;
 }
 
+void RecurrentTimer::insertEntryLocked(const WheelEntry& entry) {
+    int64_t delta = entry.expiryTick - mCurrentTick;
+    size_t level = 0;
+    while (level < LEVEL_COUNT - 1 && delta >= (int64_t{1} << getLevelShift(level + 1))) {
+        level++;
+    }
+    // Deadlines beyond the range of the last level are parked in its furthest slot and placed
+    // again when that slot is cascaded.
+    int64_t maxTick = mCurrentTick + (int64_t{1} << getLevelShift(LEVEL_COUNT)) - 1;
+    int64_t slotTick = std::min(entry.expiryTick, maxTick);
+
+    mWheel[level][getSlotIndex(level, slotTick)].push_back(entry);
+    mEntryCountByLevel[level]++;
+}
+
+void RecurrentTimer::scheduleLocked(int callbackId, CallbackInfo* callbackInfo) {
+    bool wheelEmpty = true;
+    for (size_t count : mEntryCountByLevel) {
+        if (count != 0) {
+            wheelEmpty = false;
+            break;
+        }
+    }
+    if (wheelEmpty) {
+        // Nothing to process in between, fast forward instead of walking through idle ticks.
+        mCurrentTick = std::max(mCurrentTick, uptimeNanos() / TICK_IN_NANOS);
+    }
+
+    callbackInfo->generation++;
+    int64_t expiryTick = (callbackInfo->nextTimeInNanos + TICK_IN_NANOS - 1) / TICK_IN_NANOS;
+    insertEntryLocked(WheelEntry{
+            .callbackId = callbackId,
+            .generation = callbackInfo->generation,
+            .expiryTick = std::max(expiryTick, mCurrentTick + 1),
+    });
+}
+
+void RecurrentTimer::cascadeLocked(size_t level, int64_t tick) {
+    size_t index = getSlotIndex(level, tick);
+    if (index == 0 && level + 1 < LEVEL_COUNT) {
+        // This level finished a rotation, refill it from the level above first.
+        cascadeLocked(level + 1, tick);
+    }
+
+    std::vector<WheelEntry> entries = std::move(mWheel[level][index]);
+    mWheel[level][index].clear();
+    mEntryCountByLevel[level] -= entries.size();
+    for (const WheelEntry& entry : entries) {
+        insertEntryLocked(entry);
+    }
+}
+
+void RecurrentTimer::advanceLocked(int64_t targetTick, std::vector<WheelEntry>* expiredEntries) {
+    while (mCurrentTick < targetTick) {
+        if (mEntryCountByLevel[0] == 0) {
+            // Level 0 is empty, skip straight to the next rotation boundary.
+            int64_t nextBoundary = ((mCurrentTick >> LEVEL_0_BITS) + 1) << LEVEL_0_BITS;
+            if (nextBoundary > targetTick) {
+                mCurrentTick = targetTick;
+                return;
+            }
+            mCurrentTick = nextBoundary - 1;
+        }
+
+        mCurrentTick++;
+        if (getSlotIndex(0, mCurrentTick) == 0) {
+            cascadeLocked(1, mCurrentTick);
+        }
+
+        std::vector<WheelEntry>& slot = mWheel[0][getSlotIndex(0, mCurrentTick)];
+        mEntryCountByLevel[0] -= slot.size();
+        expiredEntries->insert(expiredEntries->end(), slot.begin(), slot.end());
+        slot.clear();
+    }
+}
+
+int64_t RecurrentTimer::findNextTickLocked() const {
+    int64_t nextTick = INT64_MAX;
+    if (mEntryCountByLevel[0] != 0) {
+        int64_t endTick = mCurrentTick + static_cast<int64_t>(getLevelSlotCount(0));
+        for (int64_t tick = mCurrentTick + 1; tick < endTick; tick++) {
+            if (!mWheel[0][getSlotIndex(0, tick)].empty()) {
+                nextTick = tick;
+                break;
+            }
+        }
+    }
+    // Entries in upper levels only need a wakeup at the boundary where their slot is cascaded.
+    for (size_t level = 1; level < LEVEL_COUNT; level++) {
+        if (mEntryCountByLevel[level] == 0) {
+            continue;
+        }
+        size_t shift = getLevelShift(level);
+        int64_t slotCount = static_cast<int64_t>(getLevelSlotCount(level));
+        for (int64_t i = 1; i <= slotCount; i++) {
+            int64_t boundaryTick = ((mCurrentTick >> shift) + i) << shift;
+            if (boundaryTick >= nextTick) {
+                break;
+            }
+            if (!mWheel[level][getSlotIndex(level, boundaryTick)].empty()) {
+                nextTick = boundaryTick;
+                break;
+            }
+        }
+    }
+    return nextTick;
+}
+
+void RecurrentTimer::updateLooperMessageLocked() {
+    int64_t nextTick = findNextTickLocked();
+    if (nextTick == mScheduledTick) {
+        return;
+    }
+    mLooper->removeMessages(mHandler);
+    mScheduledTick = nextTick;
+    if (nextTick != INT64_MAX) {
+        mLooper->sendMessageAtTime(nextTick * TICK_IN_NANOS, mHandler, Message());
+    }
+}
+
 void RecurrentTimer::registerTimerCallback(int64_t intervalInNanos,
                                            std::shared_ptr<RecurrentTimer::Callback> callback) {
     {
         std::scoped_lock<std::mutex> lockGuard(mLock);
 
         int callbackId = getCallbackIdLocked(callback);
+        CallbackInfo* info = nullptr;
 
         if (callbackId == INVALID_ID) {
             callbackId = mCallbackId++;
             mIdByCallback.insert({callback, callbackId});
+            auto newInfo = std::make_unique<CallbackInfo>();
+            newInfo->callback = callback;
+            newInfo->generation = 0;
+            info = newInfo.get();
+            mCallbackInfoById.insert({callbackId, std::move(newInfo)});
         } else {
+            info = mCallbackInfoById[callbackId].get();
             ALOGI("Replacing an existing timer callback with a new interval, current: %" PRId64
                   " ns, new: %" PRId64 " ns",
-                  mCallbackInfoById[callbackId]->intervalInNanos, intervalInNanos);
-            mLooper->removeMessages(mHandler, callbackId);
+                  info->intervalInNanos, intervalInNanos);
         }
 
-        // Aligns the nextTime to multiply of interval.
-        int64_t nextTimeInNanos = ceil(uptimeNanos() / intervalInNanos) * intervalInNanos;
-
-        std::unique_ptr<CallbackInfo> info = std::make_unique<CallbackInfo>();
-        info->callback = callback;
+        // Aligns the nextTime to multiply of interval. The existing wheel entry for a replaced
+        // callback becomes outdated because scheduleLocked increases the generation.
         info->intervalInNanos = intervalInNanos;
-        info->nextTimeInNanos = nextTimeInNanos;
-        mCallbackInfoById.insert({callbackId, std::move(info)});
+        info->nextTimeInNanos = alignToInterval(uptimeNanos(), intervalInNanos);
+        scheduleLocked(callbackId, info);
 
-        mLooper->sendMessageAtTime(nextTimeInNanos, mHandler, Message(callbackId));
+        updateLooperMessageLocked();
     }
 }
 
@@ -106,37 +270,51 @@ void RecurrentTimer::unregisterTimerCallback(std::shared_ptr<RecurrentTimer::Cal
             return;
         }
 
-        mLooper->removeMessages(mHandler, callbackId);
+        // The wheel entry is dropped lazily once it expires.
         mCallbackInfoById.erase(callbackId);
         mIdByCallback.erase(callback);
     }
 }
 
-void RecurrentTimer::handleMessage(const Message& message) {
-    std::shared_ptr<RecurrentTimer::Callback> callback;
+void RecurrentTimer::handleMessage(const Message&) {
+    std::vector<std::shared_ptr<RecurrentTimer::Callback>> callbacks;
     {
         std::scoped_lock<std::mutex> lockGuard(mLock);
 
-        int callbackId = message.what;
+        // The pending message is being handled.
+        mScheduledTick = INT64_MAX;
 
-        auto it = mCallbackInfoById.find(callbackId);
-        if (it == mCallbackInfoById.end()) {
-            ALOGW("The event for callback ID: %d is outdated, ignore", callbackId);
-            return;
-        }
-
-        CallbackInfo* callbackInfo = it->second.get();
-        callback = callbackInfo->callback;
         int64_t nowNanos = uptimeNanos();
-        // intervalCount is the number of interval we have to advance until we pass now.
-        size_t intervalCount =
-                (nowNanos - callbackInfo->nextTimeInNanos) / callbackInfo->intervalInNanos + 1;
-        callbackInfo->nextTimeInNanos += intervalCount * callbackInfo->intervalInNanos;
+        std::vector<WheelEntry> expiredEntries;
+        advanceLocked(nowNanos / TICK_IN_NANOS, &expiredEntries);
 
-        mLooper->sendMessageAtTime(callbackInfo->nextTimeInNanos, mHandler, Message(callbackId));
+        for (const WheelEntry& entry : expiredEntries) {
+            auto it = mCallbackInfoById.find(entry.callbackId);
+            if (it == mCallbackInfoById.end() || it->second->generation != entry.generation) {
+                // The callback was unregistered or re-registered.
+                continue;
+            }
+
+            CallbackInfo* callbackInfo = it->second.get();
+            callbacks.push_back(callbackInfo->callback);
+            // intervalCount is the number of interval we have to advance until we pass now.
+            int64_t intervalCount =
+                    (nowNanos - callbackInfo->nextTimeInNanos) / callbackInfo->intervalInNanos + 1;
+            callbackInfo->nextTimeInNanos += intervalCount * callbackInfo->intervalInNanos;
+            scheduleLocked(entry.callbackId, callbackInfo);
+        }
+
+        updateLooperMessageLocked();
     }
 
-    (*callback)();
+    if (callbacks.empty()) {
+        return;
+    }
+    mWakeupCount++;
+    // Invoke the callbacks outside the lock to prevent dead-lock.
+    for (const auto& callback : callbacks) {
+        (*callback)();
+    }
 }
 
 void RecurrentMessageHandler::handleMessage(const Message& message) {
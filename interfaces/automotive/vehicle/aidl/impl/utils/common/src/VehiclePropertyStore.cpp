@@ -56,7 +56,7 @@ size_t VehiclePropertyStore::RecordIdHash::operator()(RecordId const& recordId)
 }
 
 VehiclePropertyStore::~VehiclePropertyStore() {
-    std::scoped_lock<std::mutex> lockGuard(mLock);
+    std::scoped_lock<std::shared_mutex> lockGuard(mLock);
 
     // Recycling record requires mValuePool, so need to recycle them before destroying mValuePool.
     mRecordsByPropId.clear();
@@ -64,20 +64,19 @@ VehiclePropertyStore::~VehiclePropertyStore() {
 }
 
 const VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(int32_t propId) const
-        REQUIRES(mLock) {
+        REQUIRES_SHARED(mLock) {
     auto RecordIt = mRecordsByPropId.find(propId);
-    return RecordIt == mRecordsByPropId.end() ? nullptr : &RecordIt->second;
+    return RecordIt == mRecordsByPropId.end() ? nullptr : RecordIt->second.get();
 }
 
 VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(int32_t propId)
-        REQUIRES(mLock) {
+        REQUIRES_SHARED(mLock) {
     auto RecordIt = mRecordsByPropId.find(propId);
-    return RecordIt == mRecordsByPropId.end() ? nullptr : &RecordIt->second;
+    return RecordIt == mRecordsByPropId.end() ? nullptr : RecordIt->second.get();
 }
 
-VehiclePropertyStore::RecordId VehiclePropertyStore::getRecordIdLocked(
-        const VehiclePropValue& propValue, const VehiclePropertyStore::Record& record) const
-        REQUIRES(mLock) {
+VehiclePropertyStore::RecordId VehiclePropertyStore::getRecordId(
+        const VehiclePropValue& propValue, const VehiclePropertyStore::Record& record) const {
     VehiclePropertyStore::RecordId recId{
             .area = isGlobalProp(propValue.prop) ? 0 : propValue.areaId, .token = 0};
 
@@ -88,7 +87,7 @@ VehiclePropertyStore::RecordId VehiclePropertyStore::getRecordIdLocked(
 }
 
 VhalResult<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readValueLocked(
-        const RecordId& recId, const Record& record) const REQUIRES(mLock) {
+        const RecordId& recId, const Record& record) const REQUIRES(record.lock) {
     if (auto it = record.values.find(recId); it != record.values.end()) {
         return mValuePool->obtain(*(it->second));
     }
@@ -98,12 +97,13 @@ VhalResult<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readValue
 
 void VehiclePropertyStore::registerProperty(const VehiclePropConfig& config,
                                             VehiclePropertyStore::TokenFunction tokenFunc) {
-    std::scoped_lock<std::mutex> g(mLock);
+    auto record = std::make_unique<Record>();
+    record->propConfig = config;
+    record->tokenFunction = tokenFunc;
 
-    mRecordsByPropId[config.prop] = Record{
-            .propConfig = config,
-            .tokenFunction = tokenFunc,
-    };
+    std::scoped_lock<std::shared_mutex> g(mLock);
+
+    mRecordsByPropId[config.prop] = std::move(record);
 }
 
 VhalResult<void> VehiclePropertyStore::writeValue(VehiclePropValuePool::RecyclableType propValue,
@@ -114,19 +114,9 @@ VhalResult<void> VehiclePropertyStore::writeValue(VehiclePropValuePool::Recyclab
     VehiclePropValue updatedValue;
     OnValueChangeCallback onValueChangeCallback = nullptr;
     OnValuesChangeCallback onValuesChangeCallback = nullptr;
-    int32_t propId;
-    int32_t areaId;
+    int32_t propId = propValue->prop;
     {
-        std::scoped_lock<std::mutex> g(mLock);
-
-        // Must set timestamp inside the lock to make sure no other writeValue will update the
-        // the timestamp to a newer one while we are writing this value.
-        if (useCurrentTimestamp) {
-            propValue->timestamp = elapsedRealtimeNano();
-        }
-
-        propId = propValue->prop;
-        areaId = propValue->areaId;
+        SharedLock registryLock(mLock);
 
         VehiclePropertyStore::Record* record = getRecordLocked(propId);
         if (record == nullptr) {
@@ -139,34 +129,51 @@ VhalResult<void> VehiclePropertyStore::writeValue(VehiclePropValuePool::Recyclab
                    << "no config for property: " << propId << " area ID: " << propValue->areaId;
         }
 
-        VehiclePropertyStore::RecordId recId = getRecordIdLocked(*propValue, *record);
-        if (auto it = record->values.find(recId); it != record->values.end()) {
-            const VehiclePropValue* valueToUpdate = it->second.get();
-            int64_t oldTimestampNanos = valueToUpdate->timestamp;
-            VehiclePropertyStatus oldStatus = valueToUpdate->status;
-            // propValue is outdated and drops it.
-            if (oldTimestampNanos > propValue->timestamp) {
-                return StatusError(StatusCode::INVALID_ARG)
-                       << "outdated timestampNanos: " << propValue->timestamp;
-            }
-            if (!updateStatus) {
-                propValue->status = oldStatus;
+        {
+            std::scoped_lock<std::mutex> recordLock(record->lock);
+
+            // Must set timestamp inside the record lock to make sure no other writeValue will
+            // update the timestamp to a newer one while we are writing this value.
+            if (useCurrentTimestamp) {
+                propValue->timestamp = elapsedRealtimeNano();
             }
 
-            valueUpdated = (valueToUpdate->value != propValue->value ||
-                            valueToUpdate->status != propValue->status ||
-                            valueToUpdate->prop != propValue->prop ||
-                            valueToUpdate->areaId != propValue->areaId);
-        } else if (!updateStatus) {
-            propValue->status = VehiclePropertyStatus::AVAILABLE;
-        }
+            VehiclePropertyStore::RecordId recId = getRecordId(*propValue, *record);
+            if (auto it = record->values.find(recId); it != record->values.end()) {
+                const VehiclePropValue* valueToUpdate = it->second.get();
+                int64_t oldTimestampNanos = valueToUpdate->timestamp;
+                VehiclePropertyStatus oldStatus = valueToUpdate->status;
+                // propValue is outdated and drops it.
+                if (oldTimestampNanos > propValue->timestamp) {
+                    return StatusError(StatusCode::INVALID_ARG)
+                           << "outdated timestampNanos: " << propValue->timestamp;
+                }
+                if (!updateStatus) {
+                    propValue->status = oldStatus;
+                }
 
-        record->values[recId] = std::move(propValue);
+                valueUpdated = (valueToUpdate->value != propValue->value ||
+                                valueToUpdate->status != propValue->status ||
+                                valueToUpdate->prop != propValue->prop ||
+                                valueToUpdate->areaId != propValue->areaId);
+                if (eventMode != EventMode::NEVER) {
+                    updatedValue = *propValue;
+                }
+                it->second = std::move(propValue);
+            } else {
+                if (!updateStatus) {
+                    propValue->status = VehiclePropertyStatus::AVAILABLE;
+                }
+                if (eventMode != EventMode::NEVER) {
+                    updatedValue = *propValue;
+                }
+                record->values.emplace(recId, std::move(propValue));
+            }
+        }
 
         if (eventMode == EventMode::NEVER) {
             return {};
         }
-        updatedValue = *(record->values[recId]);
 
         onValuesChangeCallback = mOnValuesChangeCallback;
         onValueChangeCallback = mOnValueChangeCallback;
@@ -204,7 +211,7 @@ void VehiclePropertyStore::refreshTimestamps(
     OnValuesChangeCallback onValuesChangeCallback = nullptr;
     OnValueChangeCallback onValueChangeCallback = nullptr;
     {
-        std::scoped_lock<std::mutex> g(mLock);
+        SharedLock registryLock(mLock);
 
         onValuesChangeCallback = mOnValuesChangeCallback;
         onValueChangeCallback = mOnValueChangeCallback;
@@ -223,7 +230,8 @@ void VehiclePropertyStore::refreshTimestamps(
                     .value = {},
             };
 
-            VehiclePropertyStore::RecordId recId = getRecordIdLocked(propValue, *record);
+            VehiclePropertyStore::RecordId recId = getRecordId(propValue, *record);
+            std::scoped_lock<std::mutex> recordLock(record->lock);
             if (auto it = record->values.find(recId); it != record->values.end()) {
                 it->second->timestamp = elapsedRealtimeNano();
                 if (eventMode == EventMode::ALWAYS) {
@@ -259,37 +267,40 @@ void VehiclePropertyStore::refreshTimestamps(
 }
 
 void VehiclePropertyStore::removeValue(const VehiclePropValue& propValue) {
-    std::scoped_lock<std::mutex> g(mLock);
+    SharedLock registryLock(mLock);
 
     VehiclePropertyStore::Record* record = getRecordLocked(propValue.prop);
     if (record == nullptr) {
         return;
     }
 
-    VehiclePropertyStore::RecordId recId = getRecordIdLocked(propValue, *record);
+    VehiclePropertyStore::RecordId recId = getRecordId(propValue, *record);
+    std::scoped_lock<std::mutex> recordLock(record->lock);
     if (auto it = record->values.find(recId); it != record->values.end()) {
         record->values.erase(it);
     }
 }
 
 void VehiclePropertyStore::removeValuesForProperty(int32_t propId) {
-    std::scoped_lock<std::mutex> g(mLock);
+    SharedLock registryLock(mLock);
 
     VehiclePropertyStore::Record* record = getRecordLocked(propId);
     if (record == nullptr) {
         return;
     }
 
+    std::scoped_lock<std::mutex> recordLock(record->lock);
     record->values.clear();
 }
 
 std::vector<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readAllValues() const {
-    std::scoped_lock<std::mutex> g(mLock);
+    SharedLock registryLock(mLock);
 
     std::vector<VehiclePropValuePool::RecyclableType> allValues;
 
     for (auto const& [_, record] : mRecordsByPropId) {
-        for (auto const& [_, value] : record.values) {
+        std::scoped_lock<std::mutex> recordLock(record->lock);
+        for (auto const& [_, value] : record->values) {
             allValues.push_back(std::move(mValuePool->obtain(*value)));
         }
     }
@@ -299,7 +310,7 @@ std::vector<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readAllV
 
 VehiclePropertyStore::ValuesResultType VehiclePropertyStore::readValuesForProperty(
         int32_t propId) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    SharedLock registryLock(mLock);
 
     std::vector<VehiclePropValuePool::RecyclableType> values;
 
@@ -308,6 +319,7 @@ VehiclePropertyStore::ValuesResultType VehiclePropertyStore::readValuesForProper
         return StatusError(StatusCode::INVALID_ARG) << "property: " << propId << " not registered";
     }
 
+    std::scoped_lock<std::mutex> recordLock(record->lock);
     for (auto const& [_, value] : record->values) {
         values.push_back(std::move(mValuePool->obtain(*value)));
     }
@@ -316,7 +328,7 @@ VehiclePropertyStore::ValuesResultType VehiclePropertyStore::readValuesForProper
 
 VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(
         const VehiclePropValue& propValue) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    SharedLock registryLock(mLock);
 
     int32_t propId = propValue.prop;
     const VehiclePropertyStore::Record* record = getRecordLocked(propId);
@@ -324,14 +336,15 @@ VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(
         return StatusError(StatusCode::INVALID_ARG) << "property: " << propId << " not registered";
     }
 
-    VehiclePropertyStore::RecordId recId = getRecordIdLocked(propValue, *record);
+    VehiclePropertyStore::RecordId recId = getRecordId(propValue, *record);
+    std::scoped_lock<std::mutex> recordLock(record->lock);
     return readValueLocked(recId, *record);
 }
 
 VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(int32_t propId,
                                                                       int32_t areaId,
                                                                       int64_t token) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    SharedLock registryLock(mLock);
 
     const VehiclePropertyStore::Record* record = getRecordLocked(propId);
     if (record == nullptr) {
@@ -339,22 +352,23 @@ VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(int32_t pr
     }
 
     VehiclePropertyStore::RecordId recId{.area = isGlobalProp(propId) ? 0 : areaId, .token = token};
+    std::scoped_lock<std::mutex> recordLock(record->lock);
     return readValueLocked(recId, *record);
 }
 
 std::vector<VehiclePropConfig> VehiclePropertyStore::getAllConfigs() const {
-    std::scoped_lock<std::mutex> g(mLock);
+    SharedLock registryLock(mLock);
 
     std::vector<VehiclePropConfig> configs;
     configs.reserve(mRecordsByPropId.size());
-    for (auto& [_, config] : mRecordsByPropId) {
-        configs.push_back(config.propConfig);
+    for (auto& [_, record] : mRecordsByPropId) {
+        configs.push_back(record->propConfig);
     }
     return configs;
 }
 
 VhalResult<const VehiclePropConfig*> VehiclePropertyStore::getConfig(int32_t propId) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    SharedLock registryLock(mLock);
 
     const VehiclePropertyStore::Record* record = getRecordLocked(propId);
     if (record == nullptr) {
@@ -365,7 +379,7 @@ VhalResult<const VehiclePropConfig*> VehiclePropertyStore::getConfig(int32_t pro
 }
 
 VhalResult<VehiclePropConfig> VehiclePropertyStore::getPropConfig(int32_t propId) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    SharedLock registryLock(mLock);
 
     const VehiclePropertyStore::Record* record = getRecordLocked(propId);
     if (record == nullptr) {
@@ -377,14 +391,14 @@ VhalResult<VehiclePropConfig> VehiclePropertyStore::getPropConfig(int32_t propId
 
 void VehiclePropertyStore::setOnValueChangeCallback(
         const VehiclePropertyStore::OnValueChangeCallback& callback) {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::scoped_lock<std::shared_mutex> g(mLock);
 
     mOnValueChangeCallback = callback;
 }
 
 void VehiclePropertyStore::setOnValuesChangeCallback(
         const VehiclePropertyStore::OnValuesChangeCallback& callback) {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::scoped_lock<std::shared_mutex> g(mLock);
 
     mOnValuesChangeCallback = callback;
 }
@@ -210,6 +210,53 @@ TEST_F(RecurrentTimerTest, testRegisterSameCallbackMultipleTimes) {
     ASSERT_EQ(countIdByCallback(&timer), 0u);
 }
 
+TEST_F(RecurrentTimerTest, testHarmonicIntervalsShareWakeups) {
+    RecurrentTimer timer;
+    auto action1 = getCallback(1);
+    auto action2 = getCallback(2);
+    auto action3 = getCallback(3);
+    // 0.1s, 0.05s and 0.025s, all the deadlines for action1 and action2 are also deadlines for
+    // action3.
+    timer.registerTimerCallback(100'000'000, action1);
+    timer.registerTimerCallback(50'000'000, action2);
+    timer.registerTimerCallback(25'000'000, action3);
+
+    // In 1s, we should generate 10 + 20 + 40 = 70 events. Use 5s as timeout to be safe.
+    ASSERT_TRUE(waitForCalledCallbacks(/* count= */ 70u, /* timeoutInMs= */ 5000))
+            << "Not enough callbacks called before timeout";
+
+    timer.unregisterTimerCallback(action1);
+    timer.unregisterTimerCallback(action2);
+    timer.unregisterTimerCallback(action3);
+
+    size_t action3Count = 0;
+    std::vector<size_t> calledCallbacks = getCalledCallbacks();
+    for (size_t token : calledCallbacks) {
+        if (token == 3) {
+            action3Count++;
+        }
+    }
+
+    // Every wakeup fires action3, action1 and action2 must not cause extra wakeups.
+    ASSERT_LE(timer.getWakeupCount(), action3Count);
+    ASSERT_LT(timer.getWakeupCount(), calledCallbacks.size());
+}
+
+TEST_F(RecurrentTimerTest, testRegisterCallbackLongInterval) {
+    RecurrentTimer timer;
+    // 0.6s, longer than the first level of the timing wheel.
+    int64_t interval = 600'000'000;
+
+    auto action = getCallback(0);
+    timer.registerTimerCallback(interval, action);
+
+    // Should only takes 1.2s, use 5s as timeout to be safe.
+    ASSERT_TRUE(waitForCalledCallbacks(/* count= */ 2u, /* timeoutInMs= */ 5000))
+            << "Not enough callbacks called before timeout";
+
+    timer.unregisterTimerCallback(action);
+}
+
 TEST_F(RecurrentTimerTest, testRegisterCallbackMultipleTimesNoDeadLock) {
     // We want to avoid the following situation:
     // Caller holds a lock while calling registerTimerCallback, registerTimerCallback will try
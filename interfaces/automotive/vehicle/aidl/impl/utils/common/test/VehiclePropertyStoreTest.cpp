@@ -22,6 +22,9 @@
 #include <gtest/gtest.h>
 #include <utils/SystemClock.h>
 
+#include <atomic>
+#include <thread>
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -655,6 +658,51 @@ TEST_F(VehiclePropertyStoreTest, testRefreshTimestamps) {
     ASSERT_GE(updatedValues[1].timestamp, now);
 }
 
+TEST_F(VehiclePropertyStoreTest, testConcurrentWriteAndRead) {
+    constexpr int32_t kWritesPerThread = 1000;
+    std::atomic<int32_t> eventCount = 0;
+    mStore->setOnValuesChangeCallback(
+            [&eventCount](std::vector<VehiclePropValue> values) { eventCount += values.size(); });
+
+    std::vector<std::thread> threads;
+    for (int32_t areaId : {WHEEL_FRONT_LEFT, WHEEL_FRONT_RIGHT}) {
+        threads.emplace_back([this, areaId] {
+            for (int32_t i = 1; i <= kWritesPerThread; i++) {
+                ASSERT_RESULT_OK(mStore->writeValue(mValuePool->obtain(VehiclePropValue{
+                        .prop = toInt(VehicleProperty::TIRE_PRESSURE),
+                        .areaId = areaId,
+                        .value = {.floatValues = {static_cast<float>(i)}},
+                })));
+            }
+        });
+    }
+    threads.emplace_back([this] {
+        for (int32_t i = 1; i <= kWritesPerThread; i++) {
+            ASSERT_RESULT_OK(mStore->writeValue(mValuePool->obtain(VehiclePropValue{
+                    .prop = toInt(VehicleProperty::INFO_FUEL_CAPACITY),
+                    .value = {.floatValues = {static_cast<float>(i)}},
+            })));
+        }
+    });
+    threads.emplace_back([this] {
+        for (int32_t i = 0; i < kWritesPerThread; i++) {
+            mStore->readAllValues();
+            mStore->readValue(toInt(VehicleProperty::TIRE_PRESSURE), WHEEL_FRONT_LEFT);
+        }
+    });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Every write changes the value, so each write generates exactly one event.
+    ASSERT_EQ(eventCount, 3 * kWritesPerThread);
+    for (int32_t areaId : {WHEEL_FRONT_LEFT, WHEEL_FRONT_RIGHT}) {
+        auto result = mStore->readValue(toInt(VehicleProperty::TIRE_PRESSURE), areaId);
+        ASSERT_RESULT_OK(result);
+        ASSERT_EQ(result.value()->value.floatValues[0], static_cast<float>(kWritesPerThread));
+    }
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -15,12 +15,15 @@
  */
 
 #include <ConcurrentQueue.h>
+#include <MpscRingQueue.h>
 #include <PropertyUtils.h>
 #include <VehicleUtils.h>
 
 #include <gtest/gtest.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -764,6 +767,174 @@ TEST(VehicleUtilsTest, testConcurrentQueueDeactivateNotifyWaitingThread) {
     t.join();
 }
 
+TEST(VehicleUtilsTest, testMpscRingQueueOneThread) {
+    MpscRingQueue<int> queue(/*capacity=*/4);
+    std::vector<int> results;
+
+    ASSERT_TRUE(queue.push(1));
+    ASSERT_TRUE(queue.push(std::vector<int>({2, 3})));
+    ASSERT_EQ(queue.popAll(&results, /*maxCount=*/10), 3u);
+
+    ASSERT_EQ(results, std::vector<int>({1, 2, 3}));
+}
+
+TEST(VehicleUtilsTest, testMpscRingQueueFull) {
+    MpscRingQueue<int> queue(/*capacity=*/3);
+    std::vector<int> results;
+
+    ASSERT_EQ(queue.capacity(), 4u);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.tryPush(std::move(i)));
+    }
+    ASSERT_FALSE(queue.tryPush(4)) << "push to a full queue must fail";
+    ASSERT_EQ(queue.popAll(&results, /*maxCount=*/2), 2u);
+    ASSERT_TRUE(queue.tryPush(4));
+    ASSERT_EQ(queue.popAll(&results, /*maxCount=*/10), 3u);
+
+    ASSERT_EQ(results, std::vector<int>({0, 1, 2, 3, 4}));
+}
+
+TEST(VehicleUtilsTest, testMpscRingQueueMultipleThreads) {
+    // Smaller than the number of items so that producers have to wait for the consumer.
+    MpscRingQueue<int> queue(/*capacity=*/16);
+    std::vector<int> results;
+    std::atomic<bool> stop = false;
+
+    std::thread t1([&queue]() {
+        for (int i = 0; i < 1000; i++) {
+            queue.push(0);
+        }
+    });
+    std::thread t2([&queue]() {
+        for (int i = 0; i < 1000; i++) {
+            queue.push(1);
+        }
+    });
+    std::thread t3([&queue, &results, &stop]() {
+        while (!stop) {
+            queue.waitForItems();
+            queue.popAll(&results, /*maxCount=*/100);
+        }
+
+        // After we stop, get all the remaining values in the queue.
+        queue.popAll(&results, /*maxCount=*/100);
+    });
+
+    t1.join();
+    t2.join();
+
+    stop = true;
+    queue.deactivate();
+    t3.join();
+
+    size_t zeroCount = 0;
+    size_t oneCount = 0;
+    for (int i : results) {
+        if (i == 0) {
+            zeroCount++;
+        }
+        if (i == 1) {
+            oneCount++;
+        }
+    }
+
+    EXPECT_EQ(results.size(), static_cast<size_t>(2000));
+    EXPECT_EQ(zeroCount, static_cast<size_t>(1000));
+    EXPECT_EQ(oneCount, static_cast<size_t>(1000));
+}
+
+TEST(VehicleUtilsTest, testMpscRingQueuePushAfterDeactivate) {
+    MpscRingQueue<int> queue(/*capacity=*/4);
+    std::vector<int> results;
+
+    queue.deactivate();
+
+    ASSERT_FALSE(queue.push(1));
+    ASSERT_EQ(queue.popAll(&results, /*maxCount=*/10), 0u);
+}
+
+TEST(VehicleUtilsTest, testMpscRingQueueWaitForItemsUntilTimeout) {
+    MpscRingQueue<int> queue(/*capacity=*/4);
+    queue.push(1);
+
+    ASSERT_FALSE(queue.waitForItemsUntil(
+            /*minCount=*/2, std::chrono::steady_clock::now() + std::chrono::milliseconds(10)));
+    ASSERT_TRUE(queue.waitForItemsUntil(
+            /*minCount=*/1, std::chrono::steady_clock::now() + std::chrono::milliseconds(10)));
+}
+
+TEST(VehicleUtilsTest, testAdaptiveBatchingConsumerFlushOnFullBatch) {
+    MpscRingQueue<int> queue(/*capacity=*/16);
+    AdaptiveBatchingConsumer<int> consumer;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<std::vector<int>> batches;
+
+    // The batch window is long enough that only a full batch could be delivered in time.
+    consumer.run(&queue, std::chrono::seconds(10), /*maxBatchSize=*/4,
+                 [&lock, &cv, &batches](std::vector<int> batch) {
+                     std::scoped_lock<std::mutex> lockGuard(lock);
+                     batches.push_back(std::move(batch));
+                     cv.notify_all();
+                 });
+
+    queue.push(std::vector<int>({1, 2, 3, 4}));
+
+    {
+        std::unique_lock<std::mutex> uniqueLock(lock);
+        ASSERT_TRUE(cv.wait_for(uniqueLock, std::chrono::seconds(5),
+                                [&batches] { return !batches.empty(); }));
+        ASSERT_EQ(batches[0], std::vector<int>({1, 2, 3, 4}));
+    }
+
+    queue.deactivate();
+    consumer.requestStop();
+    consumer.waitStopped();
+
+    ASSERT_EQ(consumer.getBatchSizeHistogram().getCount(/*bucket=*/3), 1u);
+}
+
+TEST(VehicleUtilsTest, testAdaptiveBatchingConsumerFlushOnDeadline) {
+    MpscRingQueue<int> queue(/*capacity=*/16);
+    AdaptiveBatchingConsumer<int> consumer;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<std::vector<int>> batches;
+
+    consumer.run(&queue, std::chrono::milliseconds(10), /*maxBatchSize=*/100,
+                 [&lock, &cv, &batches](std::vector<int> batch) {
+                     std::scoped_lock<std::mutex> lockGuard(lock);
+                     batches.push_back(std::move(batch));
+                     cv.notify_all();
+                 });
+
+    queue.push(1);
+    queue.push(2);
+
+    {
+        std::unique_lock<std::mutex> uniqueLock(lock);
+        ASSERT_TRUE(cv.wait_for(uniqueLock, std::chrono::seconds(5),
+                                [&batches] { return !batches.empty(); }));
+        ASSERT_EQ(batches[0], std::vector<int>({1, 2}));
+    }
+
+    queue.deactivate();
+    consumer.requestStop();
+    consumer.waitStopped();
+}
+
+TEST(VehicleUtilsTest, testLog2Histogram) {
+    Log2Histogram histogram;
+
+    histogram.record(0);
+    histogram.record(1);
+    histogram.record(5);
+    histogram.record(7);
+    histogram.record(1'000'000);
+
+    ASSERT_EQ(histogram.toString(), "[0]: 1, [1]: 1, [4-7]: 2, [16384+]: 1");
+}
+
 TEST(VehicleUtilsTest, testVhalError) {
     VhalResult<void> result = Error<VhalError>(StatusCode::INVALID_ARG) << "error message";
 
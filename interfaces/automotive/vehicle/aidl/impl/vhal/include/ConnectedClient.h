@@ -18,6 +18,7 @@
 #define android_hardware_automotive_vehicle_aidl_impl_vhal_include_ConnectedClient_H_
 
 #include "PendingRequestPool.h"
+#include "SharedMemoryPool.h"
 
 #include <IVehicleHardware.h>
 #include <VehicleHalTypes.h>
@@ -28,6 +29,7 @@
 
 #include <memory>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace android {
@@ -110,6 +112,18 @@ class SubscriptionClient {
             CallbackType callback,
             std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>&&
                     updatedValues);
+    // A callback and the shared memory pool of its client, the pool might be nullptr.
+    using CallbackAndPool = std::pair<CallbackType, std::shared_ptr<SharedMemoryPool>>;
+
+    // Marshals the shared updated values once and sends them through {@code onPropertyEvent}
+    // callback to every callback in {@code callbacks}. If the values do not fit in the binder
+    // payload, a free shared memory file in the client's pool is reused if there is one,
+    // otherwise a one-off shared memory file shared by all the remaining callbacks is created.
+    static void sendUpdatedValues(
+            const std::vector<CallbackAndPool>& callbacks,
+            const std::vector<std::shared_ptr<
+                    const aidl::android::hardware::automotive::vehicle::VehiclePropValue>>&
+                    updatedValues);
     // Marshals the set property error events into largeParcelable and sends it through
     // {@code onPropertySetError} callback.
     static void sendPropertySetErrors(
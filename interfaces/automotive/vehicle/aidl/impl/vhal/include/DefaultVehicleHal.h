@@ -24,6 +24,7 @@
 #include <SubscriptionManager.h>
 
 #include <ConcurrentQueue.h>
+#include <MpscRingQueue.h>
 #include <IVehicleHardware.h>
 #include <VehicleUtils.h>
 #include <aidl/android/hardware/automotive/vehicle/BnVehicle.h>
@@ -131,6 +132,12 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
     static constexpr int64_t TIMEOUT_IN_NANO = 30'000'000'000;
     // heart beat event interval: 3s
     static constexpr int64_t HEART_BEAT_INTERVAL_IN_NANO = 3'000'000'000;
+    // The capacity of the batched property change event queue. Producers wait for the consumer
+    // if the queue is full.
+    static constexpr size_t EVENT_QUEUE_CAPACITY = 4096;
+    // A batch of property change events is delivered before the batching window ends if it
+    // reaches this size.
+    static constexpr size_t MAX_EVENT_BATCH_SIZE = 256;
     bool mShouldRefreshPropertyConfigs;
     std::unique_ptr<IVehicleHardware> mVehicleHardware;
 
@@ -144,12 +151,12 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
     std::shared_ptr<PendingRequestPool> mPendingRequestPool;
     // SubscriptionManager is thread-safe.
     std::shared_ptr<SubscriptionManager> mSubscriptionManager;
-    // ConcurrentQueue is thread-safe.
-    std::shared_ptr<ConcurrentQueue<aidl::android::hardware::automotive::vehicle::VehiclePropValue>>
+    // MpscRingQueue is thread-safe.
+    std::shared_ptr<MpscRingQueue<aidl::android::hardware::automotive::vehicle::VehiclePropValue>>
             mBatchedEventQueue;
-    // BatchingConsumer is thread-safe.
-    std::shared_ptr<
-            BatchingConsumer<aidl::android::hardware::automotive::vehicle::VehiclePropValue>>
+    // AdaptiveBatchingConsumer is thread-safe.
+    std::shared_ptr<AdaptiveBatchingConsumer<
+            aidl::android::hardware::automotive::vehicle::VehiclePropValue>>
             mPropertyChangeEventsBatchingConsumer;
     // Only set once during initialization.
     std::chrono::nanoseconds mEventBatchingWindow;
@@ -229,7 +236,7 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
 
     // Puts the property change events into a queue so that they can handled in batch.
     static void batchPropertyChangeEvent(
-            const std::weak_ptr<ConcurrentQueue<
+            const std::weak_ptr<MpscRingQueue<
                     aidl::android::hardware::automotive::vehicle::VehiclePropValue>>&
                     batchedEventQueue,
             std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>&&
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_aidl_impl_vhal_include_SharedMemoryPool_H_
+#define android_hardware_automotive_vehicle_aidl_impl_vhal_include_SharedMemoryPool_H_
+
+#include <android-base/result.h>
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+#include <android/binder_auto_utils.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+// A thread-safe pool of reusable shared memory files for one subscription client.
+//
+// A memory file handed to the client through {@code onPropertyEvent} cannot be reused until the
+// client returns it through {@code returnSharedMemory}. At most {@code maxFileCount} files are
+// ever created, so a client delivering large events repeatedly does not pay the cost of creating
+// a new memory file for every event.
+//
+// The content is written with pwrite instead of through a mapping, so a client that modifies or
+// truncates a file it holds could only corrupt its own events and can never crash the VHAL.
+class SharedMemoryPool final {
+  public:
+    explicit SharedMemoryPool(size_t maxFileCount);
+
+    // Grows the maximum number of files in the pool. A smaller count is ignored since the files
+    // might be in use.
+    void setMaxFileCount(size_t maxFileCount);
+
+    // Takes a free memory file (creating one if fewer than maxFileCount files exist), resizes it
+    // to {@code size} and copies {@code data} into it. The file is marked as in use until it is
+    // released.
+    // Returns the memory ID (never {@code IVehicle::INVALID_MEMORY_ID}) and a file descriptor
+    // for the file to be sent to the client. Returns error if all the files are in use or the
+    // file cannot be written, caller should then fall back to a one-off memory file.
+    android::base::Result<std::pair<int64_t, ndk::ScopedFileDescriptor>> write(const uint8_t* data,
+                                                                               size_t size);
+
+    // Marks the memory file as free so that it could be reused.
+    // Returns false if the memory ID does not refer to a file in use.
+    bool release(int64_t sharedMemoryId);
+
+    // Returns the number of memory files created in the pool.
+    size_t getFileCount() const;
+
+    std::string dump() const;
+
+  private:
+    struct MemoryFile {
+        android::base::unique_fd fd;
+        bool inUse = false;
+    };
+
+    mutable std::mutex mLock;
+    size_t mMaxFileCount GUARDED_BY(mLock);
+    // The memory ID for mFiles[i] is i + 1.
+    std::vector<MemoryFile> mFiles GUARDED_BY(mLock);
+    uint64_t mWriteCount GUARDED_BY(mLock) = 0;
+    uint64_t mExhaustedCount GUARDED_BY(mLock) = 0;
+};
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_aidl_impl_vhal_include_SharedMemoryPool_H_
@@ -18,6 +18,7 @@
 #define android_hardware_automotive_vehicle_aidl_impl_vhal_include_SubscriptionManager_H_
 
 #include <IVehicleHardware.h>
+#include <SharedMemoryPool.h>
 #include <VehicleHalTypes.h>
 #include <VehicleUtils.h>
 
@@ -25,8 +26,10 @@
 #include <android-base/result.h>
 #include <android-base/thread_annotations.h>
 
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -68,6 +71,8 @@ class SubscriptionManager final {
     using CallbackType =
             std::shared_ptr<aidl::android::hardware::automotive::vehicle::IVehicleCallback>;
     using VehiclePropValue = aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+    // An immutable property value that is shared by all the clients it is delivered to.
+    using SharedPropValue = std::shared_ptr<const VehiclePropValue>;
 
     explicit SubscriptionManager(IVehicleHardware* vehicleHardware);
     ~SubscriptionManager();
@@ -102,7 +107,12 @@ class SubscriptionManager final {
     // For a list of updated properties, returns a map that maps clients subscribing to
     // the updated properties to a list of updated values. This would only return on-change property
     // clients that should be informed for the given updated values.
-    std::unordered_map<CallbackType, std::vector<VehiclePropValue>> getSubscribedClients(
+    //
+    // Every updated value is stored once and the same immutable instance is shared by all the
+    // clients receiving it. Multiple values for the same continuous [propId, areaId] in one batch
+    // are collapsed into the newest one, since only the latest sample matters for continuous
+    // properties. On-change values are never collapsed because each of them is an event.
+    std::unordered_map<CallbackType, std::vector<SharedPropValue>> getSubscribedClients(
             std::vector<VehiclePropValue>&& updatedValues);
 
     // For a list of set property error events, returns a map that maps clients subscribing to the
@@ -114,6 +124,21 @@ class SubscriptionManager final {
     // Returns the number of subscribed clients.
     size_t countClients();
 
+    // Sets the maximum number of shared memory files used to deliver large property events to
+    // the client. The pool for a client only grows, and is removed once the client unsubscribes
+    // from all the properties. A count of 0 means no shared memory file is ever reused.
+    void setMaxSharedMemoryFileCount(ClientIdType client, int32_t maxSharedMemoryFileCount);
+
+    // Returns the shared memory pool for the client, or nullptr if the client does not use one.
+    std::shared_ptr<SharedMemoryPool> getSharedMemoryPool(ClientIdType client);
+
+    // Returns a shared memory file delivered to the client back to its pool.
+    // Returns error if the ID does not match any shared memory file in use by the client.
+    VhalResult<void> returnSharedMemory(ClientIdType client, int64_t sharedMemoryId);
+
+    // Dumps the states of all the shared memory pools.
+    std::string dumpSharedMemoryPools();
+
     // Checks whether the sample rate is valid.
     static bool checkSampleRateHz(float sampleRateHz);
 
@@ -123,19 +148,13 @@ class SubscriptionManager final {
 
     IVehicleHardware* mVehicleHardware;
 
-    struct VehiclePropValueHashPropIdAreaId {
-        inline size_t operator()(const VehiclePropValue& vehiclePropValue) const {
-            size_t res = 0;
-            hashCombine(res, vehiclePropValue.prop);
-            hashCombine(res, vehiclePropValue.areaId);
-            return res;
-        }
-    };
-
-    struct VehiclePropValueEqualPropIdAreaId {
-        inline bool operator()(const VehiclePropValue& left, const VehiclePropValue& right) const {
-            return left.prop == right.prop && left.areaId == right.areaId;
-        }
+    // The last value delivered to a VUR-enabled client for one [propId, areaId]. The value is the
+    // shared instance sent to the clients, so keeping it does not copy the payload, and the hash of
+    // its value and status lets most updated values be told apart without comparing the payloads.
+    struct ValueFingerprint {
+        int64_t timestamp;
+        uint64_t valueHash;
+        SharedPropValue value;
     };
 
     mutable std::mutex mLock;
@@ -147,9 +166,10 @@ class SubscriptionManager final {
     std::unordered_map<PropIdAreaId, ContSubConfigs, PropIdAreaIdHash> mContSubConfigsByPropIdArea
             GUARDED_BY(mLock);
     std::unordered_map<CallbackType,
-                       std::unordered_set<VehiclePropValue, VehiclePropValueHashPropIdAreaId,
-                                          VehiclePropValueEqualPropIdAreaId>>
-            mContSubValuesByCallback GUARDED_BY(mLock);
+                       std::unordered_map<PropIdAreaId, ValueFingerprint, PropIdAreaIdHash>>
+            mContSubFingerprintsByCallback GUARDED_BY(mLock);
+    std::unordered_map<ClientIdType, std::shared_ptr<SharedMemoryPool>> mSharedMemoryPoolByClient
+            GUARDED_BY(mLock);
 
     VhalResult<void> addContinuousSubscriberLocked(const ClientIdType& clientId,
                                                    const PropIdAreaId& propIdAreaId,
@@ -174,8 +194,11 @@ class SubscriptionManager final {
     // Checks whether the manager is empty. For testing purpose.
     bool isEmpty();
 
-    bool isValueUpdatedLocked(const CallbackType& callback, const VehiclePropValue& value)
-            REQUIRES(mLock);
+    bool isValueUpdatedLocked(const CallbackType& callback, const PropIdAreaId& propIdAreaId,
+                              const ValueFingerprint& fingerprint) REQUIRES(mLock);
+
+    // Computes the fingerprint for the value and status of the property value.
+    static ValueFingerprint getValueFingerprint(const SharedPropValue& value);
 
     // Get the interval in nanoseconds accroding to sample rate.
     static android::base::Result<int64_t> getIntervalNanos(float sampleRateHz);
@@ -19,9 +19,13 @@
 
 #include <VehicleHalTypes.h>
 
+#include <android/binder_auto_utils.h>
+#include <android/binder_parcel.h>
 #include <utils/Log.h>
 
 #include <inttypes.h>
+#include <algorithm>
+#include <optional>
 #include <unordered_set>
 #include <vector>
 
@@ -45,6 +49,10 @@ using ::aidl::android::hardware::automotive::vehicle::VehiclePropValues;
 using ::android::base::Result;
 using ::ndk::ScopedAStatus;
 
+// The same threshold LargeParcelableBase uses to decide whether to move the payloads into a shared
+// memory file.
+constexpr int32_t MAX_DIRECT_PAYLOAD_SIZE = 4096;
+
 // A function to call the specific callback based on results type.
 template <class T>
 ScopedAStatus callCallback(std::shared_ptr<IVehicleCallback> callback, const T& results);
@@ -156,6 +164,97 @@ void getOrSetValuesCallback(
     }
 }
 
+bool callOnPropertyEvent(const std::shared_ptr<IVehicleCallback>& callback,
+                         const VehiclePropValues& vehiclePropValues,
+                         int32_t sharedMemoryFileCount) {
+    if (ScopedAStatus callbackStatus =
+                callback->onPropertyEvent(vehiclePropValues, sharedMemoryFileCount);
+        !callbackStatus.isOk()) {
+        ALOGE("subscribe: failed to call onPropertyEvent callback, client ID: %p, error: %s, "
+              "exception: %d, service specific error: %d",
+              callback->asBinder().get(), callbackStatus.getMessage(),
+              callbackStatus.getExceptionCode(), callbackStatus.getServiceSpecificError());
+        return false;
+    }
+    return true;
+}
+
+// Marshals the updated values once and sends them to all the callbacks. Large values are written
+// into a free shared memory file from the client's pool if possible, otherwise into a one-off
+// shared memory file shared by all the remaining callbacks.
+void sendUpdatedValuesToCallbacks(const std::vector<SubscriptionClient::CallbackAndPool>& callbacks,
+                                  std::vector<VehiclePropValue>&& updatedValues) {
+    if (updatedValues.empty()) {
+        return;
+    }
+
+    VehiclePropValues vehiclePropValues;
+    vehiclePropValues.payloads = std::move(updatedValues);
+    // The values sent to the callbacks not using a pooled shared memory file.
+    std::optional<VehiclePropValues> oneOffValues;
+    // The marshaled values to be written into a pooled shared memory file, empty if the values
+    // fit in the binder payload.
+    std::vector<uint8_t> data;
+
+    bool hasPool = std::any_of(callbacks.begin(), callbacks.end(),
+                               [](const auto& callbackAndPool) {
+                                   return callbackAndPool.second != nullptr;
+                               });
+    if (hasPool) {
+        ndk::ScopedAParcel parcel(AParcel_create());
+        if (binder_status_t status = vehiclePropValues.writeToParcel(parcel.get());
+            status != STATUS_OK) {
+            ALOGE("subscribe: failed to marshal property values, error: %d", status);
+            return;
+        }
+        int32_t dataSize = AParcel_getDataSize(parcel.get());
+        if (dataSize <= MAX_DIRECT_PAYLOAD_SIZE) {
+            oneOffValues = std::move(vehiclePropValues);
+        } else {
+            data.resize(dataSize);
+            if (binder_status_t status = AParcel_marshal(parcel.get(), data.data(), 0, dataSize);
+                status != STATUS_OK) {
+                ALOGE("subscribe: failed to marshal property values, error: %d", status);
+                data.clear();
+            }
+        }
+    }
+
+    for (const auto& [callback, pool] : callbacks) {
+        if (pool != nullptr && !data.empty()) {
+            if (auto result = pool->write(data.data(), data.size()); result.ok()) {
+                VehiclePropValues pooledValues;
+                pooledValues.sharedMemoryId = result.value().first;
+                pooledValues.sharedMemoryFd = std::move(result.value().second);
+                if (!callOnPropertyEvent(callback, pooledValues,
+                                         static_cast<int32_t>(pool->getFileCount()))) {
+                    // The client will never return the memory file.
+                    pool->release(pooledValues.sharedMemoryId);
+                }
+                continue;
+            } else {
+                ALOGD("subscribe: cannot use pooled shared memory file, error: %s",
+                      result.error().message().c_str());
+            }
+        }
+        if (!oneOffValues.has_value()) {
+            oneOffValues.emplace();
+            ScopedAStatus status = vectorToStableLargeParcelable(
+                    std::move(vehiclePropValues.payloads), &oneOffValues.value());
+            if (!status.isOk()) {
+                int statusCode = status.getServiceSpecificError();
+                ALOGE("subscribe: failed to marshal result into large parcelable, error: "
+                      "%s, code: %d",
+                      status.getMessage(), statusCode);
+                return;
+            }
+        }
+        int32_t sharedMemoryFileCount =
+                pool == nullptr ? 0 : static_cast<int32_t>(pool->getFileCount());
+        callOnPropertyEvent(callback, oneOffValues.value(), sharedMemoryFileCount);
+    }
+}
+
 // Specify the functions for GetValues and SetValues types.
 template void sendGetOrSetValueResult<GetValueResult, GetValueResults>(
         std::shared_ptr<IVehicleCallback> callback, const GetValueResult& result);
@@ -252,31 +351,22 @@ template class GetSetValuesClient<SetValueResult, SetValueResults>;
 
 void SubscriptionClient::sendUpdatedValues(std::shared_ptr<IVehicleCallback> callback,
                                            std::vector<VehiclePropValue>&& updatedValues) {
-    if (updatedValues.empty()) {
-        return;
-    }
+    sendUpdatedValuesToCallbacks({{callback, nullptr}}, std::move(updatedValues));
+}
 
-    // TODO(b/205189110): Use memory pool here and fill in sharedMemoryId.
-    VehiclePropValues vehiclePropValues;
-    int32_t sharedMemoryFileCount = 0;
-    ScopedAStatus status =
-            vectorToStableLargeParcelable(std::move(updatedValues), &vehiclePropValues);
-    if (!status.isOk()) {
-        int statusCode = status.getServiceSpecificError();
-        ALOGE("subscribe: failed to marshal result into large parcelable, error: "
-              "%s, code: %d",
-              status.getMessage(), statusCode);
+void SubscriptionClient::sendUpdatedValues(
+        const std::vector<CallbackAndPool>& callbacks,
+        const std::vector<std::shared_ptr<const VehiclePropValue>>& updatedValues) {
+    if (callbacks.empty() || updatedValues.empty()) {
         return;
     }
 
-    if (ScopedAStatus callbackStatus =
-                callback->onPropertyEvent(vehiclePropValues, sharedMemoryFileCount);
-        !callbackStatus.isOk()) {
-        ALOGE("subscribe: failed to call onPropertyEvent callback, client ID: %p, error: %s, "
-              "exception: %d, service specific error: %d",
-              callback->asBinder().get(), callbackStatus.getMessage(),
-              callbackStatus.getExceptionCode(), callbackStatus.getServiceSpecificError());
+    std::vector<VehiclePropValue> values;
+    values.reserve(updatedValues.size());
+    for (const auto& value : updatedValues) {
+        values.push_back(*value);
     }
+    sendUpdatedValuesToCallbacks(callbacks, std::move(values));
 }
 
 void SubscriptionClient::sendPropertySetErrors(std::shared_ptr<IVehicleCallback> callback,
@@ -33,6 +33,7 @@
 
 #include <inttypes.h>
 #include <chrono>
+#include <map>
 #include <set>
 #include <unordered_set>
 
@@ -104,17 +105,18 @@ DefaultVehicleHal::DefaultVehicleHal(std::unique_ptr<IVehicleHardware> vehicleHa
     mSubscriptionManager = std::make_shared<SubscriptionManager>(vehicleHardwarePtr);
     mEventBatchingWindow = mVehicleHardware->getPropertyOnChangeEventBatchingWindow();
     if (mEventBatchingWindow != std::chrono::nanoseconds(0)) {
-        mBatchedEventQueue = std::make_shared<ConcurrentQueue<VehiclePropValue>>();
+        mBatchedEventQueue =
+                std::make_shared<MpscRingQueue<VehiclePropValue>>(EVENT_QUEUE_CAPACITY);
         mPropertyChangeEventsBatchingConsumer =
-                std::make_shared<BatchingConsumer<VehiclePropValue>>();
+                std::make_shared<AdaptiveBatchingConsumer<VehiclePropValue>>();
         mPropertyChangeEventsBatchingConsumer->run(
-                mBatchedEventQueue.get(), mEventBatchingWindow,
+                mBatchedEventQueue.get(), mEventBatchingWindow, MAX_EVENT_BATCH_SIZE,
                 [this](std::vector<VehiclePropValue> batchedEvents) {
                     handleBatchedPropertyEvents(std::move(batchedEvents));
                 });
     }
 
-    std::weak_ptr<ConcurrentQueue<VehiclePropValue>> batchedEventQueueCopy = mBatchedEventQueue;
+    std::weak_ptr<MpscRingQueue<VehiclePropValue>> batchedEventQueueCopy = mBatchedEventQueue;
     std::chrono::nanoseconds eventBatchingWindow = mEventBatchingWindow;
     std::weak_ptr<SubscriptionManager> subscriptionManagerCopy = mSubscriptionManager;
     mVehicleHardware->registerOnPropertyChangeEvent(
@@ -177,7 +179,7 @@ DefaultVehicleHal::~DefaultVehicleHal() {
 }
 
 void DefaultVehicleHal::batchPropertyChangeEvent(
-        const std::weak_ptr<ConcurrentQueue<VehiclePropValue>>& batchedEventQueue,
+        const std::weak_ptr<MpscRingQueue<VehiclePropValue>>& batchedEventQueue,
         std::vector<VehiclePropValue>&& updatedValues) {
     auto batchedEventQueueStrong = batchedEventQueue.lock();
     if (batchedEventQueueStrong == nullptr) {
@@ -201,8 +203,17 @@ void DefaultVehicleHal::onPropertyChangeEvent(
         return;
     }
     auto updatedValuesByClients = manager->getSubscribedClients(std::move(updatedValues));
+    // Clients subscribing to the same properties receive the same shared values, group them so
+    // that each distinct list of values is only marshaled once.
+    std::map<std::vector<SubscriptionManager::SharedPropValue>,
+             std::vector<SubscriptionClient::CallbackAndPool>>
+            callbacksByValues;
     for (auto& [callback, values] : updatedValuesByClients) {
-        SubscriptionClient::sendUpdatedValues(callback, std::move(values));
+        callbacksByValues[std::move(values)].push_back(
+                {callback, manager->getSharedMemoryPool(callback->asBinder().get())});
+    }
+    for (const auto& [values, callbacks] : callbacksByValues) {
+        SubscriptionClient::sendUpdatedValues(callbacks, values);
     }
 }
 
@@ -689,8 +700,7 @@ VhalResult<void> DefaultVehicleHal::checkSubscribeOptions(
 
 ScopedAStatus DefaultVehicleHal::subscribe(const CallbackType& callback,
                                            const std::vector<SubscribeOptions>& options,
-                                           [[maybe_unused]] int32_t maxSharedMemoryFileCount) {
-    // TODO(b/205189110): Use shared memory file count.
+                                           int32_t maxSharedMemoryFileCount) {
     if (callback == nullptr) {
         return ScopedAStatus::fromExceptionCode(EX_NULL_POINTER);
     }
@@ -780,6 +790,12 @@ ScopedAStatus DefaultVehicleHal::subscribe(const CallbackType& callback,
                 return toScopedAStatus(result);
             }
         }
+        // Shared memory files are only reused up to the limit defined in IVehicle.
+        if (maxSharedMemoryFileCount > MAX_SHARED_MEMORY_FILES_PER_CLIENT) {
+            maxSharedMemoryFileCount = MAX_SHARED_MEMORY_FILES_PER_CLIENT;
+        }
+        mSubscriptionManager->setMaxSharedMemoryFileCount(callback->asBinder().get(),
+                                                          maxSharedMemoryFileCount);
     }
     return ScopedAStatus::ok();
 }
@@ -792,9 +808,13 @@ ScopedAStatus DefaultVehicleHal::unsubscribe(const CallbackType& callback,
     return toScopedAStatus(mSubscriptionManager->unsubscribe(callback->asBinder().get(), propIds));
 }
 
-ScopedAStatus DefaultVehicleHal::returnSharedMemory(const CallbackType&, int64_t) {
-    // TODO(b/200737967): implement this.
-    return ScopedAStatus::ok();
+ScopedAStatus DefaultVehicleHal::returnSharedMemory(const CallbackType& callback,
+                                                    int64_t sharedMemoryId) {
+    if (callback == nullptr) {
+        return ScopedAStatus::fromExceptionCode(EX_NULL_POINTER);
+    }
+    return toScopedAStatus(
+            mSubscriptionManager->returnSharedMemory(callback->asBinder().get(), sharedMemoryId));
 }
 
 IVehicleHardware* DefaultVehicleHal::getHardware() {
@@ -905,6 +925,16 @@ binder_status_t DefaultVehicleHal::dump(int fd, const char** args, uint32_t numA
         dprintf(fd, "Currently have %zu setValues clients\n", mSetValuesClients.size());
         dprintf(fd, "Currently have %zu subscribe clients\n", countSubscribeClients());
     }
+    dprintf(fd, "%s", mSubscriptionManager->dumpSharedMemoryPools().c_str());
+    if (mBatchedEventQueue) {
+        const auto& consumer = *mPropertyChangeEventsBatchingConsumer;
+        dprintf(fd, "Property change event queue was full %" PRIu64 " times\n",
+                mBatchedEventQueue->getFullCount());
+        dprintf(fd, "Property change event queue depth histogram: %s\n",
+                consumer.getQueueDepthHistogram().toString().c_str());
+        dprintf(fd, "Property change event batch size histogram: %s\n",
+                consumer.getBatchSizeHistogram().toString().c_str());
+    }
     return STATUS_OK;
 }
 
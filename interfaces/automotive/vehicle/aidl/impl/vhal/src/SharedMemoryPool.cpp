@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SharedMemoryPool"
+
+#include "SharedMemoryPool.h"
+
+#include <android-base/stringprintf.h>
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+using ::android::base::Error;
+using ::android::base::Result;
+using ::android::base::StringPrintf;
+using ::android::base::unique_fd;
+using ::ndk::ScopedFileDescriptor;
+
+constexpr char MEMORY_FILE_NAME[] = "vhal_shared_memory";
+
+Result<void> writeFully(int fd, const uint8_t* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result =
+                TEMP_FAILURE_RETRY(pwrite(fd, data + written, size - written, written));
+        if (result < 0) {
+            return Error() << "failed to write shared memory file, errno: " << errno;
+        }
+        written += static_cast<size_t>(result);
+    }
+    return {};
+}
+
+}  // namespace
+
+SharedMemoryPool::SharedMemoryPool(size_t maxFileCount) : mMaxFileCount(maxFileCount) {}
+
+void SharedMemoryPool::setMaxFileCount(size_t maxFileCount) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    if (maxFileCount > mMaxFileCount) {
+        mMaxFileCount = maxFileCount;
+    }
+}
+
+Result<std::pair<int64_t, ScopedFileDescriptor>> SharedMemoryPool::write(const uint8_t* data,
+                                                                          size_t size) {
+    int fd = -1;
+    size_t index = 0;
+    {
+        std::scoped_lock<std::mutex> lockGuard(mLock);
+        for (; index < mFiles.size(); index++) {
+            if (!mFiles[index].inUse) {
+                break;
+            }
+        }
+        if (index == mFiles.size()) {
+            if (mFiles.size() >= mMaxFileCount) {
+                mExhaustedCount++;
+                return Error() << "all " << mFiles.size() << " shared memory files are in use";
+            }
+            unique_fd newFd(memfd_create(MEMORY_FILE_NAME, MFD_CLOEXEC));
+            if (!newFd.ok()) {
+                return Error() << "failed to create shared memory file, errno: " << errno;
+            }
+            mFiles.push_back({.fd = std::move(newFd)});
+        }
+        mFiles[index].inUse = true;
+        mWriteCount++;
+        fd = mFiles[index].fd.get();
+    }
+
+    // The file is marked in use, so it is safe to write it without holding the lock. The readers
+    // take the size of the file as the size of the content, so resize it to exactly 'size'.
+    Result<void> result;
+    if (TEMP_FAILURE_RETRY(ftruncate(fd, static_cast<off_t>(size))) != 0) {
+        result = Error() << "failed to resize shared memory file, errno: " << errno;
+    } else {
+        result = writeFully(fd, data, size);
+    }
+    ScopedFileDescriptor clientFd;
+    if (result.ok()) {
+        clientFd.set(TEMP_FAILURE_RETRY(fcntl(fd, F_DUPFD_CLOEXEC, 0)));
+        if (clientFd.get() < 0) {
+            result = Error() << "failed to duplicate shared memory file, errno: " << errno;
+        }
+    }
+
+    int64_t sharedMemoryId = static_cast<int64_t>(index) + 1;
+    if (!result.ok()) {
+        release(sharedMemoryId);
+        return result.error();
+    }
+    return std::make_pair(sharedMemoryId, std::move(clientFd));
+}
+
+bool SharedMemoryPool::release(int64_t sharedMemoryId) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    if (sharedMemoryId <= 0 || static_cast<size_t>(sharedMemoryId) > mFiles.size()) {
+        return false;
+    }
+    MemoryFile& file = mFiles[sharedMemoryId - 1];
+    if (!file.inUse) {
+        return false;
+    }
+    file.inUse = false;
+    return true;
+}
+
+size_t SharedMemoryPool::getFileCount() const {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    return mFiles.size();
+}
+
+std::string SharedMemoryPool::dump() const {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    size_t inUseCount = 0;
+    for (const auto& file : mFiles) {
+        if (file.inUse) {
+            inUseCount++;
+        }
+    }
+    return StringPrintf("files: %zu/%zu, in use: %zu, written: %" PRIu64 ", exhausted: %" PRIu64,
+                        mFiles.size(), mMaxFileCount, inUseCount, mWriteCount, mExhaustedCount);
+}
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -31,6 +31,7 @@ namespace vehicle {
 namespace {
 
 using ::aidl::android::hardware::automotive::vehicle::IVehicleCallback;
+using ::aidl::android::hardware::automotive::vehicle::RawPropValues;
 using ::aidl::android::hardware::automotive::vehicle::StatusCode;
 using ::aidl::android::hardware::automotive::vehicle::SubscribeOptions;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropError;
@@ -41,6 +42,36 @@ using ::android::base::StringPrintf;
 using ::ndk::ScopedAStatus;
 
 constexpr float ONE_SECOND_IN_NANOS = 1'000'000'000.;
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+// Folds the bytes into the 64-bit FNV-1a hash.
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Folds the length and the content of the vector into the hash so that values spread differently
+// across the typed vectors do not collide.
+template <class T>
+uint64_t fnv1aVector(const std::vector<T>& values, uint64_t hash) {
+    uint64_t size = values.size();
+    hash = fnv1a(&size, sizeof(size), hash);
+    return fnv1a(values.data(), values.size() * sizeof(T), hash);
+}
+
+uint64_t hashRawPropValues(const RawPropValues& value, uint64_t hash) {
+    hash = fnv1aVector(value.int32Values, hash);
+    hash = fnv1aVector(value.floatValues, hash);
+    hash = fnv1aVector(value.int64Values, hash);
+    hash = fnv1aVector(value.byteValues, hash);
+    uint64_t size = value.stringValue.size();
+    hash = fnv1a(&size, sizeof(size), hash);
+    return fnv1a(value.stringValue.data(), value.stringValue.size(), hash);
+}
 
 SubscribeOptions newSubscribeOptions(int32_t propId, int32_t areaId, float sampleRateHz,
                                      bool enableVur) {
@@ -328,6 +359,7 @@ VhalResult<void> SubscriptionManager::unsubscribe(SubscriptionManager::ClientIdT
 
     if (subscribedPropIdsAreaIds.empty()) {
         mSubscribedPropsByClient.erase(clientId);
+        mSharedMemoryPoolByClient.erase(clientId);
     }
     return {};
 }
@@ -346,43 +378,67 @@ VhalResult<void> SubscriptionManager::unsubscribe(SubscriptionManager::ClientIdT
         }
     }
     mSubscribedPropsByClient.erase(clientId);
+    mSharedMemoryPoolByClient.erase(clientId);
     return {};
 }
 
+SubscriptionManager::ValueFingerprint SubscriptionManager::getValueFingerprint(
+        const SharedPropValue& value) {
+    int32_t status = toInt(value->status);
+    uint64_t hash = fnv1a(&status, sizeof(status), FNV_OFFSET_BASIS);
+    return {
+            .timestamp = value->timestamp,
+            .valueHash = hashRawPropValues(value->value, hash),
+            .value = value,
+    };
+}
+
 bool SubscriptionManager::isValueUpdatedLocked(const std::shared_ptr<IVehicleCallback>& callback,
-                                               const VehiclePropValue& value) {
-    const auto& it = mContSubValuesByCallback[callback].find(value);
-    if (it == mContSubValuesByCallback[callback].end()) {
-        mContSubValuesByCallback[callback].insert(value);
+                                               const PropIdAreaId& propIdAreaId,
+                                               const ValueFingerprint& fingerprint) {
+    auto& fingerprints = mContSubFingerprintsByCallback[callback];
+    auto it = fingerprints.find(propIdAreaId);
+    if (it == fingerprints.end()) {
+        fingerprints[propIdAreaId] = fingerprint;
         return true;
     }
 
-    if (it->timestamp > value.timestamp) {
-        ALOGE("The updated property value: %s is outdated, ignored", value.toString().c_str());
+    if (it->second.timestamp > fingerprint.timestamp) {
+        ALOGE("The updated property value for propId: %" PRId32 ", areaId: %" PRId32
+              " with timestamp: %" PRId64 " is outdated, ignored",
+              propIdAreaId.propId, propIdAreaId.areaId, fingerprint.timestamp);
         return false;
     }
 
-    if (it->value == value.value && it->status == value.status) {
-        // Even though the property value is the same, we need to store the new property event to
-        // update the timestamp.
-        mContSubValuesByCallback[callback].insert(value);
+    // Equal hashes may still be different values, which must not be dropped.
+    bool sameValue = it->second.valueHash == fingerprint.valueHash &&
+                     it->second.value->value == fingerprint.value->value &&
+                     it->second.value->status == fingerprint.value->status;
+    // Even though the property value is the same, we need to store the new fingerprint to update
+    // the timestamp.
+    it->second = fingerprint;
+    if (sameValue) {
         ALOGD("The updated property value for propId: %" PRId32 ", areaId: %" PRId32
               " has the "
               "same value and status, ignored if VUR is enabled",
-              it->prop, it->areaId);
+              propIdAreaId.propId, propIdAreaId.areaId);
         return false;
     }
-
-    mContSubValuesByCallback[callback].insert(value);
     return true;
 }
 
-std::unordered_map<std::shared_ptr<IVehicleCallback>, std::vector<VehiclePropValue>>
+std::unordered_map<std::shared_ptr<IVehicleCallback>,
+                   std::vector<SubscriptionManager::SharedPropValue>>
 SubscriptionManager::getSubscribedClients(std::vector<VehiclePropValue>&& updatedValues) {
     std::scoped_lock<std::mutex> lockGuard(mLock);
-    std::unordered_map<std::shared_ptr<IVehicleCallback>, std::vector<VehiclePropValue>> clients;
-
-    for (auto& value : updatedValues) {
+    std::unordered_map<std::shared_ptr<IVehicleCallback>, std::vector<SharedPropValue>> clients;
+
+    // First pass: only keep the subscribed values, and for continuous properties only keep the
+    // newest value for each [propId, areaId]. A later value wins if the timestamps are equal.
+    std::vector<bool> keep(updatedValues.size(), false);
+    std::unordered_map<PropIdAreaId, size_t, PropIdAreaIdHash> newestIndexByPropIdAreaId;
+    for (size_t i = 0; i < updatedValues.size(); i++) {
+        const VehiclePropValue& value = updatedValues[i];
         PropIdAreaId propIdAreaId{
                 .propId = value.prop,
                 .areaId = value.areaId,
@@ -390,18 +446,50 @@ SubscriptionManager::getSubscribedClients(std::vector<VehiclePropValue>&& update
         if (mClientsByPropIdAreaId.find(propIdAreaId) == mClientsByPropIdAreaId.end()) {
             continue;
         }
+        if (mContSubConfigsByPropIdArea.find(propIdAreaId) == mContSubConfigsByPropIdArea.end()) {
+            keep[i] = true;
+            continue;
+        }
+        auto [it, inserted] = newestIndexByPropIdAreaId.try_emplace(propIdAreaId, i);
+        if (inserted) {
+            keep[i] = true;
+        } else if (value.timestamp >= updatedValues[it->second].timestamp) {
+            keep[it->second] = false;
+            keep[i] = true;
+            it->second = i;
+        }
+    }
+
+    // Second pass: move each remaining value into one shared immutable instance which is handed
+    // to every client subscribing to it.
+    for (size_t i = 0; i < updatedValues.size(); i++) {
+        if (!keep[i]) {
+            continue;
+        }
+        PropIdAreaId propIdAreaId{
+                .propId = updatedValues[i].prop,
+                .areaId = updatedValues[i].areaId,
+        };
+        auto sharedValue = std::make_shared<const VehiclePropValue>(std::move(updatedValues[i]));
+        auto contSubConfigsIt = mContSubConfigsByPropIdArea.find(propIdAreaId);
+        // The fingerprint is only computed once for all the clients, and only if needed.
+        std::optional<ValueFingerprint> fingerprint;
 
         for (const auto& [client, callback] : mClientsByPropIdAreaId[propIdAreaId]) {
-            auto& subConfigs = mContSubConfigsByPropIdArea[propIdAreaId];
             // If client wants VUR (and VUR is supported as checked in DefaultVehicleHal), it is
             // possible that VUR is not enabled in IVehicleHardware because another client does not
             // enable VUR. We will implement VUR filtering here for the client that enables it.
-            if (subConfigs.isVurEnabledForClient(client) && !subConfigs.isVurEnabled()) {
-                if (isValueUpdatedLocked(callback, value)) {
-                    clients[callback].push_back(value);
+            if (contSubConfigsIt != mContSubConfigsByPropIdArea.end() &&
+                contSubConfigsIt->second.isVurEnabledForClient(client) &&
+                !contSubConfigsIt->second.isVurEnabled()) {
+                if (!fingerprint.has_value()) {
+                    fingerprint = getValueFingerprint(sharedValue);
+                }
+                if (isValueUpdatedLocked(callback, propIdAreaId, *fingerprint)) {
+                    clients[callback].push_back(sharedValue);
                 }
             } else {
-                clients[callback].push_back(value);
+                clients[callback].push_back(sharedValue);
             }
         }
     }
@@ -444,6 +532,54 @@ size_t SubscriptionManager::countClients() {
     return mSubscribedPropsByClient.size();
 }
 
+void SubscriptionManager::setMaxSharedMemoryFileCount(ClientIdType client,
+                                                      int32_t maxSharedMemoryFileCount) {
+    if (maxSharedMemoryFileCount <= 0) {
+        return;
+    }
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    if (mSubscribedPropsByClient.find(client) == mSubscribedPropsByClient.end()) {
+        // The pool is only kept for subscribed clients.
+        return;
+    }
+    auto& pool = mSharedMemoryPoolByClient[client];
+    if (pool == nullptr) {
+        pool = std::make_shared<SharedMemoryPool>(maxSharedMemoryFileCount);
+    } else {
+        pool->setMaxFileCount(maxSharedMemoryFileCount);
+    }
+}
+
+std::shared_ptr<SharedMemoryPool> SubscriptionManager::getSharedMemoryPool(ClientIdType client) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    auto it = mSharedMemoryPoolByClient.find(client);
+    if (it == mSharedMemoryPoolByClient.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+VhalResult<void> SubscriptionManager::returnSharedMemory(ClientIdType client,
+                                                         int64_t sharedMemoryId) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    auto it = mSharedMemoryPoolByClient.find(client);
+    if (it == mSharedMemoryPoolByClient.end() || !it->second->release(sharedMemoryId)) {
+        return StatusError(StatusCode::INVALID_ARG)
+               << StringPrintf("shared memory ID: %" PRId64 " is not in use by the client",
+                               sharedMemoryId);
+    }
+    return {};
+}
+
+std::string SubscriptionManager::dumpSharedMemoryPools() {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    std::string msg;
+    for (const auto& [client, pool] : mSharedMemoryPoolByClient) {
+        msg += StringPrintf("Client %p shared memory pool: %s\n", client, pool->dump().c_str());
+    }
+    return msg;
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
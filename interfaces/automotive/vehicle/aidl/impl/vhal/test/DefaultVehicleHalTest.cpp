@@ -2016,6 +2016,29 @@ TEST_F(DefaultVehicleHalTest, testBatchOnPropertyChangeEvents) {
     }
 }
 
+TEST_F(DefaultVehicleHalTest, testDumpEventBatchingStats) {
+    auto hardware = std::make_unique<MockVehicleHardware>();
+    hardware->setPropertyOnChangeEventBatchingWindow(std::chrono::milliseconds(10));
+    hardware->setDumpResult({
+            .callerShouldDumpState = true,
+            .buffer = "",
+    });
+    init(std::move(hardware));
+
+    int fd = memfd_create("memfile", 0);
+    getClient()->dump(fd, nullptr, 0);
+
+    lseek(fd, 0, SEEK_SET);
+    char buf[10240] = {};
+    read(fd, buf, sizeof(buf));
+    close(fd);
+
+    std::string msg(buf);
+
+    ASSERT_THAT(msg, ContainsRegex("Property change event queue depth histogram: "));
+    ASSERT_THAT(msg, ContainsRegex("Property change event batch size histogram: "));
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedMemoryPool.h"
+
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+std::vector<uint8_t> readFile(int fd) {
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        return {};
+    }
+    std::vector<uint8_t> content(fileStat.st_size);
+    if (pread(fd, content.data(), content.size(), 0) != static_cast<ssize_t>(content.size())) {
+        return {};
+    }
+    return content;
+}
+
+}  // namespace
+
+TEST(SharedMemoryPoolTest, testWrite) {
+    SharedMemoryPool pool(2);
+    std::vector<uint8_t> data(10000, 0xab);
+
+    auto result = pool.write(data.data(), data.size());
+
+    ASSERT_TRUE(result.ok()) << result.error().message();
+    EXPECT_NE(result.value().first, 0);
+    EXPECT_EQ(readFile(result.value().second.get()), data);
+    EXPECT_EQ(pool.getFileCount(), 1u);
+}
+
+TEST(SharedMemoryPoolTest, testWriteReusesReleasedFile) {
+    SharedMemoryPool pool(2);
+    std::vector<uint8_t> data1(10000, 1);
+    std::vector<uint8_t> data2(5000, 2);
+
+    auto result1 = pool.write(data1.data(), data1.size());
+    ASSERT_TRUE(result1.ok()) << result1.error().message();
+    int64_t id = result1.value().first;
+    ASSERT_TRUE(pool.release(id));
+
+    auto result2 = pool.write(data2.data(), data2.size());
+
+    ASSERT_TRUE(result2.ok()) << result2.error().message();
+    EXPECT_EQ(result2.value().first, id);
+    // The file must be resized to exactly the new content.
+    EXPECT_EQ(readFile(result2.value().second.get()), data2);
+    EXPECT_EQ(pool.getFileCount(), 1u);
+}
+
+TEST(SharedMemoryPoolTest, testWriteAllFilesInUse) {
+    SharedMemoryPool pool(2);
+    std::vector<uint8_t> data(100, 1);
+
+    auto result1 = pool.write(data.data(), data.size());
+    auto result2 = pool.write(data.data(), data.size());
+    auto result3 = pool.write(data.data(), data.size());
+
+    ASSERT_TRUE(result1.ok()) << result1.error().message();
+    ASSERT_TRUE(result2.ok()) << result2.error().message();
+    EXPECT_NE(result1.value().first, result2.value().first);
+    EXPECT_FALSE(result3.ok()) << "must not create more files than the max file count";
+    EXPECT_EQ(pool.getFileCount(), 2u);
+}
+
+TEST(SharedMemoryPoolTest, testSetMaxFileCount) {
+    SharedMemoryPool pool(1);
+    std::vector<uint8_t> data(100, 1);
+
+    ASSERT_TRUE(pool.write(data.data(), data.size()).ok());
+    ASSERT_FALSE(pool.write(data.data(), data.size()).ok());
+
+    pool.setMaxFileCount(2);
+
+    ASSERT_TRUE(pool.write(data.data(), data.size()).ok());
+}
+
+TEST(SharedMemoryPoolTest, testReleaseInvalidId) {
+    SharedMemoryPool pool(2);
+    std::vector<uint8_t> data(100, 1);
+
+    auto result = pool.write(data.data(), data.size());
+    ASSERT_TRUE(result.ok()) << result.error().message();
+    int64_t id = result.value().first;
+
+    EXPECT_FALSE(pool.release(0));
+    EXPECT_FALSE(pool.release(id + 1));
+    EXPECT_TRUE(pool.release(id));
+    EXPECT_FALSE(pool.release(id)) << "must not release a file twice";
+}
+
+TEST(SharedMemoryPoolTest, testClientTruncatedFile) {
+    SharedMemoryPool pool(1);
+    std::vector<uint8_t> data(10000, 1);
+
+    auto result = pool.write(data.data(), data.size());
+    ASSERT_TRUE(result.ok()) << result.error().message();
+    // A misbehaving client truncates the file before returning it.
+    ASSERT_EQ(ftruncate(result.value().second.get(), 0), 0);
+    ASSERT_TRUE(pool.release(result.value().first));
+
+    result = pool.write(data.data(), data.size());
+
+    ASSERT_TRUE(result.ok()) << result.error().message();
+    EXPECT_EQ(readFile(result.value().second.get()), data);
+}
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -50,6 +50,7 @@ using ::ndk::ScopedAStatus;
 using ::ndk::SpAIBinder;
 using ::testing::Contains;
 using ::testing::ElementsAre;
+using ::testing::Pointee;
 using ::testing::UnorderedElementsAre;
 
 class PropertyCallback final : public BnVehicleCallback {
@@ -413,8 +414,81 @@ TEST_F(SubscriptionManagerTest, testSubscribeOnchange) {
     auto clients = getManager()->getSubscribedClients(std::vector<VehiclePropValue>(updatedValues));
 
     ASSERT_THAT(clients[client1],
-                UnorderedElementsAre(updatedValues[0], updatedValues[1], updatedValues[2]));
-    ASSERT_THAT(clients[client2], ElementsAre(updatedValues[0]));
+                UnorderedElementsAre(Pointee(updatedValues[0]), Pointee(updatedValues[1]),
+                                     Pointee(updatedValues[2])));
+    ASSERT_THAT(clients[client2], ElementsAre(Pointee(updatedValues[0])));
+    ASSERT_EQ(clients[client1][0].get(), clients[client2][0].get())
+            << "the same value must be shared between clients";
+}
+
+TEST_F(SubscriptionManagerTest, testGetSubscribedClients_collapseContinuousValues) {
+    std::vector<SubscribeOptions> options = {{
+            .propId = 0,
+            .areaIds = {0, 1},
+            .sampleRate = 10.0,
+    }};
+    auto result = getManager()->subscribe(getCallbackClient(), options, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+
+    std::vector<VehiclePropValue> updatedValues = {
+            {
+                    .prop = 0,
+                    .areaId = 0,
+                    .value = {.int32Values = {0}},
+                    .timestamp = 1,
+            },
+            {
+                    .prop = 0,
+                    .areaId = 1,
+                    .value = {.int32Values = {1}},
+                    .timestamp = 1,
+            },
+            {
+                    .prop = 0,
+                    .areaId = 0,
+                    .value = {.int32Values = {2}},
+                    .timestamp = 3,
+            },
+            {
+                    // Older than the previous value for the same area.
+                    .prop = 0,
+                    .areaId = 0,
+                    .value = {.int32Values = {3}},
+                    .timestamp = 2,
+            },
+    };
+    auto clients = getManager()->getSubscribedClients(std::vector<VehiclePropValue>(updatedValues));
+
+    ASSERT_THAT(clients[getCallbackClient()],
+                ElementsAre(Pointee(updatedValues[1]), Pointee(updatedValues[2])));
+}
+
+TEST_F(SubscriptionManagerTest, testGetSubscribedClients_doNotCollapseOnChangeValues) {
+    std::vector<SubscribeOptions> options = {{
+            .propId = 0,
+            .areaIds = {0},
+    }};
+    auto result = getManager()->subscribe(getCallbackClient(), options, false);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+
+    std::vector<VehiclePropValue> updatedValues = {
+            {
+                    .prop = 0,
+                    .areaId = 0,
+                    .value = {.int32Values = {0}},
+                    .timestamp = 1,
+            },
+            {
+                    .prop = 0,
+                    .areaId = 0,
+                    .value = {.int32Values = {1}},
+                    .timestamp = 2,
+            },
+    };
+    auto clients = getManager()->getSubscribedClients(std::vector<VehiclePropValue>(updatedValues));
+
+    ASSERT_THAT(clients[getCallbackClient()],
+                ElementsAre(Pointee(updatedValues[0]), Pointee(updatedValues[1])));
 }
 
 TEST_F(SubscriptionManagerTest, testSubscribeInvalidOption) {
@@ -503,7 +577,7 @@ TEST_F(SubscriptionManagerTest, testUnsubscribeOnchange) {
     };
     auto clients = getManager()->getSubscribedClients(std::vector<VehiclePropValue>(updatedValues));
 
-    ASSERT_THAT(clients[getCallbackClient()], ElementsAre(updatedValues[1]));
+    ASSERT_THAT(clients[getCallbackClient()], ElementsAre(Pointee(updatedValues[1])));
     ASSERT_THAT(getHardware()->getSubscribedOnChangePropIdAreaIds(),
                 UnorderedElementsAre(std::pair<int32_t, int32_t>(1, 0)));
 }
@@ -623,8 +697,9 @@ TEST_F(SubscriptionManagerTest, testSubscribe_enableVur_filterUnchangedEvents) {
     auto clients =
             getManager()->getSubscribedClients(std::vector<VehiclePropValue>(propertyEvents));
 
-    ASSERT_THAT(clients[client1], UnorderedElementsAre(propertyEvents[0]));
-    ASSERT_THAT(clients[client2], UnorderedElementsAre(propertyEvents[0], propertyEvents[1]));
+    ASSERT_THAT(clients[client1], UnorderedElementsAre(Pointee(propertyEvents[0])));
+    ASSERT_THAT(clients[client2],
+                UnorderedElementsAre(Pointee(propertyEvents[0]), Pointee(propertyEvents[1])));
 
     // If the same property events happen again with a new timestamp.
     // VUR is disabled for client1, enabled for client2.
@@ -692,7 +767,7 @@ TEST_F(SubscriptionManagerTest, testSubscribe_enableVur_mustNotFilterStatusChang
     };
     auto clients = getManager()->getSubscribedClients(std::vector<VehiclePropValue>({propValue1}));
 
-    ASSERT_THAT(clients[client1], UnorderedElementsAre(propValue1));
+    ASSERT_THAT(clients[client1], UnorderedElementsAre(Pointee(propValue1)));
 
     // A new event with the same value, but different status must not be filtered out.
     VehiclePropValue propValue2 = {
@@ -704,7 +779,7 @@ TEST_F(SubscriptionManagerTest, testSubscribe_enableVur_mustNotFilterStatusChang
     };
     clients = getManager()->getSubscribedClients({propValue2});
 
-    ASSERT_THAT(clients[client1], UnorderedElementsAre(propValue2))
+    ASSERT_THAT(clients[client1], UnorderedElementsAre(Pointee(propValue2)))
             << "Must not filter out property events that has status change";
 }
 
@@ -743,7 +818,7 @@ TEST_F(SubscriptionManagerTest, testSubscribe_enableVur_timestampUpdated_filterO
     };
     auto clients = getManager()->getSubscribedClients({value0});
 
-    ASSERT_THAT(clients[client1], UnorderedElementsAre(value0));
+    ASSERT_THAT(clients[client1], UnorderedElementsAre(Pointee(value0)));
 
     // A new event with the same value arrived. This must update timestamp to 3.
     VehiclePropValue value1 = {
@@ -771,6 +846,40 @@ TEST_F(SubscriptionManagerTest, testSubscribe_enableVur_timestampUpdated_filterO
             << "Must filter out outdated property events if VUR is enabled";
 }
 
+TEST_F(SubscriptionManagerTest, testSharedMemoryPool) {
+    std::vector<SubscribeOptions> options = {{
+            .propId = 0,
+            .areaIds = {0},
+    }};
+    SubscriptionManager::ClientIdType clientId = getCallbackClient()->asBinder().get();
+
+    getManager()->setMaxSharedMemoryFileCount(clientId, 2);
+    ASSERT_EQ(getManager()->getSharedMemoryPool(clientId), nullptr)
+            << "must not create pool for client not subscribed";
+
+    auto result = getManager()->subscribe(getCallbackClient(), options, false);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+    getManager()->setMaxSharedMemoryFileCount(clientId, 2);
+
+    auto pool = getManager()->getSharedMemoryPool(clientId);
+    ASSERT_NE(pool, nullptr);
+    std::vector<uint8_t> data(100, 1);
+    auto writeResult = pool->write(data.data(), data.size());
+    ASSERT_TRUE(writeResult.ok()) << writeResult.error().message();
+    int64_t sharedMemoryId = writeResult.value().first;
+
+    ASSERT_FALSE(getManager()->returnSharedMemory(clientId, sharedMemoryId + 1).ok());
+    ASSERT_TRUE(getManager()->returnSharedMemory(clientId, sharedMemoryId).ok());
+    ASSERT_FALSE(getManager()->returnSharedMemory(clientId, sharedMemoryId).ok())
+            << "must not return the same shared memory twice";
+
+    result = getManager()->unsubscribe(clientId);
+    ASSERT_TRUE(result.ok()) << "failed to unsubscribe: " << result.error().message();
+
+    ASSERT_EQ(getManager()->getSharedMemoryPool(clientId), nullptr)
+            << "pool must be removed after the client unsubscribes";
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
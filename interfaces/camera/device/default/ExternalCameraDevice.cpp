@@ -35,12 +35,14 @@ namespace implementation {
 using ::aidl::android::hardware::camera::common::Status;
 
 namespace {
-// Only support MJPEG for now as it seems to be the one supports higher fps
+// MJPEG supports the highest fps at large sizes. The uncompressed YUYV and NV12 have a lower
+// latency, as they need no decode, and are streamed when they support the same fps.
 // Other formats to consider in the future:
 // * V4L2_PIX_FMT_YVU420 (== YV12)
 // * V4L2_PIX_FMT_YVYU (YVYU: can be converted to YV12 or other YUV420_888 formats)
-const std::array<uint32_t, /*size*/ 2> kSupportedFourCCs{
-        {V4L2_PIX_FMT_MJPEG, V4L2_PIX_FMT_Z16}};  // double braces required in C++11
+const std::array<uint32_t, /*size*/ 4> kSupportedFourCCs{
+        {V4L2_PIX_FMT_MJPEG, V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV12,
+         V4L2_PIX_FMT_Z16}};  // double braces required in C++11
 
 constexpr int MAX_RETRY = 5;                  // Allow retry v4l2 open failures a few times.
 constexpr int OPEN_RETRY_SLEEP_US = 100'000;  // 100ms * MAX_RETRY = 0.5 seconds
@@ -332,6 +334,8 @@ status_t ExternalCameraDevice::initAvailableCapabilities(
                 hasDepth = true;
                 break;
             case V4L2_PIX_FMT_MJPEG:
+            case V4L2_PIX_FMT_YUYV:
+            case V4L2_PIX_FMT_NV12:
                 hasColor = true;
                 break;
             default:
@@ -633,7 +637,7 @@ status_t ExternalCameraDevice::initOutputCharsKeys(
 
     // For V4L2_PIX_FMT_Z16
     std::array<int, /*size*/ 1> halDepthFormats{{HAL_PIXEL_FORMAT_Y16}};
-    // For V4L2_PIX_FMT_MJPEG
+    // For V4L2_PIX_FMT_MJPEG, V4L2_PIX_FMT_YUYV and V4L2_PIX_FMT_NV12
     std::array<int, /*size*/ 3> halFormats{{HAL_PIXEL_FORMAT_BLOB, HAL_PIXEL_FORMAT_YCbCr_420_888,
                                             HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED}};
 
@@ -643,6 +647,8 @@ status_t ExternalCameraDevice::initOutputCharsKeys(
                 hasDepth = true;
                 break;
             case V4L2_PIX_FMT_MJPEG:
+            case V4L2_PIX_FMT_YUYV:
+            case V4L2_PIX_FMT_NV12:
                 hasColor = true;
                 break;
             default:
@@ -654,7 +660,7 @@ status_t ExternalCameraDevice::initOutputCharsKeys(
 
     if (hasDepth) {
         status_t ret = initOutputCharsKeysByFormat(
-                metadata, V4L2_PIX_FMT_Z16, halDepthFormats,
+                metadata, {V4L2_PIX_FMT_Z16}, halDepthFormats,
                 ANDROID_DEPTH_AVAILABLE_DEPTH_STREAM_CONFIGURATIONS_OUTPUT,
                 ANDROID_DEPTH_AVAILABLE_DEPTH_STREAM_CONFIGURATIONS,
                 ANDROID_DEPTH_AVAILABLE_DEPTH_MIN_FRAME_DURATIONS,
@@ -667,7 +673,10 @@ status_t ExternalCameraDevice::initOutputCharsKeys(
     }
     if (hasColor) {
         status_t ret =
-                initOutputCharsKeysByFormat(metadata, V4L2_PIX_FMT_MJPEG, halFormats,
+                initOutputCharsKeysByFormat(metadata,
+                                            {V4L2_PIX_FMT_MJPEG, V4L2_PIX_FMT_YUYV,
+                                             V4L2_PIX_FMT_NV12},
+                                            halFormats,
                                             ANDROID_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_OUTPUT,
                                             ANDROID_SCALER_AVAILABLE_STREAM_CONFIGURATIONS,
                                             ANDROID_SCALER_AVAILABLE_MIN_FRAME_DURATIONS,
@@ -707,8 +716,9 @@ status_t ExternalCameraDevice::initOutputCharsKeys(
 template <size_t SIZE>
 status_t ExternalCameraDevice::initOutputCharsKeysByFormat(
         ::android::hardware::camera::common::V1_0::helper::CameraMetadata* metadata,
-        uint32_t fourcc, const std::array<int, SIZE>& halFormats, int streamConfigTag,
-        int streamConfigurationKey, int minFrameDurationKey, int stallDurationKey) {
+        const std::set<uint32_t>& fourccs, const std::array<int, SIZE>& halFormats,
+        int streamConfigTag, int streamConfigurationKey, int minFrameDurationKey,
+        int stallDurationKey) {
     if (mSupportedFormats.empty()) {
         ALOGE("%s: Init supported format list failed", __FUNCTION__);
         return UNKNOWN_ERROR;
@@ -718,11 +728,16 @@ status_t ExternalCameraDevice::initOutputCharsKeysByFormat(
     std::vector<int64_t> minFrameDurations;
     std::vector<int64_t> stallDurations;
 
+    std::set<std::pair<int32_t, int32_t>> sizes;
     for (const auto& supportedFormat : mSupportedFormats) {
-        if (supportedFormat.fourcc != fourcc) {
+        if (fourccs.count(supportedFormat.fourcc) == 0) {
             // Skip 4CCs not meant for the halFormats
             continue;
         }
+        // A size is advertised once, with the fps of the fastest 4CC
+        if (!sizes.insert({supportedFormat.width, supportedFormat.height}).second) {
+            continue;
+        }
         for (const auto& format : halFormats) {
             streamConfigurations.push_back(format);
             streamConfigurations.push_back(supportedFormat.width);
@@ -731,12 +746,20 @@ status_t ExternalCameraDevice::initOutputCharsKeysByFormat(
         }
 
         int64_t minFrameDuration = std::numeric_limits<int64_t>::max();
-        for (const auto& fr : supportedFormat.frameRates) {
-            // 1000000000LL < (2^32 - 1) and
-            // fr.durationNumerator is uint32_t, so no overflow here
-            int64_t frameDuration = 1000000000LL * fr.durationNumerator / fr.durationDenominator;
-            if (frameDuration < minFrameDuration) {
-                minFrameDuration = frameDuration;
+        for (const auto& sameSizeFormat : mSupportedFormats) {
+            if (fourccs.count(sameSizeFormat.fourcc) == 0 ||
+                sameSizeFormat.width != supportedFormat.width ||
+                sameSizeFormat.height != supportedFormat.height) {
+                continue;
+            }
+            for (const auto& fr : sameSizeFormat.frameRates) {
+                // 1000000000LL < (2^32 - 1) and
+                // fr.durationNumerator is uint32_t, so no overflow here
+                int64_t frameDuration =
+                        1000000000LL * fr.durationNumerator / fr.durationDenominator;
+                if (frameDuration < minFrameDuration) {
+                    minFrameDuration = frameDuration;
+                }
             }
         }
 
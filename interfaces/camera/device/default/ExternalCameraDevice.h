@@ -20,6 +20,7 @@
 #include <ExternalCameraDeviceSession.h>
 #include <ExternalCameraUtils.h>
 #include <aidl/android/hardware/camera/device/BnCameraDevice.h>
+#include <set>
 
 namespace android {
 namespace hardware {
@@ -101,8 +102,9 @@ class ExternalCameraDevice : public BnCameraDevice {
     template <size_t SIZE>
     status_t initOutputCharsKeysByFormat(
             ::android::hardware::camera::common::V1_0::helper::CameraMetadata* metadata,
-            uint32_t fourcc, const std::array<int, SIZE>& halFormats, int streamConfigTag,
-            int streamConfiguration, int minFrameDuration, int stallDuration);
+            const std::set<uint32_t>& fourccs, const std::array<int, SIZE>& halFormats,
+            int streamConfigTag, int streamConfiguration, int minFrameDuration,
+            int stallDuration);
 
     status_t calculateMinFps(::android::hardware::camera::common::V1_0::helper::CameraMetadata*);
 
@@ -35,8 +35,11 @@
 #include <aidlcommonsupport/NativeHandle.h>
 #include <convert.h>
 #include <linux/videodev2.h>
+#include <poll.h>
 #include <sync/sync.h>
 #include <utils/Trace.h>
+#include <algorithm>
+#include <cmath>
 #include <deque>
 
 #define HAVE_JPEG  // required for libyuv.h to export MJPEG decode APIs
@@ -220,7 +223,8 @@ void ExternalCameraDeviceSession::initOutputThread() {
     mBufferRequestThread = std::make_shared<BufferRequestThread>(/*parent=*/thiz, mCallback);
     mBufferRequestThread->run();
     mOutputThread = std::make_shared<OutputThread>(/*parent=*/thiz, mCroppingType,
-                                                   mCameraCharacteristics, mBufferRequestThread);
+                                                   mCameraCharacteristics, mBufferRequestThread,
+                                                   mCfg.numWorkerThreads);
 }
 
 void ExternalCameraDeviceSession::closeOutputThread() {
@@ -394,6 +398,8 @@ ScopedAStatus ExternalCameraDeviceSession::configureStreams(
               __FUNCTION__, (mCroppingType == VERTICAL) ? "width" : "height", maxDim, desiredAr);
         return fromStatus(Status::ILLEGAL_ARGUMENT);
     }
+    // Several formats may be supported at that size
+    v4l2Fmt = getPreferredV4l2Format(mSupportedFormats, v4l2Fmt);
 
     if (configureV4l2StreamLocked(v4l2Fmt) != 0) {
         ALOGE("V4L configuration failed!, format:%c%c%c%c, w %d, h %d", v4l2Fmt.fourcc & 0xFF,
@@ -625,6 +631,7 @@ Status ExternalCameraDeviceSession::processOneCaptureRequest(const CaptureReques
         }
 
         if (requestFpsMax != mV4l2StreamingFps) {
+            stopSensorThreadLocked();
             {
                 std::unique_lock<std::mutex> lk(mV4l2BufferLock);
                 while (mNumDequeuedV4l2Buffers != 0) {
@@ -1211,27 +1218,47 @@ int ExternalCameraDeviceSession::configureV4l2StreamLocked(const SupportedV4L2Fo
     ALOGI("%s: start V4L2 streaming %dx%d@%ffps", __FUNCTION__, v4l2Fmt.width, v4l2Fmt.height, fps);
     mV4l2StreamingFmt = v4l2Fmt;
     mV4l2Streaming = true;
+    startSensorThreadLocked();
     return OK;
 }
 
 std::unique_ptr<V4L2Frame> ExternalCameraDeviceSession::dequeueV4l2FrameLocked(nsecs_t* shutterTs) {
     ATRACE_CALL();
-    std::unique_ptr<V4L2Frame> ret = nullptr;
     if (shutterTs == nullptr) {
         ALOGE("%s: shutterTs must not be null!", __FUNCTION__);
-        return ret;
+        return nullptr;
     }
 
-    {
-        std::unique_lock<std::mutex> lk(mV4l2BufferLock);
-        if (mNumDequeuedV4l2Buffers == mV4L2BufferCount) {
-            int waitRet = waitForV4L2BufferReturnLocked(lk);
-            if (waitRet != 0) {
-                return ret;
-            }
+    std::unique_lock<std::mutex> lk(mV4l2BufferLock);
+    if (mLatestV4l2Frame == nullptr) {
+        auto timeout = std::chrono::seconds(kBufferWaitTimeoutSec);
+        mLock.unlock();
+        bool dequeued = mLatestV4l2FrameCond.wait_for(
+                lk, timeout, [this] { return mLatestV4l2Frame != nullptr; });
+        // Same lock order as in waitForV4L2BufferReturnLocked
+        mLock.lock();
+        if (!dequeued) {
+            ALOGE("%s: wait for V4L2 frame timeout!", __FUNCTION__);
+            return nullptr;
         }
     }
 
+    *shutterTs = mLatestV4l2FrameTs;
+    nsecs_t age = systemTime(SYSTEM_TIME_MONOTONIC) - mLatestV4l2FrameTs;
+    mSensorStats.takenFrames++;
+    mSensorStats.ageSumMs += age / 1e6;
+    mSensorStats.maxAge = std::max(mSensorStats.maxAge, age);
+    return std::move(mLatestV4l2Frame);
+}
+
+std::unique_ptr<V4L2Frame> ExternalCameraDeviceSession::dequeueV4l2Buffer(nsecs_t* shutterTs) {
+    ATRACE_CALL();
+    std::unique_ptr<V4L2Frame> ret = nullptr;
+    if (shutterTs == nullptr) {
+        ALOGE("%s: shutterTs must not be null!", __FUNCTION__);
+        return ret;
+    }
+
     ATRACE_BEGIN("VIDIOC_DQBUF");
     v4l2_buffer buffer{};
     buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -1298,6 +1325,105 @@ void ExternalCameraDeviceSession::enqueueV4l2Frame(const std::shared_ptr<V4L2Fra
     mV4L2BufferReturned.notify_one();
 }
 
+ExternalCameraDeviceSession::SensorThread::SensorThread(ExternalCameraDeviceSession* parent)
+    : mParent(parent) {}
+
+ExternalCameraDeviceSession::SensorThread::~SensorThread() {
+    requestExitAndWait();
+}
+
+bool ExternalCameraDeviceSession::SensorThread::threadLoop() {
+    return mParent->cycleV4l2Queue();
+}
+
+void ExternalCameraDeviceSession::startSensorThreadLocked() {
+    {
+        std::lock_guard<std::mutex> lk(mV4l2BufferLock);
+        mSensorStats.lastTs = 0;
+    }
+    mSensorThread = std::make_unique<SensorThread>(this);
+    mSensorThread->run();
+}
+
+void ExternalCameraDeviceSession::stopSensorThreadLocked() {
+    if (mSensorThread == nullptr) {
+        return;
+    }
+    mSensorThread->requestExitAndWait();
+    mSensorThread.reset();
+
+    std::unique_lock<std::mutex> lk(mV4l2BufferLock);
+    std::shared_ptr<V4L2Frame> latest = std::move(mLatestV4l2Frame);
+    lk.unlock();
+    if (latest != nullptr) {
+        enqueueV4l2Frame(latest);
+    }
+}
+
+bool ExternalCameraDeviceSession::cycleV4l2Queue() {
+    {
+        std::unique_lock<std::mutex> lk(mV4l2BufferLock);
+        if (mNumDequeuedV4l2Buffers == mV4L2BufferCount) {
+            if (mLatestV4l2Frame == nullptr) {
+                // All buffers are being processed, wait for one to be queued back
+                mV4L2BufferReturned.wait_for(lk, std::chrono::milliseconds(kSensorPollTimeoutMs));
+                return true;
+            }
+            // Give the latest frame back, the driver needs a buffer for the next one
+            std::shared_ptr<V4L2Frame> stale = std::move(mLatestV4l2Frame);
+            mSensorStats.droppedFrames++;
+            lk.unlock();
+            enqueueV4l2Frame(stale);
+        }
+    }
+
+    pollfd pfd = {.fd = mV4l2Fd.get(), .events = POLLIN};
+    int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, kSensorPollTimeoutMs));
+    if (ret < 0 || (ret > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))) {
+        ALOGE("%s: poll V4L2 FD failed: ret %d revents 0x%x: %s", __FUNCTION__, ret, pfd.revents,
+              strerror(errno));
+        return false;
+    }
+    if (ret == 0) {
+        // No frame yet, check for exit
+        return true;
+    }
+
+    nsecs_t shutterTs = 0;
+    std::unique_ptr<V4L2Frame> frame = dequeueV4l2Buffer(&shutterTs);
+    if (frame == nullptr) {
+        ALOGE("%s: V4L2 deque frame failed!", __FUNCTION__);
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lk(mV4l2BufferLock);
+    SensorStats& stats = mSensorStats;
+    stats.frames++;
+    if (stats.lastTs != 0) {
+        nsecs_t interval = shutterTs - stats.lastTs;
+        double intervalMs = interval / 1e6;
+        stats.intervals++;
+        stats.intervalSumMs += intervalMs;
+        stats.intervalSqSumMs += intervalMs * intervalMs;
+        stats.maxInterval = std::max(stats.maxInterval, interval);
+    }
+    stats.lastTs = shutterTs;
+
+    std::shared_ptr<V4L2Frame> stale = std::move(mLatestV4l2Frame);
+    if (stale != nullptr) {
+        stats.droppedFrames++;
+    }
+    mLatestV4l2Frame = std::move(frame);
+    mLatestV4l2FrameTs = shutterTs;
+    lk.unlock();
+    mLatestV4l2FrameCond.notify_all();
+
+    if (stale != nullptr) {
+        enqueueV4l2Frame(stale);
+    }
+    return true;
+}
+
 bool ExternalCameraDeviceSession::isSupported(
         const Stream& stream, const std::vector<SupportedV4L2Format>& supportedFormats,
         const ExternalCameraConfig& devCfg) {
@@ -1413,6 +1539,8 @@ int ExternalCameraDeviceSession::v4l2StreamOffLocked() {
         return OK;
     }
 
+    stopSensorThreadLocked();
+
     {
         std::lock_guard<std::mutex> lk(mV4l2BufferLock);
         if (mNumDequeuedV4l2Buffers != 0) {
@@ -1898,12 +2026,31 @@ binder_status_t ExternalCameraDeviceSession::dump(int fd, const char** /*args*/,
                 mV4l2StreamingFps);
 
         size_t numDequeuedV4l2Buffers = 0;
+        SensorStats stats;
         {
             std::lock_guard<std::mutex> lk(mV4l2BufferLock);
             numDequeuedV4l2Buffers = mNumDequeuedV4l2Buffers;
+            stats = mSensorStats;
         }
         dprintf(fd, "V4L2 buffer queue size %zu, dequeued %zu\n", v4L2BufferCount,
                 numDequeuedV4l2Buffers);
+
+        double meanIntervalMs = stats.intervals != 0 ? stats.intervalSumMs / stats.intervals : 0.0;
+        double jitterMs =
+                stats.intervals != 0
+                        ? std::sqrt(std::max(0.0, stats.intervalSqSumMs / stats.intervals -
+                                                          meanIntervalMs * meanIntervalMs))
+                        : 0.0;
+        dprintf(fd,
+                "Sensor thread: %" PRIu64 " frames dequeued, %" PRIu64 " taken by requests, "
+                "%" PRIu64 " dropped\n",
+                stats.frames, stats.takenFrames, stats.droppedFrames);
+        dprintf(fd,
+                "Sensor thread: frame interval %.2f ms (jitter %.2f ms, max %.2f ms), frame age "
+                "when taken %.2f ms (max %.2f ms)\n",
+                meanIntervalMs, jitterMs, stats.maxInterval / 1e6,
+                stats.takenFrames != 0 ? stats.ageSumMs / stats.takenFrames : 0.0,
+                stats.maxAge / 1e6);
     }
 
     dprintf(fd, "In-flight frames (not sorted):");
@@ -2125,18 +2272,23 @@ bool ExternalCameraDeviceSession::BufferRequestThread::threadLoop() {
 ExternalCameraDeviceSession::OutputThread::OutputThread(
         std::weak_ptr<OutputThreadInterface> parent, CroppingType ct,
         const common::V1_0::helper::CameraMetadata& chars,
-        std::shared_ptr<BufferRequestThread> bufReqThread)
+        std::shared_ptr<BufferRequestThread> bufReqThread, uint32_t numWorkerThreads)
     : mParent(parent),
       mCroppingType(ct),
       mCameraCharacteristics(chars),
-      mBufferRequestThread(bufReqThread) {}
+      mBufferRequestThread(bufReqThread),
+      mWorkerPool(std::make_shared<WorkerPool>(numWorkerThreads)),
+      mMjpegDecoder(mWorkerPool),
+      mJpegEncoder(mWorkerPool) {}
 
-ExternalCameraDeviceSession::OutputThread::~OutputThread() {}
+ExternalCameraDeviceSession::OutputThread::~OutputThread() {
+    stopPipeline();
+}
 
 Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
         const Size& v4lSize, const Size& thumbSize, const std::vector<Stream>& streams,
         uint32_t blobBufferSize) {
-    std::lock_guard<std::mutex> lk(mBufferLock);
+    std::scoped_lock lk(mBufferLock, mDecodeLock, mConvertBufferLock);
     if (!mScaledYu12Frames.empty()) {
         ALOGE("%s: intermediate buffer pool has %zu inflight buffers! (expect 0)", __FUNCTION__,
               mScaledYu12Frames.size());
@@ -2155,6 +2307,16 @@ Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
         }
     }
 
+    // YU12 frames of the pipeline are allocated on demand, drop the ones of the previous size
+    {
+        std::lock_guard<std::mutex> framesLock(mFreeYu12FramesLock);
+        if (!(mPipelineFrameSize == v4lSize)) {
+            mFreeYu12Frames.clear();
+            mNumYu12Frames = 0;
+            mPipelineFrameSize = v4lSize;
+        }
+    }
+
     // Allocating intermediate YU12 thumbnail frame
     if (mYu12ThumbFrame == nullptr || mYu12ThumbFrame->mWidth != thumbSize.width ||
         mYu12ThumbFrame->mHeight != thumbSize.height) {
@@ -2185,6 +2347,19 @@ Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
             }
             mIntermediateBuffers[sz] = buf;
         }
+        // The convert stage scales in its own buffers, while the encode stage of the previous
+        // frame may still be using mIntermediateBuffers
+        if (stream.format != PixelFormat::BLOB && mConvertBuffers.count(sz) == 0) {
+            std::shared_ptr<AllocatedFrame> buf =
+                    std::make_shared<AllocatedFrame>(stream.width, stream.height);
+            int ret = buf->allocate();
+            if (ret != 0) {
+                ALOGE("%s: allocating convert YU12 frame %dx%d failed!", __FUNCTION__,
+                      stream.width, stream.height);
+                return Status::INTERNAL_ERROR;
+            }
+            mConvertBuffers[sz] = buf;
+        }
     }
 
     // Remove unconfigured buffers
@@ -2204,6 +2379,22 @@ Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
             it = mIntermediateBuffers.erase(it);
         }
     }
+    it = mConvertBuffers.begin();
+    while (it != mConvertBuffers.end()) {
+        bool configured = false;
+        for (const auto& stream : streams) {
+            if (stream.format != PixelFormat::BLOB && stream.width == it->first.width &&
+                stream.height == it->first.height) {
+                configured = true;
+                break;
+            }
+        }
+        if (configured) {
+            it++;
+        } else {
+            it = mConvertBuffers.erase(it);
+        }
+    }
 
     // Allocate mute test pattern frame
     mMuteTestPatternFrame.resize(mYu12Frame->mWidth * mYu12Frame->mHeight * 3);
@@ -2232,10 +2423,10 @@ void ExternalCameraDeviceSession::OutputThread::flush() {
     std::unique_lock<std::mutex> lk(mRequestListLock);
     std::list<std::shared_ptr<HalRequest>> reqs = std::move(mRequestList);
     mRequestList.clear();
-    if (mProcessingRequest) {
+    if (!mProcessingFrameNumbers.empty()) {
         auto timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
-        auto st = mRequestDoneCond.wait_for(lk, timeout);
-        if (st == std::cv_status::timeout) {
+        if (!mRequestDoneCond.wait_for(lk, timeout,
+                                       [this] { return mProcessingFrameNumbers.empty(); })) {
             ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
         }
     }
@@ -2248,9 +2439,13 @@ void ExternalCameraDeviceSession::OutputThread::flush() {
 }
 
 void ExternalCameraDeviceSession::OutputThread::dump(int fd) {
-    std::lock_guard<std::mutex> lk(mRequestListLock);
-    if (mProcessingRequest) {
-        dprintf(fd, "OutputThread processing frame %d\n", mProcessingFrameNumber);
+    std::unique_lock<std::mutex> lk(mRequestListLock);
+    if (!mProcessingFrameNumbers.empty()) {
+        dprintf(fd, "OutputThread processing frame: ");
+        for (uint32_t frameNumber : mProcessingFrameNumbers) {
+            dprintf(fd, "%d, ", frameNumber);
+        }
+        dprintf(fd, "\n");
     } else {
         dprintf(fd, "OutputThread not processing any frames\n");
     }
@@ -2259,6 +2454,15 @@ void ExternalCameraDeviceSession::OutputThread::dump(int fd) {
         dprintf(fd, "%d, ", req->frameNumber);
     }
     dprintf(fd, "\n");
+    lk.unlock();
+    dprintf(fd, "OutputThread pipeline: %zu frames waiting for convert, %zu for encode%s\n",
+            mConvertQueue.size(), mEncodeQueue.size(), mPipelineFailed ? ", failed" : "");
+    dprintf(fd,
+            "OutputThread buffers: %" PRIu64 " frames decoded into output buffers, %" PRIu64
+            " into YU12 frames, %" PRIu64 " copies to output buffers\n",
+            mDirectDecodeFrames.load(), mYu12DecodeFrames.load(), mOutputBufferCopies.load());
+    mMjpegDecoder.dump(fd);
+    mJpegEncoder.dump(fd);
 }
 
 void ExternalCameraDeviceSession::OutputThread::setExifMakeModel(const std::string& make,
@@ -2279,10 +2483,10 @@ ExternalCameraDeviceSession::OutputThread::switchToOffline() {
     std::unique_lock<std::mutex> lk(mRequestListLock);
     std::list<std::shared_ptr<HalRequest>> reqs = std::move(mRequestList);
     mRequestList.clear();
-    if (mProcessingRequest) {
+    if (!mProcessingFrameNumbers.empty()) {
         auto timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
-        auto st = mRequestDoneCond.wait_for(lk, timeout);
-        if (st == std::cv_status::timeout) {
+        if (!mRequestDoneCond.wait_for(lk, timeout,
+                                       [this] { return mProcessingFrameNumbers.empty(); })) {
             ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
         }
     }
@@ -2334,20 +2538,32 @@ void ExternalCameraDeviceSession::OutputThread::waitForNextRequest(
     }
     *out = mRequestList.front();
     mRequestList.pop_front();
-    mProcessingRequest = true;
-    mProcessingFrameNumber = (*out)->frameNumber;
+    mProcessingFrameNumbers.push_back((*out)->frameNumber);
 }
 
 void ExternalCameraDeviceSession::OutputThread::signalRequestDone() {
     std::unique_lock<std::mutex> lk(mRequestListLock);
-    mProcessingRequest = false;
-    mProcessingFrameNumber = 0;
+    if (!mProcessingFrameNumbers.empty()) {
+        mProcessingFrameNumbers.pop_front();
+    }
     lk.unlock();
-    mRequestDoneCond.notify_one();
+    mRequestDoneCond.notify_all();
 }
 
 int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
         std::shared_ptr<AllocatedFrame>& in, const Size& outSz, YCbCrLayout* out) {
+    int ret = cropAndScale(in, outSz, mIntermediateBuffers, out);
+    auto it = mIntermediateBuffers.find(outSz);
+    if (ret == 0 && it != mIntermediateBuffers.end()) {
+        mScaledYu12Frames.insert(*it);
+    }
+    return ret;
+}
+
+int ExternalCameraDeviceSession::OutputThread::cropAndScale(std::shared_ptr<AllocatedFrame>& in,
+                                                            const Size& outSz,
+                                                            const FrameMap& buffers,
+                                                            YCbCrLayout* out) {
     Size inSz = {in->mWidth, in->mHeight};
 
     int ret;
@@ -2384,19 +2600,13 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
         return 0;
     }
 
-    auto it = mScaledYu12Frames.find(outSz);
-    std::shared_ptr<AllocatedFrame> scaledYu12Buf;
-    if (it != mScaledYu12Frames.end()) {
-        scaledYu12Buf = it->second;
-    } else {
-        it = mIntermediateBuffers.find(outSz);
-        if (it == mIntermediateBuffers.end()) {
-            ALOGE("%s: failed to find intermediate buffer size %dx%d", __FUNCTION__, outSz.width,
-                  outSz.height);
-            return -1;
-        }
-        scaledYu12Buf = it->second;
+    auto it = buffers.find(outSz);
+    if (it == buffers.end()) {
+        ALOGE("%s: failed to find intermediate buffer size %dx%d", __FUNCTION__, outSz.width,
+              outSz.height);
+        return -1;
     }
+    const std::shared_ptr<AllocatedFrame>& scaledYu12Buf = it->second;
     // Scale
     YCbCrLayout outLayout;
     ret = scaledYu12Buf->getLayout(&outLayout);
@@ -2422,7 +2632,6 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
     }
 
     *out = outLayout;
-    mScaledYu12Frames.insert({outSz, scaledYu12Buf});
     return 0;
 }
 
@@ -2550,7 +2759,8 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleThumbLocked(
 }
 
 int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
-        HalStreamBuffer& halBuf, const common::V1_0::helper::CameraMetadata& setting) {
+        std::shared_ptr<AllocatedFrame>& in, HalStreamBuffer& halBuf,
+        const common::V1_0::helper::CameraMetadata& setting) {
     ATRACE_CALL();
     int ret;
     auto lfail = [&](auto... args) {
@@ -2568,7 +2778,7 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
           static_cast<uint64_t>(halBuf.bufferId), halBuf.width, halBuf.height);
     ALOGV("%s: HAL buffer fmt: %x usage: %" PRIx64 " ptr: %p", __FUNCTION__, halBuf.format,
           static_cast<uint64_t>(halBuf.usage), halBuf.bufPtr);
-    ALOGV("%s: YV12 buffer %d x %d", __FUNCTION__, mYu12Frame->mWidth, mYu12Frame->mHeight);
+    ALOGV("%s: YV12 buffer %d x %d", __FUNCTION__, in->mWidth, in->mHeight);
 
     int jpegQuality, thumbQuality;
     Size thumbSize;
@@ -2623,7 +2833,7 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
 
     YCbCrLayout yu12Thumb;
     if (outputThumbnail) {
-        ret = cropAndScaleThumbLocked(mYu12Frame, thumbSize, &yu12Thumb);
+        ret = cropAndScaleThumbLocked(in, thumbSize, &yu12Thumb);
 
         if (ret != 0) {
             return lfail("%s: crop and scale thumbnail failed!", __FUNCTION__);
@@ -2631,40 +2841,48 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
     }
 
     /* Scale and crop main jpeg */
-    ret = cropAndScaleLocked(mYu12Frame, jpegSize, &yu12Main);
+    ret = cropAndScaleLocked(in, jpegSize, &yu12Main);
 
     if (ret != 0) {
         return lfail("%s: crop and scale main failed!", __FUNCTION__);
     }
 
-    /* Encode the thumbnail image */
-    if (outputThumbnail) {
-        ret = encodeJpegYU12(thumbSize, yu12Thumb, thumbQuality, 0, 0, &thumbCode[0],
-                             maxThumbCodeSize, thumbCodeSize);
+    /* Generate EXIF object */
+    std::unique_ptr<ExifUtils> utils(ExifUtils::create());
 
-        if (ret != 0) {
-            return lfail("%s: thumbnail encodeJpegYU12 failed with %d", __FUNCTION__, ret);
+    /* Encode the main image, in parallel with the thumbnail and the APP1
+     * segment which embeds it */
+    ret = mJpegEncoder.encode(jpegSize, yu12Main, jpegQuality, [&]() {
+        /* Encode the thumbnail image */
+        if (outputThumbnail) {
+            int thumbRet = encodeJpegYU12(thumbSize, yu12Thumb, thumbQuality, 0, 0, &thumbCode[0],
+                                          maxThumbCodeSize, thumbCodeSize);
+
+            if (thumbRet != 0) {
+                return lfail("createJpegLocked: thumbnail encodeJpegYU12 failed with %d", thumbRet);
+            }
         }
-    }
 
-    /* Combine camera characteristics with request settings to form EXIF
-     * metadata */
-    common::V1_0::helper::CameraMetadata meta(mCameraCharacteristics);
-    meta.append(setting);
+        /* Combine camera characteristics with request settings to form EXIF
+         * metadata */
+        common::V1_0::helper::CameraMetadata meta(mCameraCharacteristics);
+        meta.append(setting);
 
-    /* Generate EXIF object */
-    std::unique_ptr<ExifUtils> utils(ExifUtils::create());
-    /* Make sure it's initialized */
-    utils->initialize();
+        /* Make sure it's initialized */
+        utils->initialize();
 
-    utils->setFromMetadata(meta, jpegSize.width, jpegSize.height);
-    utils->setMake(mExifMake);
-    utils->setModel(mExifModel);
+        utils->setFromMetadata(meta, jpegSize.width, jpegSize.height);
+        utils->setMake(mExifMake);
+        utils->setModel(mExifModel);
 
-    ret = utils->generateApp1(outputThumbnail ? &thumbCode[0] : nullptr, thumbCodeSize);
+        if (!utils->generateApp1(outputThumbnail ? &thumbCode[0] : nullptr, thumbCodeSize)) {
+            return lfail("createJpegLocked: generating APP1 failed");
+        }
+        return 0;
+    });
 
-    if (!ret) {
-        return lfail("%s: generating APP1 failed", __FUNCTION__);
+    if (ret != 0) {
+        return ret;
     }
 
     /* Get internal buffer */
@@ -2679,9 +2897,8 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
         return lfail("%s: could not lock %zu bytes", __FUNCTION__, maxJpegCodeSize);
     }
 
-    /* Encode the main jpeg image */
-    ret = encodeJpegYU12(jpegSize, yu12Main, jpegQuality, exifData, exifDataSize, bufPtr,
-                         maxJpegCodeSize, jpegCodeSize);
+    /* Write the main jpeg image */
+    ret = mJpegEncoder.write(exifData, exifDataSize, bufPtr, maxJpegCodeSize, jpegCodeSize);
 
     /* TODO: Not sure this belongs here, maybe better to pass jpegCodeSize out
      * and do this when returning buffer to parent */
@@ -2708,10 +2925,14 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
 }
 
 void ExternalCameraDeviceSession::OutputThread::clearIntermediateBuffers() {
-    std::lock_guard<std::mutex> lk(mBufferLock);
+    std::scoped_lock lk(mBufferLock, mDecodeLock, mConvertBufferLock, mFreeYu12FramesLock);
     mYu12Frame.reset();
     mYu12ThumbFrame.reset();
     mIntermediateBuffers.clear();
+    mConvertBuffers.clear();
+    mFreeYu12Frames.clear();
+    mNumYu12Frames = 0;
+    mPipelineFrameSize = {0, 0};
     mMuteTestPatternFrame.clear();
     mBlobBufferSize = 0;
 }
@@ -2724,23 +2945,29 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
         return false;
     }
 
-    // TODO: maybe we need to setup a sensor thread to dq/enq v4l frames
-    //       regularly to prevent v4l buffer queue filled with stale buffers
-    //       when app doesn't program a preview request
+    if (mConvertThread == nullptr) {
+        startPipeline();
+    }
+    if (mPipelineFailed) {
+        return false;
+    }
+
     waitForNextRequest(&req);
     if (req == nullptr) {
         // No new request, wait again
         return true;
     }
 
+    auto frame = std::make_shared<PipelineFrame>();
+    frame->req = req;
     auto onDeviceError = [&](auto... args) {
         ALOGE(args...);
-        parent->notifyError(req->frameNumber, /*stream*/ -1, ErrorCode::ERROR_DEVICE);
-        signalRequestDone();
+        onPipelineDeviceError(frame);
         return false;
     };
 
-    if (req->frameIn->mFourcc != V4L2_PIX_FMT_MJPEG && req->frameIn->mFourcc != V4L2_PIX_FMT_Z16) {
+    if (req->frameIn->mFourcc != V4L2_PIX_FMT_MJPEG && req->frameIn->mFourcc != V4L2_PIX_FMT_Z16 &&
+        !isUncompressedFourcc(req->frameIn->mFourcc)) {
         return onDeviceError("%s: do not support V4L2 format %c%c%c%c", __FUNCTION__,
                              req->frameIn->mFourcc & 0xFF, (req->frameIn->mFourcc >> 8) & 0xFF,
                              (req->frameIn->mFourcc >> 16) & 0xFF,
@@ -2753,7 +2980,7 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
         return onDeviceError("%s: failed to send buffer request!", __FUNCTION__);
     }
 
-    std::unique_lock<std::mutex> lk(mBufferLock);
+    std::unique_lock<std::mutex> lk(mDecodeLock);
     // Convert input V4L2 frame to YU12 of the same size
     // TODO: see if we can save some computation by converting to YV12 here
     uint8_t* inData;
@@ -2787,65 +3014,75 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
         }
     }
 
-    // TODO: in some special case maybe we can decode jpg directly to gralloc output?
-    if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
-        ATRACE_BEGIN("MJPGtoI420");
-        res = 0;
-        if (mCameraMuted) {
-            res = libyuv::ConvertToI420(
-                    mMuteTestPatternFrame.data(), mMuteTestPatternFrame.size(),
-                    static_cast<uint8_t*>(mYu12FrameLayout.y), mYu12FrameLayout.yStride,
-                    static_cast<uint8_t*>(mYu12FrameLayout.cb), mYu12FrameLayout.cStride,
-                    static_cast<uint8_t*>(mYu12FrameLayout.cr), mYu12FrameLayout.cStride, 0, 0,
-                    mYu12Frame->mWidth, mYu12Frame->mHeight, mYu12Frame->mWidth,
-                    mYu12Frame->mHeight, libyuv::kRotate0, libyuv::FOURCC_RAW);
-        } else {
-            res = libyuv::MJPGToI420(
-                    inData, inDataSize, static_cast<uint8_t*>(mYu12FrameLayout.y),
-                    mYu12FrameLayout.yStride, static_cast<uint8_t*>(mYu12FrameLayout.cb),
-                    mYu12FrameLayout.cStride, static_cast<uint8_t*>(mYu12FrameLayout.cr),
-                    mYu12FrameLayout.cStride, mYu12Frame->mWidth, mYu12Frame->mHeight,
-                    mYu12Frame->mWidth, mYu12Frame->mHeight);
-        }
+    const Size frameSize{req->frameIn->mWidth, req->frameIn->mHeight};
+    bool buffersReady = false;
+    if (req->frameIn->mFourcc != V4L2_PIX_FMT_Z16 && canDecodeToOutput(req->buffers, frameSize)) {
+        // The output buffers are needed before decoding into them
+        ATRACE_BEGIN("Wait for BufferRequest done");
+        res = waitForBufferRequestDone(&req->buffers);
         ATRACE_END();
+        buffersReady = true;
 
         if (res != 0) {
-            // For some webcam, the first few V4L2 frames might be malformed...
-            ALOGE("%s: Convert V4L2 frame to YU12 failed! res %d", __FUNCTION__, res);
-
-            ATRACE_BEGIN("Wait for BufferRequest done");
-            res = waitForBufferRequestDone(&req->buffers);
-            ATRACE_END();
+            // HAL buffer management buffer request can fail
+            ALOGE("%s: wait for BufferRequest done failed! res %d", __FUNCTION__, res);
+            frame->failed = true;
+        } else {
+            frame->decodedToOutput =
+                    decodeToOutputBuffersLocked(frame, inData, inDataSize, &res);
+            if (frame->decodedToOutput && res != 0) {
+                // For some webcam, the first few V4L2 frames might be malformed...
+                ALOGE("%s: Convert V4L2 frame to output buffer failed! res %d", __FUNCTION__, res);
+                frame->failed = true;
+            }
+        }
+    }
 
+    if (!frame->failed && !frame->decodedToOutput) {
+        // Waits for the encode stage to release a frame when the pipeline is full
+        frame->yu12Frame = acquireYu12Frame();
+        if (frame->yu12Frame == nullptr) {
             lk.unlock();
-            Status st = parent->processCaptureRequestError(req);
-            if (st != Status::OK) {
-                return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
+            return onDeviceError("%s: no YU12 frame available", __FUNCTION__);
+        }
+
+        if (req->frameIn->mFourcc != V4L2_PIX_FMT_Z16) {
+            YCbCrLayout yu12Layout;
+            frame->yu12Frame->getLayout(&yu12Layout);
+            res = decodeFrameLocked(req->frameIn->mFourcc, inData, inDataSize, frameSize,
+                                    yu12Layout);
+            mYu12DecodeFrames++;
+            if (res != 0) {
+                // For some webcam, the first few V4L2 frames might be malformed...
+                ALOGE("%s: Convert V4L2 frame to YU12 failed! res %d", __FUNCTION__, res);
+                frame->failed = true;
             }
-            signalRequestDone();
-            return true;
         }
     }
+    lk.unlock();
 
-    ATRACE_BEGIN("Wait for BufferRequest done");
-    res = waitForBufferRequestDone(&req->buffers);
-    ATRACE_END();
+    if (!buffersReady) {
+        ATRACE_BEGIN("Wait for BufferRequest done");
+        res = waitForBufferRequestDone(&req->buffers);
+        ATRACE_END();
 
-    if (res != 0) {
-        // HAL buffer management buffer request can fail
-        ALOGE("%s: wait for BufferRequest done failed! res %d", __FUNCTION__, res);
-        lk.unlock();
-        Status st = parent->processCaptureRequestError(req);
-        if (st != Status::OK) {
-            return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
+        if (res != 0) {
+            // HAL buffer management buffer request can fail
+            ALOGE("%s: wait for BufferRequest done failed! res %d", __FUNCTION__, res);
+            frame->failed = true;
         }
-        signalRequestDone();
-        return true;
     }
 
-    ALOGV("%s processing new request", __FUNCTION__);
+    if (!handOver(&mConvertQueue, frame)) {
+        return onDeviceError("%s: convert stage stopped", __FUNCTION__);
+    }
+    return true;
+}
+
+void ExternalCameraDeviceSession::OutputThread::waitForAcquireFences(
+        std::vector<HalStreamBuffer>* buffers) {
     const int kSyncWaitTimeoutMs = 500;
-    for (auto& halBuf : req->buffers) {
+    for (auto& halBuf : *buffers) {
         if (*(halBuf.bufPtr) == nullptr) {
             ALOGW("%s: buffer for stream %d missing", __FUNCTION__, halBuf.streamId);
             halBuf.fenceTimeout = true;
@@ -2858,98 +3095,427 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
                 halBuf.acquireFence = -1;
             }
         }
+    }
+}
+
+int ExternalCameraDeviceSession::OutputThread::lockOutputYCbCr(HalStreamBuffer& halBuf,
+                                                               YCbCrLayout* out) {
+    android::Rect outRect{0, 0, static_cast<int32_t>(halBuf.width),
+                          static_cast<int32_t>(halBuf.height)};
+    android_ycbcr result = sHandleImporter.lockYCbCr(
+            *(halBuf.bufPtr), static_cast<uint64_t>(halBuf.usage), outRect);
+    ALOGV("%s: outLayout y %p cb %p cr %p y_str %zu c_str %zu c_step %zu", __FUNCTION__, result.y,
+          result.cb, result.cr, result.ystride, result.cstride, result.chroma_step);
+    if (result.ystride > UINT32_MAX || result.cstride > UINT32_MAX ||
+        result.chroma_step > UINT32_MAX) {
+        ALOGE("%s: lockYCbCr failed. Unexpected values!", __FUNCTION__);
+        sHandleImporter.unlock(*(halBuf.bufPtr));
+        return -1;
+    }
+    *out = {.y = result.y,
+            .cb = result.cb,
+            .cr = result.cr,
+            .yStride = static_cast<uint32_t>(result.ystride),
+            .cStride = static_cast<uint32_t>(result.cstride),
+            .chromaStep = static_cast<uint32_t>(result.chroma_step)};
+    return 0;
+}
+
+int ExternalCameraDeviceSession::OutputThread::decodeFrameLocked(uint32_t fourcc,
+                                                                 uint8_t* inData,
+                                                                 size_t inDataSize,
+                                                                 const Size& size,
+                                                                 const YCbCrLayout& out) {
+    ATRACE_BEGIN(fourcc == V4L2_PIX_FMT_MJPEG ? "MJPGtoI420" : "toI420");
+    int res = 0;
+    if (mCameraMuted) {
+        res = libyuv::ConvertToI420(
+                mMuteTestPatternFrame.data(), mMuteTestPatternFrame.size(),
+                static_cast<uint8_t*>(out.y), out.yStride, static_cast<uint8_t*>(out.cb),
+                out.cStride, static_cast<uint8_t*>(out.cr), out.cStride, 0, 0, size.width,
+                size.height, size.width, size.height, libyuv::kRotate0, libyuv::FOURCC_RAW);
+    } else if (fourcc == V4L2_PIX_FMT_MJPEG) {
+        res = mMjpegDecoder.decodeToYU12(inData, inDataSize, size, out);
+    } else {
+        res = uncompressedToYU12(fourcc, inData, inDataSize, size, out);
+    }
+    ATRACE_END();
+    return res;
+}
+
+bool ExternalCameraDeviceSession::OutputThread::canDecodeToOutput(
+        const std::vector<HalStreamBuffer>& buffers, const Size& size) {
+    if (buffers.empty()) {
+        return false;
+    }
+    for (const auto& halBuf : buffers) {
+        if ((halBuf.format != PixelFormat::YCBCR_420_888 && halBuf.format != PixelFormat::YV12) ||
+            halBuf.width != size.width || halBuf.height != size.height) {
+            return false;
+        }
+    }
+    return true;
+}
 
+bool ExternalCameraDeviceSession::OutputThread::decodeToOutputBuffersLocked(
+        const std::shared_ptr<PipelineFrame>& frame, uint8_t* inData, size_t inDataSize,
+        int* res) {
+    ATRACE_CALL();
+    auto& req = frame->req;
+    waitForAcquireFences(&req->buffers);
+
+    std::vector<std::pair<HalStreamBuffer*, YCbCrLayout>> outputs;
+    auto unlockOutputs = [&] {
+        for (auto& output : outputs) {
+            int relFence = sHandleImporter.unlock(*(output.first->bufPtr));
+            if (relFence >= 0) {
+                output.first->acquireFence = relFence;
+            }
+        }
+    };
+    // YU12 and YV12 layouts are decoded into, only the order of the chroma planes differs
+    int target = -1;
+    for (auto& halBuf : req->buffers) {
         if (halBuf.fenceTimeout) {
             continue;
         }
+        YCbCrLayout layout;
+        if (lockOutputYCbCr(halBuf, &layout) != 0) {
+            // Left to the convert stage to report
+            unlockOutputs();
+            return false;
+        }
+        outputs.push_back({&halBuf, layout});
+        if (target < 0 && layout.chromaStep == 1) {
+            target = outputs.size() - 1;
+        }
+    }
+    if (outputs.empty()) {
+        // No buffer to fill
+        *res = 0;
+        return true;
+    }
+    if (target < 0) {
+        unlockOutputs();
+        return false;
+    }
 
-        // Gralloc lockYCbCr the buffer
-        switch (halBuf.format) {
-            case PixelFormat::BLOB: {
-                int ret = createJpegLocked(halBuf, req->setting);
+    const Size size{req->frameIn->mWidth, req->frameIn->mHeight};
+    const YCbCrLayout& targetLayout = outputs[target].second;
+    *res = decodeFrameLocked(req->frameIn->mFourcc, inData, inDataSize, size, targetLayout);
+    for (int i = 0; i < outputs.size() && *res == 0; i++) {
+        if (i == target) {
+            continue;
+        }
+        const YCbCrLayout& outLayout = outputs[i].second;
+        ATRACE_BEGIN("formatConvert");
+        *res = formatConvert(targetLayout, outLayout, size, getFourCcFromLayout(outLayout));
+        ATRACE_END();
+        mOutputBufferCopies++;
+    }
+    unlockOutputs();
+    mDirectDecodeFrames++;
+    return true;
+}
 
-                if (ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: createJpegLocked failed with %d", __FUNCTION__, ret);
-                }
-            } break;
-            case PixelFormat::Y16: {
-                void* outLayout = sHandleImporter.lock(
-                        *(halBuf.bufPtr), static_cast<uint64_t>(halBuf.usage), inDataSize);
+ExternalCameraDeviceSession::OutputThread::StageThread::StageThread(
+        PipelineQueue* input, std::function<bool(const std::shared_ptr<PipelineFrame>&)> process)
+    : mInput(input), mProcess(std::move(process)) {}
 
-                std::memcpy(outLayout, inData, inDataSize);
+ExternalCameraDeviceSession::OutputThread::StageThread::~StageThread() {
+    // mProcess must outlive the thread
+    requestExitAndWait();
+}
 
-                int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
-                if (relFence >= 0) {
-                    halBuf.acquireFence = relFence;
-                }
-            } break;
+bool ExternalCameraDeviceSession::OutputThread::StageThread::threadLoop() {
+    std::shared_ptr<PipelineFrame> frame;
+    if (!mInput->pop(&frame, std::chrono::milliseconds(kReqWaitTimeoutMs))) {
+        // Check for exit, wait again
+        return true;
+    }
+    return mProcess(frame);
+}
+
+void ExternalCameraDeviceSession::OutputThread::startPipeline() {
+    mPipelineFailed = false;
+    mConvertThread = std::make_unique<StageThread>(
+            &mConvertQueue,
+            [this](const std::shared_ptr<PipelineFrame>& frame) { return convertStage(frame); });
+    mEncodeThread = std::make_unique<StageThread>(
+            &mEncodeQueue,
+            [this](const std::shared_ptr<PipelineFrame>& frame) { return encodeStage(frame); });
+    mConvertThread->run();
+    mEncodeThread->run();
+}
+
+void ExternalCameraDeviceSession::OutputThread::stopPipeline() {
+    if (mConvertThread != nullptr) {
+        mConvertThread->requestExitAndWait();
+    }
+    if (mEncodeThread != nullptr) {
+        mEncodeThread->requestExitAndWait();
+    }
+}
+
+bool ExternalCameraDeviceSession::OutputThread::handOver(
+        PipelineQueue* queue, const std::shared_ptr<PipelineFrame>& frame) {
+    while (!queue->push(frame, std::chrono::milliseconds(kReqWaitTimeoutMs))) {
+        if (mPipelineFailed || exitPending()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<AllocatedFrame> ExternalCameraDeviceSession::OutputThread::acquireYu12Frame() {
+    ATRACE_CALL();
+    std::unique_lock<std::mutex> lk(mFreeYu12FramesLock);
+    while (mFreeYu12Frames.empty()) {
+        if (mNumYu12Frames < kNumPipelineYu12Frames) {
+            auto frame = std::make_shared<AllocatedFrame>(mPipelineFrameSize.width,
+                                                          mPipelineFrameSize.height);
+            if (frame->allocate() != 0) {
+                ALOGE("%s: allocating YU12 frame failed!", __FUNCTION__);
+                return nullptr;
+            }
+            mNumYu12Frames++;
+            return frame;
+        }
+        if (mPipelineFailed || exitPending()) {
+            return nullptr;
+        }
+        mYu12FrameReleasedCond.wait_for(lk, std::chrono::milliseconds(kReqWaitTimeoutMs));
+    }
+    std::shared_ptr<AllocatedFrame> frame = std::move(mFreeYu12Frames.back());
+    mFreeYu12Frames.pop_back();
+    return frame;
+}
+
+void ExternalCameraDeviceSession::OutputThread::releaseYu12Frame(
+        std::shared_ptr<AllocatedFrame> frame) {
+    if (frame == nullptr) {
+        return;
+    }
+    std::unique_lock<std::mutex> lk(mFreeYu12FramesLock);
+    if (frame->mWidth != mPipelineFrameSize.width || frame->mHeight != mPipelineFrameSize.height) {
+        // Allocated before the streams were reconfigured
+        return;
+    }
+    mFreeYu12Frames.push_back(std::move(frame));
+    lk.unlock();
+    mYu12FrameReleasedCond.notify_one();
+}
+
+bool ExternalCameraDeviceSession::OutputThread::convertStage(
+        const std::shared_ptr<PipelineFrame>& frame) {
+    ATRACE_CALL();
+    if (mPipelineFailed) {
+        dropPipelineFrame(frame);
+        return true;
+    }
+    if (frame->failed || frame->decodedToOutput) {
+        if (!handOver(&mEncodeQueue, frame)) {
+            dropPipelineFrame(frame);
+        }
+        return true;
+    }
+    auto& req = frame->req;
+
+    ALOGV("%s processing new request", __FUNCTION__);
+    waitForAcquireFences(&req->buffers);
+    // Buffers of the same size share the crop and scale of the YU12 frame
+    std::vector<std::vector<size_t>> yuvGroups;
+    std::vector<size_t> depthBuffers;
+    for (size_t i = 0; i < req->buffers.size(); i++) {
+        auto& halBuf = req->buffers[i];
+        if (halBuf.fenceTimeout) {
+            continue;
+        }
+
+        switch (halBuf.format) {
+            case PixelFormat::BLOB:
+                // Encoded by the encode stage
+                break;
+            case PixelFormat::Y16:
+                depthBuffers.push_back(i);
+                break;
             case PixelFormat::YCBCR_420_888:
             case PixelFormat::YV12: {
-                android::Rect outRect{0, 0, static_cast<int32_t>(halBuf.width),
-                                      static_cast<int32_t>(halBuf.height)};
-                android_ycbcr result = sHandleImporter.lockYCbCr(
-                        *(halBuf.bufPtr), static_cast<uint64_t>(halBuf.usage), outRect);
-                ALOGV("%s: outLayout y %p cb %p cr %p y_str %zu c_str %zu c_step %zu", __FUNCTION__,
-                      result.y, result.cb, result.cr, result.ystride, result.cstride,
-                      result.chroma_step);
-                if (result.ystride > UINT32_MAX || result.cstride > UINT32_MAX ||
-                    result.chroma_step > UINT32_MAX) {
-                    return onDeviceError("%s: lockYCbCr failed. Unexpected values!", __FUNCTION__);
-                }
-                YCbCrLayout outLayout = {.y = result.y,
-                                         .cb = result.cb,
-                                         .cr = result.cr,
-                                         .yStride = static_cast<uint32_t>(result.ystride),
-                                         .cStride = static_cast<uint32_t>(result.cstride),
-                                         .chromaStep = static_cast<uint32_t>(result.chroma_step)};
-
-                // Convert to output buffer size/format
-                uint32_t outputFourcc = getFourCcFromLayout(outLayout);
-                ALOGV("%s: converting to format %c%c%c%c", __FUNCTION__, outputFourcc & 0xFF,
-                      (outputFourcc >> 8) & 0xFF, (outputFourcc >> 16) & 0xFF,
-                      (outputFourcc >> 24) & 0xFF);
-
-                YCbCrLayout cropAndScaled;
-                ATRACE_BEGIN("cropAndScaleLocked");
-                int ret = cropAndScaleLocked(mYu12Frame, Size{halBuf.width, halBuf.height},
-                                             &cropAndScaled);
-                ATRACE_END();
-                if (ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: crop and scale failed!", __FUNCTION__);
-                }
-
-                Size sz{halBuf.width, halBuf.height};
-                ATRACE_BEGIN("formatConvert");
-                ret = formatConvert(cropAndScaled, outLayout, sz, outputFourcc);
-                ATRACE_END();
-                if (ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: format conversion failed!", __FUNCTION__);
-                }
-                int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
-                if (relFence >= 0) {
-                    halBuf.acquireFence = relFence;
+                auto group = std::find_if(
+                        yuvGroups.begin(), yuvGroups.end(), [&](const std::vector<size_t>& g) {
+                            const auto& other = req->buffers[g[0]];
+                            return other.width == halBuf.width && other.height == halBuf.height;
+                        });
+                if (group != yuvGroups.end()) {
+                    group->push_back(i);
+                } else {
+                    yuvGroups.push_back({i});
                 }
             } break;
             default:
-                lk.unlock();
-                return onDeviceError("%s: unknown output format %x", __FUNCTION__, halBuf.format);
+                ALOGE("%s: unknown output format %x", __FUNCTION__, halBuf.format);
+                onPipelineDeviceError(frame);
+                return true;
+        }
+    }
+
+    uint8_t* inData = nullptr;
+    size_t inDataSize = 0;
+    if (!depthBuffers.empty() && req->frameIn->getData(&inData, &inDataSize) != 0) {
+        ALOGE("%s: V4L2 buffer map failed", __FUNCTION__);
+        onPipelineDeviceError(frame);
+        return true;
+    }
+
+    // Output sizes are processed in parallel, the buffers of a size one after the other
+    std::vector<int> results(yuvGroups.size() + depthBuffers.size(), 0);
+    auto convertGroup = [&](const std::vector<size_t>& group) {
+        const Size sz{req->buffers[group[0]].width, req->buffers[group[0]].height};
+        YCbCrLayout cropAndScaled;
+        ATRACE_BEGIN("cropAndScale");
+        int ret = cropAndScale(frame->yu12Frame, sz, mConvertBuffers, &cropAndScaled);
+        ATRACE_END();
+        if (ret != 0) {
+            ALOGE("%s: crop and scale failed!", __FUNCTION__);
+            return ret;
+        }
+
+        for (size_t i : group) {
+            auto& halBuf = req->buffers[i];
+            YCbCrLayout outLayout;
+            ret = lockOutputYCbCr(halBuf, &outLayout);
+            if (ret != 0) {
+                return ret;
+            }
+
+            // Convert to output buffer size/format
+            uint32_t outputFourcc = getFourCcFromLayout(outLayout);
+            ALOGV("%s: converting to format %c%c%c%c", __FUNCTION__, outputFourcc & 0xFF,
+                  (outputFourcc >> 8) & 0xFF, (outputFourcc >> 16) & 0xFF,
+                  (outputFourcc >> 24) & 0xFF);
+
+            ATRACE_BEGIN("formatConvert");
+            ret = formatConvert(cropAndScaled, outLayout, sz, outputFourcc);
+            ATRACE_END();
+            mOutputBufferCopies++;
+            // The buffer is unlocked even if the conversion failed, it is returned with an error
+            int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
+            if (relFence >= 0) {
+                halBuf.acquireFence = relFence;
+            }
+            if (ret != 0) {
+                ALOGE("%s: format conversion failed!", __FUNCTION__);
+                return ret;
+            }
+        }
+        return 0;
+    };
+    auto copyDepth = [&](size_t i) {
+        auto& halBuf = req->buffers[i];
+        void* outLayout = sHandleImporter.lock(*(halBuf.bufPtr),
+                                               static_cast<uint64_t>(halBuf.usage), inDataSize);
+
+        std::memcpy(outLayout, inData, inDataSize);
+        mOutputBufferCopies++;
+
+        int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
+        if (relFence >= 0) {
+            halBuf.acquireFence = relFence;
+        }
+        return 0;
+    };
+
+    {
+        std::lock_guard<std::mutex> lk(mConvertBufferLock);
+        mWorkerPool->run(results.size(), [&](size_t task) {
+            results[task] = task < yuvGroups.size()
+                                    ? convertGroup(yuvGroups[task])
+                                    : copyDepth(depthBuffers[task - yuvGroups.size()]);
+        });
+    }
+    for (int ret : results) {
+        if (ret != 0) {
+            onPipelineDeviceError(frame);
+            return true;
+        }
+    }
+
+    if (!handOver(&mEncodeQueue, frame)) {
+        dropPipelineFrame(frame);
+    }
+    return true;
+}
+
+bool ExternalCameraDeviceSession::OutputThread::encodeStage(
+        const std::shared_ptr<PipelineFrame>& frame) {
+    ATRACE_CALL();
+    auto parent = mParent.lock();
+    if (parent == nullptr) {
+        ALOGE("%s: session has been disconnected!", __FUNCTION__);
+        return false;
+    }
+    auto& req = frame->req;
+
+    if (mPipelineFailed) {
+        dropPipelineFrame(frame);
+        return true;
+    }
+    if (frame->failed) {
+        releaseYu12Frame(std::move(frame->yu12Frame));
+        Status st = parent->processCaptureRequestError(req);
+        if (st != Status::OK) {
+            ALOGE("%s: failed to process capture request error!", __FUNCTION__);
+            onPipelineDeviceError(frame);
+            return true;
         }
-    }  // for each buffer
+        signalRequestDone();
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lk(mBufferLock);
+    for (auto& halBuf : req->buffers) {
+        if (halBuf.fenceTimeout || halBuf.format != PixelFormat::BLOB) {
+            continue;
+        }
+        int ret = createJpegLocked(frame->yu12Frame, halBuf, req->setting);
+        if (ret != 0) {
+            lk.unlock();
+            ALOGE("%s: createJpegLocked failed with %d", __FUNCTION__, ret);
+            onPipelineDeviceError(frame);
+            return true;
+        }
+    }
     mScaledYu12Frames.clear();
+    lk.unlock();
+    releaseYu12Frame(std::move(frame->yu12Frame));
 
     // Don't hold the lock while calling back to parent
-    lk.unlock();
     Status st = parent->processCaptureResult(req);
     if (st != Status::OK) {
-        return onDeviceError("%s: failed to process capture result!", __FUNCTION__);
+        ALOGE("%s: failed to process capture result!", __FUNCTION__);
+        onPipelineDeviceError(frame);
+        return true;
     }
     signalRequestDone();
     return true;
 }
 
+void ExternalCameraDeviceSession::OutputThread::onPipelineDeviceError(
+        const std::shared_ptr<PipelineFrame>& frame) {
+    mPipelineFailed = true;
+    auto parent = mParent.lock();
+    if (parent != nullptr) {
+        parent->notifyError(frame->req->frameNumber, /*stream*/ -1, ErrorCode::ERROR_DEVICE);
+    }
+    dropPipelineFrame(frame);
+}
+
+void ExternalCameraDeviceSession::OutputThread::dropPipelineFrame(
+        const std::shared_ptr<PipelineFrame>& frame) {
+    releaseYu12Frame(std::move(frame->yu12Frame));
+    signalRequestDone();
+}
+
 // End ExternalCameraDeviceSession::OutputThread functions
 
 }  // namespace implementation
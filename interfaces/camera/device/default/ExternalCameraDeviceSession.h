@@ -18,6 +18,8 @@
 #define HARDWARE_INTERFACES_CAMERA_DEVICE_DEFAULT_EXTERNALCAMERADEVICESESSION_H_
 
 #include <ExternalCameraUtils.h>
+#include <JpegEncoder.h>
+#include <MjpegDecoder.h>
 #include <SimpleThread.h>
 #include <aidl/android/hardware/camera/common/Status.h>
 #include <aidl/android/hardware/camera/device/BnCameraDeviceSession.h>
@@ -29,6 +31,7 @@
 #include <android/hardware/graphics/mapper/4.0/IMapper.h>
 #include <fmq/AidlMessageQueue.h>
 #include <utils/Thread.h>
+#include <atomic>
 #include <deque>
 #include <list>
 
@@ -165,7 +168,8 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
       public:
         OutputThread(std::weak_ptr<OutputThreadInterface> parent, CroppingType,
                      const common::V1_0::helper::CameraMetadata&,
-                     std::shared_ptr<BufferRequestThread> bufReqThread);
+                     std::shared_ptr<BufferRequestThread> bufReqThread,
+                     uint32_t numWorkerThreads = 0);
         ~OutputThread();
 
         Status allocateIntermediateBuffers(const Size& v4lSize, const Size& thumbSize,
@@ -185,6 +189,9 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
         static const int kFlushWaitTimeoutSec = 3;  // 3 sec
         static const int kReqWaitTimeoutMs = 33;    // 33ms
         static const int kReqWaitTimesMax = 90;     // 33ms * 90 ~= 3 sec
+        static const size_t kPipelineQueueSize = 1;
+        // One frame per stage
+        static const size_t kNumPipelineYu12Frames = 3;
 
         // Methods to request output buffer in parallel
         int requestBufferStart(const std::vector<HalStreamBuffer>&);
@@ -192,6 +199,7 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
                 /*out*/ std::vector<HalStreamBuffer>*);
 
         void waitForNextRequest(std::shared_ptr<HalRequest>* out);
+        // Marks the oldest request being processed as done
         void signalRequestDone();
 
         int cropAndScaleLocked(std::shared_ptr<AllocatedFrame>& in, const Size& outSize,
@@ -200,34 +208,102 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
         int cropAndScaleThumbLocked(std::shared_ptr<AllocatedFrame>& in, const Size& outSize,
                                     YCbCrLayout* out);
 
-        int createJpegLocked(HalStreamBuffer& halBuf,
+        int createJpegLocked(std::shared_ptr<AllocatedFrame>& in, HalStreamBuffer& halBuf,
                              const common::V1_0::helper::CameraMetadata& settings);
 
         void clearIntermediateBuffers();
 
+        // The online session processes requests in a pipeline of three stages, each on its own
+        // thread, handing frames over through bounded queues:
+        //   - decode: this thread, waits for the output buffers and converts the V4L2 frame to a
+        //     YU12 frame of a small pool, or directly to the output buffers when they are all of
+        //     the size of the V4L2 frame,
+        //   - convert: scales and converts the YU12 frame to the YUV and Y16 output buffers, the
+        //     output sizes in parallel on mWorkerPool,
+        //   - encode: encodes the BLOB output buffers and sends the capture result.
+        // Requests go through all stages in order, failed ones included, so that results and
+        // errors are sent in order. After a device error, the stages drop the frames in flight.
+        struct PipelineFrame {
+            std::shared_ptr<HalRequest> req;
+            std::shared_ptr<AllocatedFrame> yu12Frame;
+            bool failed = false;           // send a request error for this frame
+            bool decodedToOutput = false;  // the YUV output buffers are filled already
+        };
+        using PipelineQueue = BoundedQueue<std::shared_ptr<PipelineFrame>>;
+
+        class StageThread : public SimpleThread {
+          public:
+            // The stage stops when process returns false
+            StageThread(PipelineQueue* input,
+                        std::function<bool(const std::shared_ptr<PipelineFrame>&)> process);
+            ~StageThread() override;
+            bool threadLoop() override;
+
+          private:
+            PipelineQueue* const mInput;
+            const std::function<bool(const std::shared_ptr<PipelineFrame>&)> mProcess;
+        };
+
+        // Waits for the acquire fences of the output buffers, marks the missing ones
+        void waitForAcquireFences(std::vector<HalStreamBuffer>* buffers);
+        int lockOutputYCbCr(HalStreamBuffer& halBuf, YCbCrLayout* out);
+        // Decodes the MJPEG frame, converts the YUYV or NV12 frame, or the mute test pattern,
+        // to YU12 of the same size
+        int decodeFrameLocked(uint32_t fourcc, uint8_t* inData, size_t inDataSize,
+                              const Size& size, const YCbCrLayout& out);
+        // Whether all output buffers are YUV buffers of the size of the V4L2 frame
+        static bool canDecodeToOutput(const std::vector<HalStreamBuffer>& buffers,
+                                      const Size& size);
+        // Decodes into a planar output buffer and copies it to the others. Returns false,
+        // without having touched the buffers, if none of them is planar.
+        bool decodeToOutputBuffersLocked(const std::shared_ptr<PipelineFrame>& frame,
+                                         uint8_t* inData, size_t inDataSize, int* res);
+
+        void startPipeline();
+        void stopPipeline();
+        // Returns false if the next stage stopped
+        bool handOver(PipelineQueue* queue, const std::shared_ptr<PipelineFrame>& frame);
+        std::shared_ptr<AllocatedFrame> acquireYu12Frame();
+        void releaseYu12Frame(std::shared_ptr<AllocatedFrame> frame);
+        bool convertStage(const std::shared_ptr<PipelineFrame>& frame);
+        bool encodeStage(const std::shared_ptr<PipelineFrame>& frame);
+        // Crops 'in' to the aspect ratio of outSize, and scales it to the buffer of that size in
+        // 'buffers' if needed
+        using FrameMap = std::unordered_map<Size, std::shared_ptr<AllocatedFrame>, SizeHasher>;
+        int cropAndScale(std::shared_ptr<AllocatedFrame>& in, const Size& outSize,
+                         const FrameMap& buffers, YCbCrLayout* out);
+        // Notifies ERROR_DEVICE for the frame and stops the pipeline
+        void onPipelineDeviceError(const std::shared_ptr<PipelineFrame>& frame);
+        // Marks the request of the frame as done without sending a result
+        void dropPipelineFrame(const std::shared_ptr<PipelineFrame>& frame);
+
         const std::weak_ptr<OutputThreadInterface> mParent;
         const CroppingType mCroppingType;
         const common::V1_0::helper::CameraMetadata mCameraCharacteristics;
 
-        mutable std::mutex mRequestListLock;       // Protect access to mRequestList,
-                                                   // mProcessingRequest and mProcessingFrameNumber
+        mutable std::mutex mRequestListLock;       // Protect access to mRequestList and
+                                                   // mProcessingFrameNumbers
         std::condition_variable mRequestCond;      // signaled when a new request is submitted
         std::condition_variable mRequestDoneCond;  // signaled when a request is done processing
         std::list<std::shared_ptr<HalRequest>> mRequestList;
-        bool mProcessingRequest = false;
-        uint32_t mProcessingFrameNumber = 0;
+        // Requests taken from mRequestList and not done yet, oldest first
+        std::deque<uint32_t> mProcessingFrameNumbers;
 
         // V4L2 frameIn
-        // (MJPG decode)-> mYu12Frame
-        // (Scale)-> mScaledYu12Frames
+        // (MJPG decode)-> mYu12Frame, or a frame of mFreeYu12Frames in the pipeline
+        // (Scale)-> mScaledYu12Frames, or mConvertBuffers in the convert stage
         // (Format convert) -> output gralloc frames
-        mutable std::mutex mBufferLock;  // Protect access to intermediate buffers
+        mutable std::mutex mBufferLock;  // Protect access to intermediate buffers, except for
+                                         // the ones of the decode and convert stages
         std::shared_ptr<AllocatedFrame> mYu12Frame;
         std::shared_ptr<AllocatedFrame> mYu12ThumbFrame;
         std::unordered_map<Size, std::shared_ptr<AllocatedFrame>, SizeHasher> mIntermediateBuffers;
         std::unordered_map<Size, std::shared_ptr<AllocatedFrame>, SizeHasher> mScaledYu12Frames;
         YCbCrLayout mYu12FrameLayout;
         YCbCrLayout mYu12ThumbFrameLayout;
+        // The decode stage holds mDecodeLock instead of mBufferLock, protecting the mute test
+        // pattern and mMjpegDecoder
+        std::mutex mDecodeLock;
         std::vector<uint8_t> mMuteTestPatternFrame;
         uint32_t mTestPatternData[4] = {0, 0, 0, 0};
         bool mCameraMuted = false;
@@ -237,6 +313,32 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
         std::string mExifModel;
 
         const std::shared_ptr<BufferRequestThread> mBufferRequestThread;
+
+        // Threads splitting the processing of a frame in strips
+        const std::shared_ptr<WorkerPool> mWorkerPool;
+        MjpegDecoder mMjpegDecoder;
+        JpegEncoder mJpegEncoder;  // protected by mBufferLock
+
+        std::mutex mConvertBufferLock;  // Protect access to mConvertBuffers
+        std::unordered_map<Size, std::shared_ptr<AllocatedFrame>, SizeHasher> mConvertBuffers;
+
+        std::mutex mFreeYu12FramesLock;  // Protect the YU12 frames of the pipeline
+        std::condition_variable mYu12FrameReleasedCond;
+        std::vector<std::shared_ptr<AllocatedFrame>> mFreeYu12Frames;
+        size_t mNumYu12Frames = 0;  // free or in the pipeline
+        Size mPipelineFrameSize = {0, 0};
+
+        PipelineQueue mConvertQueue{kPipelineQueueSize};
+        PipelineQueue mEncodeQueue{kPipelineQueueSize};
+        std::atomic<bool> mPipelineFailed = false;
+
+        // Frames decoded into an output buffer, saving the YU12 frame and a copy
+        std::atomic<uint64_t> mDirectDecodeFrames = 0;
+        std::atomic<uint64_t> mYu12DecodeFrames = 0;
+        // Full frame copies or conversions to an output buffer, JPEG excluded
+        std::atomic<uint64_t> mOutputBufferCopies = 0;
+        std::unique_ptr<StageThread> mConvertThread;
+        std::unique_ptr<StageThread> mEncodeThread;
     };
 
   private:
@@ -256,11 +358,32 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
 
     int setV4l2FpsLocked(double fps);
 
+    // Takes the latest frame of the SensorThread, waiting for one if needed
     std::unique_ptr<V4L2Frame> dequeueV4l2FrameLocked(
             /*out*/ nsecs_t* shutterTs);  // Called with mLock held
 
     void enqueueV4l2Frame(const std::shared_ptr<V4L2Frame>&);
 
+    // Cycles the V4L2 buffer queue while streaming, so that requests take a recent frame
+    // without waiting for a DQBUF, even when they are sporadic. Each dequeued frame replaces
+    // the latest frame, which is queued back to the driver.
+    class SensorThread : public SimpleThread {
+      public:
+        explicit SensorThread(ExternalCameraDeviceSession* parent);
+        ~SensorThread() override;
+        bool threadLoop() override;
+
+      private:
+        ExternalCameraDeviceSession* const mParent;
+    };
+
+    void startSensorThreadLocked();
+    // Also queues the latest frame back to the driver
+    void stopSensorThreadLocked();
+    // One iteration of the SensorThread, returns false on V4L2 error
+    bool cycleV4l2Queue();
+    std::unique_ptr<V4L2Frame> dequeueV4l2Buffer(/*out*/ nsecs_t* shutterTs);
+
     // Check if input Stream is one of supported stream setting on this device
     static bool isSupported(const Stream& stream,
                             const std::vector<SupportedV4L2Format>& supportedFormats,
@@ -334,11 +457,34 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
     size_t mV4L2BufferCount = 0;
 
     static const int kBufferWaitTimeoutSec = 3;  // TODO: handle long exposure (or not allowing)
-    std::mutex mV4l2BufferLock;                  // protect the buffer count and condition below
+    std::mutex mV4l2BufferLock;  // protect the buffer count, latest frame and conditions below
     std::condition_variable mV4L2BufferReturned;
     size_t mNumDequeuedV4l2Buffers = 0;
     uint32_t mMaxV4L2BufferSize = 0;
 
+    static const int kSensorPollTimeoutMs = 100;
+    // Runs while streaming, protected by mLock
+    std::unique_ptr<SensorThread> mSensorThread;
+    std::condition_variable mLatestV4l2FrameCond;  // signaled when a new frame is dequeued
+    std::unique_ptr<V4L2Frame> mLatestV4l2Frame;   // counted in mNumDequeuedV4l2Buffers
+    nsecs_t mLatestV4l2FrameTs = 0;
+
+    struct SensorStats {
+        uint64_t frames = 0;         // dequeued by the SensorThread
+        uint64_t droppedFrames = 0;  // replaced by a newer frame before a request took them
+        uint64_t takenFrames = 0;
+        nsecs_t lastTs = 0;
+        // Intervals between the timestamps of consecutive frames
+        uint64_t intervals = 0;
+        double intervalSumMs = 0.0;
+        double intervalSqSumMs = 0.0;
+        nsecs_t maxInterval = 0;
+        // Age of the frames when taken by a request
+        double ageSumMs = 0.0;
+        nsecs_t maxAge = 0;
+    };
+    SensorStats mSensorStats;  // Protected by mV4l2BufferLock
+
     // Not protected by mLock (but might be used when mLock is locked)
     std::shared_ptr<OutputThread> mOutputThread;
 
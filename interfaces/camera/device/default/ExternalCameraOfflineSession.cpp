@@ -389,7 +389,8 @@ bool ExternalCameraOfflineSession::OutputThread::threadLoop() {
         return false;
     };
 
-    if (req->frameIn->mFourcc != V4L2_PIX_FMT_MJPEG && req->frameIn->mFourcc != V4L2_PIX_FMT_Z16) {
+    if (req->frameIn->mFourcc != V4L2_PIX_FMT_MJPEG && req->frameIn->mFourcc != V4L2_PIX_FMT_Z16 &&
+        !isUncompressedFourcc(req->frameIn->mFourcc)) {
         return onDeviceError("%s: do not support V4L2 format %c%c%c%c", __FUNCTION__,
                              req->frameIn->mFourcc & 0xFF, (req->frameIn->mFourcc >> 8) & 0xFF,
                              (req->frameIn->mFourcc >> 16) & 0xFF,
@@ -413,15 +414,10 @@ bool ExternalCameraOfflineSession::OutputThread::threadLoop() {
     }
 
     // TODO: in some special case maybe we can decode jpg directly to gralloc output?
-    if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
-        ATRACE_BEGIN("MJPGtoI420");
-        int convRes = libyuv::MJPGToI420(
-                inData, inDataSize, static_cast<uint8_t*>(mYu12FrameLayout.y),
-                mYu12FrameLayout.yStride, static_cast<uint8_t*>(mYu12FrameLayout.cb),
-                mYu12FrameLayout.cStride, static_cast<uint8_t*>(mYu12FrameLayout.cr),
-                mYu12FrameLayout.cStride, mYu12Frame->mWidth, mYu12Frame->mHeight,
-                mYu12Frame->mWidth, mYu12Frame->mHeight);
-        ATRACE_END();
+    if (req->frameIn->mFourcc != V4L2_PIX_FMT_Z16) {
+        int convRes = decodeFrameLocked(req->frameIn->mFourcc, inData, inDataSize,
+                                        Size{mYu12Frame->mWidth, mYu12Frame->mHeight},
+                                        mYu12FrameLayout);
 
         if (convRes != 0) {
             // For some webcam, the first few V4L2 frames might be malformed...
@@ -469,7 +465,7 @@ bool ExternalCameraOfflineSession::OutputThread::threadLoop() {
         // Gralloc lockYCbCr the buffer
         switch (halBuf.format) {
             case PixelFormat::BLOB: {
-                int ret = createJpegLocked(halBuf, req->setting);
+                int ret = createJpegLocked(mYu12Frame, halBuf, req->setting);
 
                 if (ret != 0) {
                     lk.unlock();
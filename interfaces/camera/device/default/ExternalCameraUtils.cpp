@@ -44,6 +44,7 @@ const int kDefaultNumVideoBuffer = 4;
 const int kDefaultNumStillBuffer = 2;
 const int kDefaultOrientation = 0;  // suitable for natural landscape displays like tablet/TV
                                     // For phone devices 270 is better
+const int kDefaultNumWorkerThreads = 0;  // derived from the number of CPUs
 }  // anonymous namespace
 
 const char* ExternalCameraConfig::kDefaultCfgPath = "/vendor/etc/external_camera_config.xml";
@@ -168,10 +169,18 @@ ExternalCameraConfig ExternalCameraConfig::loadFromCfg(const char* cfgPath) {
         ret.orientation = orientation->IntAttribute("degree", /*Default*/ kDefaultOrientation);
     }
 
+    XMLElement* numWorkerThreads = deviceCfg->FirstChildElement("NumWorkerThreads");
+    if (numWorkerThreads == nullptr) {
+        ALOGI("%s: no num worker threads specified", __FUNCTION__);
+    } else {
+        ret.numWorkerThreads =
+                numWorkerThreads->UnsignedAttribute("count", /*Default*/ kDefaultNumWorkerThreads);
+    }
+
     ALOGI("%s: external camera cfg loaded: maxJpgBufSize %d,"
-          " num video buffers %d, num still buffers %d, orientation %d",
+          " num video buffers %d, num still buffers %d, orientation %d, num worker threads %d",
           __FUNCTION__, ret.maxJpegBufSize, ret.numVideoBuffers, ret.numStillBuffers,
-          ret.orientation);
+          ret.orientation, ret.numWorkerThreads);
     for (const auto& limit : ret.fpsLimits) {
         ALOGI("%s: fpsLimitList: %dx%d@%f", __FUNCTION__, limit.size.width, limit.size.height,
               limit.fpsUpperBound);
@@ -220,7 +229,8 @@ ExternalCameraConfig::ExternalCameraConfig()
       numVideoBuffers(kDefaultNumVideoBuffer),
       numStillBuffers(kDefaultNumStillBuffer),
       depthEnabled(false),
-      orientation(kDefaultOrientation) {
+      orientation(kDefaultOrientation),
+      numWorkerThreads(kDefaultNumWorkerThreads) {
     fpsLimits.push_back({/* size */ {/* width */ 640, /* height */ 480}, /* fpsUpperBound */ 30.0});
     fpsLimits.push_back({/* size */ {/* width */ 1280, /* height */ 720}, /* fpsUpperBound */ 7.5});
     fpsLimits.push_back(
@@ -390,6 +400,75 @@ int AllocatedFrame::getCroppedLayout(const IMapper::Rect& rect, YCbCrLayout* out
     return 0;
 }
 
+WorkerPool::WorkerPool(uint32_t numThreads)
+    : mThreadCount(numThreads != 0 ? numThreads
+                                   : std::clamp(std::thread::hardware_concurrency(), 1u,
+                                                kMaxDefaultThreads)) {
+    for (uint32_t i = 1; i < mThreadCount; i++) {
+        mThreads.emplace_back(&WorkerPool::threadLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        mExiting = true;
+    }
+    mBatchCond.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1 || mThreads.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    Batch batch{.task = &task, .count = count, .next = 0, .pending = count};
+    std::unique_lock<std::mutex> lk(mLock);
+    mBatches.push_back(&batch);
+    lk.unlock();
+    mBatchCond.notify_all();
+
+    lk.lock();
+    // Only help with our own batch so that its latency does not depend on other batches
+    while (batch.next < batch.count) {
+        runNextTaskLocked(lk, &batch);
+    }
+    mDoneCond.wait(lk, [&batch] { return batch.pending == 0; });
+}
+
+void WorkerPool::threadLoop() {
+    std::unique_lock<std::mutex> lk(mLock);
+    while (true) {
+        mBatchCond.wait(lk, [this] { return mExiting || !mBatches.empty(); });
+        if (mExiting) {
+            return;
+        }
+        runNextTaskLocked(lk, mBatches.front());
+    }
+}
+
+void WorkerPool::runNextTaskLocked(std::unique_lock<std::mutex>& lk, Batch* batch) {
+    size_t index = batch->next++;
+    if (batch->next == batch->count) {
+        mBatches.erase(std::find(mBatches.begin(), mBatches.end(), batch));
+    }
+    lk.unlock();
+    (*batch->task)(index);
+    lk.lock();
+    if (--batch->pending == 0) {
+        mDoneCond.notify_all();
+    }
+}
+
 bool isAspectRatioClose(float ar1, float ar2) {
     constexpr float kAspectRatioMatchThres = 0.025f;  // This threshold is good enough to
                                                       // distinguish 4:3/16:9/20:9 1.33/1.78/2
@@ -541,7 +620,7 @@ int formatConvert(const YCbCrLayout& in, const YCbCrLayout& out, Size sz, uint32
             break;
         case V4L2_PIX_FMT_YVU420:  // YV12
         case V4L2_PIX_FMT_YUV420:  // YU12
-            // TODO: maybe we can speed up here by somehow save this copy?
+            // The OutputThread decodes into the output buffer instead when the sizes match
             ret = libyuv::I420Copy(static_cast<uint8_t*>(in.y), static_cast<int32_t>(in.yStride),
                                    static_cast<uint8_t*>(in.cb), static_cast<int32_t>(in.cStride),
                                    static_cast<uint8_t*>(in.cr), static_cast<int32_t>(in.cStride),
@@ -567,9 +646,82 @@ int formatConvert(const YCbCrLayout& in, const YCbCrLayout& out, Size sz, uint32
     return 0;
 }
 
+int uncompressedToYU12(uint32_t fourcc, const uint8_t* inData, size_t inDataSize, const Size& sz,
+                       const YCbCrLayout& out) {
+    // libyuv picks the SSE2/AVX2 or NEON row functions of these at runtime
+    int ret = 0;
+    switch (fourcc) {
+        case V4L2_PIX_FMT_YUYV:
+            if (inDataSize < static_cast<size_t>(sz.width) * sz.height * 2) {
+                ALOGE("%s: YUYV frame %dx%d too small: %zu bytes", __FUNCTION__, sz.width,
+                      sz.height, inDataSize);
+                return -1;
+            }
+            ret = libyuv::YUY2ToI420(inData, sz.width * 2, static_cast<uint8_t*>(out.y),
+                                     static_cast<int32_t>(out.yStride),
+                                     static_cast<uint8_t*>(out.cb),
+                                     static_cast<int32_t>(out.cStride),
+                                     static_cast<uint8_t*>(out.cr),
+                                     static_cast<int32_t>(out.cStride), sz.width, sz.height);
+            break;
+        case V4L2_PIX_FMT_NV12:
+            if (inDataSize < static_cast<size_t>(sz.width) * sz.height * 3 / 2) {
+                ALOGE("%s: NV12 frame %dx%d too small: %zu bytes", __FUNCTION__, sz.width,
+                      sz.height, inDataSize);
+                return -1;
+            }
+            ret = libyuv::NV12ToI420(inData, sz.width, inData + sz.width * sz.height, sz.width,
+                                     static_cast<uint8_t*>(out.y),
+                                     static_cast<int32_t>(out.yStride),
+                                     static_cast<uint8_t*>(out.cb),
+                                     static_cast<int32_t>(out.cStride),
+                                     static_cast<uint8_t*>(out.cr),
+                                     static_cast<int32_t>(out.cStride), sz.width, sz.height);
+            break;
+        default:
+            ALOGE("%s: unknown V4L2 format 0x%x!", __FUNCTION__, fourcc);
+            return -1;
+    }
+    if (ret != 0) {
+        ALOGE("%s: convert to YU12 failed! ret %d", __FUNCTION__, ret);
+    }
+    return ret;
+}
+
+bool isUncompressedFourcc(uint32_t fourcc) {
+    return fourcc == V4L2_PIX_FMT_YUYV || fourcc == V4L2_PIX_FMT_NV12;
+}
+
+SupportedV4L2Format getPreferredV4l2Format(const std::vector<SupportedV4L2Format>& formats,
+                                           const SupportedV4L2Format& format) {
+    auto maxFps = [](const SupportedV4L2Format& fmt) {
+        double fps = 0.0;
+        for (const auto& fr : fmt.frameRates) {
+            fps = std::max(fps, fr.getFramesPerSecond());
+        }
+        return fps;
+    };
+    bool depth = format.fourcc == V4L2_PIX_FMT_Z16;
+    SupportedV4L2Format preferred = format;
+    for (const auto& fmt : formats) {
+        if (fmt.width != format.width || fmt.height != format.height ||
+            (fmt.fourcc == V4L2_PIX_FMT_Z16) != depth) {
+            continue;
+        }
+        double fps = maxFps(fmt);
+        double preferredFps = maxFps(preferred);
+        if (fps > preferredFps ||
+            (fps == preferredFps && isUncompressedFourcc(fmt.fourcc) &&
+             !isUncompressedFourcc(preferred.fourcc))) {
+            preferred = fmt;
+        }
+    }
+    return preferred;
+}
+
 int encodeJpegYU12(const Size& inSz, const YCbCrLayout& inLayout, int jpegQuality,
                    const void* app1Buffer, size_t app1Size, void* out, size_t maxOutSize,
-                   size_t& actualCodeSize) {
+                   size_t& actualCodeSize, int restartInRows) {
     /* libjpeg is a C library so we use C-style "inheritance" by
      * putting libjpeg's jpeg_destination_mgr first in our custom
      * struct. This allows us to cast jpeg_destination_mgr* to
@@ -652,6 +804,7 @@ int encodeJpegYU12(const Size& inSz, const YCbCrLayout& inLayout, int jpegQualit
     jpeg_set_colorspace(&cinfo, JCS_YCbCr);
     cinfo.raw_data_in = 1;
     cinfo.dct_method = JDCT_IFAST;
+    cinfo.restart_in_rows = restartInRows;
 
     /* Configure sampling factors. The sampling factor is JPEG subsampling 420
      * because the source format is YUV420. Note that libjpeg sampling factors
@@ -718,12 +871,20 @@ int encodeJpegYU12(const Size& inSz, const YCbCrLayout& inLayout, int jpegQualit
         if (done != batchSize) {
             ALOGE("%s: compressed %u lines, expected %u (total %u/%u)", __FUNCTION__, done,
                   batchSize, cinfo.next_scanline, cinfo.image_height);
+            jpeg_destroy_compress(&cinfo);
             return -1;
         }
     }
 
     /* This will flush everything */
     jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    /* error_exit returns, e.g. when the output buffer is too small */
+    if (!dmgr.mSuccess) {
+        ALOGE("%s: libjpeg failed to compress the frame", __FUNCTION__);
+        return -1;
+    }
 
     /* Grab the actual code size and set it */
     actualCodeSize = dmgr.mEncodedSize;
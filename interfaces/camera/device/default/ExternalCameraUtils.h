@@ -29,7 +29,13 @@
 #include <android/hardware/graphics/mapper/3.0/IMapper.h>
 #include <android/hardware/graphics/mapper/4.0/IMapper.h>
 #include <tinyxml2.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -107,6 +113,9 @@ struct ExternalCameraConfig {
     // The value of android.sensor.orientation
     int32_t orientation;
 
+    // Number of threads processing a frame in parallel, 0 to derive it from the number of CPUs
+    uint32_t numWorkerThreads;
+
   private:
     ExternalCameraConfig();
     static bool updateFpsList(tinyxml2::XMLElement* fpsList, std::vector<FpsLimitation>& fpsLimits);
@@ -189,6 +198,88 @@ class AllocatedFrame : public Frame {
                          // bigger to horizontally pad the frame for jpeglib.
 };
 
+// A fixed set of threads running the tasks of a batch in parallel, used to process a frame in
+// horizontal strips. The thread submitting a batch runs its tasks too, so a pool of N threads
+// starts N - 1 threads. Batches may be submitted from several threads at once.
+class WorkerPool {
+  public:
+    // numThreads 0 derives the number of threads from the number of CPUs
+    explicit WorkerPool(uint32_t numThreads);
+    ~WorkerPool();
+
+    uint32_t getThreadCount() const { return mThreadCount; }
+
+    // Runs task(0) to task(count - 1) and returns once all of them have returned
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+  private:
+    struct Batch {
+        const std::function<void(size_t)>* task;
+        size_t count;
+        size_t next;     // index of the next task to start
+        size_t pending;  // number of tasks not finished yet
+    };
+
+    void threadLoop();
+    // Starts the next task of the batch, called with mLock held
+    void runNextTaskLocked(std::unique_lock<std::mutex>& lk, Batch* batch);
+
+    static const uint32_t kMaxDefaultThreads = 4;
+
+    const uint32_t mThreadCount;
+    std::mutex mLock;
+    std::condition_variable mBatchCond;  // signaled when a batch is submitted
+    std::condition_variable mDoneCond;   // signaled when the last task of a batch is done
+    std::deque<Batch*> mBatches;         // batches with tasks not started yet
+    bool mExiting = false;
+    std::vector<std::thread> mThreads;
+};
+
+// A FIFO of bounded size handing over items from one thread to another. Both ends wait with a
+// timeout, so that the calling threads can check whether they have been asked to exit.
+template <typename T>
+class BoundedQueue {
+  public:
+    explicit BoundedQueue(size_t capacity) : mCapacity(capacity) {}
+
+    // Returns false if the queue stayed full for the whole timeout
+    bool push(T item, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lk(mLock);
+        if (!mNotFullCond.wait_for(lk, timeout, [this] { return mItems.size() < mCapacity; })) {
+            return false;
+        }
+        mItems.push_back(std::move(item));
+        lk.unlock();
+        mNotEmptyCond.notify_one();
+        return true;
+    }
+
+    // Returns false if the queue stayed empty for the whole timeout
+    bool pop(T* item, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lk(mLock);
+        if (!mNotEmptyCond.wait_for(lk, timeout, [this] { return !mItems.empty(); })) {
+            return false;
+        }
+        *item = std::move(mItems.front());
+        mItems.pop_front();
+        lk.unlock();
+        mNotFullCond.notify_one();
+        return true;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lk(mLock);
+        return mItems.size();
+    }
+
+  private:
+    const size_t mCapacity;
+    mutable std::mutex mLock;
+    std::condition_variable mNotEmptyCond;
+    std::condition_variable mNotFullCond;
+    std::deque<T> mItems;
+};
+
 enum CroppingType { HORIZONTAL = 0, VERTICAL = 1 };
 
 // Aspect ratio is defined as width/height here and ExternalCameraDevice
@@ -247,9 +338,23 @@ int getCropRect(CroppingType ct, const Size& inSize, const Size& outSize, IMappe
 
 int formatConvert(const YCbCrLayout& in, const YCbCrLayout& out, Size sz, uint32_t format);
 
+// Converts an uncompressed YUYV or NV12 V4L2 frame to YU12. Returns 0 on success.
+int uncompressedToYU12(uint32_t fourcc, const uint8_t* inData, size_t inDataSize, const Size& sz,
+                       const YCbCrLayout& out);
+
+// V4L2 formats which need no decode
+bool isUncompressedFourcc(uint32_t fourcc);
+
+// Returns the format to stream at the size of 'format', among the ones of the same kind (color
+// or depth) in 'formats': the one with the highest frame rate, an uncompressed one at equal
+// frame rate as it has a lower latency.
+SupportedV4L2Format getPreferredV4l2Format(const std::vector<SupportedV4L2Format>& formats,
+                                           const SupportedV4L2Format& format);
+
+// restartInRows is the number of MCU rows between restart markers, 0 for no restart markers
 int encodeJpegYU12(const Size& inSz, const YCbCrLayout& inLayout, int jpegQuality,
                    const void* app1Buffer, size_t app1Size, void* out, size_t maxOutSize,
-                   size_t& actualCodeSize);
+                   size_t& actualCodeSize, int restartInRows = 0);
 
 Size getMaxThumbnailResolution(const common::V1_0::helper::CameraMetadata&);
 
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ExtCamJpegEnc"
+// #define LOG_NDEBUG 0
+
+#include "JpegEncoder.h"
+
+#include <log/log.h>
+#include <utils/Timers.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+namespace android {
+namespace hardware {
+namespace camera {
+namespace device {
+namespace implementation {
+
+namespace {
+const uint8_t kMarker = 0xFF;
+const uint8_t kSof0 = 0xC0;
+const uint8_t kRst7 = 0xD7;
+const uint8_t kSoi = 0xD8;
+const uint8_t kEoi = 0xD9;
+const uint8_t kSos = 0xDA;
+const uint8_t kApp0 = 0xE0;
+const uint8_t kApp1 = 0xE1;
+
+// encodeJpegYU12 encodes YUV 4:2:0, in MCUs of 16x16 pixels
+const int32_t kMcuHeight = 16;
+// Strips start on a multiple of 8 MCU rows, the period of the restart marker numbers
+const int32_t kStripRowAlignment = 8 * kMcuHeight;
+// Headers of a strip without APP1: SOI, APP0, 2 DQT, SOF0, 4 DHT, DRI, SOS and EOI
+const size_t kStripHeaderSize = 1024;
+// Largest payload of a marker segment
+const size_t kMaxSegmentSize = 65533;
+
+uint16_t readBigEndian16(const uint8_t* data) {
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+}  // anonymous namespace
+
+JpegEncoder::JpegEncoder(std::shared_ptr<WorkerPool> workerPool)
+    : mWorkerPool(std::move(workerPool)) {}
+
+int JpegEncoder::encode(const Size& size, const YCbCrLayout& in, int jpegQuality,
+                        const std::function<int()>& concurrentTask) {
+    nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    mSize = size;
+    mLayout = in;
+    mJpegQuality = jpegQuality;
+    mNumStrips = getStripCount(size);
+    if (mNumStrips == 0) {
+        return concurrentTask ? concurrentTask() : 0;
+    }
+
+    int32_t numGroups = (size.height + kStripRowAlignment - 1) / kStripRowAlignment;
+    mStrips.resize(mNumStrips);
+    mStripSizes.assign(mNumStrips, 0);
+    std::vector<int> stripResults(mNumStrips, 0);
+    int taskRet = 0;
+    size_t firstStripTask = concurrentTask ? 1 : 0;
+    mWorkerPool->run(firstStripTask + mNumStrips, [&](size_t task) {
+        // The concurrent task starts first, the strips keep the other threads busy meanwhile
+        if (task < firstStripTask) {
+            taskRet = concurrentTask();
+            return;
+        }
+        size_t i = task - firstStripTask;
+        int32_t top = i * numGroups / mNumStrips * kStripRowAlignment;
+        int32_t bottom = std::min<int32_t>(
+                size.height, (i + 1) * numGroups / mNumStrips * kStripRowAlignment);
+        Size stripSize{size.width, bottom - top};
+        YCbCrLayout strip = in;
+        strip.y = static_cast<uint8_t*>(in.y) + top * in.yStride;
+        strip.cb = static_cast<uint8_t*>(in.cb) + top / 2 * in.cStride;
+        strip.cr = static_cast<uint8_t*>(in.cr) + top / 2 * in.cStride;
+        // Fits all but noise at the highest qualities, which write encodes on one thread
+        std::vector<uint8_t>& code = mStrips[i];
+        code.resize(kStripHeaderSize + stripSize.width * stripSize.height * 3 / 2);
+        stripResults[i] = encodeJpegYU12(stripSize, strip, jpegQuality, nullptr, 0, code.data(),
+                                         code.size(), mStripSizes[i], /*restartInRows*/ 1);
+    });
+
+    bool stripsFailed = std::any_of(stripResults.begin(), stripResults.end(),
+                                    [](int ret) { return ret != 0; });
+    if (stripsFailed || !parseStrips()) {
+        ALOGW("%s: cannot encode %dx%d frame in %zu strips, encoding it on one thread",
+              __FUNCTION__, size.width, size.height, mNumStrips);
+        mNumStrips = 0;
+    }
+    mEncodeTimeUs += ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+    return taskRet;
+}
+
+int JpegEncoder::write(const void* app1Buffer, size_t app1Size, void* out, size_t maxOutSize,
+                       size_t& actualCodeSize) {
+    nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (mNumStrips == 0) {
+        int ret = encodeJpegYU12(mSize, mLayout, mJpegQuality, app1Buffer, app1Size, out,
+                                 maxOutSize, actualCodeSize);
+        mSerialFrames++;
+        mEncodeTimeUs += ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+        return ret;
+    }
+
+    if (app1Buffer == nullptr) {
+        app1Size = 0;
+    }
+    if (app1Size > kMaxSegmentSize) {
+        ALOGE("%s: APP1 of %zu bytes is too large", __FUNCTION__, app1Size);
+        return -1;
+    }
+    size_t app1SegmentSize = app1Size != 0 ? 4 + app1Size : 0;
+    size_t jpegSize = mStripScanStarts[0] + app1SegmentSize + 2;
+    for (size_t i = 0; i < mNumStrips; i++) {
+        // Entropy coded data without EOI, then RST7 or EOI
+        jpegSize += mStripSizes[i] - 2 - mStripScanStarts[i] + 2;
+    }
+    if (jpegSize > maxOutSize) {
+        ALOGE("%s: JPEG of %zu bytes does not fit in %zu bytes", __FUNCTION__, jpegSize,
+              maxOutSize);
+        return -1;
+    }
+
+    uint8_t* dst = static_cast<uint8_t*>(out);
+    const uint8_t* headers = mStrips[0].data();
+    memcpy(dst, headers, mApp1Offset);
+    dst += mApp1Offset;
+    if (app1Size != 0) {
+        *dst++ = kMarker;
+        *dst++ = kApp1;
+        *dst++ = (app1Size + 2) >> 8;
+        *dst++ = (app1Size + 2) & 0xFF;
+        memcpy(dst, app1Buffer, app1Size);
+        dst += app1Size;
+    }
+    uint8_t* sofHeight = dst + (mSofHeightOffset - mApp1Offset);
+    memcpy(dst, headers + mApp1Offset, mStripScanStarts[0] - mApp1Offset);
+    dst += mStripScanStarts[0] - mApp1Offset;
+    sofHeight[0] = mSize.height >> 8;
+    sofHeight[1] = mSize.height & 0xFF;
+
+    for (size_t i = 0; i < mNumStrips; i++) {
+        size_t scanSize = mStripSizes[i] - 2 - mStripScanStarts[i];
+        memcpy(dst, mStrips[i].data() + mStripScanStarts[i], scanSize);
+        dst += scanSize;
+        *dst++ = kMarker;
+        *dst++ = i + 1 < mNumStrips ? kRst7 : kEoi;
+    }
+    actualCodeSize = dst - static_cast<uint8_t*>(out);
+
+    mStripFrames++;
+    mStripCount += mNumStrips;
+    mEncodeTimeUs += ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+    return 0;
+}
+
+void JpegEncoder::dump(int fd) const {
+    uint64_t stripFrames = mStripFrames;
+    uint64_t serialFrames = mSerialFrames;
+    uint64_t frames = stripFrames + serialFrames;
+    dprintf(fd,
+            "JPEG encoder: %d threads, %" PRIu64 " frames encoded in %.1f strips on average, "
+            "%" PRIu64 " frames on one thread, %.2f ms per frame on average\n",
+            mWorkerPool != nullptr ? mWorkerPool->getThreadCount() : 1, stripFrames,
+            stripFrames != 0 ? static_cast<double>(mStripCount) / stripFrames : 0.0, serialFrames,
+            frames != 0 ? mEncodeTimeUs / 1000.0 / frames : 0.0);
+}
+
+size_t JpegEncoder::getStripCount(const Size& size) const {
+    if (mWorkerPool == nullptr || mWorkerPool->getThreadCount() < 2 || size.width <= 0) {
+        return 0;
+    }
+    int32_t numGroups = (size.height + kStripRowAlignment - 1) / kStripRowAlignment;
+    size_t numStrips = std::min<size_t>(mWorkerPool->getThreadCount(), std::max(numGroups, 0));
+    return numStrips < 2 ? 0 : numStrips;
+}
+
+bool JpegEncoder::parseStrips() {
+    mStripScanStarts.resize(mNumStrips);
+    for (size_t i = 0; i < mNumStrips; i++) {
+        const uint8_t* data = mStrips[i].data();
+        size_t size = mStripSizes[i];
+        if (size < 4 || data[0] != kMarker || data[1] != kSoi || data[size - 2] != kMarker ||
+            data[size - 1] != kEoi) {
+            return false;
+        }
+
+        bool hasFrameHeader = false;
+        size_t pos = 2;
+        if (i == 0) {
+            mApp1Offset = pos;
+        }
+        while (true) {
+            if (pos + 4 > size || data[pos] != kMarker) {
+                return false;
+            }
+            uint8_t marker = data[pos + 1];
+            size_t length = readBigEndian16(&data[pos + 2]);
+            if (length < 2 || pos + 2 + length > size) {
+                return false;
+            }
+            if (i == 0 && marker == kApp0 && mApp1Offset == pos) {
+                // APP1 goes after the JFIF header, as written by encodeJpegYU12
+                mApp1Offset = pos + 2 + length;
+            } else if (i == 0 && marker == kSof0) {
+                mSofHeightOffset = pos + 4 + 1;  // after P
+                hasFrameHeader = true;
+            } else if (marker == kSos) {
+                mStripScanStarts[i] = pos + 2 + length;
+                break;
+            }
+            pos += 2 + length;
+        }
+        if (i == 0 && !hasFrameHeader) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace implementation
+}  // namespace device
+}  // namespace camera
+}  // namespace hardware
+}  // namespace android
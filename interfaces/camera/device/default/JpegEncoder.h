@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_INTERFACES_CAMERA_DEVICE_DEFAULT_JPEGENCODER_H_
+#define HARDWARE_INTERFACES_CAMERA_DEVICE_DEFAULT_JPEGENCODER_H_
+
+#include <ExternalCameraUtils.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace camera {
+namespace device {
+namespace implementation {
+
+using ::android::hardware::camera::external::common::Size;
+
+// Encodes YU12 frames to JPEG.
+//
+// Large frames are split into horizontal strips of a multiple of 8 MCU rows, which are encoded in
+// parallel on a WorkerPool by encodeJpegYU12 as standalone JPEGs with a restart marker after each
+// MCU row. All strips use the same quantization and Huffman tables, so the entropy coded data of
+// the strips, separated by RST7 markers, follow the headers of the first strip as the scan of the
+// whole frame. Starting each strip on a multiple of 8 MCU rows keeps the restart markers numbered
+// in sequence. Other frames are encoded on the calling thread.
+//
+// encode and write must not be called from several threads at once.
+class JpegEncoder {
+  public:
+    explicit JpegEncoder(std::shared_ptr<WorkerPool> workerPool);
+
+    // Encodes a frame, running concurrentTask (if any) on the WorkerPool along with the strips,
+    // e.g. to encode the thumbnail. The frame must stay valid until write returns. Returns 0 on
+    // success, else the error of concurrentTask.
+    int encode(const Size& size, const YCbCrLayout& in, int jpegQuality,
+               const std::function<int()>& concurrentTask);
+
+    // Writes the JPEG of the frame passed to encode, with the given APP1 segment. Returns 0 on
+    // success, same as encodeJpegYU12.
+    int write(const void* app1Buffer, size_t app1Size, void* out, size_t maxOutSize,
+              size_t& actualCodeSize);
+
+    void dump(int fd) const;
+
+  private:
+    // Returns the number of strips of a frame, 0 if it is not worth splitting
+    size_t getStripCount(const Size& size) const;
+    // Fills mStripScanStarts and mApp1Offset, returns false if the strips cannot be stitched
+    bool parseStrips();
+
+    const std::shared_ptr<WorkerPool> mWorkerPool;
+    Size mSize;
+    YCbCrLayout mLayout;
+    int mJpegQuality;
+    std::vector<std::vector<uint8_t>> mStrips;  // encoded strips, empty if encoding failed
+    std::vector<size_t> mStripSizes;
+    std::vector<size_t> mStripScanStarts;  // offset of the entropy coded data of each strip
+    size_t mApp1Offset;                    // where to insert APP1 in the headers of strip 0
+    size_t mSofHeightOffset;               // offset of the height in the SOF of strip 0
+    size_t mNumStrips = 0;                 // 0 when encoding on the calling thread in write
+
+    std::atomic<uint64_t> mStripFrames = 0;  // frames encoded in strips
+    std::atomic<uint64_t> mStripCount = 0;   // strips of these frames
+    std::atomic<uint64_t> mSerialFrames = 0;
+    std::atomic<uint64_t> mEncodeTimeUs = 0;
+};
+
+}  // namespace implementation
+}  // namespace device
+}  // namespace camera
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_INTERFACES_CAMERA_DEVICE_DEFAULT_JPEGENCODER_H_
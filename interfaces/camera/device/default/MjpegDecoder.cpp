@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ExtCamMjpegDec"
+// #define LOG_NDEBUG 0
+
+#include "MjpegDecoder.h"
+
+#include <log/log.h>
+#include <utils/Timers.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <numeric>
+
+#define HAVE_JPEG  // required for libyuv.h to export MJPEG decode APIs
+#include <libyuv.h>
+
+namespace android {
+namespace hardware {
+namespace camera {
+namespace device {
+namespace implementation {
+
+namespace {
+const uint8_t kMarker = 0xFF;
+const uint8_t kSof0 = 0xC0;  // baseline
+const uint8_t kSof1 = 0xC1;  // extended sequential, Huffman
+const uint8_t kDht = 0xC4;
+const uint8_t kJpg = 0xC8;
+const uint8_t kDac = 0xCC;
+const uint8_t kRst0 = 0xD0;
+const uint8_t kRst7 = 0xD7;
+const uint8_t kSoi = 0xD8;
+const uint8_t kEoi = 0xD9;
+const uint8_t kSos = 0xDA;
+const uint8_t kDri = 0xDD;
+const uint8_t kTem = 0x01;
+
+const int kBlockSize = 8;
+// Strips shorter than this are not worth the cost of a task
+const int32_t kMinStripHeight = 64;
+
+uint16_t readBigEndian16(const uint8_t* data) {
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+bool isRestartMarker(uint8_t marker) {
+    return marker >= kRst0 && marker <= kRst7;
+}
+}  // anonymous namespace
+
+MjpegDecoder::MjpegDecoder(std::shared_ptr<WorkerPool> workerPool)
+    : mWorkerPool(std::move(workerPool)) {}
+
+int MjpegDecoder::decodeToYU12(const uint8_t* inData, size_t inDataSize, const Size& size,
+                               const YCbCrLayout& out) {
+    nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    size_t numStrips = 0;
+    if (mWorkerPool != nullptr && mWorkerPool->getThreadCount() > 1 &&
+        parseFrame(inData, inDataSize, &mFrameInfo) && mFrameInfo.width == size.width &&
+        mFrameInfo.height == size.height) {
+        numStrips = splitFrame(inData, mFrameInfo);
+    }
+
+    int ret = 0;
+    if (numStrips == 0) {
+        ret = libyuv::MJPGToI420(inData, inDataSize, static_cast<uint8_t*>(out.y), out.yStride,
+                                 static_cast<uint8_t*>(out.cb), out.cStride,
+                                 static_cast<uint8_t*>(out.cr), out.cStride, size.width,
+                                 size.height, size.width, size.height);
+        mSerialFrames++;
+    } else {
+        mStripResults.assign(numStrips, 0);
+        mWorkerPool->run(numStrips, [&](size_t i) {
+            // Strips start on an MCU row, which is an even row
+            int32_t top = mStripRows[i];
+            int32_t height = mStripRows[i + 1] - top;
+            const std::vector<uint8_t>& strip = mStrips[i];
+            mStripResults[i] = libyuv::MJPGToI420(
+                    strip.data(), strip.size(),
+                    static_cast<uint8_t*>(out.y) + top * out.yStride, out.yStride,
+                    static_cast<uint8_t*>(out.cb) + top / 2 * out.cStride, out.cStride,
+                    static_cast<uint8_t*>(out.cr) + top / 2 * out.cStride, out.cStride,
+                    size.width, height, size.width, height);
+        });
+        for (int stripRet : mStripResults) {
+            if (stripRet != 0) {
+                ret = stripRet;
+                break;
+            }
+        }
+        mStripFrames++;
+        mStripCount += numStrips;
+    }
+    mDecodeTimeUs += ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+    return ret;
+}
+
+void MjpegDecoder::dump(int fd) const {
+    uint64_t stripFrames = mStripFrames;
+    uint64_t serialFrames = mSerialFrames;
+    uint64_t frames = stripFrames + serialFrames;
+    dprintf(fd,
+            "MJPEG decoder: %d threads, %" PRIu64 " frames decoded in %.1f strips on average, "
+            "%" PRIu64 " frames on one thread, %.2f ms per frame on average\n",
+            mWorkerPool != nullptr ? mWorkerPool->getThreadCount() : 1, stripFrames,
+            stripFrames != 0 ? static_cast<double>(mStripCount) / stripFrames : 0.0, serialFrames,
+            frames != 0 ? mDecodeTimeUs / 1000.0 / frames : 0.0);
+}
+
+bool MjpegDecoder::parseFrame(const uint8_t* data, size_t size, FrameInfo* info) {
+    if (size < 4 || data[0] != kMarker || data[1] != kSoi) {
+        return false;
+    }
+
+    bool hasFrameHeader = false;
+    info->restartInterval = 0;
+    size_t pos = 2;
+    while (true) {
+        if (pos + 4 > size || data[pos] != kMarker) {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == kMarker) {
+            pos++;  // fill byte
+            continue;
+        }
+        if (marker == kTem || isRestartMarker(marker)) {
+            pos += 2;  // no payload
+            continue;
+        }
+        if (marker == kEoi) {
+            return false;
+        }
+        size_t length = readBigEndian16(&data[pos + 2]);
+        if (length < 2 || pos + 2 + length > size) {
+            return false;
+        }
+        const uint8_t* segment = &data[pos + 4];
+        size_t segmentSize = length - 2;
+
+        if (marker == kSof0 || marker == kSof1) {
+            // P, Y, X, Nf, then Nf times (C, HV, Tq)
+            if (segmentSize < 6) {
+                return false;
+            }
+            int numComponents = segment[5];
+            if (numComponents != 3 || segmentSize < 6 + 3 * static_cast<size_t>(numComponents)) {
+                return false;
+            }
+            int maxH = 1;
+            int maxV = 1;
+            for (int i = 0; i < numComponents; i++) {
+                uint8_t sampling = segment[6 + 3 * i + 1];
+                maxH = std::max(maxH, sampling >> 4);
+                maxV = std::max(maxV, sampling & 0xF);
+            }
+            info->height = readBigEndian16(&segment[1]);
+            info->width = readBigEndian16(&segment[3]);
+            info->mcuWidth = kBlockSize * maxH;
+            info->mcuHeight = kBlockSize * maxV;
+            info->sofHeightOffset = pos + 4 + 1;
+            hasFrameHeader = true;
+        } else if (marker > kSof1 && marker <= 0xCF && marker != kDht && marker != kJpg &&
+                   marker != kDac) {
+            // Progressive, lossless, hierarchical or arithmetic coded
+            return false;
+        } else if (marker == kDri) {
+            if (segmentSize < 2) {
+                return false;
+            }
+            info->restartInterval = readBigEndian16(segment);
+        } else if (marker == kSos) {
+            // Only a single interleaved scan of all components can be split
+            if (!hasFrameHeader || segmentSize < 1 || segment[0] != 3) {
+                return false;
+            }
+            info->scanStart = pos + 2 + length;
+            break;
+        }
+        pos += 2 + length;
+    }
+
+    if (info->restartInterval == 0 || info->width <= 0 || info->height <= 0) {
+        return false;
+    }
+
+    // Locate the restart markers in the entropy coded data. 0xFF data bytes are stuffed with 0x00.
+    info->restartMarkers.clear();
+    pos = info->scanStart;
+    while (true) {
+        if (pos + 1 >= size) {
+            return false;  // truncated frame
+        }
+        const void* found = memchr(&data[pos], kMarker, size - pos - 1);
+        if (found == nullptr) {
+            return false;
+        }
+        pos = static_cast<const uint8_t*>(found) - data;
+        uint8_t marker = data[pos + 1];
+        if (marker == 0x00) {
+            pos += 2;
+        } else if (marker == kMarker) {
+            pos++;
+        } else if (isRestartMarker(marker)) {
+            info->restartMarkers.push_back(pos);
+            pos += 2;
+        } else if (marker == kEoi) {
+            info->scanEnd = pos;
+            break;
+        } else {
+            return false;  // more than one scan
+        }
+    }
+
+    // Corrupted frames are left to the serial decoder to report
+    uint64_t mcusPerRow = (info->width + info->mcuWidth - 1) / info->mcuWidth;
+    uint64_t mcuRows = (info->height + info->mcuHeight - 1) / info->mcuHeight;
+    uint64_t numIntervals = (mcusPerRow * mcuRows + info->restartInterval - 1) /
+                            info->restartInterval;
+    return info->restartMarkers.size() + 1 == numIntervals;
+}
+
+size_t MjpegDecoder::splitFrame(const uint8_t* data, const FrameInfo& info) {
+    uint64_t mcusPerRow = (info.width + info.mcuWidth - 1) / info.mcuWidth;
+    uint64_t mcuRows = (info.height + info.mcuHeight - 1) / info.mcuHeight;
+    // A strip can start on the MCU rows which start a restart interval
+    uint64_t rowStep = std::lcm(mcusPerRow, static_cast<uint64_t>(info.restartInterval)) /
+                       mcusPerRow;
+    uint64_t numSteps = (mcuRows + rowStep - 1) / rowStep;
+    uint64_t minSteps = std::max<uint64_t>(
+            1, kMinStripHeight / (rowStep * info.mcuHeight));
+    size_t numStrips = std::min<uint64_t>(mWorkerPool->getThreadCount(), numSteps / minSteps);
+    if (numStrips < 2) {
+        return 0;
+    }
+
+    mStrips.resize(numStrips);
+    mStripRows.resize(numStrips + 1);
+    for (size_t i = 0; i < numStrips; i++) {
+        uint64_t firstRow = i * numSteps / numStrips * rowStep;
+        uint64_t endRow = std::min(mcuRows, (i + 1) * numSteps / numStrips * rowStep);
+        uint64_t firstInterval = firstRow * mcusPerRow / info.restartInterval;
+        uint64_t endInterval = i + 1 < numStrips ? endRow * mcusPerRow / info.restartInterval
+                                                 : info.restartMarkers.size() + 1;
+        mStripRows[i] = firstRow * info.mcuHeight;
+        int32_t height = std::min<int32_t>(endRow * info.mcuHeight, info.height) - mStripRows[i];
+
+        // The marker before an interval is the one of index interval - 1
+        size_t start = firstInterval == 0 ? info.scanStart
+                                          : info.restartMarkers[firstInterval - 1] + 2;
+        size_t end = i + 1 < numStrips ? info.restartMarkers[endInterval - 1] : info.scanEnd;
+
+        std::vector<uint8_t>& strip = mStrips[i];
+        strip.resize(info.scanStart + (end - start) + 2);
+        memcpy(strip.data(), data, info.scanStart);
+        strip[info.sofHeightOffset] = height >> 8;
+        strip[info.sofHeightOffset + 1] = height & 0xFF;
+        uint8_t* dst = strip.data() + info.scanStart;
+        size_t cursor = start;
+        for (uint64_t m = firstInterval; m + 1 < endInterval; m++) {
+            size_t markerPos = info.restartMarkers[m];
+            memcpy(dst, data + cursor, markerPos - cursor);
+            dst += markerPos - cursor;
+            *dst++ = kMarker;
+            *dst++ = kRst0 + (m - firstInterval) % 8;
+            cursor = markerPos + 2;
+        }
+        memcpy(dst, data + cursor, end - cursor);
+        dst += end - cursor;
+        *dst++ = kMarker;
+        *dst++ = kEoi;
+    }
+    mStripRows[numStrips] = info.height;
+    return numStrips;
+}
+
+}  // namespace implementation
+}  // namespace device
+}  // namespace camera
+}  // namespace hardware
+}  // namespace android
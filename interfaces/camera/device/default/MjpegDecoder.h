@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_INTERFACES_CAMERA_DEVICE_DEFAULT_MJPEGDECODER_H_
+#define HARDWARE_INTERFACES_CAMERA_DEVICE_DEFAULT_MJPEGDECODER_H_
+
+#include <ExternalCameraUtils.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace camera {
+namespace device {
+namespace implementation {
+
+using ::android::hardware::camera::external::common::Size;
+
+// Decodes MJPEG frames to YU12.
+//
+// Baseline JPEG frames with restart markers are split at the restart markers which start an MCU
+// row into horizontal strips. Each strip is rewritten as a standalone JPEG (same tables, height of
+// the strip, restart markers renumbered from 0) and the strips are decoded in parallel on a
+// WorkerPool, directly into their rows of the output. Frames which cannot be split (no restart
+// markers, restart interval not lining up with MCU rows, progressive, ...) are decoded on the
+// calling thread.
+//
+// decodeToYU12 must not be called from several threads at once.
+class MjpegDecoder {
+  public:
+    explicit MjpegDecoder(std::shared_ptr<WorkerPool> workerPool);
+
+    // Returns 0 on success, same as libyuv::MJPGToI420
+    int decodeToYU12(const uint8_t* inData, size_t inDataSize, const Size& size,
+                     const YCbCrLayout& out);
+
+    void dump(int fd) const;
+
+  private:
+    // Layout of the first scan of a frame
+    struct FrameInfo {
+        int32_t width;
+        int32_t height;
+        int32_t mcuWidth;
+        int32_t mcuHeight;
+        uint32_t restartInterval;            // in MCUs
+        size_t sofHeightOffset;              // offset of the height in the SOF segment
+        size_t scanStart;                    // offset of the entropy coded data
+        size_t scanEnd;                      // offset of the EOI marker
+        std::vector<size_t> restartMarkers;  // offsets of the RSTn markers in the scan
+    };
+
+    static bool parseFrame(const uint8_t* data, size_t size, FrameInfo* info);
+    // Fills mStrips and mStripRows, returns the number of strips, 0 if the frame cannot be split
+    size_t splitFrame(const uint8_t* data, const FrameInfo& info);
+
+    const std::shared_ptr<WorkerPool> mWorkerPool;
+    FrameInfo mFrameInfo;
+    std::vector<std::vector<uint8_t>> mStrips;  // standalone JPEG of each strip
+    std::vector<int32_t> mStripRows;            // first pixel row of each strip, and the height
+    std::vector<int> mStripResults;
+
+    std::atomic<uint64_t> mStripFrames = 0;  // frames decoded in strips
+    std::atomic<uint64_t> mStripCount = 0;   // strips of these frames
+    std::atomic<uint64_t> mSerialFrames = 0;
+    std::atomic<uint64_t> mDecodeTimeUs = 0;
+};
+
+}  // namespace implementation
+}  // namespace device
+}  // namespace camera
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_INTERFACES_CAMERA_DEVICE_DEFAULT_MJPEGDECODER_H_
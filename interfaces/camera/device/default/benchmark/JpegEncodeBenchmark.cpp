@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Latency of the JPEG encoding of a still capture by the external camera HAL, by resolution,
+// quality and number of encoding threads. A 320x240 thumbnail is encoded along with the frame.
+
+#include <JpegEncoder.h>
+#include <benchmark/benchmark.h>
+#include <vector>
+
+using ::android::hardware::camera::device::implementation::AllocatedFrame;
+using ::android::hardware::camera::device::implementation::encodeJpegYU12;
+using ::android::hardware::camera::device::implementation::JpegEncoder;
+using ::android::hardware::camera::device::implementation::Size;
+using ::android::hardware::camera::device::implementation::WorkerPool;
+using ::android::hardware::graphics::mapper::V2_0::YCbCrLayout;
+
+namespace {
+
+const Size kThumbnailSize = {320, 240};
+// Fits in an APP1 segment
+const size_t kMaxThumbnailCodeSize = 60 * 1024;
+
+// Fills a YU12 frame with a gradient and some noise, for a realistic JPEG size
+void fillPattern(const Size& size, const YCbCrLayout& layout) {
+    uint32_t noise = 1;
+    for (int y = 0; y < size.height; y++) {
+        uint8_t* row = static_cast<uint8_t*>(layout.y) + y * layout.yStride;
+        for (int x = 0; x < size.width; x++) {
+            noise = noise * 1664525 + 1013904223;
+            row[x] = (x ^ y) + (noise >> 29);
+        }
+    }
+    for (int y = 0; y < size.height / 2; y++) {
+        uint8_t* cb = static_cast<uint8_t*>(layout.cb) + y * layout.cStride;
+        uint8_t* cr = static_cast<uint8_t*>(layout.cr) + y * layout.cStride;
+        for (int x = 0; x < size.width / 2; x++) {
+            cb[x] = x + y;
+            cr[x] = (x * y) >> 6;
+        }
+    }
+}
+
+}  // anonymous namespace
+
+/**
+ * Encodes a frame in a loop, as createJpegLocked does: the frame and the thumbnail in parallel,
+ * then the JPEG written to the output buffer. 1 thread is the single threaded libjpeg encode.
+ */
+static void BM_JpegEncode(::benchmark::State& state) {
+    const Size size{static_cast<int32_t>(state.range(0)), static_cast<int32_t>(state.range(1))};
+    const int quality = state.range(2);
+    AllocatedFrame frame(size.width, size.height);
+    AllocatedFrame thumbnail(kThumbnailSize.width, kThumbnailSize.height);
+    YCbCrLayout layout;
+    YCbCrLayout thumbnailLayout;
+    if (frame.allocate(&layout) != 0 || thumbnail.allocate(&thumbnailLayout) != 0) {
+        state.SkipWithError("cannot allocate the frames");
+        return;
+    }
+    fillPattern(size, layout);
+    fillPattern(kThumbnailSize, thumbnailLayout);
+
+    JpegEncoder encoder(std::make_shared<WorkerPool>(state.range(3)));
+    std::vector<uint8_t> thumbnailCode(kMaxThumbnailCodeSize);
+    std::vector<uint8_t> jpeg(size.width * size.height * 3);
+    size_t jpegSize = 0;
+    for (auto _ : state) {
+        size_t thumbnailSize = 0;
+        int ret = encoder.encode(size, layout, quality, [&]() {
+            return encodeJpegYU12(kThumbnailSize, thumbnailLayout, quality, nullptr, 0,
+                                  thumbnailCode.data(), thumbnailCode.size(), thumbnailSize);
+        });
+        if (ret == 0) {
+            // The thumbnail stands for the APP1 segment
+            ret = encoder.write(thumbnailCode.data(), thumbnailSize, jpeg.data(), jpeg.size(),
+                                jpegSize);
+        }
+        if (ret != 0) {
+            state.SkipWithError("encode failed");
+            break;
+        }
+    }
+    state.counters["jpeg_bytes"] = jpegSize;
+}
+
+static void JpegEncodeArgs(::benchmark::internal::Benchmark* b) {
+    b->ArgNames({"width", "height", "quality", "threads"});
+    for (int quality : {75, 90, 95}) {
+        for (int threads : {1, 2, 4}) {
+            b->Args({1280, 720, quality, threads})
+                    ->Args({1920, 1080, quality, threads})
+                    ->Args({3840, 2160, quality, threads})
+                    ->Args({4000, 3000, quality, threads});
+        }
+    }
+    b->UseRealTime()->Unit(::benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_JpegEncode)->Apply(JpegEncodeArgs);
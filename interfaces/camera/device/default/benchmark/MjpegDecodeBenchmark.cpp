@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Frame rate of the MJPEG decoder of the external camera HAL, by number of decoding threads.
+//
+// Usage: camera_external_benchmark [--clip=<file.mjpeg>]... [benchmark flags]
+//
+// A clip is a raw MJPEG stream as captured from a UVC camera, e.g. with
+//   ffmpeg -f v4l2 -input_format mjpeg -video_size 3840x2160 -i /dev/video0 -c:v copy clip.mjpeg
+// Without clips, 4K frames are synthesized with and without restart markers.
+
+#include <MjpegDecoder.h>
+#include <benchmark/benchmark.h>
+#include <jpeglib.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using ::android::hardware::camera::device::implementation::AllocatedFrame;
+using ::android::hardware::camera::device::implementation::MjpegDecoder;
+using ::android::hardware::camera::device::implementation::Size;
+using ::android::hardware::camera::device::implementation::WorkerPool;
+using ::android::hardware::graphics::mapper::V2_0::YCbCrLayout;
+
+namespace {
+
+struct Clip {
+    std::string name;
+    Size size;
+    std::vector<std::vector<uint8_t>> frames;
+};
+
+const Size kSynthesizedSize = {3840, 2160};
+const int kSynthesizedFrames = 4;
+
+bool readJpegSize(const std::vector<uint8_t>& jpeg, Size* size) {
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg.data(), jpeg.size());
+    bool ok = jpeg_read_header(&cinfo, TRUE) == JPEG_HEADER_OK;
+    size->width = cinfo.image_width;
+    size->height = cinfo.image_height;
+    jpeg_destroy_decompress(&cinfo);
+    return ok && size->width > 0 && size->height > 0;
+}
+
+// Splits a raw MJPEG stream at the start of image markers
+bool loadClip(const std::string& path, Clip* clip) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    static const uint8_t kSoi[] = {0xFF, 0xD8, 0xFF};
+    auto start = std::search(data.begin(), data.end(), std::begin(kSoi), std::end(kSoi));
+    while (start != data.end()) {
+        auto next = std::search(start + 1, data.end(), std::begin(kSoi), std::end(kSoi));
+        clip->frames.emplace_back(start, next);
+        start = next;
+    }
+    if (clip->frames.empty() || !readJpegSize(clip->frames[0], &clip->size)) {
+        fprintf(stderr, "%s: no MJPEG frames\n", path.c_str());
+        return false;
+    }
+    clip->name = path.substr(path.find_last_of('/') + 1);
+    return true;
+}
+
+// A moving pattern with enough detail for the entropy coded data to be of realistic size
+std::vector<uint8_t> synthesizeFrame(const Size& size, int index, bool restartMarkers) {
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char* buffer = nullptr;
+    unsigned long bufferSize = 0;
+    jpeg_mem_dest(&cinfo, &buffer, &bufferSize);
+    cinfo.image_width = size.width;
+    cinfo.image_height = size.height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 85, TRUE);
+    // YUV 4:2:2, as sent by most UVC cameras
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 1;
+    cinfo.restart_in_rows = restartMarkers ? 1 : 0;
+    jpeg_start_compress(&cinfo, TRUE);
+    std::vector<uint8_t> row(size.width * 3);
+    uint32_t noise = 1;
+    while (cinfo.next_scanline < cinfo.image_height) {
+        int y = cinfo.next_scanline;
+        for (int x = 0; x < size.width; x++) {
+            noise = noise * 1664525 + 1013904223;
+            row[3 * x] = ((x + index * 16) ^ y) + (noise >> 29);
+            row[3 * x + 1] = (x * y) >> 8;
+            row[3 * x + 2] = x + y + index * 8;
+        }
+        JSAMPROW rowPointer = row.data();
+        jpeg_write_scanlines(&cinfo, &rowPointer, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    std::vector<uint8_t> jpeg(buffer, buffer + bufferSize);
+    free(buffer);
+    jpeg_destroy_compress(&cinfo);
+    return jpeg;
+}
+
+Clip synthesizeClip(bool restartMarkers) {
+    Clip clip{.name = restartMarkers ? "synthetic_4k_restart" : "synthetic_4k_no_restart",
+              .size = kSynthesizedSize};
+    for (int i = 0; i < kSynthesizedFrames; i++) {
+        clip.frames.push_back(synthesizeFrame(kSynthesizedSize, i, restartMarkers));
+    }
+    return clip;
+}
+
+}  // anonymous namespace
+
+/**
+ * Decodes the frames of a clip in a loop into a YU12 frame, as the OutputThread does, with the
+ * given number of threads. 1 thread is the single threaded libyuv decode.
+ */
+static void BM_MjpegDecode(::benchmark::State& state, const Clip* clip) {
+    MjpegDecoder decoder(std::make_shared<WorkerPool>(state.range(0)));
+    AllocatedFrame frame(clip->size.width, clip->size.height);
+    YCbCrLayout layout;
+    if (frame.allocate(&layout) != 0) {
+        state.SkipWithError("cannot allocate the YU12 frame");
+        return;
+    }
+
+    size_t index = 0;
+    for (auto _ : state) {
+        const std::vector<uint8_t>& jpeg = clip->frames[index++ % clip->frames.size()];
+        if (decoder.decodeToYU12(jpeg.data(), jpeg.size(), clip->size, layout) != 0) {
+            state.SkipWithError("decode failed");
+            break;
+        }
+    }
+    state.counters["fps"] = ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+}
+
+int main(int argc, char** argv) {
+    std::vector<Clip> clips;
+    for (int i = 1; i < argc;) {
+        if (strncmp(argv[i], "--clip=", strlen("--clip=")) != 0) {
+            i++;
+            continue;
+        }
+        Clip clip;
+        if (!loadClip(argv[i] + strlen("--clip="), &clip)) {
+            return 1;
+        }
+        clips.push_back(std::move(clip));
+        std::copy(argv + i + 1, argv + argc, argv + i);
+        argc--;
+    }
+    if (clips.empty()) {
+        clips.push_back(synthesizeClip(/*restartMarkers*/ true));
+        clips.push_back(synthesizeClip(/*restartMarkers*/ false));
+    }
+
+    for (const auto& clip : clips) {
+        std::string name = "BM_MjpegDecode/" + clip.name + "/" +
+                           std::to_string(clip.size.width) + "x" +
+                           std::to_string(clip.size.height);
+        ::benchmark::RegisterBenchmark(name.c_str(), BM_MjpegDecode, &clip)
+                ->ArgName("threads")
+                ->Arg(1)
+                ->Arg(2)
+                ->Arg(4)
+                ->Arg(8)
+                ->UseRealTime()
+                ->Unit(::benchmark::kMillisecond);
+    }
+
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Latency added by the external camera HAL between a V4L2 buffer and the YU12 frame, for each
+// supported color V4L2 format. The MJPEG frames are encoded by the HAL JPEG encoder from the
+// same content as the uncompressed frames.
+
+#include <MjpegDecoder.h>
+#include <benchmark/benchmark.h>
+#include <linux/videodev2.h>
+#include <vector>
+
+#include <libyuv.h>
+
+using ::android::hardware::camera::device::implementation::AllocatedFrame;
+using ::android::hardware::camera::device::implementation::encodeJpegYU12;
+using ::android::hardware::camera::device::implementation::MjpegDecoder;
+using ::android::hardware::camera::device::implementation::Size;
+using ::android::hardware::camera::device::implementation::uncompressedToYU12;
+using ::android::hardware::camera::device::implementation::WorkerPool;
+using ::android::hardware::graphics::mapper::V2_0::YCbCrLayout;
+
+namespace {
+
+const int kJpegQuality = 85;
+
+// Fills a YU12 frame with a gradient and some noise, for a realistic JPEG size
+void fillPattern(const Size& size, const YCbCrLayout& layout) {
+    uint32_t noise = 1;
+    for (int y = 0; y < size.height; y++) {
+        uint8_t* row = static_cast<uint8_t*>(layout.y) + y * layout.yStride;
+        for (int x = 0; x < size.width; x++) {
+            noise = noise * 1664525 + 1013904223;
+            row[x] = (x ^ y) + (noise >> 29);
+        }
+    }
+    for (int y = 0; y < size.height / 2; y++) {
+        uint8_t* cb = static_cast<uint8_t*>(layout.cb) + y * layout.cStride;
+        uint8_t* cr = static_cast<uint8_t*>(layout.cr) + y * layout.cStride;
+        for (int x = 0; x < size.width / 2; x++) {
+            cb[x] = x + y;
+            cr[x] = (x * y) >> 6;
+        }
+    }
+}
+
+// Returns the V4L2 buffer content of a frame in the given format
+std::vector<uint8_t> makeInputFrame(uint32_t fourcc, const Size& size) {
+    AllocatedFrame yu12(size.width, size.height);
+    YCbCrLayout layout;
+    if (yu12.allocate(&layout) != 0) {
+        return {};
+    }
+    fillPattern(size, layout);
+
+    std::vector<uint8_t> frame;
+    switch (fourcc) {
+        case V4L2_PIX_FMT_YUYV:
+            frame.resize(size.width * size.height * 2);
+            libyuv::I420ToYUY2(static_cast<uint8_t*>(layout.y), layout.yStride,
+                               static_cast<uint8_t*>(layout.cb), layout.cStride,
+                               static_cast<uint8_t*>(layout.cr), layout.cStride, frame.data(),
+                               size.width * 2, size.width, size.height);
+            break;
+        case V4L2_PIX_FMT_NV12:
+            frame.resize(size.width * size.height * 3 / 2);
+            libyuv::I420ToNV12(static_cast<uint8_t*>(layout.y), layout.yStride,
+                               static_cast<uint8_t*>(layout.cb), layout.cStride,
+                               static_cast<uint8_t*>(layout.cr), layout.cStride, frame.data(),
+                               size.width, frame.data() + size.width * size.height, size.width,
+                               size.width, size.height);
+            break;
+        case V4L2_PIX_FMT_MJPEG: {
+            frame.resize(size.width * size.height * 3 / 2);
+            size_t jpegSize = 0;
+            if (encodeJpegYU12(size, layout, kJpegQuality, nullptr, 0, frame.data(), frame.size(),
+                               jpegSize) != 0) {
+                return {};
+            }
+            frame.resize(jpegSize);
+        } break;
+    }
+    return frame;
+}
+
+}  // anonymous namespace
+
+/**
+ * Converts a frame of the given V4L2 format to YU12 in a loop, as the OutputThread does. MJPEG
+ * frames are decoded on one thread, the encoder of the HAL does not emit restart markers.
+ */
+static void BM_V4l2ToYU12(::benchmark::State& state, uint32_t fourcc) {
+    const Size size{static_cast<int32_t>(state.range(0)), static_cast<int32_t>(state.range(1))};
+    std::vector<uint8_t> input = makeInputFrame(fourcc, size);
+    AllocatedFrame frame(size.width, size.height);
+    YCbCrLayout layout;
+    if (input.empty() || frame.allocate(&layout) != 0) {
+        state.SkipWithError("cannot create the frames");
+        return;
+    }
+    MjpegDecoder decoder(std::make_shared<WorkerPool>(1));
+
+    for (auto _ : state) {
+        int ret = fourcc == V4L2_PIX_FMT_MJPEG
+                          ? decoder.decodeToYU12(input.data(), input.size(), size, layout)
+                          : uncompressedToYU12(fourcc, input.data(), input.size(), size, layout);
+        if (ret != 0) {
+            state.SkipWithError("conversion failed");
+            break;
+        }
+    }
+    state.counters["input_bytes"] = input.size();
+}
+
+static void V4l2InputSizes(::benchmark::internal::Benchmark* b) {
+    b->ArgNames({"width", "height"})
+            ->Args({640, 480})
+            ->Args({1280, 720})
+            ->Args({1920, 1080})
+            ->Unit(::benchmark::kMicrosecond);
+}
+
+BENCHMARK_CAPTURE(BM_V4l2ToYU12, MJPEG, V4L2_PIX_FMT_MJPEG)->Apply(V4l2InputSizes);
+BENCHMARK_CAPTURE(BM_V4l2ToYU12, YUYV, V4L2_PIX_FMT_YUYV)->Apply(V4l2InputSizes);
+BENCHMARK_CAPTURE(BM_V4l2ToYU12, NV12, V4L2_PIX_FMT_NV12)->Apply(V4l2InputSizes);
@@ -22,6 +22,7 @@
 
 #include <fmq/AidlMessageQueue.h>
 #include <utils/Log.h>
+#include <optional>
 #include <thread>
 #include "Demux.h"
 
@@ -123,55 +124,44 @@ void Demux::setIptvThreadRunning(bool isIptvThreadRunning) {
     mIsIptvThreadRunningCv.notify_all();
 }
 
-void Demux::readIptvThreadLoop(dtv_plugin* interface, dtv_streamer* streamer, size_t buf_size,
-                               int timeout_ms, int buffer_timeout) {
-    Timer *timer, *fullBufferTimer;
+void Demux::readIptvThreadLoop(dtv_plugin* interface, dtv_streamer* streamer,
+                               size_t min_read_size, int timeout_ms, int buffer_timeout) {
+    // The streamer reads straight into the DVR FMQ
+    auto readStream = [&](void* buf, size_t count) {
+        return interface->read_stream(streamer, buf, count, timeout_ms);
+    };
+    // Started when the DVR FMQ gets full, cleared once it has room again
+    std::optional<Timer> fullBufferTimer;
     while (true) {
-        std::unique_lock<std::mutex> lock(mIsIptvThreadRunningMutex);
-        mIsIptvThreadRunningCv.wait(lock, [this] { return mIsIptvReadThreadRunning; });
-        if (mIsIptvDvrFMQFull && fullBufferTimer->get_elapsed_time_ms() > buffer_timeout) {
-            ALOGE("DVR FMQ has not been flushed within timeout of %d ms", buffer_timeout);
-            delete fullBufferTimer;
-            break;
+        {
+            std::unique_lock<std::mutex> lock(mIsIptvThreadRunningMutex);
+            mIsIptvThreadRunningCv.wait(lock, [this] { return mIsIptvReadThreadRunning; });
         }
-        timer = new Timer();
-        void* buf = malloc(sizeof(char) * IPTV_BUFFER_SIZE);
-        if (buf == nullptr) ALOGI("Buffer allocation failed");
-        ssize_t bytes_read = interface->read_stream(streamer, buf, buf_size, timeout_ms);
-        if (bytes_read == 0) {
-            double elapsed_time = timer->get_elapsed_time_ms();
-            if (elapsed_time > timeout_ms) {
-                ALOGE("[Demux] timeout reached - elapsed_time: %f, timeout: %d", elapsed_time,
-                      timeout_ms);
-            }
-            ALOGE("[Demux] Cannot read data from the socket");
-            delete timer;
+        if (fullBufferTimer && fullBufferTimer->get_elapsed_time_ms() > buffer_timeout) {
+            ALOGE("[Demux] DVR FMQ has not been flushed within timeout of %d ms", buffer_timeout);
             break;
         }
 
-        delete timer;
-        ALOGI("Number of bytes read: %zd", bytes_read);
-        int result = mDvrPlayback->writePlaybackFMQ(buf, bytes_read);
-
+        int result = mDvrPlayback->writePlaybackFMQ(min_read_size, readStream);
         switch (result) {
+            case DVR_WRITE_SUCCESS:
+                fullBufferTimer.reset();
+                break;
             case DVR_WRITE_FAILURE_REASON_FMQ_FULL:
-                if (!mIsIptvDvrFMQFull) {
-                    mIsIptvDvrFMQFull = true;
-                    fullBufferTimer = new Timer();
+                if (!fullBufferTimer) {
+                    ALOGW("[Demux] Waiting for client to flush DVR FMQ.");
+                    fullBufferTimer.emplace();
                 }
-                ALOGI("Waiting for client to flush DVR FMQ.");
-                break;
-            case DVR_WRITE_FAILURE_REASON_UNKNOWN:
-                ALOGE("Failed to write data into DVR FMQ for unknown reason");
-                break;
-            case DVR_WRITE_SUCCESS:
-                ALOGI("Wrote %zd bytes to DVR FMQ", bytes_read);
+                // Stop reading the socket until the DVR FMQ is read from
+                mDvrPlayback->waitForPlaybackFMQSpace(timeout_ms);
                 break;
+            case DVR_WRITE_FAILURE_REASON_NO_DATA:
+                ALOGE("[Demux] Cannot read data from the socket");
+                return;
             default:
-                ALOGI("Invalid DVR Status");
+                ALOGE("[Demux] Failed to write data into DVR FMQ for unknown reason");
+                break;
         }
-
-        free(buf);
     }
 }
 
@@ -231,7 +221,7 @@ void Demux::readIptvThreadLoop(dtv_plugin* interface, dtv_streamer* streamer, si
         int timeout_ms = 20;
         int buffer_timeout = 10000;  // 10s
         mDemuxIptvReadThread = std::thread(&Demux::readIptvThreadLoop, this, interface, streamer,
-                                           IPTV_BUFFER_SIZE, timeout_ms, buffer_timeout);
+                                           IPTV_DATAGRAM_SIZE, timeout_ms, buffer_timeout);
     }
     return ::ndk::ScopedAStatus::ok();
 }
@@ -268,6 +258,7 @@ void Demux::readIptvThreadLoop(dtv_plugin* interface, dtv_streamer* streamer, si
         // Only save non-record filters for now. Record filters are saved when the
         // IDvr.attacheFilter is called.
         mPlaybackFilterIds.insert(filterId);
+        mPidTable.invalidate();
         if (mDvrPlayback != nullptr) {
             result = mDvrPlayback->addPlaybackFilter(filterId, filter);
         }
@@ -356,6 +347,7 @@ void Demux::readIptvThreadLoop(dtv_plugin* interface, dtv_streamer* streamer, si
     mPlaybackFilterIds.clear();
     mRecordFilterIds.clear();
     mFilters.clear();
+    mPidTable.invalidate();
     mLastUsedFilterId = -1;
     if (mTuner != nullptr) {
         mTuner->removeDemux(mDemuxId);
@@ -388,24 +380,34 @@ void Demux::readIptvThreadLoop(dtv_plugin* interface, dtv_streamer* streamer, si
     mPlaybackFilterIds.erase(filterId);
     mRecordFilterIds.erase(filterId);
     mFilters.erase(filterId);
+    mPidTable.invalidate();
 
     return ::ndk::ScopedAStatus::ok();
 }
 
-void Demux::startBroadcastTsFilter(vector<int8_t> data) {
-    set<int64_t>::iterator it;
-    uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
+void Demux::startBroadcastTsFilter(std::span<const int8_t> packets, size_t packetSize) {
+    mPidTable.updateIfStale([this] {
+        for (int64_t filterId : mPlaybackFilterIds) {
+            auto filter = mFilters.find(filterId);
+            if (filter != mFilters.end() && filter->second != nullptr) {
+                mPidTable.add(filter->second);
+            }
+        }
+    });
+    size_t routed = mPidTable.dispatch(packets, packetSize);
     if (DEBUG_DEMUX) {
-        ALOGW("[Demux] start ts filter pid: %d", pid);
+        ALOGW("[Demux] routed %zu of %zu ts packets", routed, packets.size() / packetSize);
     }
-    for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
-        if (pid == mFilters[*it]->getTpid()) {
-            mFilters[*it]->updateFilterOutput(data);
-        }
+}
+
+void Demux::invalidatePidTables() {
+    mPidTable.invalidate();
+    if (mDvrPlayback != nullptr) {
+        mDvrPlayback->invalidatePidTable();
     }
 }
 
-void Demux::sendFrontendInputToRecord(vector<int8_t> data) {
+void Demux::sendFrontendInputToRecord(std::span<const int8_t> data) {
     set<int64_t>::iterator it;
     if (DEBUG_DEMUX) {
         ALOGW("[Demux] update record filter output");
@@ -415,7 +417,7 @@ void Demux::sendFrontendInputToRecord(vector<int8_t> data) {
     }
 }
 
-void Demux::sendFrontendInputToRecord(vector<int8_t> data, uint16_t pid, uint64_t pts) {
+void Demux::sendFrontendInputToRecord(std::span<const int8_t> data, uint16_t pid, uint64_t pts) {
     sendFrontendInputToRecord(data);
     set<int64_t>::iterator it;
     for (it = mRecordFilterIds.begin(); it != mRecordFilterIds.end(); it++) {
@@ -454,11 +456,12 @@ bool Demux::startRecordFilterDispatcher() {
     return mFilters[filterId]->startFilterHandler();
 }
 
-void Demux::updateFilterOutput(int64_t filterId, vector<int8_t> data) {
+void Demux::updateFilterOutput(int64_t filterId, std::span<const int8_t> data) {
     mFilters[filterId]->updateFilterOutput(data);
 }
 
-void Demux::updateMediaFilterOutput(int64_t filterId, vector<int8_t> data, uint64_t pts) {
+void Demux::updateMediaFilterOutput(int64_t filterId, std::span<const int8_t> data,
+                                    uint64_t pts) {
     updateFilterOutput(filterId, data);
     mFilters[filterId]->updatePts(pts);
 }
@@ -28,6 +28,7 @@
 #include "Dvr.h"
 #include "Filter.h"
 #include "Frontend.h"
+#include "PidDispatchTable.h"
 #include "TimeFilter.h"
 #include "Timer.h"
 #include "Tuner.h"
@@ -97,13 +98,17 @@ class Demux : public BnDemux {
     bool attachRecordFilter(int64_t filterId);
     bool detachRecordFilter(int64_t filterId);
     ::ndk::ScopedAStatus startFilterHandler(int64_t filterId);
-    void updateFilterOutput(int64_t filterId, vector<int8_t> data);
-    void updateMediaFilterOutput(int64_t filterId, vector<int8_t> data, uint64_t pts);
+    void updateFilterOutput(int64_t filterId, std::span<const int8_t> data);
+    void updateMediaFilterOutput(int64_t filterId, std::span<const int8_t> data, uint64_t pts);
     uint16_t getFilterTpid(int64_t filterId);
     void setIsRecording(bool isRecording);
     bool isRecording();
     void startFrontendInputLoop();
-    void readIptvThreadLoop(dtv_plugin* interface, dtv_streamer* streamer, size_t size,
+    /**
+     * Reads the IPTV stream into the DVR playback FMQ, min_read_size bytes at least at once. Stops
+     * reading while the FMQ is full, and ends if it stays full for buffer_timeout ms.
+     */
+    void readIptvThreadLoop(dtv_plugin* interface, dtv_streamer* streamer, size_t min_read_size,
                             int timeout_ms, int buffer_timeout);
 
     /**
@@ -112,10 +117,17 @@ class Demux : public BnDemux {
      * Note that recording filters are not included.
      */
     bool startBroadcastFilterDispatcher();
-    void startBroadcastTsFilter(vector<int8_t> data);
+    /**
+     * Routes a batch of TS packets to the playback filters of their PID.
+     */
+    void startBroadcastTsFilter(std::span<const int8_t> packets, size_t packetSize);
+    /**
+     * To be called when the PID of a filter may have changed, to rebuild the PID dispatch tables.
+     */
+    void invalidatePidTables();
 
-    void sendFrontendInputToRecord(vector<int8_t> data);
-    void sendFrontendInputToRecord(vector<int8_t> data, uint16_t pid, uint64_t pts);
+    void sendFrontendInputToRecord(std::span<const int8_t> data);
+    void sendFrontendInputToRecord(std::span<const int8_t> data, uint16_t pid, uint64_t pts);
     bool startRecordFilterDispatcher();
 
     void getDemuxInfo(DemuxInfo* demuxInfo);
@@ -178,6 +190,10 @@ class Demux : public BnDemux {
      * The array number is the filter ID.
      */
     std::map<int64_t, std::shared_ptr<Filter>> mFilters;
+    /**
+     * The playback filters by PID, used by the DVR playback thread.
+     */
+    PidDispatchTable<Filter> mPidTable;
 
     /**
      * Local reference to the opened Timer Filter instance.
@@ -194,9 +210,6 @@ class Demux : public BnDemux {
     std::thread mFrontendInputThread;
     std::thread mDemuxIptvReadThread;
 
-    // track whether the DVR FMQ for IPTV Playback is full
-    bool mIsIptvDvrFMQFull = false;
-
     /**
      * If a specific filter's writing loop is still running
      */
@@ -285,25 +285,34 @@ PlaybackStatus Dvr::checkPlaybackStatusChange(uint32_t availableToWrite, uint32_
 }
 
 bool Dvr::readPlaybackFMQ(bool isVirtualFrontend, bool isRecording) {
-    // Read playback data from the input FMQ
+    // Read all the complete playback packets of the input FMQ in one batch
     size_t size = mDvrMQ->availableToRead();
     int64_t playbackPacketSize = mDvrSettings.get<DvrSettings::Tag::playback>().packetSize;
-    vector<int8_t> dataOutputBuffer;
-    dataOutputBuffer.resize(playbackPacketSize);
-    // Dispatch the packet to the PID matching filter output buffer
-    for (int i = 0; i < size / playbackPacketSize; i++) {
-        if (!mDvrMQ->read(dataOutputBuffer.data(), playbackPacketSize)) {
-            return false;
-        }
-        if (isVirtualFrontend) {
-            if (isRecording) {
-                mDemux->sendFrontendInputToRecord(dataOutputBuffer);
-            } else {
-                mDemux->startBroadcastTsFilter(dataOutputBuffer);
-            }
+    if (playbackPacketSize <= 0) {
+        ALOGE("[Dvr] invalid playback packet size %" PRId64, playbackPacketSize);
+        return false;
+    }
+    size_t batchSize = size / playbackPacketSize * playbackPacketSize;
+    if (batchSize == 0) {
+        return true;
+    }
+    mPlaybackBuffer.resize(batchSize);
+    if (!mDvrMQ->read(mPlaybackBuffer.data(), batchSize)) {
+        return false;
+    }
+    // Lets an IPTV stream waiting for room write again
+    mDvrEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED));
+
+    // Dispatch the packets to the PID matching filter output buffers
+    std::span<const int8_t> packets(mPlaybackBuffer.data(), batchSize);
+    if (isVirtualFrontend) {
+        if (isRecording) {
+            mDemux->sendFrontendInputToRecord(packets);
         } else {
-            startTpidFilter(dataOutputBuffer);
+            mDemux->startBroadcastTsFilter(packets, playbackPacketSize);
         }
+    } else {
+        startTpidFilter(packets, playbackPacketSize);
     }
 
     return true;
@@ -397,13 +406,12 @@ bool Dvr::processEsDataOnPlayback(bool isVirtualFrontend, bool isRecording) {
     }
 
     // Read es raw data from the FMQ per meta data built previously
-    vector<int8_t> frameData;
     map<int64_t, std::shared_ptr<Filter>>::iterator it;
     int pid = 0;
     for (int i = 0; i < totalFrames; i++) {
-        frameData.resize(esMeta[i].len);
+        std::span<const int8_t> frameData(dataOutputBuffer.data() + esMeta[i].startIndex,
+                                          esMeta[i].len);
         pid = esMeta[i].isAudio ? audioPid : videoPid;
-        memcpy(frameData.data(), dataOutputBuffer.data() + esMeta[i].startIndex, esMeta[i].len);
         // Send to the media filters or record filters
         if (!isRecording) {
             for (it = mFilters.begin(); it != mFilters.end(); it++) {
@@ -416,7 +424,6 @@ bool Dvr::processEsDataOnPlayback(bool isVirtualFrontend, bool isRecording) {
             mDemux->sendFrontendInputToRecord(frameData, pid, static_cast<uint64_t>(esMeta[i].pts));
         }
         startFilterDispatcher(isVirtualFrontend, isRecording);
-        frameData.clear();
     }
 
     return true;
@@ -429,16 +436,17 @@ void Dvr::getMetaDataValue(int& index, int8_t* dataOutputBuffer, int& value) {
     }
 }
 
-void Dvr::startTpidFilter(vector<int8_t> data) {
-    map<int64_t, std::shared_ptr<Filter>>::iterator it;
-    for (it = mFilters.begin(); it != mFilters.end(); it++) {
-        uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
-        if (DEBUG_DVR) {
-            ALOGW("[Dvr] start ts filter pid: %d", pid);
-        }
-        if (pid == mDemux->getFilterTpid(it->first)) {
-            mDemux->updateFilterOutput(it->first, data);
+void Dvr::startTpidFilter(std::span<const int8_t> packets, size_t packetSize) {
+    mPidTable.updateIfStale([this] {
+        for (const auto& [filterId, filter] : mFilters) {
+            if (filter != nullptr) {
+                mPidTable.add(filter);
+            }
         }
+    });
+    size_t routed = mPidTable.dispatch(packets, packetSize);
+    if (DEBUG_DVR) {
+        ALOGW("[Dvr] routed %zu of %zu ts packets", routed, packets.size() / packetSize);
     }
 }
 
@@ -462,22 +470,46 @@ bool Dvr::startFilterDispatcher(bool isVirtualFrontend, bool isRecording) {
     return true;
 }
 
-int Dvr::writePlaybackFMQ(void* buf, size_t size) {
+int Dvr::writePlaybackFMQ(size_t minSize, const std::function<ssize_t(void*, size_t)>& read) {
     lock_guard<mutex> lock(mWriteLock);
-    ALOGI("Playback status: %d", mPlaybackStatus);
-    if (mPlaybackStatus == PlaybackStatus::SPACE_FULL) {
-        ALOGW("[Dvr] stops writing and wait for the client side flushing.");
+    size_t size = mDvrMQ->availableToWrite();
+    if (size < minSize) {
+        maySendIptvPlaybackStatusCallback();
         return DVR_WRITE_FAILURE_REASON_FMQ_FULL;
     }
-    ALOGI("availableToWrite before: %zu", mDvrMQ->availableToWrite());
-    if (mDvrMQ->write((int8_t*)buf, size)) {
-        mDvrEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_READY));
-        ALOGI("availableToWrite: %zu", mDvrMQ->availableToWrite());
-        maySendIptvPlaybackStatusCallback();
-        return DVR_WRITE_SUCCESS;
+    DvrMQ::MemTransaction tx;
+    if (!mDvrMQ->beginWrite(size, &tx)) {
+        return DVR_WRITE_FAILURE_REASON_UNKNOWN;
     }
+
+    auto first = tx.getFirstRegion();
+    ssize_t bytesRead;
+    if (first.getLength() >= minSize) {
+        bytesRead = read(first.getAddress(), first.getLength());
+    } else {
+        // A datagram can't be split between the end and the start of the FMQ
+        mPlaybackWrapBuffer.resize(minSize);
+        bytesRead = read(mPlaybackWrapBuffer.data(), minSize);
+        if (bytesRead > 0 && !tx.copyTo(mPlaybackWrapBuffer.data(), 0, bytesRead)) {
+            return DVR_WRITE_FAILURE_REASON_UNKNOWN;
+        }
+    }
+    if (bytesRead <= 0) {
+        return DVR_WRITE_FAILURE_REASON_NO_DATA;
+    }
+    if (!mDvrMQ->commitWrite(bytesRead)) {
+        return DVR_WRITE_FAILURE_REASON_UNKNOWN;
+    }
+    mDvrEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_READY));
     maySendIptvPlaybackStatusCallback();
-    return DVR_WRITE_FAILURE_REASON_UNKNOWN;
+    return DVR_WRITE_SUCCESS;
+}
+
+void Dvr::waitForPlaybackFMQSpace(int timeoutMs) {
+    uint32_t efState = 0;
+    int64_t timeoutNs = static_cast<int64_t>(timeoutMs) * 1000000;
+    mDvrEventFlag->wait(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED), &efState,
+                        timeoutNs, true /* retry on spurious wake */);
 }
 
 bool Dvr::writeRecordFMQ(const vector<int8_t>& data) {
@@ -525,11 +557,13 @@ RecordStatus Dvr::checkRecordStatusChange(uint32_t availableToWrite, uint32_t av
 
 bool Dvr::addPlaybackFilter(int64_t filterId, std::shared_ptr<Filter> filter) {
     mFilters[filterId] = filter;
+    mPidTable.invalidate();
     return true;
 }
 
 bool Dvr::removePlaybackFilter(int64_t filterId) {
     mFilters.erase(filterId);
+    mPidTable.invalidate();
     return true;
 }
 
@@ -22,10 +22,12 @@
 #include <fmq/AidlMessageQueue.h>
 #include <math.h>
 #include <atomic>
+#include <functional>
 #include <set>
 #include <thread>
 #include "Demux.h"
 #include "Frontend.h"
+#include "PidDispatchTable.h"
 #include "Tuner.h"
 
 using namespace std;
@@ -46,9 +48,12 @@ using DvrMQ = AidlMessageQueue<int8_t, SynchronizedReadWrite>;
 const int DVR_WRITE_SUCCESS = 0;
 const int DVR_WRITE_FAILURE_REASON_FMQ_FULL = 1;
 const int DVR_WRITE_FAILURE_REASON_UNKNOWN = 2;
+const int DVR_WRITE_FAILURE_REASON_NO_DATA = 3;
 
 const int TS_SIZE = 188;
-const int IPTV_BUFFER_SIZE = TS_SIZE * 7 * 8;  // defined in service_streamer_udp in cbs v3 project
+// defined in service_streamer_udp in cbs v3 project
+const int IPTV_DATAGRAM_SIZE = TS_SIZE * 7;
+const int IPTV_BUFFER_SIZE = IPTV_DATAGRAM_SIZE * 8;
 
 // Thresholds are defined to indicate how full the buffers are.
 const double HIGH_THRESHOLD_PERCENT = 0.90;
@@ -93,10 +98,26 @@ class Dvr : public BnDvr {
      * Return false is any of the above processes fails.
      */
     bool createDvrMQ();
-    int writePlaybackFMQ(void* buf, size_t size);
+    /**
+     * Reads input straight into the free space of the playback FMQ, without an intermediate
+     * buffer. read is called with a contiguous free region of the FMQ and returns the number of
+     * bytes it wrote there, or -1 on error.
+     *
+     * Returns DVR_WRITE_FAILURE_REASON_FMQ_FULL without calling read while less than minSize bytes
+     * are free, minSize being the largest size read may need at once, e.g. a datagram.
+     */
+    int writePlaybackFMQ(size_t minSize, const std::function<ssize_t(void*, size_t)>& read);
+    /**
+     * Waits until the playback FMQ has been read from, or for timeoutMs.
+     */
+    void waitForPlaybackFMQSpace(int timeoutMs);
     bool writeRecordFMQ(const std::vector<int8_t>& data);
     bool addPlaybackFilter(int64_t filterId, std::shared_ptr<Filter> filter);
     bool removePlaybackFilter(int64_t filterId);
+    /**
+     * To be called when the PID of a playback filter may have changed.
+     */
+    void invalidatePidTable() { mPidTable.invalidate(); }
     bool readPlaybackFMQ(bool isVirtualFrontend, bool isRecording);
     bool processEsDataOnPlayback(bool isVirtualFrontend, bool isRecording);
     bool startFilterDispatcher(bool isVirtualFrontend, bool isRecording);
@@ -111,6 +132,18 @@ class Dvr : public BnDvr {
     uint32_t mBufferSize;
     std::shared_ptr<IDvrCallback> mCallback;
     std::map<int64_t, std::shared_ptr<Filter>> mFilters;
+    /**
+     * mFilters by PID, used by the playback thread.
+     */
+    PidDispatchTable<Filter> mPidTable;
+    /**
+     * The packets read from the playback FMQ in one batch.
+     */
+    vector<int8_t> mPlaybackBuffer;
+    /**
+     * Holds a read which does not fit before the end of the playback FMQ, see writePlaybackFMQ.
+     */
+    vector<int8_t> mPlaybackWrapBuffer;
 
     void deleteEventFlag();
     bool readDataFromMQ();
@@ -123,10 +156,10 @@ class Dvr : public BnDvr {
     RecordStatus checkRecordStatusChange(uint32_t availableToWrite, uint32_t availableToRead,
                                          int64_t highThreshold, int64_t lowThreshold);
     /**
-     * A dispatcher to read and dispatch input data to all the started filters.
+     * Routes a batch of TS packets read from the playback FMQ to the filters of their PID.
      * Each filter handler handles the data filtering/output writing/filterEvent updating.
      */
-    void startTpidFilter(vector<int8_t> data);
+    void startTpidFilter(std::span<const int8_t> packets, size_t packetSize);
     void playbackThreadLoop();
 
     unique_ptr<DvrMQ> mDvrMQ;
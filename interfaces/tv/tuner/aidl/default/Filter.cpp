@@ -303,9 +303,18 @@ Filter::~Filter() {
 
     mFilterSettings = in_settings;
     switch (mType.mainType) {
-        case DemuxFilterMainType::TS:
-            mTpid = in_settings.get<DemuxFilterSettings::Tag::ts>().tpid;
+        case DemuxFilterMainType::TS: {
+            const auto& tsSettings = in_settings.get<DemuxFilterSettings::Tag::ts>();
+            mTpid = tsSettings.tpid;
+            if (tsSettings.filterSettings.getTag() ==
+                DemuxTsFilterSettingsFilterSettings::Tag::section) {
+                configureSectionFilter(
+                        tsSettings.filterSettings
+                                .get<DemuxTsFilterSettingsFilterSettings::Tag::section>());
+            }
+            mDemux->invalidatePidTables();
             break;
+        }
         case DemuxFilterMainType::MMTP:
             break;
         case DemuxFilterMainType::IP:
@@ -330,6 +339,12 @@ Filter::~Filter() {
     mFilterCount += 1;
     mDemux->setIptvThreadRunning(true);
 
+    {
+        // A restarted filter sends the current sections again
+        std::lock_guard<std::mutex> lock(mFilterOutputLock);
+        mSectionFilter.reset();
+    }
+
     // All the filter event callbacks in start are for testing purpose.
     switch (mType.mainType) {
         case DemuxFilterMainType::TS:
@@ -676,6 +691,15 @@ binder_status_t Filter::dump(int fd, const char** /* args */, uint32_t /* numArg
     dprintf(fd, "      mIsRecordFilter: %d\n", mIsRecordFilter);
     dprintf(fd, "      mIsUsingFMQ: %d\n", mIsUsingFMQ);
     dprintf(fd, "      mFilterThreadRunning: %d\n", (bool)mFilterThreadRunning);
+    if (mType.mainType == DemuxFilterMainType::TS &&
+        mType.subType.get<DemuxFilterSubType::Tag::tsFilterType>() == DemuxTsFilterType::SECTION) {
+        std::lock_guard<std::mutex> lock(mFilterOutputLock);
+        const SectionFilter::Stats& stats = mSectionFilter.getStats();
+        dprintf(fd,
+                "      Sections: %" PRIu64 " received, %" PRIu64 " invalid, %" PRIu64
+                " unmatched, %" PRIu64 " repeated, %" PRIu64 " bytes sent\n",
+                stats.sections, stats.invalid, stats.unmatched, stats.repeated, stats.bytesOut);
+    }
     return STATUS_OK;
 }
 
@@ -715,7 +739,7 @@ uint16_t Filter::getTpid() {
     return mTpid;
 }
 
-void Filter::updateFilterOutput(vector<int8_t>& data) {
+void Filter::updateFilterOutput(std::span<const int8_t> data) {
     std::lock_guard<std::mutex> lock(mFilterOutputLock);
     mFilterOutput.insert(mFilterOutput.end(), data.begin(), data.end());
 }
@@ -725,7 +749,7 @@ void Filter::updatePts(uint64_t pts) {
     mPts = pts;
 }
 
-void Filter::updateRecordOutput(vector<int8_t>& data) {
+void Filter::updateRecordOutput(std::span<const int8_t> data) {
     std::lock_guard<std::mutex> lock(mRecordFilterOutputLock);
     mRecordFilterOutput.insert(mRecordFilterOutput.end(), data.begin(), data.end());
 }
@@ -783,7 +807,18 @@ void Filter::updateRecordOutput(vector<int8_t>& data) {
         return ::ndk::ScopedAStatus::ok();
     }
     if (!writeSectionsAndCreateEvent(mFilterOutput)) {
-        ALOGD("[Filter] filter %" PRIu64 " fails to write into FMQ. Ending thread", mFilterId);
+        // The sections already written are not pushed again with the next output: the rest of
+        // the output is dropped, and the section which did not fit is sent on its next repetition
+        ALOGD("[Filter] filter %" PRIu64 " fails to write into FMQ. Dropping the output",
+              mFilterId);
+        mFilterOutput.clear();
+        {
+            std::lock_guard<std::mutex> lock(mFilterStatusLock);
+            if (mFilterStatus != DemuxFilterStatus::OVERFLOW) {
+                mFilterStatus = DemuxFilterStatus::OVERFLOW;
+                mCallbackScheduler.onFilterStatus(mFilterStatus);
+            }
+        }
         return ::ndk::ScopedAStatus::fromServiceSpecificError(
                 static_cast<int32_t>(Result::UNKNOWN_ERROR));
     }
@@ -1008,68 +1043,59 @@ void Filter::updateRecordOutput(vector<int8_t>& data) {
 // Read PSI (Program Specific Information) Sections from TransportStreams
 // as defined in ISO/IEC 13818-1 Section 2.4.4
 bool Filter::writeSectionsAndCreateEvent(vector<int8_t>& data) {
-    // TODO check how many sections has been read
-    ALOGD("[Filter] section handler");
-
     // Transport Stream Packets are 188 bytes long, as defined in the
     // Introduction of ISO/IEC 13818-1
-    for (int i = 0; i < data.size(); i += 188) {
-        if (mSectionSizeLeft == 0) {
-            // Location for sectionSize as defined by Section 2.4.4
-            // Note that the first 4 bytes skipped are the TsHeader
-            mSectionSizeLeft = ((static_cast<uint8_t>(data[i + 5]) & 0x0f) << 8) |
-                               static_cast<uint8_t>(data[i + 6]);
-            mSectionSizeLeft += 3;
-            if (DEBUG_FILTER) {
-                ALOGD("[Filter] section data length %d", mSectionSizeLeft);
-            }
-        }
-
-        // 184 bytes per packet is derived by subtracting the 4 byte length of
-        // the TsHeader from its 188 byte packet size
-        uint32_t endPoint = min(184u, mSectionSizeLeft);
-        // append data and check size
-        vector<int8_t>::const_iterator first = data.begin() + i + 4;
-        vector<int8_t>::const_iterator last = data.begin() + i + 4 + endPoint;
-        mSectionOutput.insert(mSectionOutput.end(), first, last);
-        // size does not match then continue
-        mSectionSizeLeft -= endPoint;
-        if (DEBUG_FILTER) {
-            ALOGD("[Filter] section data left %d", mSectionSizeLeft);
-        }
-        if (mSectionSizeLeft > 0) {
-            continue;
-        }
-
-        if (!writeDataToFilterMQ(mSectionOutput)) {
-            mSectionOutput.clear();
+    return mSectionFilter.push(data, 188, [this](const SectionFilter::Section& section) {
+        if (!writeDataToFilterMQ(section.data)) {
             return false;
         }
 
         DemuxFilterSectionEvent secEvent;
         secEvent = {
-                // temp dump meta data
-                .tableId = 0,
-                .version = 1,
-                .sectionNum = 1,
-                .dataLength = static_cast<int32_t>(mSectionOutput.size()),
+                .tableId = section.tableId,
+                .version = section.version,
+                .sectionNum = section.sectionNumber,
+                .dataLength = static_cast<int64_t>(section.data.size()),
         };
         if (DEBUG_FILTER) {
-            ALOGD("[Filter] assembled section data length %" PRIu64, secEvent.dataLength);
+            ALOGD("[Filter] section table id %d version %d number %d length %" PRIu64,
+                  secEvent.tableId, secEvent.version, secEvent.sectionNum, secEvent.dataLength);
         }
 
-        {
-            std::lock_guard<std::mutex> lock(mFilterEventsLock);
-            mFilterEvents.push_back(
-                    DemuxFilterEvent::make<DemuxFilterEvent::Tag::section>(secEvent));
+        std::lock_guard<std::mutex> lock(mFilterEventsLock);
+        mFilterEvents.push_back(DemuxFilterEvent::make<DemuxFilterEvent::Tag::section>(secEvent));
+        return true;
+    });
+}
+
+void Filter::configureSectionFilter(const DemuxFilterSectionSettings& settings) {
+    SectionFilter::Settings sectionSettings;
+    sectionSettings.checkCrc = settings.isCheckCrc;
+    switch (settings.condition.getTag()) {
+        case DemuxFilterSectionSettingsCondition::Tag::tableInfo: {
+            const auto& tableInfo =
+                    settings.condition.get<DemuxFilterSectionSettingsCondition::Tag::tableInfo>();
+            sectionSettings.tableId = tableInfo.tableId;
+            if (tableInfo.version != static_cast<int32_t>(Constant::INVALID_TABINFO_VERSION)) {
+                sectionSettings.version = tableInfo.version;
+            }
+            break;
+        }
+        case DemuxFilterSectionSettingsCondition::Tag::sectionBits: {
+            const auto& bits =
+                    settings.condition.get<DemuxFilterSectionSettingsCondition::Tag::sectionBits>();
+            sectionSettings.filter.assign(bits.filter.begin(), bits.filter.end());
+            sectionSettings.mask.assign(bits.mask.begin(), bits.mask.end());
+            sectionSettings.mode.assign(bits.mode.begin(), bits.mode.end());
+            break;
         }
-        mSectionOutput.clear();
     }
 
-    return true;
+    std::lock_guard<std::mutex> lock(mFilterOutputLock);
+    mSectionFilter.configure(std::move(sectionSettings));
 }
 
-bool Filter::writeDataToFilterMQ(const std::vector<int8_t>& data) {
+bool Filter::writeDataToFilterMQ(std::span<const int8_t> data) {
     std::lock_guard<std::mutex> lock(mWriteLock);
     if (mFilterMQ->write(data.data(), data.size())) {
         return true;
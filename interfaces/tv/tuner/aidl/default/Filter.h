@@ -29,11 +29,13 @@
 #include <atomic>
 #include <condition_variable>
 #include <set>
+#include <span>
 #include <thread>
 
 #include "Demux.h"
 #include "Dvr.h"
 #include "Frontend.h"
+#include "SectionFilter.h"
 
 using namespace std;
 
@@ -136,8 +138,8 @@ class Filter : public BnFilter {
      */
     bool createFilterMQ();
     uint16_t getTpid();
-    void updateFilterOutput(vector<int8_t>& data);
-    void updateRecordOutput(vector<int8_t>& data);
+    void updateFilterOutput(std::span<const int8_t> data);
+    void updateRecordOutput(std::span<const int8_t> data);
     void updatePts(uint64_t pts);
     ::ndk::ScopedAStatus startFilterHandler();
     ::ndk::ScopedAStatus startRecordFilterHandler();
@@ -209,9 +211,10 @@ class Filter : public BnFilter {
     ::ndk::ScopedAStatus startFilterLoop();
 
     void deleteEventFlag();
-    bool writeDataToFilterMQ(const std::vector<int8_t>& data);
+    bool writeDataToFilterMQ(std::span<const int8_t> data);
     bool readDataFromMQ();
     bool writeSectionsAndCreateEvent(vector<int8_t>& data);
+    void configureSectionFilter(const DemuxFilterSectionSettings& settings);
     void maySendFilterStatusCallback();
     DemuxFilterStatus checkFilterStatusChange(uint32_t availableToWrite, uint32_t availableToRead,
                                               uint32_t highThreshold, uint32_t lowThreshold);
@@ -258,9 +261,8 @@ class Filter : public BnFilter {
     std::mutex mFilterOutputLock;
     std::mutex mRecordFilterOutputLock;
 
-    // handle single Section filter
-    uint32_t mSectionSizeLeft = 0;
-    vector<int8_t> mSectionOutput;
+    // Reassembles, validates and deduplicates the sections, protected by mFilterOutputLock
+    SectionFilter mSectionFilter;
 
     // temp handle single PES filter
     // TODO handle mulptiple Pes filters
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+const int TS_PID_COUNT = 8192;
+
+/**
+ * Routes the TS packets of a batch to the filters of their PID.
+ *
+ * Each of the 8192 PIDs indexes the list of filters configured with it, so routing a packet is
+ * one lookup rather than a comparison with the PID of every filter. The table is owned by the
+ * dispatching thread, which rebuilds it before a batch once it has been invalidated, e.g. when a
+ * filter is added, removed or configured.
+ *
+ * FilterT needs updateFilterOutput(std::span<const int8_t>) and getTpid().
+ */
+template <typename FilterT>
+class PidDispatchTable {
+  public:
+    PidDispatchTable() { mSlots.fill(0); }
+
+    /**
+     * Marks the table to be rebuilt before the next batch. Can be called from any thread.
+     */
+    void invalidate() { mStale = true; }
+
+    /**
+     * Rebuilds the table if it has been invalidated. addFilters is called to add the filters
+     * again, with add(filter).
+     */
+    template <typename AddFilters>
+    void updateIfStale(AddFilters addFilters) {
+        if (!mStale.exchange(false)) {
+            return;
+        }
+        for (const auto& list : mLists) {
+            mSlots[list.pid] = 0;
+        }
+        mLists.clear();
+        addFilters();
+    }
+
+    void add(const std::shared_ptr<FilterT>& filter) {
+        uint16_t pid = filter->getTpid() % TS_PID_COUNT;
+        if (mSlots[pid] == 0) {
+            mLists.push_back({.pid = pid});
+            mSlots[pid] = mLists.size();
+        }
+        mLists[mSlots[pid] - 1].filters.push_back(filter);
+    }
+
+    /**
+     * Appends the packets to the output of the filters of their PID, a run of consecutive packets
+     * of the same PID at once. Returns the number of packets routed to at least one filter.
+     */
+    size_t dispatch(std::span<const int8_t> packets, size_t packetSize) {
+        size_t numPackets = packets.size() / packetSize;
+        size_t routed = 0;
+        size_t first = 0;
+        while (first < numPackets) {
+            uint16_t pid = getPid(&packets[first * packetSize]);
+            size_t end = first + 1;
+            while (end < numPackets && getPid(&packets[end * packetSize]) == pid) {
+                end++;
+            }
+            if (mSlots[pid] != 0) {
+                std::span<const int8_t> run =
+                        packets.subspan(first * packetSize, (end - first) * packetSize);
+                for (const auto& filter : mLists[mSlots[pid] - 1].filters) {
+                    filter->updateFilterOutput(run);
+                }
+                routed += end - first;
+            }
+            first = end;
+        }
+        return routed;
+    }
+
+    static uint16_t getPid(const int8_t* packet) {
+        return ((packet[1] & 0x1f) << 8) | (packet[2] & 0xff);
+    }
+
+  private:
+    struct FilterList {
+        uint16_t pid;
+        std::vector<std::shared_ptr<FilterT>> filters;
+    };
+
+    // 1 + index in mLists of the filters of each PID, 0 for none
+    std::array<uint16_t, TS_PID_COUNT> mSlots;
+    std::vector<FilterList> mLists;
+    std::atomic<bool> mStale = true;
+};
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
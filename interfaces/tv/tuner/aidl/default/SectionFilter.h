@@ -0,0 +1,339 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+const uint32_t CRC32_MPEG2_POLYNOMIAL = 0x04C11DB7;
+
+/**
+ * Tables of the slice-by-8 CRC32/MPEG-2: table k gives the CRC of a byte followed by k zero bytes.
+ */
+constexpr std::array<std::array<uint32_t, 256>, 8> makeCrc32Mpeg2Tables() {
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i << 24;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ CRC32_MPEG2_POLYNOMIAL : crc << 1;
+        }
+        tables[0][i] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t prev = tables[k - 1][i];
+            tables[k][i] = (prev << 8) ^ tables[0][prev >> 24];
+        }
+    }
+    return tables;
+}
+
+inline constexpr std::array<std::array<uint32_t, 256>, 8> CRC32_MPEG2_TABLES =
+        makeCrc32Mpeg2Tables();
+
+inline uint32_t readBigEndian32(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+/**
+ * CRC32/MPEG-2 of ISO/IEC 13818-1 Annex A, 8 bytes per step. The CRC of a section including its
+ * CRC_32 field is 0 when the section is intact.
+ */
+inline uint32_t crc32Mpeg2(std::span<const uint8_t> data, uint32_t crc = 0xFFFFFFFF) {
+    const auto& t = CRC32_MPEG2_TABLES;
+    const uint8_t* p = data.data();
+    size_t size = data.size();
+    for (; size >= 8; p += 8, size -= 8) {
+        uint32_t a = crc ^ readBigEndian32(p);
+        crc = t[7][a >> 24] ^ t[6][(a >> 16) & 0xff] ^ t[5][(a >> 8) & 0xff] ^ t[4][a & 0xff] ^
+              t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; size > 0; p++, size--) {
+        crc = (crc << 8) ^ t[0][(crc >> 24) ^ *p];
+    }
+    return crc;
+}
+
+/**
+ * Reassembles the PSI sections carried by the TS packets of a PID, as defined in ISO/IEC 13818-1
+ * Section 2.4.4, and keeps the new ones which match the filter.
+ *
+ * A long section (section_syntax_indicator set) is new unless the last one received with the same
+ * table_id, table_id_extension, section_number and current_next_indicator had the same version and
+ * CRC, so the repetitions of a table which has not changed are dropped. Short sections, which have
+ * no version, are all new. New long sections with a wrong CRC are dropped if checkCrc is set.
+ *
+ * Not thread safe.
+ */
+class SectionFilter {
+  public:
+    struct Settings {
+        bool checkCrc = true;
+        // table_id to match, -1 for any
+        int tableId = -1;
+        // version_number to match, -1 for any
+        int version = -1;
+        // Positive or negative match of the masked bits of table_id and of the bytes following
+        // section_length, as the section filters of Linux DVB
+        std::vector<uint8_t> filter;
+        std::vector<uint8_t> mask;
+        std::vector<uint8_t> mode;
+    };
+
+    struct Section {
+        std::span<const int8_t> data;
+        uint8_t tableId;
+        uint8_t version;
+        uint8_t sectionNumber;
+    };
+
+    struct Stats {
+        uint64_t sections = 0;
+        uint64_t invalid = 0;  // too short or with a wrong CRC
+        uint64_t unmatched = 0;
+        uint64_t repeated = 0;
+        uint64_t bytesOut = 0;
+    };
+
+    /**
+     * Also forgets the sections received so far.
+     */
+    void configure(Settings settings) {
+        mSettings = std::move(settings);
+        reset();
+    }
+
+    /**
+     * Forgets the sections received so far, so they are all new again.
+     */
+    void reset() {
+        mSection.clear();
+        mLastContinuityCounter = -1;
+        mVersions.clear();
+    }
+
+    /**
+     * Reassembles the sections of TS packets of packetSize bytes and calls onSection(Section) for
+     * each new matching section, which stops if it returns false. Returns false if it did.
+     */
+    template <typename OnSection>
+    bool push(std::span<const int8_t> packets, size_t packetSize, OnSection onSection) {
+        for (size_t i = 0; i + packetSize <= packets.size(); i += packetSize) {
+            if (!pushPacket(reinterpret_cast<const uint8_t*>(&packets[i]), onSection)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const Stats& getStats() const { return mStats; }
+
+  private:
+    static const size_t TS_HEADER_SIZE = 4;
+    static const size_t TS_PAYLOAD_END = 188;
+    static const size_t SECTION_HEADER_SIZE = 3;
+    static const size_t MAX_SECTION_SIZE = 4096;
+    static const uint8_t STUFFING_BYTE = 0xFF;
+
+    template <typename OnSection>
+    bool pushPacket(const uint8_t* packet, OnSection& onSection) {
+        bool unitStart = packet[1] & 0x40;
+        uint8_t adaptationFieldControl = (packet[3] >> 4) & 0x3;
+        int continuityCounter = packet[3] & 0x0f;
+        if (!(adaptationFieldControl & 0x1)) {
+            return true;
+        }
+        // A repeated packet is skipped, a gap loses the section being reassembled
+        if (continuityCounter == mLastContinuityCounter) {
+            return true;
+        }
+        if (mLastContinuityCounter >= 0 &&
+            continuityCounter != ((mLastContinuityCounter + 1) & 0xf)) {
+            mSection.clear();
+        }
+        mLastContinuityCounter = continuityCounter;
+
+        size_t start = TS_HEADER_SIZE;
+        if (adaptationFieldControl & 0x2) {
+            start += 1 + packet[TS_HEADER_SIZE];
+        }
+        if (start >= TS_PAYLOAD_END) {
+            return true;
+        }
+        const uint8_t* payload = packet + start;
+        size_t size = TS_PAYLOAD_END - start;
+        if (!unitStart) {
+            return !mSection.empty() ? append(payload, size, false, onSection) : true;
+        }
+
+        // The pointer_field gives where the first section starting in the packet is
+        size_t pointer = payload[0];
+        if (1 + pointer > size) {
+            mSection.clear();
+            return true;
+        }
+        if (!mSection.empty() && !append(payload + 1, pointer, false, onSection)) {
+            return false;
+        }
+        mSection.clear();
+        return append(payload + 1 + pointer, size - 1 - pointer, true, onSection);
+    }
+
+    /**
+     * Appends bytes to the section being reassembled. Sections may follow each other until
+     * stuffing if startsSections is set.
+     */
+    template <typename OnSection>
+    bool append(const uint8_t* data, size_t size, bool startsSections, OnSection& onSection) {
+        while (size > 0) {
+            if (mSection.empty()) {
+                if (!startsSections || data[0] == STUFFING_BYTE) {
+                    return true;
+                }
+                mSectionSize = 0;
+            }
+            size_t needed = (mSectionSize != 0 ? mSectionSize : SECTION_HEADER_SIZE) -
+                            mSection.size();
+            size_t count = std::min(needed, size);
+            mSection.insert(mSection.end(), data, data + count);
+            data += count;
+            size -= count;
+            if (mSectionSize == 0 && mSection.size() == SECTION_HEADER_SIZE) {
+                mSectionSize =
+                        SECTION_HEADER_SIZE + (((mSection[1] & 0x0f) << 8) | mSection[2]);
+                if (mSectionSize > MAX_SECTION_SIZE) {
+                    mSection.clear();
+                    return true;
+                }
+            }
+            if (mSectionSize != 0 && mSection.size() == mSectionSize) {
+                bool keepGoing = processSection(onSection);
+                mSection.clear();
+                if (!keepGoing) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template <typename OnSection>
+    bool processSection(OnSection& onSection) {
+        mStats.sections++;
+        const uint8_t* s = mSection.data();
+        size_t size = mSection.size();
+        bool isLong = s[1] & 0x80;
+        // Header, extension and CRC_32 of a long section
+        if (isLong && size < 12) {
+            mStats.invalid++;
+            return true;
+        }
+
+        uint8_t version = isLong ? (s[5] >> 1) & 0x1f : 0;
+        if (!matches(version)) {
+            mStats.unmatched++;
+            return true;
+        }
+        // table_id, table_id_extension, section_number and current_next_indicator
+        uint64_t key = 0;
+        uint64_t value = 0;
+        if (isLong) {
+            key = (static_cast<uint64_t>(s[0]) << 32) | (static_cast<uint32_t>(s[3]) << 24) |
+                  (s[4] << 16) | (s[6] << 8) | (s[5] & 0x1);
+            value = (static_cast<uint64_t>(version) << 32) | readBigEndian32(&s[size - 4]);
+            auto it = mVersions.find(key);
+            if (it != mVersions.end() && it->second == value) {
+                mStats.repeated++;
+                return true;
+            }
+            // Only the sections to send are checked, a repetition is dropped even if corrupted
+            if (mSettings.checkCrc && crc32Mpeg2(mSection) != 0) {
+                mStats.invalid++;
+                return true;
+            }
+        }
+
+        bool keepGoing = onSection(Section{
+                .data = std::span<const int8_t>(reinterpret_cast<const int8_t*>(s), size),
+                .tableId = s[0],
+                .version = version,
+                .sectionNumber = isLong ? s[6] : static_cast<uint8_t>(0),
+        });
+        // A section which could not be sent is still new
+        if (keepGoing) {
+            if (isLong) {
+                mVersions[key] = value;
+            }
+            mStats.bytesOut += size;
+        }
+        return keepGoing;
+    }
+
+    bool matches(uint8_t version) const {
+        const uint8_t* s = mSection.data();
+        if (mSettings.tableId >= 0 && s[0] != mSettings.tableId) {
+            return false;
+        }
+        if (mSettings.version >= 0 && version != mSettings.version) {
+            return false;
+        }
+        // The filter bytes match table_id, then the bytes following section_length. The masked
+        // bits of mode set to 0 must equal the filter, and if some are set to 1, at least one of
+        // them must differ from it
+        size_t filterSize = std::min(mSettings.filter.size(), mSettings.mask.size());
+        bool hasNegativeMatch = false;
+        bool differs = false;
+        for (size_t i = 0; i < filterSize; i++) {
+            size_t offset = i == 0 ? 0 : i + 2;
+            if (offset >= mSection.size()) {
+                return false;
+            }
+            uint8_t mode = i < mSettings.mode.size() ? mSettings.mode[i] : 0;
+            uint8_t diff = (s[offset] ^ mSettings.filter[i]) & mSettings.mask[i];
+            if ((diff & ~mode) != 0) {
+                return false;
+            }
+            hasNegativeMatch |= (mSettings.mask[i] & mode) != 0;
+            differs |= (diff & mode) != 0;
+        }
+        return !hasNegativeMatch || differs;
+    }
+
+    Settings mSettings;
+    std::vector<uint8_t> mSection;
+    size_t mSectionSize = 0;  // 0 until section_length has been read
+    int mLastContinuityCounter = -1;
+    // Version and CRC of the last long section received for each key, see processSection
+    std::unordered_map<uint64_t, uint64_t> mVersions;
+    Stats mStats;
+};
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,333 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Sustained bitrate of the IPTV ingest of the default tuner HAL, from the dtv_plugin streamer into
+// the DVR playback FMQ drained by the demux: with the streamer reading straight into the FMQ, and
+// with the former copy through a buffer allocated for each read.
+//
+// Usage: tuner_hal_example_iptv_benchmark [--ts=<file.ts>] [benchmark flags]
+//
+// The streamer is stood in for by a local socket fed with datagrams of 7 TS packets, as
+// service_streamer_udp receives them, and by a file. Loopback UDP drops the datagrams which do
+// not fit in its socket buffer, so the socket is an AF_UNIX SOCK_SEQPACKET pair, which keeps the
+// datagram boundaries but blocks the sender instead. Without a stream, a 1 MB one is synthesized.
+//
+// bytes_per_second is the bitrate read by the demux. Bytes of the stream which did not fit in the
+// FMQ are counted as dropped.
+
+#include <aidl/android/hardware/tv/tuner/DemuxQueueNotifyBits.h>
+#include <benchmark/benchmark.h>
+#include <fmq/AidlMessageQueue.h>
+#include <fmq/EventFlag.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Timer.h"
+
+using ::aidl::android::hardware::common::fmq::SynchronizedReadWrite;
+using ::aidl::android::hardware::tv::tuner::DemuxQueueNotifyBits;
+using ::android::AidlMessageQueue;
+using ::android::hardware::EventFlag;
+
+namespace {
+
+using DvrMQ = AidlMessageQueue<int8_t, SynchronizedReadWrite>;
+
+// As in Dvr.h
+const size_t kTsSize = 188;
+const size_t kDatagramSize = kTsSize * 7;
+const size_t kBufferSize = kDatagramSize * 8;
+
+const size_t kSynthesizedSize = 1024 * 1024;
+const int64_t kWaitTimeoutNs = 20 * 1000000;  // timeout_ms of Demux::setFrontendDataSource
+
+std::vector<int8_t> gStream;
+
+// Stands for the dtv_plugin streamer
+class Source {
+  public:
+    virtual ~Source() = default;
+    // Same as dtv_plugin::read_stream
+    virtual ssize_t read(void* buf, size_t count) = 0;
+};
+
+// Datagrams of the stream sent on a local socket by another thread, as fast as they are read
+class DatagramSource : public Source {
+  public:
+    DatagramSource() {
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, mFds) != 0) {
+            mFds[0] = mFds[1] = -1;
+            return;
+        }
+        mSender = std::thread([this] {
+            size_t offset = 0;
+            while (true) {
+                size_t size = std::min(kDatagramSize, gStream.size() - offset);
+                if (send(mFds[1], &gStream[offset], size, MSG_NOSIGNAL) < 0) {
+                    return;
+                }
+                offset = (offset + size) % gStream.size();
+            }
+        });
+    }
+    ~DatagramSource() override {
+        if (mSender.joinable()) {
+            shutdown(mFds[0], SHUT_RDWR);
+            mSender.join();
+        }
+        for (int fd : mFds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+    bool isValid() const { return mFds[0] >= 0; }
+    ssize_t read(void* buf, size_t count) override { return recv(mFds[0], buf, count, 0); }
+
+  private:
+    int mFds[2];
+    std::thread mSender;
+};
+
+// The stream in a file, read from in a loop
+class FileSource : public Source {
+  public:
+    FileSource() : mFd(memfd_create("iptv_stream", 0)) {
+        if (mFd >= 0 && write(mFd, gStream.data(), gStream.size()) !=
+                                static_cast<ssize_t>(gStream.size())) {
+            close(mFd);
+            mFd = -1;
+        }
+    }
+    ~FileSource() override {
+        if (mFd >= 0) {
+            close(mFd);
+        }
+    }
+    bool isValid() const { return mFd >= 0; }
+    ssize_t read(void* buf, size_t count) override {
+        count = std::min(count, gStream.size() - mOffset);
+        ssize_t size = pread(mFd, buf, count, mOffset);
+        if (size > 0) {
+            mOffset = (mOffset + size) % gStream.size();
+        }
+        return size;
+    }
+
+  private:
+    int mFd;
+    size_t mOffset = 0;
+};
+
+// The DVR playback FMQ and the demux thread which reads whole packets from it
+class Dvr {
+  public:
+    Dvr() : mMQ(kBufferSize, true) {
+        if (!mMQ.isValid() ||
+            EventFlag::createEventFlag(mMQ.getEventFlagWord(), &mEventFlag) != ::android::OK) {
+            mEventFlag = nullptr;
+            return;
+        }
+        mReader = std::thread([this] {
+            std::vector<int8_t> packets(kBufferSize);
+            while (mReading) {
+                uint32_t efState = 0;
+                mEventFlag->wait(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_READY),
+                                 &efState, kWaitTimeoutNs, true);
+                size_t size = mMQ.availableToRead() / kTsSize * kTsSize;
+                if (size == 0 || !mMQ.read(packets.data(), size)) {
+                    continue;
+                }
+                mEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED));
+                mBytesRead += size;
+            }
+        });
+    }
+    ~Dvr() {
+        if (mReader.joinable()) {
+            mReading = false;
+            mReader.join();
+        }
+        if (mEventFlag != nullptr) {
+            EventFlag::deleteEventFlag(&mEventFlag);
+        }
+    }
+    bool isValid() const { return mEventFlag != nullptr; }
+    uint64_t getBytesRead() const { return mBytesRead; }
+
+    DvrMQ mMQ;
+    EventFlag* mEventFlag = nullptr;
+    std::mutex mWriteLock;
+
+  private:
+    std::thread mReader;
+    std::atomic<bool> mReading = true;
+    std::atomic<uint64_t> mBytesRead = 0;
+};
+
+/**
+ * One read of the former Demux::readIptvThreadLoop: a Timer and a buffer allocated, the stream
+ * read into the buffer and copied into the FMQ by the former Dvr::writePlaybackFMQ, the data being
+ * lost if it does not fit. Returns the number of bytes lost.
+ */
+size_t copyIngest(Dvr& dvr, Source& source) {
+    Timer* timer = new Timer();
+    void* buf = malloc(kBufferSize);
+    ssize_t size = source.read(buf, kBufferSize);
+    delete timer;
+    size_t dropped = 0;
+    if (size > 0) {
+        std::lock_guard<std::mutex> lock(dvr.mWriteLock);
+        if (dvr.mMQ.write(static_cast<int8_t*>(buf), size)) {
+            dvr.mEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_READY));
+        } else {
+            dropped = size;
+        }
+    }
+    free(buf);
+    return dropped;
+}
+
+/**
+ * The stream read straight into the FMQ, as Dvr::writePlaybackFMQ does. Returns false if the FMQ
+ * is full.
+ */
+bool writePlaybackFMQ(Dvr& dvr, Source& source, std::vector<int8_t>& wrapBuffer) {
+    std::lock_guard<std::mutex> lock(dvr.mWriteLock);
+    size_t size = dvr.mMQ.availableToWrite();
+    DvrMQ::MemTransaction tx;
+    if (size < kDatagramSize || !dvr.mMQ.beginWrite(size, &tx)) {
+        return false;
+    }
+    auto first = tx.getFirstRegion();
+    ssize_t bytesRead;
+    if (first.getLength() >= kDatagramSize) {
+        bytesRead = source.read(first.getAddress(), first.getLength());
+    } else {
+        wrapBuffer.resize(kDatagramSize);
+        bytesRead = source.read(wrapBuffer.data(), kDatagramSize);
+        if (bytesRead > 0 && !tx.copyTo(wrapBuffer.data(), 0, bytesRead)) {
+            return true;
+        }
+    }
+    if (bytesRead > 0 && dvr.mMQ.commitWrite(bytesRead)) {
+        dvr.mEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_READY));
+    }
+    return true;
+}
+
+/**
+ * One read of Demux::readIptvThreadLoop: writePlaybackFMQ, or a wait for the demux to read from
+ * the FMQ if it is full.
+ */
+void zeroCopyIngest(Dvr& dvr, Source& source, std::vector<int8_t>& wrapBuffer) {
+    if (!writePlaybackFMQ(dvr, source, wrapBuffer)) {
+        uint32_t efState = 0;
+        dvr.mEventFlag->wait(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED),
+                             &efState, kWaitTimeoutNs, true);
+    }
+}
+
+// 0 for the socket, 1 for the file
+std::unique_ptr<Source> createSource(int type) {
+    if (type == 0) {
+        auto source = std::make_unique<DatagramSource>();
+        return source->isValid() ? std::move(source) : nullptr;
+    }
+    auto source = std::make_unique<FileSource>();
+    return source->isValid() ? std::move(source) : nullptr;
+}
+
+void reportBitrate(::benchmark::State& state, const Dvr& dvr, size_t dropped) {
+    state.SetBytesProcessed(dvr.getBytesRead());
+    state.counters["dropped"] = ::benchmark::Counter(dropped, ::benchmark::Counter::kIsRate);
+}
+
+}  // anonymous namespace
+
+static void BM_ZeroCopyIngest(::benchmark::State& state) {
+    std::unique_ptr<Source> source = createSource(state.range(0));
+    Dvr dvr;
+    if (source == nullptr || !dvr.isValid()) {
+        state.SkipWithError("cannot open the stream or the FMQ");
+        return;
+    }
+    std::vector<int8_t> wrapBuffer;
+    for (auto _ : state) {
+        zeroCopyIngest(dvr, *source, wrapBuffer);
+    }
+    reportBitrate(state, dvr, 0);
+}
+
+static void BM_CopyIngest(::benchmark::State& state) {
+    std::unique_ptr<Source> source = createSource(state.range(0));
+    Dvr dvr;
+    if (source == nullptr || !dvr.isValid()) {
+        state.SkipWithError("cannot open the stream or the FMQ");
+        return;
+    }
+    size_t dropped = 0;
+    for (auto _ : state) {
+        dropped += copyIngest(dvr, *source);
+    }
+    reportBitrate(state, dvr, dropped);
+}
+
+static void IngestArgs(::benchmark::internal::Benchmark* b) {
+    b->ArgName("source")->Arg(0)->Arg(1)->UseRealTime()->MinTime(2);
+}
+
+BENCHMARK(BM_ZeroCopyIngest)->Apply(IngestArgs);
+BENCHMARK(BM_CopyIngest)->Apply(IngestArgs);
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--ts=", strlen("--ts=")) != 0) {
+            continue;
+        }
+        std::ifstream file(argv[i] + strlen("--ts="), std::ios::binary);
+        gStream.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (gStream.size() < kDatagramSize) {
+            fprintf(stderr, "%s: stream too short\n", argv[i]);
+            return 1;
+        }
+        std::copy(argv + i + 1, argv + argc, argv + i);
+        argc--;
+        break;
+    }
+    if (gStream.empty()) {
+        gStream.resize(kSynthesizedSize / kTsSize * kTsSize);
+        for (size_t i = 0; i < gStream.size(); i += kTsSize) {
+            gStream[i] = 0x47;
+        }
+    }
+
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::benchmark::Shutdown();
+    return 0;
+}
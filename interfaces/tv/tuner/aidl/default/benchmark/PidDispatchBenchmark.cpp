@@ -0,0 +1,268 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Packets per second routed by the default tuner HAL from the DVR playback buffer to the filters
+// of their PID, with the PID dispatch table and with the former scan of all the filters.
+//
+// Usage: tuner_hal_example_benchmark [--ts=<file.ts>]... [benchmark flags]
+//
+// A stream is a recorded transport stream of 188 byte packets, e.g. captured with
+//   dvbsnoop -s ts -b 0x2000 > stream.ts
+// Without streams, a 40 Mbps like multiplex is synthesized: one video, two audio and the SI PIDs.
+// Filters are opened on the PIDs of the stream, then on unused PIDs up to the filter count.
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PidDispatchTable.h"
+
+using ::aidl::android::hardware::tv::tuner::PidDispatchTable;
+
+namespace {
+
+const size_t kTsSize = 188;
+const int8_t kSyncByte = 0x47;
+const size_t kSynthesizedPackets = 20000;
+
+struct Stream {
+    std::string name;
+    std::vector<int8_t> packets;
+    std::vector<uint16_t> pids;  // in order of decreasing packet count
+};
+
+// Stands for Filter: appends the routed packets to its output
+class FakeFilter {
+  public:
+    explicit FakeFilter(uint16_t tpid) : mTpid(tpid) {}
+
+    uint16_t getTpid() { return mTpid; }
+    void updateFilterOutput(std::span<const int8_t> data) {
+        mOutput.insert(mOutput.end(), data.begin(), data.end());
+    }
+    // Done by the filter handlers after each batch
+    void clearOutput() { mOutput.clear(); }
+
+  private:
+    uint16_t mTpid;
+    std::vector<int8_t> mOutput;
+};
+
+uint16_t getPid(const int8_t* packet) {
+    return ((packet[1] & 0x1f) << 8) | (packet[2] & 0xff);
+}
+
+void sortPidsByCount(Stream* stream) {
+    std::map<uint16_t, size_t> counts;
+    for (size_t i = 0; i < stream->packets.size(); i += kTsSize) {
+        counts[getPid(&stream->packets[i])]++;
+    }
+    for (const auto& [pid, count] : counts) {
+        stream->pids.push_back(pid);
+    }
+    std::sort(stream->pids.begin(), stream->pids.end(),
+              [&](uint16_t a, uint16_t b) { return counts[a] > counts[b]; });
+}
+
+// Keeps the packets which start with a sync byte
+bool loadStream(const std::string& path, Stream* stream) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<int8_t> data((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+    for (size_t i = 0; i + kTsSize <= data.size();) {
+        if (data[i] != kSyncByte) {
+            i++;
+            continue;
+        }
+        stream->packets.insert(stream->packets.end(), data.begin() + i,
+                               data.begin() + i + kTsSize);
+        i += kTsSize;
+    }
+    if (stream->packets.empty()) {
+        fprintf(stderr, "%s: no TS packets\n", path.c_str());
+        return false;
+    }
+    stream->name = path.substr(path.find_last_of('/') + 1);
+    sortPidsByCount(stream);
+    return true;
+}
+
+Stream synthesizeStream() {
+    // PID and share of the packets, in 1/1000
+    const std::pair<uint16_t, int> kPids[] = {
+            {0x100, 860},  // video
+            {0x101, 40},   // audio
+            {0x102, 40},   // audio
+            {0x12, 30},    // EIT
+            {0x1fff, 20},  // null
+            {0x0, 3},      // PAT
+            {0x20, 3},     // PMT
+            {0x11, 2},     // SDT
+            {0x14, 2},     // TDT
+    };
+    Stream stream{.name = "synthetic"};
+    uint32_t noise = 1;
+    while (stream.packets.size() < kSynthesizedPackets * kTsSize) {
+        noise = noise * 1664525 + 1013904223;
+        int share = (noise >> 8) % 1000;
+        uint16_t pid = kPids[0].first;
+        for (const auto& [candidate, candidateShare] : kPids) {
+            if (share < candidateShare) {
+                pid = candidate;
+                break;
+            }
+            share -= candidateShare;
+        }
+        // Video comes in runs of packets, as a PES spans many of them
+        int run = pid == kPids[0].first ? 8 : 1;
+        for (int r = 0; r < run; r++) {
+            int8_t packet[kTsSize] = {kSyncByte, static_cast<int8_t>(0x40 | (pid >> 8)),
+                                      static_cast<int8_t>(pid & 0xff), 0x10};
+            stream.packets.insert(stream.packets.end(), std::begin(packet), std::end(packet));
+        }
+    }
+    sortPidsByCount(&stream);
+    return stream;
+}
+
+std::vector<std::shared_ptr<FakeFilter>> openFilters(const Stream& stream, size_t count) {
+    std::vector<std::shared_ptr<FakeFilter>> filters;
+    for (size_t i = 0; i < count; i++) {
+        // Then unused PIDs, from the top of the range
+        uint16_t pid = i < stream.pids.size() ? stream.pids[i] : 0x1ffe - i;
+        filters.push_back(std::make_shared<FakeFilter>(pid));
+    }
+    return filters;
+}
+
+}  // anonymous namespace
+
+/**
+ * Routes the packets of a stream in batches with the PID dispatch table, as Dvr::startTpidFilter
+ * does.
+ */
+static void BM_PidDispatchTable(::benchmark::State& state, const Stream* stream) {
+    auto filters = openFilters(*stream, state.range(0));
+    const size_t batchSize = state.range(1) * kTsSize;
+    PidDispatchTable<FakeFilter> table;
+    table.updateIfStale([&] {
+        for (const auto& filter : filters) {
+            table.add(filter);
+        }
+    });
+
+    size_t offset = 0;
+    size_t packets = 0;
+    for (auto _ : state) {
+        size_t size = std::min(batchSize, stream->packets.size() - offset);
+        packets += size / kTsSize;
+        table.dispatch(std::span<const int8_t>(&stream->packets[offset], size), kTsSize);
+        offset = (offset + size) % stream->packets.size();
+        for (const auto& filter : filters) {
+            filter->clearOutput();
+        }
+    }
+    state.counters["pps"] = ::benchmark::Counter(packets, ::benchmark::Counter::kIsRate);
+}
+
+/**
+ * Routes the packets of a stream one at a time, copied by value and compared with the PID of
+ * every filter of a map, as the former Dvr::startTpidFilter did.
+ */
+static void BM_FilterScan(::benchmark::State& state, const Stream* stream) {
+    auto filters = openFilters(*stream, state.range(0));
+    const size_t batchSize = state.range(1) * kTsSize;
+    std::map<int64_t, std::shared_ptr<FakeFilter>> filterMap;
+    for (size_t i = 0; i < filters.size(); i++) {
+        filterMap[i] = filters[i];
+    }
+    auto startTpidFilter = [&](std::vector<int8_t> data) {
+        for (auto it = filterMap.begin(); it != filterMap.end(); it++) {
+            uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
+            if (pid == it->second->getTpid()) {
+                it->second->updateFilterOutput(data);
+            }
+        }
+    };
+
+    size_t offset = 0;
+    size_t packets = 0;
+    std::vector<int8_t> packet(kTsSize);
+    for (auto _ : state) {
+        size_t size = std::min(batchSize, stream->packets.size() - offset);
+        packets += size / kTsSize;
+        for (size_t i = 0; i < size; i += kTsSize) {
+            memcpy(packet.data(), &stream->packets[offset + i], kTsSize);
+            startTpidFilter(packet);
+        }
+        offset = (offset + size) % stream->packets.size();
+        for (const auto& filter : filters) {
+            filter->clearOutput();
+        }
+    }
+    state.counters["pps"] = ::benchmark::Counter(packets, ::benchmark::Counter::kIsRate);
+}
+
+static void DispatchArgs(::benchmark::internal::Benchmark* b) {
+    b->ArgNames({"filters", "batch"});
+    for (int filters : {4, 16, 64}) {
+        for (int batch : {7, 256}) {
+            b->Args({filters, batch});
+        }
+    }
+    b->Unit(::benchmark::kMicrosecond);
+}
+
+int main(int argc, char** argv) {
+    std::vector<Stream> streams;
+    for (int i = 1; i < argc;) {
+        if (strncmp(argv[i], "--ts=", strlen("--ts=")) != 0) {
+            i++;
+            continue;
+        }
+        Stream stream;
+        if (!loadStream(argv[i] + strlen("--ts="), &stream)) {
+            return 1;
+        }
+        streams.push_back(std::move(stream));
+        std::copy(argv + i + 1, argv + argc, argv + i);
+        argc--;
+    }
+    if (streams.empty()) {
+        streams.push_back(synthesizeStream());
+    }
+
+    for (const auto& stream : streams) {
+        ::benchmark::RegisterBenchmark(("BM_PidDispatchTable/" + stream.name).c_str(),
+                                       BM_PidDispatchTable, &stream)
+                ->Apply(DispatchArgs);
+        ::benchmark::RegisterBenchmark(("BM_FilterScan/" + stream.name).c_str(), BM_FilterScan,
+                                       &stream)
+                ->Apply(DispatchArgs);
+    }
+
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "SectionFilter.h"
+
+using ::aidl::android::hardware::tv::tuner::crc32Mpeg2;
+using ::aidl::android::hardware::tv::tuner::SectionFilter;
+
+namespace {
+
+const size_t kTsSize = 188;
+const uint16_t kPid = 0x10;
+
+std::vector<uint8_t> makeLongSection(uint8_t tableId, uint16_t extension, uint8_t version,
+                                     uint8_t number, size_t payloadSize) {
+    std::vector<uint8_t> section = {tableId,
+                                    0,
+                                    0,
+                                    static_cast<uint8_t>(extension >> 8),
+                                    static_cast<uint8_t>(extension),
+                                    static_cast<uint8_t>(0xC1 | (version << 1)),
+                                    number,
+                                    number};
+    for (size_t i = 0; i < payloadSize; i++) {
+        section.push_back(static_cast<uint8_t>(i * 7 + number));
+    }
+    size_t sectionLength = section.size() - 3 + 4;
+    section[1] = 0xB0 | (sectionLength >> 8);
+    section[2] = sectionLength & 0xFF;
+    uint32_t crc = crc32Mpeg2(section);
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        section.push_back(crc >> shift);
+    }
+    return section;
+}
+
+std::vector<uint8_t> makeShortSection(uint8_t tableId, size_t payloadSize) {
+    std::vector<uint8_t> section = {tableId, static_cast<uint8_t>(0x70 | (payloadSize >> 8)),
+                                    static_cast<uint8_t>(payloadSize)};
+    section.resize(section.size() + payloadSize, 0x5A);
+    return section;
+}
+
+// Packets of the sections, which follow each other from the start of the first packet. The
+// packets in which a section starts have a pointer_field to the first one.
+class Packetizer {
+  public:
+    std::vector<int8_t> packetize(const std::vector<std::vector<uint8_t>>& sections) {
+        std::vector<uint8_t> payload;
+        std::vector<size_t> starts;
+        for (const auto& section : sections) {
+            starts.push_back(payload.size());
+            payload.insert(payload.end(), section.begin(), section.end());
+        }
+        std::vector<int8_t> stream;
+        for (size_t pos = 0; pos < payload.size();) {
+            uint8_t packet[kTsSize];
+            memset(packet, 0xFF, kTsSize);
+            auto start = std::lower_bound(starts.begin(), starts.end(), pos);
+            bool unitStart = start != starts.end() && *start < pos + kTsSize - 5;
+            packet[0] = 0x47;
+            packet[1] = (unitStart ? 0x40 : 0x00) | (kPid >> 8);
+            packet[2] = kPid & 0xFF;
+            packet[3] = 0x10 | mContinuityCounter++ % 16;
+            size_t offset = 4;
+            if (unitStart) {
+                packet[offset++] = *start - pos;
+            }
+            size_t size = std::min(kTsSize - offset, payload.size() - pos);
+            memcpy(packet + offset, &payload[pos], size);
+            pos += size;
+            stream.insert(stream.end(), packet, packet + kTsSize);
+        }
+        return stream;
+    }
+
+  private:
+    int mContinuityCounter = 0;
+};
+
+std::vector<uint8_t> toBytes(const SectionFilter::Section& section) {
+    return std::vector<uint8_t>(section.data.begin(), section.data.end());
+}
+
+// Pushes the stream and returns the sections sent
+std::vector<std::vector<uint8_t>> push(SectionFilter& filter, const std::vector<int8_t>& stream) {
+    std::vector<std::vector<uint8_t>> sent;
+    EXPECT_TRUE(filter.push(stream, kTsSize, [&](const SectionFilter::Section& section) {
+        sent.push_back(toBytes(section));
+        return true;
+    }));
+    return sent;
+}
+
+}  // anonymous namespace
+
+TEST(SectionFilterTest, Crc32Mpeg2CheckValue) {
+    const std::string check = "123456789";
+    EXPECT_EQ(0x0376E6E7u, crc32Mpeg2(std::span<const uint8_t>(
+                                   reinterpret_cast<const uint8_t*>(check.data()), check.size())));
+    // Longer than a slice, with a tail
+    const std::vector<uint8_t> section = makeLongSection(0x42, 1, 0, 0, 29);
+    EXPECT_EQ(0u, crc32Mpeg2(section));
+}
+
+TEST(SectionFilterTest, SendsSectionWithItsHeaderFields) {
+    SectionFilter filter;
+    Packetizer packetizer;
+    const std::vector<uint8_t> section = makeLongSection(0x42, 0x1234, 5, 3, 20);
+    std::vector<SectionFilter::Section> sent;
+    std::vector<uint8_t> data;
+    EXPECT_TRUE(filter.push(packetizer.packetize({section}), kTsSize,
+                            [&](const SectionFilter::Section& s) {
+                                sent.push_back(s);
+                                data = toBytes(s);
+                                return true;
+                            }));
+    ASSERT_EQ(1u, sent.size());
+    EXPECT_EQ(0x42, sent[0].tableId);
+    EXPECT_EQ(5, sent[0].version);
+    EXPECT_EQ(3, sent[0].sectionNumber);
+    EXPECT_EQ(section, data);
+}
+
+TEST(SectionFilterTest, ReassemblesSectionsAcrossAndWithinPackets) {
+    SectionFilter filter;
+    Packetizer packetizer;
+    // Over 3 packets, then 3 sections which share packets
+    const std::vector<std::vector<uint8_t>> sections = {
+            makeLongSection(0x50, 1, 0, 0, 500), makeLongSection(0x50, 1, 0, 1, 10),
+            makeShortSection(0x70, 5), makeLongSection(0x50, 1, 0, 2, 10)};
+    EXPECT_EQ(sections, push(filter, packetizer.packetize(sections)));
+}
+
+TEST(SectionFilterTest, DropsRepeatedSections) {
+    SectionFilter filter;
+    Packetizer packetizer;
+    const std::vector<std::vector<uint8_t>> carousel = {makeLongSection(0x00, 1, 0, 0, 8),
+                                                        makeLongSection(0x02, 1, 0, 0, 30)};
+    EXPECT_EQ(carousel, push(filter, packetizer.packetize(carousel)));
+    for (int cycle = 0; cycle < 3; cycle++) {
+        EXPECT_TRUE(push(filter, packetizer.packetize(carousel)).empty());
+    }
+    EXPECT_EQ(8u, filter.getStats().sections);
+    EXPECT_EQ(6u, filter.getStats().repeated);
+}
+
+TEST(SectionFilterTest, SendsChangedSections) {
+    SectionFilter filter;
+    Packetizer packetizer;
+    const std::vector<uint8_t> first = makeLongSection(0x02, 1, 0, 0, 30);
+    push(filter, packetizer.packetize({first}));
+
+    // A new version, a section of another extension or number, and a new content with the same
+    // version, which changes the CRC
+    const std::vector<uint8_t> newVersion = makeLongSection(0x02, 1, 1, 0, 30);
+    const std::vector<uint8_t> newExtension = makeLongSection(0x02, 2, 1, 0, 30);
+    const std::vector<uint8_t> newNumber = makeLongSection(0x02, 1, 1, 1, 30);
+    const std::vector<uint8_t> newContent = makeLongSection(0x02, 1, 1, 0, 31);
+    for (const auto& section : {newVersion, newExtension, newNumber, newContent}) {
+        EXPECT_EQ(std::vector<std::vector<uint8_t>>{section},
+                  push(filter, packetizer.packetize({section})));
+    }
+    // Back to the first version
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>{first},
+              push(filter, packetizer.packetize({first})));
+}
+
+TEST(SectionFilterTest, SendsAllShortSections) {
+    SectionFilter filter;
+    Packetizer packetizer;
+    const std::vector<uint8_t> section = makeShortSection(0x70, 5);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(std::vector<std::vector<uint8_t>>{section},
+                  push(filter, packetizer.packetize({section})));
+    }
+}
+
+TEST(SectionFilterTest, DropsCorruptedSections) {
+    std::vector<uint8_t> corrupted = makeLongSection(0x42, 1, 0, 0, 40);
+    corrupted[20] ^= 0x01;
+    // Too short for the header, extension and CRC of a long section
+    const std::vector<uint8_t> truncated = {0x42, 0xB0, 0x05, 0x00, 0x01, 0xC1, 0x00, 0x00};
+
+    SectionFilter filter;
+    Packetizer packetizer;
+    EXPECT_TRUE(push(filter, packetizer.packetize({corrupted, truncated})).empty());
+    EXPECT_EQ(2u, filter.getStats().invalid);
+
+    SectionFilter unchecked;
+    SectionFilter::Settings settings;
+    settings.checkCrc = false;
+    unchecked.configure(settings);
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>{corrupted},
+              push(unchecked, packetizer.packetize({corrupted})));
+}
+
+TEST(SectionFilterTest, DropsSectionWithContinuityGap) {
+    SectionFilter filter;
+    Packetizer packetizer;
+    std::vector<int8_t> stream = packetizer.packetize({makeLongSection(0x50, 1, 0, 0, 400)});
+    // The second of the 3 packets is lost
+    stream.erase(stream.begin() + kTsSize, stream.begin() + 2 * kTsSize);
+    EXPECT_TRUE(push(filter, stream).empty());
+
+    // A repeated packet is skipped
+    const std::vector<uint8_t> section = makeLongSection(0x50, 1, 0, 1, 400);
+    stream = packetizer.packetize({section});
+    stream.insert(stream.begin() + kTsSize, stream.begin(), stream.begin() + kTsSize);
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>{section}, push(filter, stream));
+}
+
+TEST(SectionFilterTest, MatchesTableIdAndVersion) {
+    SectionFilter filter;
+    SectionFilter::Settings settings;
+    settings.tableId = 0x4E;
+    settings.version = 2;
+    filter.configure(settings);
+    Packetizer packetizer;
+    const std::vector<uint8_t> match = makeLongSection(0x4E, 1, 2, 0, 10);
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>{match},
+              push(filter, packetizer.packetize({makeLongSection(0x4F, 1, 2, 0, 10),
+                                                 makeLongSection(0x4E, 1, 3, 0, 10), match})));
+    EXPECT_EQ(2u, filter.getStats().unmatched);
+}
+
+TEST(SectionFilterTest, MatchesSectionBits) {
+    SectionFilter filter;
+    // table_id 0x4E or 0x4F, and table_id_extension high byte other than 0x12
+    SectionFilter::Settings settings;
+    settings.filter = {0x4E, 0x12};
+    settings.mask = {0xFE, 0xFF};
+    settings.mode = {0x00, 0xFF};
+    filter.configure(settings);
+    Packetizer packetizer;
+    const std::vector<uint8_t> match = makeLongSection(0x4F, 0x1334, 0, 0, 10);
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>{match},
+              push(filter, packetizer.packetize({makeLongSection(0x50, 0x1334, 0, 0, 10),
+                                                 makeLongSection(0x4E, 0x1234, 0, 0, 10), match})));
+}
+
+TEST(SectionFilterTest, SendsAgainSectionsWhichCouldNotBeSent) {
+    SectionFilter filter;
+    Packetizer packetizer;
+    const std::vector<std::vector<uint8_t>> sections = {makeLongSection(0x42, 1, 0, 0, 10),
+                                                        makeLongSection(0x42, 1, 0, 1, 10),
+                                                        makeLongSection(0x42, 1, 0, 2, 10)};
+    // The second section does not fit: the push stops there
+    std::vector<std::vector<uint8_t>> sent;
+    EXPECT_FALSE(filter.push(packetizer.packetize(sections), kTsSize,
+                             [&](const SectionFilter::Section& section) {
+                                 if (sent.size() == 1) {
+                                     return false;
+                                 }
+                                 sent.push_back(toBytes(section));
+                                 return true;
+                             }));
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>{sections[0]}, sent);
+    // On the next repetition, only the sections not sent yet are sent
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>(sections.begin() + 1, sections.end()),
+              push(filter, packetizer.packetize(sections)));
+}
+
+TEST(SectionFilterTest, ResetForgetsSections) {
+    SectionFilter filter;
+    Packetizer packetizer;
+    const std::vector<uint8_t> section = makeLongSection(0x42, 1, 0, 0, 10);
+    push(filter, packetizer.packetize({section}));
+    filter.reset();
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>{section},
+              push(filter, packetizer.packetize({section})));
+}